@@ -35,6 +35,8 @@
 #include <loggers/console_logger.h>
 #include <loggers/file_logger.h>
 #include <processes/launch_process.h>
+#include <structures/byte_hasher.h>
+#include <structures/hash_table.h>
 #include <structures/static_memory_gremlin.h>
 #include <structures/string_table.h>
 #include <textual/byte_formatter.h>
@@ -44,7 +46,6 @@
 
 #include <stdio.h>
 #include <sys/stat.h>
-#include <zlib.h>
 //#ifdef __WIN32__
   //#include <io.h>
 //#endif
@@ -60,8 +61,13 @@ using namespace structures;
 using namespace textual;
 using namespace timely;
 
-const int CHUNKING_SIZE = 256 * KILOBYTE;
-  // we'll read this big a chunk from a source file at a time.
+const int BATCH_BLOCKS_PER_THREAD = 4;
+  // how many blocks each compression thread gets in a batch.  the batches
+  // limit the memory used, since only one batch is held at a time.
+
+const un_int CONTENT_CUT_MASK = 0xFFFFC000;
+  // a content chunk ends where the rolling hash has none of these bits set.
+  // past the minimum size, that happens about every 256 KB.
 
 const astring SUBVERSION_FOLDER = ".svn";
   // we don't want to include this in a bundle.
@@ -95,6 +101,116 @@ struct bundled_chunk : manifest_chunk
 
 ////////////////////////////////////////////////////////////////////////////
 
+// identifies the contents of a block, or of a whole file, well enough that
+// two with the same key can be treated as the same.
+
+struct content_key
+{
+  checksums::wide_hash _hash;  //!< the main hash of the contents.
+  checksums::wide_hash _check;  //!< a second hash seeded with the size.
+
+  content_key() : _hash(0), _check(0) {}
+
+  content_key(const byte_array &data)
+      : _hash(checksums::wide_hash_bytes(data.observe(), data.length())),
+        _check(checksums::wide_hash_bytes(data.observe(), data.length(),
+            data.length() + 1)) {}
+
+  bool operator ==(const content_key &to_compare) const
+  { return (_hash == to_compare._hash) && (_check == to_compare._check); }
+};
+
+// says which block of which manifest item holds some contents.
+
+struct block_place
+{
+  int _owner;  //!< the manifest item.
+  int _place;  //!< which of the item's blocks it is.
+
+  block_place(int owner = 0, int place = 0) : _owner(owner), _place(place) {}
+};
+
+////////////////////////////////////////////////////////////////////////////
+
+// reads a file one block at a time.  the blocks are either a fixed size or
+// are cut where the contents say to, which lets the same run of bytes turn
+// into the same blocks even when it's at different offsets in two files.
+
+class block_reader
+{
+public:
+  block_reader(byte_filer &source, bool content_chunks)
+      : _source(source), _content_chunks(content_chunks) {}
+
+  int next(byte_array &block);
+    //!< reads the next "block", returning its size, or zero at the end.
+    /*!< a negative value means the file could not be read. */
+
+private:
+  byte_filer &_source;  //!< where the blocks come from.
+  bool _content_chunks;  //!< true if the contents decide where blocks end.
+  byte_array _pending;  //!< data that's been read but not handed out.
+
+  static const un_int *gear_table();
+    //!< the random values that feed the rolling hash, one for each byte.
+  int find_cut() const;
+    //!< returns where the first block of the _pending data should end.
+};
+
+const un_int *block_reader::gear_table()
+{
+  static un_int table[256];
+  static bool initialized = false;
+  if (!initialized) {
+    // any well scattered values will do, since only the bundle creator
+    // decides where the blocks are cut.
+    un_int seed = 0x5bd1e995;
+    for (int i = 0; i < 256; i++) {
+      seed = seed * 1103515245 + 12345;
+      table[i] = seed ^ (seed >> 15);
+    }
+    initialized = true;
+  }
+  return table;
+}
+
+int block_reader::find_cut() const
+{
+  if (_pending.length() <= CONTENT_CHUNK_MINIMUM) return _pending.length();
+  const un_int *gear = gear_table();
+  // each byte shifts the hash over, so only the last 32 bytes matter and
+  // there's no need to start any earlier than that.
+  un_int hash = 0;
+  for (int i = CONTENT_CHUNK_MINIMUM - 32; i < _pending.length(); i++) {
+    hash = (hash << 1) + gear[_pending[i]];
+    if ( (i >= CONTENT_CHUNK_MINIMUM) && !(hash & CONTENT_CUT_MASK) )
+      return i + 1;
+  }
+  return _pending.length();  // no cut found, so this is a full block.
+}
+
+int block_reader::next(byte_array &block)
+{
+  if (!_content_chunks) return _source.read(block, BUNDLE_BLOCK_SIZE);
+  // keep a whole block's worth on hand, so the cut can be anywhere in it.
+  if (_pending.length() < BUNDLE_BLOCK_SIZE) {
+    byte_array more;
+    int ret = _source.read(more, BUNDLE_BLOCK_SIZE - _pending.length());
+    if (ret < 0) return ret;
+    _pending += more;
+  }
+  int cut = find_cut();
+  if (!cut) {
+    block.reset();
+    return 0;
+  }
+  block = _pending.subarray(0, cut - 1);
+  _pending.zap(0, cut - 1);
+  return cut;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
 // main bundler class.
 
 class bundle_creator : public application_shell
@@ -103,10 +219,12 @@ public:
   bundle_creator()
       : application_shell(),
         _app_name(filename(_global_argv[0]).basename()),
-        _bundle(NULL_POINTER), _stub_size(0), _keyword() {}
+        _bundle(NULL_POINTER), _stub_size(0), _keyword(),
+        _crew(new block_crew), _content_chunks(false) {}
 
   virtual ~bundle_creator() {
     WHACK(_bundle);
+    WHACK(_crew);
   }
 
   DEFINE_CLASS_NAME("bundle_creator");
@@ -127,9 +245,18 @@ public:
   int write_stub_and_toc();
     //!< stuffs the unpacker stub into output file and table of contents.
 
+  int write_toc();
+    //!< writes the table of contents at the current position in the bundle.
+
   int bundle_sources();
     //!< reads all of the input files and dumps them into the bundle.
 
+  int store_batch(block_batch &batch, array<block_place> &places);
+    //!< compresses the "batch" of blocks and writes them into the bundle.
+    /*!< the "places" say which block of which manifest item each block is.
+    the item's block list is updated with where the block went, and both
+    lists are emptied. */
+
   int finalize_file();
     //!< puts finishing touches on the output file and closes it.
 
@@ -168,6 +295,8 @@ private:
   byte_filer *_bundle;  //!< points at the bundled output file.
   int _stub_size;  //!< where the TOC will be located.
   astring _keyword;  // set if we were given a keyword on cmd line.
+  block_crew *_crew;  //!< compresses the blocks on all processors.
+  bool _content_chunks;  //!< true if blocks are cut by their contents.
 };
 
 ////////////////////////////////////////////////////////////////////////////
@@ -181,6 +310,10 @@ must point at a valid manifest file that defines what will be packed into\n\
 the output file.  See the example manifest in the bundler example\n\
 (in setup_src/bundle_example) for more information on the required file\n\
 format.\n\
+    Blocks of data that occur more than once are only stored once.  Passing\n\
+the --content_chunks flag cuts the files into blocks based on what's in\n\
+them, which finds more of the repeats when files share only some of their\n\
+contents, at the cost of a larger table of contents.\n\
 ", _app_name.s()));
   return 4;
 }
@@ -228,6 +361,9 @@ Abandoning bundling process.\n", _app_name.s()));
   // make sure we snag any keyword that was passed on the command line.
   cmds.get_value("keyword", _keyword);
 
+  int indy = 0;
+  _content_chunks = cmds.find("content_chunks", indy);
+
   // first step is to provide some built-in variables that can be used to
   // make the manifests less platform specific.  this doesn't really help
   // if you bundle it on linux and try to run it on windows.  but either
@@ -780,6 +916,21 @@ int bundle_creator::write_stub_and_toc()
   stubby.close();
   _bundle->write(whole_stub);
 
+  // the files get room for all their blocks now, so the table of contents
+  // can be written again with the real block locations once they're known.
+  for (int i = 0; i < _manifest_list.length(); i++) {
+    bundled_chunk &curr = _manifest_list[i];
+    if (curr._flags & (SET_VARIABLE | TEST_VARIABLE_DEFINED | OMIT_PACKING))
+      continue;
+    curr._blocks.reset(manifest_chunk::blocks_needed(curr._size,
+        _content_chunks));
+  }
+  return write_toc();
+}
+
+int bundle_creator::write_toc()
+{
+  FUNCDEF("write_toc");
   byte_array packed_toc_len;
   structures::obscure_attach(packed_toc_len, _manifest_list.length());
   int ret = _bundle->write(packed_toc_len);
@@ -812,6 +963,28 @@ int bundle_creator::bundle_sources()
   // go through all the source files and append them to the bundled output.
   file_logger noisy_logfile(application_configuration::make_logfile_name
       ("bundle_creator_activity.log"));
+  time_stamp started;
+  double total_size = 0;
+  double duplicate_size = 0;  // the bytes that didn't need to be stored.
+  int duplicate_blocks = 0;
+  int duplicate_files = 0;
+  block_batch batch;  // the blocks waiting to be compressed.
+  array<block_place> places;  // where each block in the batch belongs.
+  const int batch_size = _crew->threads() * BATCH_BLOCKS_PER_THREAD;
+
+  // every block's contents are remembered, so a block that's already been
+  // stored can just be listed again.  the copies are filled in once all the
+  // stored blocks have found their places in the bundle.
+  int estimated_blocks = 0;
+  for (int i = 0; i < _manifest_list.length(); i++)
+    estimated_blocks += _manifest_list[i]._blocks.length();
+  hash_table<content_key, block_place> stored(rotating_byte_hasher(),
+      maximum(1, estimated_blocks));
+  hash_table<content_key, int> files(rotating_byte_hasher(),
+      maximum(1, _manifest_list.length()));
+  array<block_place> copies;  // blocks that repeat an earlier one...
+  array<block_place> originals;  // and the earlier ones they repeat.
+
   for (int i = 0; i < _manifest_list.length(); i++) {
     bundled_chunk &curr = _manifest_list[i];
 
@@ -838,85 +1011,131 @@ int bundle_creator::bundle_sources()
       return 98;
     }
 
-    byte_array compressed(256 * KILOBYTE);  // expand the buffer to start with.
-    byte_array temp;  // temporary read buffer.
-
-    // chew on the file a chunk at a time.  this allows us to easily handle
+    // chew on the file a block at a time.  this allows us to easily handle
     // arbitrarily large files rather than reading their entirety into memory.
-    int total_written = 0;
-    do {
-      int ret = source.read(temp, CHUNKING_SIZE);
+    // the blocks from several small files can share a batch.
+    block_reader reader(source, _content_chunks);
+    content_key whole_file;  // built up from the keys of all the blocks.
+    int total_read = 0;
+    for (int b = 0; ; b++) {
+      block_job *job = new block_job;
+      int ret = reader.next(job->_data);
+      if (!ret) {
+        WHACK(job);
+        break;
+      }
       if (ret < 0) {
+        WHACK(job);
         LOG(a_sprintf("failed while reading item #%d: ", i) + curr._source);
         return 99;
-      } 
-      total_written += ret;  // add in what we expect to write.
-      // skip compressing if there's no data.
-      uLongf destlen = 0;
-      bool null_chunk = false;
-      if (ret == 0) {
-        compressed.reset();
-	null_chunk = true;
-      } else {
-        compressed.reset(int(0.1 * ret) + ret + KILOBYTE);
-          // provide some extra space as per zlib instructions.  we're giving it
-          // way more than they request.
-        destlen = compressed.length();
-        // pack the chunks first so we can know sizes needed.
-        int comp_ret = compress(compressed.access(), &destlen, temp.observe(),
-            temp.length());
-        if (comp_ret != Z_OK) {
-          LOG(a_sprintf("failed while compressing item #%d: ", i)
-              + curr._source);
-          return 99;
-        }
-        compressed.zap(destlen, compressed.length() - 1);
       }
-      byte_array just_sizes;
-      structures::obscure_attach(just_sizes, temp.length());
-        // add in the real size.
-      structures::obscure_attach(just_sizes, int(destlen));
-        // add in the packed size.
-      ret = _bundle->write(just_sizes);
-      if (ret <= 0) {
-        LOG(a_sprintf("failed while writing sizes for item #%d: ", i)
-            + curr._source);
-        return 93;
+      if (b >= curr._blocks.length()) {
+        WHACK(job);
+        LOG(a_sprintf("item #%d grew larger than its initial size (%d): ", i,
+            curr._size) + curr._source);
+        return 99;
       }
-      if (!null_chunk) {
-        ret = _bundle->write(compressed);
-        if (ret <= 0) {
-          LOG(a_sprintf("failed while writing item #%d: ", i) + curr._source);
-          return 93;
-        } else if (ret != compressed.length()) {
-          LOG(a_sprintf("wrote different size for item #%d (tried %d, "
-              "wrote %d): ", i, compressed.length(), ret) + curr._source);
-          return 93;
-        }
+      total_read += ret;
+      content_key key(job->_data);
+      whole_file._hash = checksums::wide_hash_bytes((const abyte *)&key,
+          sizeof(key), whole_file._hash);
+      block_place *original = stored.find(key);
+      if (original) {
+        // this block has been seen before, so it won't be stored again.
+        copies += block_place(i, b);
+        originals += *original;
+        duplicate_size += ret;
+        duplicate_blocks++;
+        WHACK(job);
+        continue;
+      }
+      stored.add(key, new block_place(i, b));
+      batch.append(job);
+      places += block_place(i, b);
+      if (batch.elements() >= batch_size) {
+        ret = store_batch(batch, places);
+        if (ret) return ret;
       }
-    } while (!source.eof());
-//hmmm: very common code to above size writing.
-    byte_array just_sizes;
-    structures::obscure_attach(just_sizes, -1);
-    structures::obscure_attach(just_sizes, -1);
-    int ret = _bundle->write(just_sizes);
-    if (ret <= 0) {
-      LOG(a_sprintf("failed while writing sentinel of item #%d: ", i)
-          + curr._source);
-      return 96;
     }
     source.close();
-    if (total_written != curr._size) {
+    total_size += total_read;
+    // the block list was sized for the file when we first looked at it.
+    if (total_read != int(curr._size)) {
       LOG(a_sprintf("size (%d) disagrees with initial size (%d) for "
-          "item #%d: ", total_written, curr._size, i) + curr._source);
+          "item #%d: ", total_read, curr._size, i) + curr._source);
+      return 99;
+    }
+
+    // a file that matches an earlier one can be recreated from it.
+    if (!curr._size) continue;
+    whole_file._check = curr._size;
+    int *earlier = files.find(whole_file);
+    if (earlier) {
+      curr._same_as = *earlier + 1;
+      duplicate_files++;
+      noisy_logfile.log(astring("bundling: same contents as ")
+          + _manifest_list[*earlier]._source);
+    } else {
+      files.add(whole_file, new int(i));
     }
   }
+  int ret = store_batch(batch, places);
+  if (ret) return ret;
+
+  // every stored block knows where it is now, so the repeats can follow.
+  for (int i = 0; i < copies.length(); i++) {
+    _manifest_list[copies[i]._owner]._blocks[copies[i]._place]
+        = _manifest_list[originals[i]._owner]._blocks[originals[i]._place];
+  }
+
+  // now the table of contents can say where every block went.
+  double packed_size = double(_bundle->tell());
+  if (!_bundle->seek(_stub_size)) {
+    LOG(astring("could not return to the table of contents in: ") + _output_file);
+    return 81;
+  }
+  ret = write_toc();
+  if (ret) return ret;
+
+  BASE_LOG(a_sprintf("packed %.0f bytes into %.0f byte bundle in %.0f ms "
+      "using %d threads.", total_size, packed_size,
+      time_stamp().value() - started.value(), _crew->threads()));
+  BASE_LOG(a_sprintf("%.0f bytes (%.1f%%) were duplicates and stored only "
+      "once: %d blocks, with %d whole files.", duplicate_size,
+      total_size? 100.0 * duplicate_size / total_size : 0.0,
+      duplicate_blocks, duplicate_files));
   noisy_logfile.log(astring("Bundling run ends at ") + time_stamp::notarize(false));
   noisy_logfile.log(astring('-', 76));
 
   return 0;
 }
 
+int bundle_creator::store_batch(block_batch &batch, array<block_place> &places)
+{
+  FUNCDEF("store_batch");
+  _crew->compress(batch);
+  for (int j = 0; j < batch.elements(); j++) {
+    block_job &job = *batch.borrow(j);
+    bundled_chunk &curr = _manifest_list[places[j]._owner];
+    if (!job._worked) {
+      LOG(a_sprintf("failed while compressing item #%d: ", places[j]._owner)
+          + curr._source);
+      return 99;
+    }
+    job._info._offset = _bundle->tell();
+    int ret = _bundle->write(job._data);
+    if (ret != job._data.length()) {
+      LOG(a_sprintf("failed while writing item #%d: ", places[j]._owner)
+          + curr._source);
+      return 93;
+    }
+    curr._blocks[places[j]._place] = job._info;
+  }
+  batch.reset();
+  places.reset();
+  return 0;
+}
+
 int bundle_creator::finalize_file()
 {
   _bundle->close();
@@ -988,13 +1207,17 @@ HOOPLE_MAIN(bundle_creator, )
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
   #include <filesystem/filename.cpp>
   #include <filesystem/file_time.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <loggers/combo_logger.cpp>
   #include <loggers/console_logger.cpp>
   #include <loggers/critical_events.cpp>
   #include <loggers/file_logger.cpp>
   #include <loggers/program_wide_logger.cpp>
+  #include <processes/ethread.cpp>
+  #include <processes/child_supervisor.cpp>
   #include <processes/launch_process.cpp>
   #include <structures/bit_vector.cpp>
   #include <structures/checksums.cpp>
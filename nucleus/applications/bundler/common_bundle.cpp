@@ -16,15 +16,73 @@
 
 #include <basis/byte_array.h>
 #include <basis/contracts.h>
+#include <basis/functions.h>
+#include <basis/mutex.h>
 #include <filesystem/byte_filer.h>
 #include <filesystem/file_time.h>
+#include <filesystem/huge_file.h>
+#include <processes/ethread.h>
+#include <structures/checksums.h>
 #include <structures/object_packers.h>
 #include <structures/set.h>
 
+#include <zlib.h>
+#ifdef __UNIX__
+  #include <unistd.h>
+#endif
+
 using namespace basis;
 using namespace filesystem;
+using namespace processes;
 using namespace structures;
 
+// packs a 64 bit number as two integers.
+static void attach_wide(byte_array &target, unsigned long long to_attach)
+{
+  structures::attach(target, un_int(to_attach & 0xFFFFFFFF));
+  structures::attach(target, un_int(to_attach >> 32));
+}
+
+// unpacks a 64 bit number that was packed by attach_wide().
+static bool detach_wide(byte_array &source, unsigned long long &to_detach)
+{
+  un_int low, high;
+  if (!structures::detach(source, low) || !structures::detach(source, high))
+    return false;
+  to_detach = (((unsigned long long)high) << 32) | low;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+void bundle_block::pack(byte_array &target) const
+{
+  attach_wide(target, _offset);
+  structures::attach(target, _real_size);
+  structures::attach(target, _packed_size);
+  attach_wide(target, _checksum);
+}
+
+bool bundle_block::unpack(byte_array &source)
+{
+  unsigned long long offset;
+  if (!detach_wide(source, offset)) return false;
+  _offset = offset;
+  if (!structures::detach(source, _real_size)) return false;
+  if (!structures::detach(source, _packed_size)) return false;
+  if (!detach_wide(source, _checksum)) return false;
+  return true;
+}
+
+bool bundle_block::read_block(byte_filer &bundle, bundle_block &to_fill)
+{
+  byte_array temp;
+  if (bundle.read(temp, packed_size()) != packed_size()) return false;
+  return to_fill.unpack(temp);
+}
+
+////////////////////////////////////////////////////////////////////////////
+
 manifest_chunk::~manifest_chunk()
 {}
 
@@ -34,6 +92,19 @@ int manifest_chunk::packed_filetime_size()
   return hidden_comparison_object.packed_size();
 }
 
+int manifest_chunk::blocks_needed(un_int size, bool content_chunks)
+{
+  // every block but the last is at least the minimum size.
+  int block_size = content_chunks? CONTENT_CHUNK_MINIMUM : BUNDLE_BLOCK_SIZE;
+  return int((double(size) + block_size - 1) / block_size);
+}
+
+void manifest_chunk::trim_blocks()
+{
+  while (_blocks.length() && !_blocks[_blocks.last()]._real_size)
+    _blocks.zap(_blocks.last(), _blocks.last());
+}
+
 void manifest_chunk::pack(byte_array &target) const
 {
   structures::obscure_attach(target, _size);
@@ -42,6 +113,9 @@ void manifest_chunk::pack(byte_array &target) const
   _parms.pack(target);
   _keywords.pack(target);
   target += c_filetime;
+  structures::obscure_attach(target, _blocks.length());
+  for (int i = 0; i < _blocks.length(); i++) _blocks[i].pack(target);
+  structures::obscure_attach(target, _same_as);
 }
 
 bool manifest_chunk::unpack(byte_array &source)
@@ -54,6 +128,12 @@ bool manifest_chunk::unpack(byte_array &source)
   if (source.length() < 8) return false;
   c_filetime = source.subarray(0, 7);
   source.zap(0, 7);
+  un_int blocks;
+  if (!structures::obscure_detach(source, blocks)) return false;
+  _blocks.reset(blocks);
+  for (int i = 0; i < (int)blocks; i++)
+    if (!_blocks[i].unpack(source)) return false;
+  if (!structures::obscure_detach(source, _same_as)) return false;
   return true;
 }
 
@@ -134,6 +214,129 @@ bool manifest_chunk::read_manifest(byte_filer &bundle, manifest_chunk &curr)
     curr._keywords += found;
   }
   worked = read_a_filetime(bundle, curr.c_filetime);
-  return worked;
+  if (!worked)
+    return false;
+  // finally, find out where the file's data is stored.
+  un_int blocks = 0;
+  worked = read_an_obscured_int(bundle, blocks);
+  if (!worked)
+    return false;
+  curr._blocks.reset(blocks);
+  for (int i = 0; i < (int)blocks; i++) {
+    if (!bundle_block::read_block(bundle, curr._blocks[i]))
+      return false;
+  }
+  // and whether it's a copy of an earlier file.
+  return read_an_obscured_int(bundle, curr._same_as);
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+// one of the threads in a block_crew.
+
+class block_worker : public ethread
+{
+public:
+  block_worker(block_crew &crew) : ethread(), _crew(crew) {}
+
+  DEFINE_CLASS_NAME("block_worker");
+
+  virtual void perform_activity(void *formal(ptr)) {
+    block_job *job;
+    while ( (job = _crew.next_job()) ) _crew.work(*job);
+  }
+
+private:
+  block_crew &_crew;
+};
+
+////////////////////////////////////////////////////////////////////////////
+
+block_crew::block_crew(int threads)
+: _threads(maximum(1, threads)),
+  _lock(new mutex),
+  _batch(NULL_POINTER),
+  _bundle(NULL_POINTER),
+  _next(0)
+{}
+
+block_crew::~block_crew() { WHACK(_lock); }
+
+int block_crew::default_threads()
+{
+#ifdef __UNIX__
+  return maximum(1, int(sysconf(_SC_NPROCESSORS_ONLN)));
+#else
+  return 1;
+#endif
+}
+
+void block_crew::compress(block_batch &batch) { process(batch, NULL_POINTER); }
+
+void block_crew::expand(block_batch &batch, huge_file &bundle)
+{ process(batch, &bundle); }
+
+void block_crew::process(block_batch &batch, huge_file *bundle)
+{
+  _batch = &batch;
+  _bundle = bundle;
+  _next = 0;
+  // we pitch in too, so there's no need for extra threads when there are
+  // only a few blocks, such as for a small file.
+  int crew_size = minimum(_threads, batch.elements()) - 1;
+  array<block_worker *> crew(maximum(0, crew_size), NULL_POINTER,
+      byte_array::SIMPLE_COPY);
+  for (int i = 0; i < crew.length(); i++) {
+    crew[i] = new block_worker(*this);
+    crew[i]->start(NULL_POINTER);
+  }
+  block_job *job;
+  while ( (job = next_job()) ) work(*job);
+  for (int i = 0; i < crew.length(); i++) {
+    crew[i]->stop();
+    WHACK(crew[i]);
+  }
+  _batch = NULL_POINTER;
+  _bundle = NULL_POINTER;
+}
+
+block_job *block_crew::next_job()
+{
+  auto_synchronizer l(*_lock);
+  if (!_batch || (_next >= _batch->elements())) return NULL_POINTER;
+  return _batch->borrow(_next++);
+}
+
+void block_crew::work(block_job &job)
+{
+  if (!_bundle) {
+    // compress the block, after noting what it looked like beforehand.
+    job._info._real_size = job._data.length();
+    job._info._checksum = checksums::wide_hash_bytes(job._data.observe(),
+        job._data.length());
+    uLongf destlen = compressBound(job._data.length());
+    byte_array compressed((int)destlen);
+    job._worked = (::compress(compressed.access(), &destlen, job._data.observe(),
+        job._data.length()) == Z_OK);
+    if (!job._worked) return;
+    compressed.zap(int(destlen), compressed.length() - 1);
+    job._data = compressed;
+    job._info._packed_size = job._data.length();
+    return;
+  }
+
+  // read the block from the bundle, then expand and check it.
+  int read = 0;
+  job._worked = (_bundle->read_at(job._info._offset, job._data,
+      job._info._packed_size, read) == huge_file::OKAY)
+      && (read == int(job._info._packed_size));
+  if (!job._worked) return;
+  byte_array expanded(job._info._real_size);
+  uLongf destlen = expanded.length();
+  job._worked = (uncompress(expanded.access(), &destlen, job._data.observe(),
+      job._data.length()) == Z_OK) && (destlen == job._info._real_size)
+      && (checksums::wide_hash_bytes(expanded.observe(), expanded.length())
+          == job._info._checksum);
+  job._data = expanded;
 }
 
@@ -21,11 +21,19 @@
   other headers.
 */
 
+#include <basis/array.h>
 #include <basis/astring.h>
 #include <basis/contracts.h>
+#include <basis/mutex.h>
 #include <filesystem/byte_filer.h>
+#include <structures/amorph.h>
+#include <structures/checksums.h>
 #include <structures/set.h>
 
+// forward.
+class block_worker;
+namespace filesystem { class huge_file; }
+
 ////////////////////////////////////////////////////////////////////////////
 
 //! flags that control special attributes of the packed files.
@@ -44,6 +52,36 @@ enum special_bundling_flags {
 
 ////////////////////////////////////////////////////////////////////////////
 
+//! the packed files are split into blocks that are compressed separately.
+enum bundle_block_sizes {
+  BUNDLE_BLOCK_SIZE = 1 * basis::MEGABYTE,  //!< the size of each full block.
+  CONTENT_CHUNK_MINIMUM = 64 * basis::KILOBYTE
+    //!< the smallest block when the blocks are cut by content, besides the last.
+};
+
+//! describes where one compressed block of a packed file lives in the bundle.
+
+struct bundle_block
+{
+  basis::signed_long_long _offset;  //!< where the compressed block starts.
+  basis::un_int _real_size;  //!< the size of the block before compression.
+  basis::un_int _packed_size;  //!< the size of the compressed block.
+  structures::checksums::wide_hash _checksum;  //!< hash of the real block.
+
+  bundle_block() : _offset(0), _real_size(0), _packed_size(0), _checksum(0) {}
+
+  static int packed_size() { return 6 * sizeof(basis::un_int); }
+    //!< every block is packed in the same size, so the index can be patched.
+
+  void pack(basis::byte_array &target) const;  //!< streams out into the "target".
+  bool unpack(basis::byte_array &source);  //!< streams in from the "source".
+
+  static bool read_block(filesystem::byte_filer &bundle, bundle_block &to_fill);
+    //!< reads a block description out of the "bundle" into "to_fill".
+};
+
+////////////////////////////////////////////////////////////////////////////
+
 //! we will read the manifest pieces out of our own exe image.
 /*!
   the manifest chunks provide us with enough information to unpack the
@@ -58,21 +96,40 @@ struct manifest_chunk : public basis::text_formable
   basis::astring _parms;  //!< the parameters to pass on the command line.
   structures::string_set _keywords;  //!< keywords applicable to this item.
   basis::byte_array c_filetime;  //!< more than enough room for unix file time.
+  basis::array<bundle_block> _blocks;  //!< where the file's data is stored.
+  basis::un_int _same_as;  //!< if non-zero, the file matches item _same_as - 1.
 
   // note: when flags has SET_VARIABLE, the _payload is the variable
   // name to be set and the _parms is the value to use.
 
   static int packed_filetime_size();
 
+  static int blocks_needed(basis::un_int size, bool content_chunks = false);
+    //!< returns the number of bundle blocks needed for "size" bytes.
+    /*!< if "content_chunks" is true, the blocks are cut where the content
+    says to rather than at fixed sizes, so there's room for the most blocks
+    that could happen. */
+
+  void trim_blocks();
+    //!< drops any unused entries from the end of the block list.
+
+  // note: the _blocks are listed in the order that they make up the file.
+  // the list always has room for the whole file (see blocks_needed()) before
+  // the data is packed, so the manifest does not change size when the real
+  // block information is filled in.  entries that weren't needed are left
+  // with a real size of zero.  blocks with the same contents are only stored
+  // once in the bundle, so several items can list the same block.
+
   //! the chunk is the unit found in the packing manifest in the bundle.
   manifest_chunk(int size, const basis::astring &target, int flags,
       const basis::astring &parms, const structures::string_set &keywords)
       : _size(size), _payload(target), _flags(flags), _parms(parms),
-        _keywords(keywords), c_filetime(packed_filetime_size()) {
+        _keywords(keywords), c_filetime(packed_filetime_size()), _same_as(0) {
     for (int i = 0; i < packed_filetime_size(); i++) c_filetime[i] = 0;
   }
 
-  manifest_chunk() : _size(0), _flags(0), c_filetime(packed_filetime_size()) {
+  manifest_chunk() : _size(0), _flags(0), c_filetime(packed_filetime_size()),
+      _same_as(0) {
     //!< default constructor.
     for (int i = 0; i < packed_filetime_size(); i++) c_filetime[i] = 0;
   }
@@ -109,5 +166,69 @@ struct manifest_chunk : public basis::text_formable
 
 ////////////////////////////////////////////////////////////////////////////
 
+//! a block of a packed file that is being compressed or expanded.
+
+struct block_job
+{
+  basis::byte_array _data;  //!< the block's contents, before or after.
+  bundle_block _info;  //!< the block's sizes, checksum and location.
+  bool _worked;  //!< false if the block could not be processed.
+
+  block_job() : _worked(false) {}
+};
+
+//! a list of blocks that are processed together.
+class block_batch : public structures::amorph<block_job> {};
+
+//! compresses or expands batches of blocks using a crew of threads.
+/*!
+  The blocks in a batch are handed out to the threads one at a time, and
+  process() returns once every block in the batch has been dealt with.  The
+  caller keeps the batches to a limited size, so the memory used stays
+  bounded no matter how large the packed files are.
+*/
+
+class block_crew : public virtual basis::root_object
+{
+public:
+  block_crew(int threads = default_threads());
+  virtual ~block_crew();
+
+  DEFINE_CLASS_NAME("block_crew");
+
+  static int default_threads();
+    //!< returns the number of processors that are available.
+
+  int threads() const { return _threads; }  //!< the crew size.
+
+  void compress(block_batch &batch);
+    //!< compresses the data in each block of the "batch".
+    /*!< the sizes and checksum of every block are filled in, and the data
+    is replaced by its compressed form. */
+
+  void expand(block_batch &batch, filesystem::huge_file &bundle);
+    //!< reads the blocks of the "batch" from the "bundle" and expands them.
+    /*!< each block's data is read from the place its info describes, and is
+    replaced by the expanded form.  a block that fails to expand, or whose
+    checksum doesn't match, is marked as not having worked. */
+
+private:
+  friend class ::block_worker;
+  int _threads;  //!< the number of threads used.
+  basis::mutex *_lock;  //!< protects our place in the batch.
+  block_batch *_batch;  //!< the batch being processed.
+  filesystem::huge_file *_bundle;  //!< where expanded blocks come from.
+  int _next;  //!< the next block to hand out.
+
+  void process(block_batch &batch, filesystem::huge_file *bundle);
+    //!< runs the crew across the "batch"; the "bundle" is null to compress.
+  block_job *next_job();
+    //!< hands out the next unprocessed block, or null when they're done.
+  void work(block_job &job);
+    //!< compresses or expands the "job", depending on what's being done.
+};
+
+////////////////////////////////////////////////////////////////////////////
+
 #endif
 
@@ -29,6 +29,7 @@
 #include <filesystem/filename.h>
 #include <filesystem/file_time.h>
 #include <filesystem/heavy_file_ops.h>
+#include <filesystem/huge_file.h>
 #include <loggers/console_logger.h>
 #include <loggers/critical_events.h>
 #include <loggers/file_logger.h>
@@ -36,10 +37,13 @@
 #include <structures/static_memory_gremlin.h>
 #include <structures/string_table.h>
 #include <textual/parser_bits.h>
+#include <timely/time_stamp.h>
 
 #include <stdio.h>
 #include <sys/stat.h>
-#include <zlib.h>
+#ifdef __UNIX__
+  #include <unistd.h>
+#endif
 //#ifdef __UNIX__
   #include <utime.h>
 //#endif
@@ -60,9 +64,11 @@ using namespace loggers;
 using namespace processes;
 using namespace structures;
 using namespace textual;
+using namespace timely;
 
-const int CHUNKING_SIZE = 64 * KILOBYTE;
-  // we'll read this big a chunk from a source file at a time.
+const int BATCH_BLOCKS_PER_THREAD = 2;
+  // how many blocks each expansion thread gets in a batch.  only one batch
+  // is held in memory at a time.
 
 const astring TARGET_WORD = "TARGET";
 const astring LOGDIR_WORD = "LOGDIR";
@@ -119,7 +125,10 @@ the default %s variable to specify their install folder).\n\
 bundle that are marked with that keyword will be installed, but files that\n\
 are missing the keyword will not be.\n\
     Further, variables can be overridden on the command line in the\n\
-form: X=Y.\n\n\
+form: X=Y.\n\
+    Files that were bundled more than once are copied from the first one\n\
+unpacked.  The --hardlink flag makes them hard links to it instead, so they\n\
+will share their permissions and timestamp.\n\n\
 The line below uses all these parameters as an example:\n\n\
   %s --target c:\\Program Files\\gubernator --keyword dlls_only SILENT=true\n\
 \n\
@@ -133,6 +142,21 @@ until overridden.\n\
   return 12;
 }
 
+// recreates the already unpacked file "original" at "target", either as a
+// hard link to it or as a copy.  false is returned if neither one worked.
+bool duplicate_file(const astring &original, const astring &target,
+    bool hardlink)
+{
+#ifdef __UNIX__
+  if (hardlink) {
+    filename(target).unlink();
+    if (!link(original.s(), target.s())) return true;
+  }
+#endif
+  return heavy_file_operations::copy_file(original, target)
+      == heavy_file_operations::OKAY;
+}
+
 // creates a unique backup file name, if it can.
 // we assume that this file already exists, but we want to check for
 // our backup file naming scheme in case we already backed this up
@@ -224,6 +248,9 @@ int unpacker_stub::execute()
   astring keyword;  // set if we were given a keyword on cmd line.
   cmds.get_value("keyword", keyword);
 
+  bool hardlink = cmds.find("hardlink", indy);
+    // true if duplicate files should be linked rather than copied.
+
   astring vars_set;  // we will document the variables we saw and show later.
 
   for (int x = 0; x < cmds.entries(); x++) {
@@ -304,6 +331,7 @@ int unpacker_stub::execute()
   for (int i = 0; i < (int)item_count; i++) {
     manifest_chunk &curr = _manifest[i];
     bool worked = manifest_chunk::read_manifest(our_exe, curr);
+    curr.trim_blocks();
 
 #ifdef DEBUG_STUB
     astring tmpork;
@@ -330,9 +358,20 @@ int unpacker_stub::execute()
   critical_events::alert_message(temp, "manifest contents");
 #endif
 
-  // now we should be just after the last byte of the manifest, at the
-  // first piece of data.  we should read each chunk of data out and store
-  // it where it's supposed to go.
+  // the manifest says where each block of data is found, so they can be read
+  // and expanded in parallel.
+  our_exe.close();
+  huge_file bundle(this_exe.raw(), "rb");
+  block_crew crew;
+  const int batch_size = crew.threads() * BATCH_BLOCKS_PER_THREAD;
+  time_stamp started;
+  int_array unpacked(_manifest.length());  // non-zero once an item is written.
+  for (int i = 0; i < unpacked.length(); i++) unpacked[i] = false;
+  int files_written = 0;
+  int files_duplicated = 0;
+
+  // we should read each chunk of data out and store it where it's supposed
+  // to go.
   for (int festdex = 0; festdex < _manifest.length(); festdex++) {
     manifest_chunk &curr = _manifest[festdex];
     int size_left = curr._size;
@@ -448,78 +487,51 @@ int unpacker_stub::execute()
         }
       }
 
+      // a file that's the same as one we've already unpacked can be made
+      // from that one, rather than expanding all of its blocks again.
+      bool duplicated = false;
+      int original = int(curr._same_as) - 1;
+      if (keyword_good && (original >= 0) && (original < festdex)
+          && unpacked[original]) {
+        duplicated = duplicate_file(_manifest[original]._payload, curr._payload,
+            hardlink);
+        if (duplicated) files_duplicated++;
+      }
+
       byte_filer *targo = NULL_POINTER;
-      if (keyword_good) targo = new byte_filer(curr._payload, "wb");
-      byte_array uncompressed(256 * KILOBYTE);  // fluff it out to begin with.
-      byte_array temp(256 * KILOBYTE);
+      if (keyword_good && !duplicated)
+        targo = new byte_filer(curr._payload, "wb");
 
-      bool first_read = true;
-        // true if there haven't been any reads of the file before now.
       bool too_tiny_complaint_already = false;
         // becomes true if we complain about the file's size being larger than
         // expected.  this allows us to only complain once about each file.
 
-      // read a chunk at a time out of our exe image and store it into the
-      // target file.
-      while (first_read || !our_exe.eof()) {
-        first_read = false;
-        un_int real_size = 0, packed_size = 0;
-        // read in the real size from the file.
-        bool worked = manifest_chunk::read_an_obscured_int(our_exe, real_size);
-        if (!worked) {
-          show_message(a_sprintf("failed while reading real size "
-              "for item #%d: ", festdex) + curr._payload, ERROR_TITLE);
-          return 99;
-        }
-        // read in the packed size now.
-        worked = manifest_chunk::read_an_obscured_int(our_exe, packed_size);
-        if (!worked) {
-          show_message(a_sprintf("failed while reading packed size "
-              "for item #%d: ", festdex) + curr._payload, ERROR_TITLE);
-          return 99;
-        }
-
-        // make sure we don't eat the whole package--did the file end?
-        if ( (real_size == -1) && (packed_size == -1) ) {
-          // we've hit our sentinel; we've already unpacked all of this file.
-          break;
+      // expand the blocks a batch at a time and store them into the target
+      // file.  there's no need to read them if the file isn't wanted.
+      for (int b = 0; targo && (b < curr._blocks.length()); b += batch_size) {
+        block_batch batch;
+        for (int j = b; j < minimum(b + batch_size, curr._blocks.length()); j++) {
+          block_job *job = new block_job;
+          job->_info = curr._blocks[j];
+          batch.append(job);
         }
+        crew.expand(batch, bundle);
 
+        for (int j = 0; j < batch.elements(); j++) {
+          block_job &job = *batch.borrow(j);
 #ifdef DEBUG_STUB
-        BASE_LOG(a_sprintf("chunk packed_size=%d, real_size=%d", packed_size,
-            real_size));
+          BASE_LOG(a_sprintf("block packed_size=%d, real_size=%d",
+              job._info._packed_size, job._info._real_size));
 #endif
-
-        // now we know how big our next chunk is, so we can try reading it.
-        if (packed_size) {
-          int ret = our_exe.read(temp, packed_size);
-          if (ret <= 0) {
-            show_message(a_sprintf("failed while reading item #%d: ", festdex)
-                + curr._payload, ERROR_TITLE);
-            return 99;
-          } else if (ret != packed_size) {
-            show_message(a_sprintf("bad trouble ahead, item #%d had different "
-                " size on read (expected %d, got %d): ", festdex, packed_size,
-                ret) + curr._payload, ERROR_TITLE);
-          }
-
-          uncompressed.reset(real_size + KILOBYTE);  // add some for paranoia.
-          uLongf destlen = uncompressed.length();
-          int uncomp_ret = uncompress(uncompressed.access(), &destlen,
-              temp.observe(), packed_size);
-          if (uncomp_ret != Z_OK) {
-            show_message(a_sprintf("failed while uncompressing item #%d: ",
-                festdex) + curr._payload, ERROR_TITLE);
+          if (!job._worked) {
+            show_message(a_sprintf("failed to expand or verify block %d of "
+                "item #%d: ", b + j, festdex) + curr._payload, ERROR_TITLE);
+            WHACK(targo);
             return 99;
           }
-  
-          if (int(destlen) != real_size) {
-            LOG(a_sprintf("got a different unpacked size for item #%d: ",
-                festdex) + curr._payload);
-          }
 
           // update the remaining size for this data chunk.
-          size_left -= real_size;
+          size_left -= job._info._real_size;
           if (size_left < 0) {
             if (!too_tiny_complaint_already) {
               LOG(a_sprintf("item #%d was larger than expected (non-fatal): ",
@@ -527,22 +539,23 @@ int unpacker_stub::execute()
               too_tiny_complaint_already = true;
             }
           }
-          // toss the extra bytes out.
-          uncompressed.zap(real_size, uncompressed.length() - 1);
-
-          if (targo) {
-            // stuff the data we read into the target file.
-            ret = targo->write(uncompressed);
-            if (ret != uncompressed.length()) {
-              show_message(a_sprintf("failed while writing item #%d: ", festdex)
-                  + curr._payload, ERROR_TITLE);
-              return 93;
-            }
+
+          // stuff the data we read into the target file.
+          int ret = targo->write(job._data);
+          if (ret != job._data.length()) {
+            show_message(a_sprintf("failed while writing item #%d: ", festdex)
+                + curr._payload, ERROR_TITLE);
+            WHACK(targo);
+            return 93;
           }
         }
       }
       if (targo) targo->close();
       WHACK(targo);
+      if (keyword_good) {
+        unpacked[festdex] = true;
+        files_written++;
+      }
       // the file's written, but now we slap it's old time on it too.
       file_time t;
       if (!t.unpack(curr.c_filetime)) {
@@ -600,6 +613,10 @@ int unpacker_stub::execute()
 
   }
 
+  BASE_LOG(a_sprintf("unpacked %d files (%d of them from duplicates) in "
+      "%.0f ms using %d threads.", files_written, files_duplicated,
+      time_stamp().value() - started.value(), crew.threads()));
+
 #ifdef __WIN32__
   whack_simplistic_window(f_window);
 #endif
@@ -627,7 +644,9 @@ HOOPLE_MAIN(unpacker_stub, )
   #include <configuration/table_configurator.cpp>
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
+  #include <filesystem/content_hash.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_delta.cpp>
   #include <filesystem/file_info.cpp>
   #include <filesystem/filename.cpp>
   #include <filesystem/filename_list.cpp>
@@ -639,6 +658,8 @@ HOOPLE_MAIN(unpacker_stub, )
   #include <loggers/critical_events.cpp>
   #include <loggers/file_logger.cpp>
   #include <loggers/program_wide_logger.cpp>
+  #include <processes/ethread.cpp>
+  #include <processes/child_supervisor.cpp>
   #include <processes/launch_process.cpp>
   #include <structures/bit_vector.cpp>
   #include <structures/checksums.cpp>
@@ -97,6 +97,8 @@ int main(int argc, char *argv[])
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
+  #include <filesystem/file_info.cpp>
   #include <filesystem/file_time.cpp>
   #include <loggers/combo_logger.cpp>
   #include <loggers/console_logger.cpp>
@@ -1,6 +1,3 @@
-
-
-
 /*****************************************************************************\
 *                                                                             *
 *  Name   : callstack_tracker                                                 *
@@ -15,258 +12,422 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include "callstack_tracker.h"
+
 #ifdef ENABLE_CALLSTACK_TRACKING
 
-// note: this object cannot be constructed when the memory_checker is still
-// tracking memory leaks.  it must be disabled so that this object can
-// construct without being tracked, which causes an infinite loop.  the code
-// in the basis extern support takes care of that for us.
+// note: nothing here uses FUNCDEF, since that would track our own calls.
+// the memory checker may also call full_trace() from inside of new, so
+// only malloc and free are used for memory.
 
-#include "callstack_tracker.h"
-
-#include <malloc.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-////#undef new
-//is this right way to clean that out.
+using namespace basis;
 
-const int MAX_STACK_DEPTH = 2000;
-  // beyond that many stack frames, we will simply refuse to add any more.
+namespace application {
+
+const char *emptiness_note = "Empty Stack\n";
+  //!< what we show when the stack is empty.
 
 const int MAX_TEXT_FIELD = 1024;
   // the most space we allow the class, function, and file to take up.
 
-const char *emptiness_note = "Empty Stack\n";
-  //!< what we show when the stack is empty.
+const int SAMPLE_DEPTH = 64;
+  // the most frames recorded for one sample; deeper stacks lose their roots.
 
-//////////////
+const int SAMPLE_TABLE_SIZE = 2048;
+  // how many different stacks the sampler can count.  a power of two.
 
-class callstack_records
-{
-public:
-  frame_tracking_instance _records[MAX_STACK_DEPTH + 2];  // fudging room.
-};
+const int TRACE_BUFFER_SIZE = 512;
+  // how much of the trace is built up before writing it during a crash.
 
 //////////////
 
-// our current depth gives us our position in the array.  we define our
-// stack as starting at element zero, which is a null stack entry and
-// corresponds to a depth of zero also.  then, when the stack depth is one,
-// we actually have an element in place and it resides at index 1.  this
-// scheme allows us to have an update to the line number just do nothing when
-// there is no current stack.
-
-callstack_tracker::callstack_tracker()
-: _bt(new callstack_records),
-  _depth(0),
-  _frames_in(0),
-  _frames_out(0),
-  _highest(0),
-  _unusable(false)
-{
-//printf("callstack ctor\n");
-}
+__thread frame_ring *__thread_frames = NULL_POINTER;
 
-callstack_tracker::~callstack_tracker()
-{
-//printf("!!!!!!!!!!!!!!!!!!   callstack dtor in\n");
-  _unusable = true;
-  WHACK(_bt);
-//printf("!!!!!!!!!!!!!!!!!!   callstack dtor out\n");
-}
+static frame_ring *__all_rings = NULL_POINTER;
+  // every ring ever created.  rings are never freed, only reused, so that
+  // the sampler can walk this list without any locking.
+
+static pthread_key_t __ring_key;
+static pthread_once_t __ring_key_once = PTHREAD_ONCE_INIT;
+  // the key lets a thread's ring be given up when the thread exits.
 
-bool callstack_tracker::push_frame(const char *class_name, const char *func,
-    const char *file, int line)
+static void release_ring(void *to_release)
 {
-//printf("callstack pushframe depth=%d in\n", _depth);
-  if (_unusable) return false;
-  if (_depth >= MAX_STACK_DEPTH) {
-    // too many frames already.
-    printf("callstack_tracker::push_frame: past limit at class=%s func=%s "
-        "file=%s line=%d\n", class_name, func, file, line);
-    return false;
-  }
-  _depth++;
-  if (_depth > _highest) _highest = _depth;
-  _frames_in += 1;
-  _bt->_records[_depth].assign(class_name, func, file, line);
-//printf("callstack pushframe depth=%d out\n", _depth);
-  return true;
+  frame_ring *ring = (frame_ring *)to_release;
+  if (__thread_frames == ring) __thread_frames = NULL_POINTER;
+  ring->_depth = 0;
+  ring->_lost = 0;
+  __atomic_store_n(&ring->_in_use, 0, __ATOMIC_RELEASE);
 }
 
-bool callstack_tracker::pop_frame()
+static void create_ring_key() { pthread_key_create(&__ring_key, release_ring); }
+
+frame_ring *callstack_tracker::attach_thread()
 {
-//printf("callstack popframe depth=%d in\n", _depth);
-  if (_unusable) return false;
-  if (_depth <= 0) {
-    // how inappropriate of them; we have no frames.
-    _depth = 0;  // we don't lose anything useful by forcing it to be zero.
-    printf("callstack_tracker::pop_frame stack underflow!\n");
-    return false;
+  pthread_once(&__ring_key_once, create_ring_key);
+  frame_ring *ring = NULL_POINTER;
+  // reuse a ring left behind by a thread that exited, if there is one.
+  for (frame_ring *curr = __atomic_load_n(&__all_rings, __ATOMIC_ACQUIRE);
+      curr; curr = curr->_next) {
+    int unused = 0;
+    if (__atomic_compare_exchange_n(&curr->_in_use, &unused, 1, false,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      ring = curr;
+      break;
+    }
   }
-  _bt->_records[_depth].clean();
-  _depth--;
-  _frames_out += 1;
-//printf("callstack popframe depth=%d out\n", _depth);
-  return true;
+  if (!ring) {
+    ring = (frame_ring *)calloc(1, sizeof(frame_ring));
+    ring->_in_use = 1;
+    ring->_next = __atomic_load_n(&__all_rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&__all_rings, &ring->_next, ring,
+        true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+  }
+  ring->_depth = 0;
+  ring->_highest = 0;
+  ring->_lost = 0;
+  __thread_frames = ring;
+  pthread_setspecific(__ring_key, ring);
+  return ring;
 }
 
-bool callstack_tracker::update_line(int line)
+callstack_tracker &program_wide_stack_trace()
 {
-  if (_unusable) return false;
-  if (!_depth) return false;  // not as serious, but pretty weird.
-  _bt->_records[_depth]._line = line;
-  return true;
+  // the tracker has no state of its own; the frames are all per thread.
+  static callstack_tracker _tracker;
+  return _tracker;
 }
 
-char *callstack_tracker::full_trace() const
+int callstack_tracker::depth()
+{ return __thread_frames? __thread_frames->_depth : 0; }
+
+int callstack_tracker::highest()
+{ return __thread_frames? __thread_frames->_highest : 0; }
+
+//////////////
+
+// returns the number of frames in the "ring" that are still being held.
+static int frames_kept(const frame_ring *ring)
+{ return ring->_depth - ring->_lost; }
+
+// finds the frame that's "down" levels below the top of the stack.
+static const stack_frame &frame_below_top(const frame_ring *ring, int down)
+{ return ring->_frames[(ring->_depth - 1 - down) & (FRAME_RING_SIZE - 1)]; }
+
+static const char *text_or_blank(const char *text)
+{ return text? text : ""; }
+
+char *callstack_tracker::full_trace()
 {
-  if (_unusable) return strdup("");
-//printf("fulltrace in\n");
   char *to_return = (char *)malloc(full_trace_size());
   to_return[0] = '\0';
-  if (!_depth) {
+  frame_ring *ring = __thread_frames;
+  if (!ring || !ring->_depth) {
     strcat(to_return, emptiness_note);
     return to_return;
   }
-  const int initial_len = MAX_TEXT_FIELD + 8;
-  char temp[initial_len];
-  int allowed_len = initial_len;
-    // space provided for one text line.
+  char temp[MAX_TEXT_FIELD + 40];
   // start at top most active frame and go down towards bottom most.
-  for (int i = _depth; i >= 1; i--) {
-    strcat(to_return, "\t");  // we left space for this and \n at end.
-    temp[0] = '\0';
-    int len_class = strlen(_bt->_records[i]._class);
-    int len_func = strlen(_bt->_records[i]._func);
-    if (allowed_len > len_class + len_func + 6) {
-      allowed_len -= len_class + len_func + 6;
-      sprintf(temp, "\"%s::%s\", ", _bt->_records[i]._class,
-          _bt->_records[i]._func);
-      strcat(to_return, temp);
-    }
-
-    temp[0] = '\0';
-    int len_file = strlen(_bt->_records[i]._file);
-    if (allowed_len > len_file + 4) {
-      allowed_len -= len_file + 4;
-      sprintf(temp, "\"%s\", ", _bt->_records[i]._file);
-      strcat(to_return, temp);
-    }
-
-    temp[0] = '\0';
-    sprintf(temp, "\"line=%d\"", _bt->_records[i]._line);
-    int len_line = strlen(temp);
-    if (allowed_len > len_line) {
-      allowed_len -= len_line;
-      strcat(to_return, temp);
-    }
-
-    strcat(to_return, "\n");  // we left space for this already.
+  for (int i = 0; i < frames_kept(ring); i++) {
+    const stack_frame &frame = frame_below_top(ring, i);
+    snprintf(temp, sizeof(temp), "\t\"%s::%s\", \"%s\", \"line=%d\"\n",
+        text_or_blank(frame._class), text_or_blank(frame._func),
+        text_or_blank(frame._file), frame._line);
+    strcat(to_return, temp);
+  }
+  if (ring->_lost) {
+    snprintf(temp, sizeof(temp), "\t(%d outer frames were not kept)\n",
+        ring->_lost);
+    strcat(to_return, temp);
   }
-
-//printf("fulltrace out\n");
   return to_return;
 }
 
-int callstack_tracker::full_trace_size() const
+int callstack_tracker::full_trace_size()
 {
-  if (_unusable) return 0;
-  if (!_depth) return strlen(emptiness_note) + 14;  // liberal allocation.
-  int to_return = 28;  // another hollywood style excess.
-  for (int i = _depth; i >= 1; i--) {
-    int this_line = 0;  // add up parts for just this item.
+  frame_ring *ring = __thread_frames;
+  if (!ring || !ring->_depth) return strlen(emptiness_note) + 14;
+  int to_return = 28 + 60;  // room for the note about lost frames.
+  for (int i = 0; i < frames_kept(ring); i++) {
+    const stack_frame &frame = frame_below_top(ring, i);
+    // these additions are completely dependent on how it's done above.
+    int this_line = strlen(text_or_blank(frame._class))
+        + strlen(text_or_blank(frame._func))
+        + strlen(text_or_blank(frame._file)) + 40;
+    // limit it like the snprintf does; we will use the lesser size value.
+    if (this_line < MAX_TEXT_FIELD + 40) to_return += this_line;
+    else to_return += MAX_TEXT_FIELD + 40;
+  }
+  return to_return;
+}
 
-    // all of these additions are completely dependent on how it's done above.
+//////////////
 
-    int len_class = strlen(_bt->_records[i]._class);
-    int len_func = strlen(_bt->_records[i]._func);
-    this_line += len_class + len_func + 6;
+// these helpers build up text without allocating, so they can be used by a
+// signal handler.  once the "buffer" fills, it is written to the "fd".
 
-    int len_file = strlen(_bt->_records[i]._file);
-    this_line += len_file + 4;
+static void flush_trace(int fd, char *buffer, int &used)
+{
+  int written = 0;
+  while (written < used) {
+    int ret = int(write(fd, buffer + written, used - written));
+    if (ret <= 0) {
+      if (ret < 0 && errno == EINTR) continue;
+      break;
+    }
+    written += ret;
+  }
+  used = 0;
+}
 
-    this_line += 32;  // extra space for line number and such.
+static void add_text(int fd, char *buffer, int &used, const char *text)
+{
+  for (const char *curr = text_or_blank(text); *curr; curr++) {
+    if (used >= TRACE_BUFFER_SIZE) flush_trace(fd, buffer, used);
+    buffer[used++] = *curr;
+  }
+}
 
-    // limit it like we did above; we will use the lesser size value.
-    if (this_line < MAX_TEXT_FIELD + 8) to_return += this_line;
-    else to_return += MAX_TEXT_FIELD + 8;
+static void add_number(int fd, char *buffer, int &used, int number)
+{
+  char digits[16];
+  int posn = sizeof(digits) - 1;
+  digits[posn] = '\0';
+  bool negative = number < 0;
+  unsigned int value = negative? 0U - unsigned(number) : unsigned(number);
+  do {
+    digits[--posn] = char('0' + value % 10);
+    value /= 10;
+  } while (value && posn > 1);
+  if (negative) digits[--posn] = '-';
+  add_text(fd, buffer, used, digits + posn);
+}
+
+void callstack_tracker::write_trace(int fd)
+{
+  char buffer[TRACE_BUFFER_SIZE];
+  int used = 0;
+  frame_ring *ring = __thread_frames;
+  if (!ring || !ring->_depth) {
+    add_text(fd, buffer, used, emptiness_note);
+  } else {
+    // the same form as the full_trace, but written out piece by piece.
+    for (int i = 0; i < frames_kept(ring); i++) {
+      const stack_frame &frame = frame_below_top(ring, i);
+      add_text(fd, buffer, used, "\t\"");
+      add_text(fd, buffer, used, frame._class);
+      add_text(fd, buffer, used, "::");
+      add_text(fd, buffer, used, frame._func);
+      add_text(fd, buffer, used, "\", \"");
+      add_text(fd, buffer, used, frame._file);
+      add_text(fd, buffer, used, "\", \"line=");
+      add_number(fd, buffer, used, frame._line);
+      add_text(fd, buffer, used, "\"\n");
+    }
+    if (ring->_lost) {
+      add_text(fd, buffer, used, "\t(");
+      add_number(fd, buffer, used, ring->_lost);
+      add_text(fd, buffer, used, " outer frames were not kept)\n");
+    }
   }
-  return to_return;
+  flush_trace(fd, buffer, used);
 }
 
 //////////////
 
-frame_tracking_instance::frame_tracking_instance(const char *class_name,
-    const char *func, const char *file, int line, bool add_frame)
-: _frame_involved(add_frame),
-  _class(class_name? strdup(class_name) : NULL_POINTER),
-  _func(func? strdup(func) : NULL_POINTER),
-  _file(file? strdup(file) : NULL_POINTER),
-  _line(line)
+// one stack that the sampler has seen, and how many times it was seen.
+
+class sampled_stack
 {
-  if (_frame_involved) {
-//printf("frametrackinst ctor in class=%s func=%s\n", class_name, func);
-    program_wide_stack_trace().push_frame(class_name, func, file, line);
-//printf("frametrackinst ctor out\n");
+public:
+  int _count;  //!< the number of samples that found this stack.
+  int _frames;  //!< how many frames are in the stack.
+  bool _truncated;  //!< true if the stack was deeper than we record.
+  const char *_classes[SAMPLE_DEPTH];  //!< the classes, outermost first.
+  const char *_funcs[SAMPLE_DEPTH];  //!< the functions, outermost first.
+};
+
+// the state for the sampling thread.  the samples are guarded by the lock.
+
+static pthread_mutex_t __samples_lock = PTHREAD_MUTEX_INITIALIZER;
+static sampled_stack *__samples = NULL_POINTER;  // the stacks seen so far.
+static int __dropped_samples = 0;  // samples that didn't fit in the table.
+static bool __sampling = false;  // true while the sampler should keep going.
+static int __sample_interval = 0;  // milliseconds between samples.
+static pthread_t __sampler;  // the thread doing the sampling.
+static pthread_mutex_t __sampler_sleep = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __sampler_alarm = PTHREAD_COND_INITIALIZER;
+  // lets the sampler be woken up promptly when it's stopped.
+
+// copies the stack on the "ring" into the "sample".  false is returned if the
+// thread changed its stack while we looked, or if there's no stack.
+static bool copy_stack(frame_ring *ring, sampled_stack &sample)
+{
+  un_int before = __atomic_load_n(&ring->_changes, __ATOMIC_ACQUIRE);
+  if (before & 1) return false;  // caught in the middle of a change.
+  int depth = ring->_depth;
+  if (depth <= 0) return false;
+  int kept = depth - ring->_lost;
+  int frames = kept < SAMPLE_DEPTH? kept : SAMPLE_DEPTH;
+  sample._frames = frames;
+  sample._truncated = frames < depth;
+  for (int i = 0; i < frames; i++) {
+    // the innermost frames are kept, but they're stored outermost first.
+    const stack_frame &frame
+        = ring->_frames[(depth - frames + i) & (FRAME_RING_SIZE - 1)];
+    sample._classes[i] = frame._class;
+    sample._funcs[i] = frame._func;
   }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&ring->_changes, __ATOMIC_RELAXED) == before;
 }
 
-frame_tracking_instance::frame_tracking_instance
-    (const frame_tracking_instance &to_copy)
-: _frame_involved(false),  // copies don't get a right to this.
-  _class(to_copy._class? strdup(to_copy._class) : NULL_POINTER),
-  _func(to_copy._func? strdup(to_copy._func) : NULL_POINTER),
-  _file(to_copy._file? strdup(to_copy._file) : NULL_POINTER),
-  _line(to_copy._line)
+// adds one to the count for the stack in "sample".
+static void count_sample(const sampled_stack &sample)
 {
+  un_int hash = un_int(sample._frames);
+  for (int i = 0; i < sample._frames; i++)
+    hash = hash * 31 + un_int(size_t(sample._funcs[i]) >> 2)
+        + un_int(size_t(sample._classes[i]) >> 2);
+  for (int probe = 0; probe < SAMPLE_TABLE_SIZE; probe++) {
+    sampled_stack &slot = __samples[(hash + probe) & (SAMPLE_TABLE_SIZE - 1)];
+    if (!slot._count) {
+      slot = sample;
+      slot._count = 1;
+      return;
+    }
+    if ( (slot._frames == sample._frames)
+        && (slot._truncated == sample._truncated)
+        && !memcmp(slot._funcs, sample._funcs,
+            sample._frames * sizeof(const char *))
+        && !memcmp(slot._classes, sample._classes,
+            sample._frames * sizeof(const char *)) ) {
+      slot._count++;
+      return;
+    }
+  }
+  __dropped_samples++;
 }
 
-frame_tracking_instance::~frame_tracking_instance() { clean(); }
-
-void frame_tracking_instance::clean()
+// records the stack of every thread that's currently in a tracked function.
+static void take_samples()
 {
-  if (_frame_involved) {
-//printf("frametrackinst clean\n");
-    program_wide_stack_trace().pop_frame();
+  sampled_stack sample;
+  for (frame_ring *ring = __atomic_load_n(&__all_rings, __ATOMIC_ACQUIRE);
+      ring; ring = ring->_next) {
+    if (!__atomic_load_n(&ring->_in_use, __ATOMIC_ACQUIRE)) continue;
+    // a thread that's busy changing its stack gets a few more chances.
+    for (int tries = 0; tries < 3; tries++) {
+      if (copy_stack(ring, sample)) {
+        pthread_mutex_lock(&__samples_lock);
+        count_sample(sample);
+        pthread_mutex_unlock(&__samples_lock);
+        break;
+      }
+      if (!ring->_depth) break;  // nothing to see on that thread.
+    }
   }
-  _frame_involved = false;
-  free(_class); _class = NULL_POINTER;
-  free(_func); _func = NULL_POINTER;
-  free(_file); _file = NULL_POINTER;
-  _line = 0;
 }
 
-frame_tracking_instance &frame_tracking_instance::operator =
-    (const frame_tracking_instance &to_copy)
+static void *sampler_thread(void *)
 {
-//printf("frametrackinst tor = in\n");
-  if (this == &to_copy) return *this;
-  assign(to_copy._class, to_copy._func, to_copy._file, to_copy._line);
-//printf("frametrackinst tor = out\n");
-  return *this;
+  pthread_mutex_lock(&__sampler_sleep);
+  while (__sampling) {
+    timespec wake_at;
+    clock_gettime(CLOCK_REALTIME, &wake_at);
+    wake_at.tv_nsec += long(__sample_interval % 1000) * 1000000;
+    wake_at.tv_sec += __sample_interval / 1000 + wake_at.tv_nsec / 1000000000;
+    wake_at.tv_nsec %= 1000000000;
+    pthread_cond_timedwait(&__sampler_alarm, &__sampler_sleep, &wake_at);
+    if (!__sampling) break;
+    pthread_mutex_unlock(&__sampler_sleep);
+    take_samples();
+    pthread_mutex_lock(&__sampler_sleep);
+  }
+  pthread_mutex_unlock(&__sampler_sleep);
+  return NULL_POINTER;
 }
 
-void frame_tracking_instance::assign(const char *class_name, const char *func,
-    const char *file, int line)
+bool callstack_tracker::start_sampling(int interval)
 {
-  clean();
-  _frame_involved = false;  // copies don't get a right to this.
-  _class = class_name? strdup(class_name) : NULL_POINTER;
-  _func = func? strdup(func) : NULL_POINTER;
-  _file = file? strdup(file) : NULL_POINTER;
-  _line = line;
+  pthread_mutex_lock(&__sampler_sleep);
+  if (__sampling) {
+    pthread_mutex_unlock(&__sampler_sleep);
+    return false;
+  }
+  pthread_mutex_lock(&__samples_lock);
+  if (!__samples)
+    __samples = (sampled_stack *)calloc(SAMPLE_TABLE_SIZE,
+        sizeof(sampled_stack));
+  pthread_mutex_unlock(&__samples_lock);
+  __sampling = true;
+  __sample_interval = interval < 1? 1 : interval;
+  bool started = !pthread_create(&__sampler, NULL_POINTER, sampler_thread,
+      NULL_POINTER);
+  if (!started) __sampling = false;
+  pthread_mutex_unlock(&__sampler_sleep);
+  return started;
 }
 
-void update_current_stack_frame_line_number(int line)
+void callstack_tracker::stop_sampling()
 {
-//printf("frametrackinst updatelinenum in\n");
-  program_wide_stack_trace().update_line(line);
-//printf("frametrackinst updatelinenum out\n");
+  pthread_mutex_lock(&__sampler_sleep);
+  bool was_sampling = __sampling;
+  __sampling = false;
+  pthread_cond_signal(&__sampler_alarm);
+  pthread_mutex_unlock(&__sampler_sleep);
+  if (was_sampling) pthread_join(__sampler, NULL_POINTER);
 }
 
-#endif // ENABLE_CALLSTACK_TRACKING
+void callstack_tracker::reset_samples()
+{
+  pthread_mutex_lock(&__samples_lock);
+  if (__samples)
+    memset(__samples, 0, SAMPLE_TABLE_SIZE * sizeof(sampled_stack));
+  __dropped_samples = 0;
+  pthread_mutex_unlock(&__samples_lock);
+}
 
+char *callstack_tracker::sampled_stacks()
+{
+  pthread_mutex_lock(&__samples_lock);
+  // figure out how much room the folded stacks will need.
+  int size_needed = 80;  // room for the dropped samples line.
+  for (int i = 0; __samples && (i < SAMPLE_TABLE_SIZE); i++) {
+    const sampled_stack &stack = __samples[i];
+    if (!stack._count) continue;
+    size_needed += 20 + 4;  // the count and the truncation marker.
+    for (int j = 0; j < stack._frames; j++)
+      size_needed += strlen(text_or_blank(stack._classes[j]))
+          + strlen(text_or_blank(stack._funcs[j])) + 3;
+  }
+  char *to_return = (char *)malloc(size_needed);
+  char *posn = to_return;
+  *posn = '\0';
+  for (int i = 0; __samples && (i < SAMPLE_TABLE_SIZE); i++) {
+    const sampled_stack &stack = __samples[i];
+    if (!stack._count) continue;
+    if (stack._truncated) posn += sprintf(posn, "...;");
+    for (int j = 0; j < stack._frames; j++)
+      posn += sprintf(posn, "%s%s::%s", j? ";" : "",
+          text_or_blank(stack._classes[j]), text_or_blank(stack._funcs[j]));
+    posn += sprintf(posn, " %d\n", stack._count);
+  }
+  if (__dropped_samples)
+    sprintf(posn, "[dropped] %d\n", __dropped_samples);
+  pthread_mutex_unlock(&__samples_lock);
+  return to_return;
+}
 
+} //namespace.
 
+#endif // ENABLE_CALLSTACK_TRACKING
 
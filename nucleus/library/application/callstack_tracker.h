@@ -15,91 +15,136 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
-#include "definitions.h"
+#include <basis/definitions.h>
 
 #ifdef ENABLE_CALLSTACK_TRACKING
 
-#include "build_configuration.h"
-#include "root_object.h"
-
 namespace application {
 
 // forward.
-class callstack_records;
 class callstack_tracker;
 
 //////////////
 
-callstack_tracker BASIS_EXTERN &program_wide_stack_trace();
+callstack_tracker &program_wide_stack_trace();
   //!< a global object that can be used to track the runtime callstack.
 
 //////////////
 
+//! one function call that is being tracked on a thread's stack.
+/*! the strings are not copied, so they must be static, such as the ones
+provided by DEFINE_CLASS_NAME, FUNCDEF and __FILE__. */
+
+class stack_frame
+{
+public:
+  const char *_class;  //!< the name of the class that the function is in.
+  const char *_func;  //!< the name of the function.
+  const char *_file;  //!< the source file holding the function.
+  int _line;  //!< the most recently noted line within the function.
+};
+
+const int FRAME_RING_SIZE = 256;
+  //!< the number of innermost frames that are kept for each thread.
+
+//! the frames being tracked for one thread.
+/*! only the owning thread changes its frames.  they are kept in a ring, so
+a thread that goes deeper than FRAME_RING_SIZE calls just overwrites its
+outermost frames and the innermost calls stay visible.  the overwritten
+frames stay lost until the thread returns past them. */
+
+class frame_ring
+{
+public:
+  stack_frame _frames[FRAME_RING_SIZE];  //!< the tracked calls.
+  int _depth;  //!< how deep the thread is; this can exceed the ring size.
+  int _highest;  //!< the deepest that the thread has ever been.
+  int _lost;  //!< how many of the outermost frames have been overwritten.
+  basis::un_int _changes;  //!< odd while the frames are being changed.
+    /*!< this lets another thread that's sampling the frames notice when it
+    saw them halfway through an update. */
+  frame_ring *_next;  //!< every ring is listed for the sampling profiler.
+  int _in_use;  //!< non-zero while a thread owns this ring.
+};
+
+extern __thread frame_ring *__thread_frames;
+  //!< the current thread's frames, once it has tracked a call.
+
+//////////////
+
 //! This object can provide a backtrace at runtime of the invoking methods.
 /*!
   The callstack tracking is hooked in through the FUNCDEF macros used to
   set function names for logging.  Thus it will only be visible if those
   macros are used fairly carefully or if people invoke the stack frame addition
-  method themselves.
+  method themselves.  Each thread tracks its own stack without any locking or
+  allocation, so a FUNCDEF only costs a few stores.
+
+  The stacks can also be sampled periodically from a separate thread, which
+  provides a cheap profile of where the program is spending its time.
 */
 
 class callstack_tracker
 {
 public:
-  callstack_tracker();
-  virtual ~callstack_tracker();
-
-  DEFINE_CLASS_NAME("callstack_tracker");
-
-  bool push_frame(const char *class_name, const char *func, const char *file,
-          int line);
-    //!< adds a new stack from for the "class_name" in "function" at the "line".
+  static bool push_frame(const char *class_name, const char *func,
+          const char *file, int line);
+    //!< adds a new stack frame for the "class_name" in "func" at the "line".
     /*!< this function should be invoked when entering a new stack frame.  the
     "file" can be gotten from the __FILE__ macro and the "line" number can come
     from __LINE__, but the "class_name" and "func" must be tracked some other
-    way.  we recommend the FUNCDEF macro.  this function might return false if
-    there is no longer any room for tracking more frames; that is a serious
-    issue that might indicate a runaway recursion or infinite loop. */
+    way.  we recommend the FUNCDEF macro.  none of the strings are copied. */
 
-  bool pop_frame();
+  static bool pop_frame();
     //!< removes the last callstack frame off from our tracking.
 
-  bool update_line(int line);
+  static bool update_line(int line);
     //!< sets the line number within the current stack frame.
     /*!< the current frame can reside across several line numbers, so this
     allows the code to be more specific about the location of an invocation. */
 
-  char *full_trace() const;
-    //!< provides the current stack trace in a newly malloc'd string.
+  static char *full_trace();
+    //!< provides the current thread's stack trace in a newly malloc'd string.
     /*!< the user *must* free() the string returned. */
 
-  int full_trace_size() const;
+  static int full_trace_size();
     //!< this returns the number of bytes needed for the above full_trace().
 
-  int depth() const { return _depth; }
-    //!< the current number of frames we know of.
+  static void write_trace(int file_descriptor);
+    //!< writes the current thread's stack trace to the "file_descriptor".
+    /*!< this is safe to call from a signal handler, since it does not
+    allocate memory or take any locks. */
+
+  static int depth();
+    //!< the current number of frames we know of on this thread.
+
+  static int highest();
+    //!< reports the maximum stack depth seen on this thread so far.
 
-  double frames_in() const { return _frames_in; }
-    //!< reports the number of call stack frames that were added, total.
+  static bool start_sampling(int interval);
+    //!< begins recording every thread's stack every "interval" milliseconds.
+    /*!< false is returned if the sampling was already running. */
 
-  double frames_out() const { return _frames_out; }
-    //!< reports the number of call stack frames that were removed, total.
+  static void stop_sampling();
+    //!< ends the periodic sampling, but keeps the samples gathered so far.
 
-  double highest() const { return _highest; }
-    //!< reports the maximum stack depth seen during the runtime so far.
+  static char *sampled_stacks();
+    //!< returns the samples in the "folded" form used by flame graphs.
+    /*!< each line lists one stack, outermost function first, separated by
+    semicolons and followed by the number of times that the stack was seen.
+    the string is malloc'd and the user *must* free() it. */
+
+  static void reset_samples();
+    //!< throws out all of the samples gathered so far.
 
 private:
-  callstack_records *_bt;  //!< the backtrace records for current program.
-  int _depth;  //!< the current number of frames we know of.
-  double _frames_in;  //!< number of frame additions.
-  double _frames_out;  //!< number of frame removals.
-  double _highest;  //!< the most number of frames in play at once.
-  bool _unusable;  //!< object has already been destroyed.
+  static frame_ring *attach_thread();
+    //!< sets up the frames for a thread that has not tracked anything yet.
 };
 
 //////////////
 
-//! a small object that represents a stack trace in progress.
+//! a small object that represents a stack frame in progress.
 /*! the object will automatically be destroyed when the containing scope
 exits.  this enables a users of the stack tracker to simply label their
 function name and get the frame added.  if they want finer grained tracking,
@@ -110,47 +155,92 @@ wrong. */
 class frame_tracking_instance
 {
 public:
-  // these are not encapsulated, but be careful with the contents.
-  bool _frame_involved;  //!< has this object been added to the tracker?
-  char *_class, *_func, *_file;  //!< newly allocated copies.
-  int _line;
-
-  frame_tracking_instance(const char *class_name = "", const char *func = "",
-      const char *file = "", int line = 0, bool add_frame = false);
+  frame_tracking_instance(const char *class_name, const char *func,
+      const char *file, int line, bool add_frame = false)
+  : _frame_involved(add_frame) {
+    if (_frame_involved)
+      callstack_tracker::push_frame(class_name, func, file, line);
+  }
     //!< as an automatic variable, this can hang onto frame information.
     /*!< if "add_frame" is true, then this actually adds the stack frame in
     question to the tracker.  thus if you use this class at the top of your
     function, such as via the FUNCDEF macro, then you can forget about having
     to pop the frame later. */
 
-  frame_tracking_instance(const frame_tracking_instance &to_copy);
-
-  ~frame_tracking_instance();
-    //!< releases the information *and* this stack frame in the tracker.
-
-  frame_tracking_instance &operator =(const frame_tracking_instance &to_copy);
+  ~frame_tracking_instance()
+  { if (_frame_involved) callstack_tracker::pop_frame(); }
+    //!< releases this stack frame in the tracker.
 
-  void assign(const char *class_name, const char *func, const char *file,
-          int line);
-    //!< similar to assignment operator but doesn't require an object.
+private:
+  bool _frame_involved;  //!< has this object been added to the tracker?
 
-  void clean();
-    //!< throws out our accumulated memory and pops frame if applicable.
+  // not appropriate.
+  frame_tracking_instance(const frame_tracking_instance &);
+  frame_tracking_instance &operator =(const frame_tracking_instance &);
 };
 
-void update_current_stack_frame_line_number(int line);
+//////////////
+
+inline void update_current_stack_frame_line_number(int line)
+{ callstack_tracker::update_line(line); }
   //!< sets the line number for the current frame in the global stack trace.
 
-#else // ENABLE_CALLSTACK_TRACKING
-  // bogus replacements for most commonly used callstack tracking support.
-  #define frame_tracking_instance
-  #define __trail_of_function(p1, p2, p3, p4, p5) if (func) {}
-    // the above actually trades on the name of the object we'd normally
-    // define.  it must match the object name in the FUNCDEF macro.
-  #define update_current_stack_frame_line_number(line)
-#endif // ENABLE_CALLSTACK_TRACKING
+//////////////
+
+// the frame changes below are bracketed by bumps to the change counter, so
+// that a sampler reading the frames from another thread can tell if it saw
+// them in the middle of an update.
+
+inline bool callstack_tracker::push_frame(const char *class_name,
+    const char *func, const char *file, int line)
+{
+  frame_ring *ring = __thread_frames;
+  if (!ring) ring = attach_thread();
+  basis::un_int changes = ring->_changes;
+  __atomic_store_n(&ring->_changes, changes + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  if (ring->_depth >= ring->_lost + FRAME_RING_SIZE)
+    ring->_lost = ring->_depth - FRAME_RING_SIZE + 1;
+  stack_frame &frame = ring->_frames[ring->_depth & (FRAME_RING_SIZE - 1)];
+  frame._class = class_name;
+  frame._func = func;
+  frame._file = file;
+  frame._line = line;
+  ring->_depth++;
+  if (ring->_depth > ring->_highest) ring->_highest = ring->_depth;
+  __atomic_store_n(&ring->_changes, changes + 2, __ATOMIC_RELEASE);
+  return true;
+}
+
+inline bool callstack_tracker::pop_frame()
+{
+  frame_ring *ring = __thread_frames;
+  if (!ring || (ring->_depth <= 0)) return false;  // stack underflow.
+  basis::un_int changes = ring->_changes;
+  __atomic_store_n(&ring->_changes, changes + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  ring->_depth--;
+  if (ring->_lost > ring->_depth) ring->_lost = ring->_depth;
+  __atomic_store_n(&ring->_changes, changes + 2, __ATOMIC_RELEASE);
+  return true;
+}
+
+inline bool callstack_tracker::update_line(int line)
+{
+  frame_ring *ring = __thread_frames;
+  if (!ring || !ring->_depth) return false;  // not as serious, but weird.
+  ring->_frames[(ring->_depth - 1) & (FRAME_RING_SIZE - 1)]._line = line;
+  return true;
+}
 
 } //namespace.
 
+// the FUNCDEF and FUNCTION macros name these without any namespace, since
+// they're used from everywhere.
+using application::frame_tracking_instance;
+using application::update_current_stack_frame_line_number;
+
+#endif // ENABLE_CALLSTACK_TRACKING
+
 #endif // outer guard.
 
@@ -43,6 +43,13 @@ namespace application {
 #define HOOPLE_STARTUP_CODE \
   DEFINE_INSTANCE_HANDLE;
 
+#ifdef ENABLE_CALLSTACK_TRACKING
+  //! builds that track the callstack also record it if the program crashes.
+  #define SETUP_CRASH_DUMPS loggers::critical_events::install_crash_dumps()
+#else
+  #define SETUP_CRASH_DUMPS
+#endif
+
 #ifdef __WXWIDGETS__
   //! main program for applications using WxWidgets library.
   #define HOOPLE_MAIN(obj_name, obj_args) \
@@ -63,6 +70,7 @@ namespace application {
     int main(int argc, char *argv[]) { \
       SET_ARGC_ARGV(argc, argv); \
       SETUP_COMBO_LOGGER; \
+      SETUP_CRASH_DUMPS; \
       obj_name to_run_obj obj_args; \
       return to_run_obj.execute_application(); \
     }
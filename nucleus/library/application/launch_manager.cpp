@@ -139,6 +139,10 @@ launch_manager::launch_manager(configured_applications &config)
 {
   FUNCDEF("constructor");
 
+  // hear about our children exiting as soon as they're reaped.
+  if (child_supervisor::supported())
+    child_supervisor::program_wide().add_observer(this);
+
   // start the application checking thread.
   _checker->start(NULL_POINTER);
 
@@ -149,6 +153,8 @@ launch_manager::~launch_manager()
 {
   FUNCDEF("destructor");
   stop_everything();
+  if (child_supervisor::supported())
+    child_supervisor::program_wide().remove_observer(this);
 
   WHACK(_checker);
   WHACK(_going_down);
@@ -240,16 +246,26 @@ void launch_manager::stop_all_kids()
       // will hose us but good if the processes aren't eventually cleared up,
       // but that shouldn't happen.
 
+      int_set dying;
       {
         LOCK_ZOMBIES;
         num_dying = _going_down->length();
+        for (int i = 0; i < num_dying; i++) dying += (*_going_down)[i]._pid;
       }
 
       if (!num_dying) break;  // jump out of loop.
 
-      _checker->reschedule(0);  // make thread check as soon as possible.
-
-      time_control::sleep_ms(40);
+      // sleep until one of the dying processes actually exits, rather than
+      // checking back on them every so often.
+      if (child_supervisor::await_any_exit(dying, CHECK_INTERVAL)) {
+        LOCK_ZOMBIES;
+        for (int i = _going_down->length() - 1; i >= 0; i--)
+          if (!child_supervisor::alive((*_going_down)[i]._pid))
+            _going_down->zap(i, i);
+      } else {
+        // still waiting, so make sure any slow ones get zapped.
+        _checker->reschedule(0);
+      }
     }
 #ifdef DEBUG_PROCESS_MANAGER
     LOG("done waiting...");
@@ -257,6 +273,28 @@ void launch_manager::stop_all_kids()
   }
 }
 
+#ifdef DEBUG_PROCESS_MANAGER
+void launch_manager::child_exited(basis::un_int child_id, int exit_value)
+#else
+void launch_manager::child_exited(basis::un_int child_id, int formal(exit_value))
+#endif
+{
+#ifdef DEBUG_PROCESS_MANAGER
+  FUNCDEF("child_exited");
+  LOG(a_sprintf("child %d exited with %d.", child_id, exit_value));
+#endif
+  {
+    LOCK_ZOMBIES;
+    for (int i = _going_down->length() - 1; i >= 0; i--)
+      if ((*_going_down)[i]._pid == int(child_id)) _going_down->zap(i, i);
+  }
+  {
+    LOCK_KIDS;
+    for (int i = _our_kids->length() - 1; i >= 0; i--)
+      if ((*_our_kids)[i]._pid == int(child_id)) _our_kids->zap(i, i);
+  }
+}
+
 void launch_manager::launch_startup_apps()
 {
   FUNCDEF("launch_startup_apps");
@@ -579,10 +617,7 @@ bool launch_manager::get_processes(process_entry_array &processes)
 bool launch_manager::find_process(const astring &app_name_in, int_set &pids)
 {
   FUNCDEF("find_process");
-  pids.clear();
-  process_entry_array processes;
-  if (!get_processes(processes)) return false;
-  return process_control::find_process_in_list(processes, app_name_in, pids);
+  return _procs->find_process(app_name_in, pids);
 }
 
 outcome launch_manager::zap_process(const astring &product,
@@ -727,11 +762,15 @@ void launch_manager::push_timed_activities(process_entry_array &processes)
     for (int i = _going_down->length() - 1; i >= 0; i--) {
       graceful_record &grace = (*_going_down)[i];
 
-      GET_PROCESSES;  // load them if they hadn't been.
-
+      // the supervisor tells us when its children exit, so those that it's
+      // still watching are known to be running.
+      bool supervised = child_supervisor::program_wide().supervising(grace._pid);
       int_set pids;
-      if (!process_control::find_process_in_list(processes, grace._app_name,
-          pids)) {
+      if (!supervised) {
+        GET_PROCESSES;  // load them if they hadn't been.
+      }
+      if (!supervised && !process_control::find_process_in_list(processes,
+          grace._app_name, pids)) {
         // the app can't be found as running, so whack the record for it.
 #ifdef DEBUG_PROCESS_MANAGER
         LOG(astring("cannot find app ") + grace._app_name
@@ -740,7 +779,7 @@ void launch_manager::push_timed_activities(process_entry_array &processes)
         _going_down->zap(i, i);
         continue;
       }
-      if (!pids.member(grace._pid)) {
+      if (!supervised && !pids.member(grace._pid)) {
         // that particular instance exited on its own, so whack the record.
 #ifdef DEBUG_PROCESS_MANAGER
         LOG(astring("app ") + grace._app_name
@@ -772,6 +811,9 @@ void launch_manager::push_timed_activities(process_entry_array &processes)
     for (int i = _our_kids->length() - 1; i >= 0; i--) {
       graceful_record &grace = (*_our_kids)[i];
 
+      // no need to look for the ones that the supervisor is watching.
+      if (child_supervisor::program_wide().supervising(grace._pid)) continue;
+
       GET_PROCESSES;  // load them if they hadn't been.
 
       int_set pids;
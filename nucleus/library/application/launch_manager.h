@@ -29,6 +29,7 @@
 #include <basis/mutex.h>
 #include <basis/outcome.h>
 #include <basis/contracts.h>
+#include <processes/child_supervisor.h>
 #include <processes/configured_applications.h>
 #include <processes/process_entry.h>
 #include <processes/process_control.h>
@@ -43,10 +44,14 @@ class launch_manager_thread;
 //! Provides methods for starting, stopping and checking on processes.
 /*!
   This includes support for graceful shutdowns and background handling of
-  exiting processes.
+  exiting processes.  When the child_supervisor is supported, the exits of
+  the children we started are reported to us directly, rather than being
+  noticed on the next scan of the process list.
 */
 
-class launch_manager : public virtual basis::root_object
+class launch_manager
+: public virtual basis::root_object,
+  public virtual processes::child_observer
 {
 public:
   launch_manager(processes::configured_applications &config);
@@ -144,6 +149,9 @@ public:
   void stop_everything();
     //!< closes down the operation of this object.
 
+  virtual void child_exited(basis::un_int child_id, int exit_value);
+    //!< drops the records for a child process that the supervisor reaped.
+
 private:
   processes::configured_applications &_configs;  //!< manages the entries for companies.
   bool _started_initial_apps;  //!< true if we launched the boot apps.
@@ -1,6 +1,3 @@
-
-
-
 /*****************************************************************************\
 *                                                                             *
 *  Name   : memory_checker                                                    *
@@ -18,22 +15,46 @@
 // note: parts of this have been around since at least 1998, but this code was
 // newly revised for memory checking in february of 2007.  --cak
 
+#include "memory_checker.h"
+
 #ifdef ENABLE_MEMORY_HOOK
 
-#include "definitions.h"
-#include "log_base.h"
-#include "memory_checker.h"
-#include "mutex.h"
-#include "utility.h"
+#include <basis/definitions.h>
+#include <basis/common_outcomes.h>
+#include <basis/mutex.h>
+#ifdef ENABLE_CALLSTACK_TRACKING
+  #include "callstack_tracker.h"
+#endif
 
+#include <new>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+using namespace basis;
+
+namespace application {
+
 const int MAXIMUM_HASH_SLOTS = 256 * KILOBYTE;
   // that's a whole lot of slots.  this number is basically multiplied by
   // the sizeof(memory_bin) to get full memory footprint.
 
+const int MAXIMUM_CALL_SITES = 16 * KILOBYTE;
+  // the most places in the code that allocations can be charged to.  this
+  // must be a power of two.  any sites past this are lumped together.
+
+const int UNKNOWN_SITE = 0;
+  // the call site used when the real one is unknown or can't be recorded.
+
+const int THREAD_CACHED_LINKS = 64;
+  // each thread keeps up to this many spare memlinks for tracking its next
+  // sampled allocations, so that those don't need a malloc of their own.
+
+const int STATISTICS_FLUSH = 256;
+  // a thread adds its counts into the program-wide statistics after this many
+  // allocations, rather than fighting over the totals on every single one.
+
 const int SINGLE_LINE_SIZE_ESTIMATE = 200;
   // we are guessing that the average line of memory printout will take
   // this many characters.  that includes the size, the pointer value,
@@ -57,15 +78,18 @@ const int RESERVED_AREA = 1000;
 
 //////////////
 
-// define the replacement new and delete operators.
+// a call site is a place in the code that allocates memory.  once a site is
+// filled in, it never changes, so it can be read without any locking.
 
-#include <basis/trap_new.addin>
-void *operator new(size_t size, char *file, int line) throw (std::bad_alloc)
-{ return program_wide_memories().provide_memory(size, file, line); }
-#include <basis/untrap_new.addin>
+class call_site
+{
+public:
+  const void *_place;  //!< the file name, or the code address for a site.
+  int _line;  //!< line number in the file; negative for a code address.
+  int _state;  //!< one of the site_states below.
+};
 
-void operator delete(void *ptr) throw ()
-{ program_wide_memories().release_memory(ptr); }
+enum site_states { EMPTY_SITE, FILLING_SITE, READY_SITE };
 
 //////////////
 
@@ -81,34 +105,26 @@ public:
     code. */
   memlink *_next;  //!< the next memory wrapper in the list.
   int _size;  //!< the size of the chunk delivered.
-  char *_where;  //!< the name of the place that created it.
-  int _line;  //!< the line number where the item was allocated.
+  int _site;  //!< the call site that allocated the chunk.
 #ifdef ENABLE_CALLSTACK_TRACKING
   char *_stack;  //!< records the stack seen at time of allocation.
 #endif
 
-  void construct(void *ptr, int size, char *where, int line) {
+  void construct(void *ptr, int size, int site) {
     _next = NULL_POINTER;
     _chunk = ptr;
     _size = size;
-    _where = strdup(where);  // uses malloc, not new, so we're safe.
-    if (strlen(_where) > SINGLE_LINE_SIZE_ESTIMATE - 40) {
-      // if we will not have room for the full line, we crop it.
-      _where[SINGLE_LINE_SIZE_ESTIMATE - 40] = '\0';
-    }
-    _line = line;
+    _site = site;
 #ifdef ENABLE_CALLSTACK_TRACKING
     _stack = program_wide_stack_trace().full_trace();
-///printf("stack here:\n%s", _stack);
 #endif
   }
 
   void destruct() {
     free(_chunk); _chunk = NULL_POINTER;
-    free(_where); _where = NULL_POINTER; 
     _next = NULL_POINTER;
     _size = 0;
-    _line = 0;
+    _site = UNKNOWN_SITE;
 #ifdef ENABLE_CALLSTACK_TRACKING
     free(_stack); _stack = NULL_POINTER;
 #endif
@@ -117,23 +133,147 @@ public:
 
 //////////////
 
-//pretty lame here so far.
 #ifdef MEMORY_CHECKER_STATISTICS
   // simple stats: the methods below will tweak these numbers if memory_checker
   // statistics are enabled.  ints won't do here, due to the number of
-  // operations in a long-running program easily overflowing that size.
+  // operations in a long-running program easily overflowing that size.  the
+  // threads add their own counts into these every so often.
 
   // this bank of statistics counts the number of times memory was treated
   // a certain way.
-  double _stat_new_allocations = 0;  // this many new allocations occurred.
-  double _stat_freed_allocations = 0;  // number of freed blocks.
+  signed_long_long _stat_new_allocations = 0;  // this many new allocations.
+  signed_long_long _stat_freed_allocations = 0;  // number of freed blocks.
   // next bank of stats are the sizes of the memory that were stowed, etc.
-  double _stat_new_allocations_size = 0;  // this many bytes got allocated.
-  double _stat_freed_allocations_size = 0;  // this many bytes were freed.
+  signed_long_long _stat_new_allocations_size = 0;  // bytes allocated.
+  signed_long_long _stat_tracked_freed_size = 0;  // tracked bytes freed.
 #endif
 
 //////////////
 
+// the thread_cache holds what each thread keeps to itself, so that most
+// allocations never touch anything shared with the other threads.
+
+class thread_cache
+{
+public:
+  memlink *_spares;  //!< memlinks that can be reused for tracking.
+  int _spare_count;  //!< how many memlinks are in the spares.
+  int _countdown;  //!< allocations left before the next one is tracked.
+  un_int _random;  //!< state for choosing the sampling intervals.
+#ifdef MEMORY_CHECKER_STATISTICS
+  int _unflushed;  //!< allocations since we last flushed the statistics.
+  signed_long_long _new_allocations;
+  signed_long_long _freed_allocations;
+  signed_long_long _new_allocations_size;
+  signed_long_long _tracked_freed_size;
+#endif
+
+  void construct() {
+    memset(this, 0, sizeof(thread_cache));
+    _random = un_int(size_t(this) >> 4) | 1;  // any non-zero seed will do.
+  }
+
+  void destruct() {
+    flush_statistics();
+    while (_spares) {
+      memlink *goner = _spares;
+      _spares = goner->_next;
+      free(goner);
+    }
+    _spare_count = 0;
+  }
+
+  //! decides whether the next allocation should be tracked.
+  /*! the intervals between tracked allocations are random, averaging out to
+  the "sampling" rate, so that a program that allocates in a regular pattern
+  can't keep sidestepping the samples. */
+  bool take_sample(int sampling) {
+    if (sampling <= 1) return true;
+    if (--_countdown > 0) return false;
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    _countdown = int(_random % un_int(2 * sampling - 1)) + 1;
+    return true;
+  }
+
+  memlink *grab_link() {
+    if (!_spares) return (memlink *)malloc(sizeof(memlink));
+    memlink *to_return = _spares;
+    _spares = to_return->_next;
+    _spare_count--;
+    return to_return;
+  }
+
+  void give_back_link(memlink *link) {
+    if (_spare_count >= THREAD_CACHED_LINKS) { free(link); return; }
+    link->_next = _spares;
+    _spares = link;
+    _spare_count++;
+  }
+
+#ifdef MEMORY_CHECKER_STATISTICS
+  void count_allocation(size_t size) {
+    _new_allocations++;
+    _new_allocations_size += size;
+    if (++_unflushed >= STATISTICS_FLUSH) flush_statistics();
+  }
+
+  void count_release(int tracked_size) {
+    _freed_allocations++;
+    _tracked_freed_size += tracked_size;
+  }
+#else
+  void count_allocation(size_t formal(size)) {}
+  void count_release(int formal(tracked_size)) {}
+#endif
+
+  void flush_statistics() {
+#ifdef MEMORY_CHECKER_STATISTICS
+    __atomic_add_fetch(&_stat_new_allocations, _new_allocations,
+        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_stat_freed_allocations, _freed_allocations,
+        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_stat_new_allocations_size, _new_allocations_size,
+        __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_stat_tracked_freed_size, _tracked_freed_size,
+        __ATOMIC_RELAXED);
+    _new_allocations = 0;
+    _freed_allocations = 0;
+    _new_allocations_size = 0;
+    _tracked_freed_size = 0;
+    _unflushed = 0;
+#endif
+  }
+};
+
+static pthread_key_t __cache_key;
+  // lets each thread's cache be cleaned up when the thread exits.
+
+static __thread thread_cache *__thread_cache = NULL_POINTER;
+  // the current thread's cache, once it has allocated anything.
+
+static void whack_thread_cache(void *cache)
+{
+  thread_cache *goner = (thread_cache *)cache;
+  if (__thread_cache == goner) __thread_cache = NULL_POINTER;
+  goner->destruct();
+  free(goner);
+}
+
+//! returns the cache for the current thread, creating it on first use.
+static thread_cache &current_cache()
+{
+  if (!__thread_cache) {
+    __thread_cache = (thread_cache *)malloc(sizeof(thread_cache));
+    __thread_cache->construct();
+    pthread_setspecific(__cache_key, __thread_cache);
+  }
+  return *__thread_cache;
+}
+
+//////////////
+
 //! the memory bin holds a list of chunks of memory in memlink objects.
 
 class memory_bin
@@ -142,7 +282,7 @@ public:
   void construct() {
     _head = NULL_POINTER;
     _count = 0;
-    _lock = (mutex_base *)malloc(sizeof(mutex_base));
+    _lock = (mutex *)malloc(sizeof(mutex));
     _lock->construct();
   }
   void destruct() {
@@ -150,38 +290,29 @@ public:
     free(_lock);
   }
 
-  int count() const { return _count; }
+  int count() const { return __atomic_load_n(&_count, __ATOMIC_RELAXED); }
 
-  int record_memory(void *ptr, int size, char *where, int line) {
-    memlink *new_guy = (memlink *)malloc(sizeof(memlink));
-    new_guy->construct(ptr, size, where, line);
+  void record_memory(memlink *new_guy) {
     _lock->lock();
     // this code has the effect of putting more recent allocations first.
     // if they happen to get cleaned up right away, that's nice and fast.
     new_guy->_next = _head;
     _head = new_guy;
-    _count++;
+    __atomic_store_n(&_count, _count + 1, __ATOMIC_RELAXED);
     _lock->unlock();
-    return common::OKAY;  // seems to have worked fine.
   }
 
-  int release_memory(void *to_release) {
+  //! unlinks the record for "to_release" and returns it, if we had one.
+  memlink *release_memory(void *to_release) {
+    // most bins are empty when sampling, and the memory can't be in those.
+    if (!count()) return NULL_POINTER;
     _lock->lock();
     // search the bin to locate the item specified.
     memlink *current = _head;  // current will scoot through the list.
     memlink *previous = NULL_POINTER;  // previous remembers the parent node, if any.
     while (current) {
       if (current->_chunk == to_release) {
-#ifdef MEMORY_CHECKER_STATISTICS
-        // record that it went away.
-        _stat_freed_allocations += 1.0;
-        _stat_freed_allocations_size += current->_size;
-#endif
-#ifdef DEBUG_MEMORY_CHECKER
-        printf("found %p listed, removing for %s[%d]\n", to_release,
-            current->_where, current->_line);
-#endif
-        // unlink this one and clean up; they don't want it now.
+        // unlink this one; they don't want it now.
         if (!previous) {
           // this is the head we're modifying.
           _head = current->_next;
@@ -189,32 +320,33 @@ public:
           // not the head, so there was a valid previous element.
           previous->_next = current->_next;
         }
-        // now trash that goner's house.
-        current->destruct();
-        free(current);
-        _count--;
+        __atomic_store_n(&_count, _count - 1, __ATOMIC_RELAXED);
         _lock->unlock();
-        return common::OKAY;
+        return current;
       }
       // the current node isn't it; jump to next node.
       previous = current;
       current = current->_next;
     }
-#ifdef DEBUG_MEMORY_CHECKER
-    printf("failed to find %p listed.\n", to_release);
-#endif
     _lock->unlock();
-    return common::NOT_FOUND;
+    return NULL_POINTER;
   }
 
-  void dump_list(char *add_to, int &curr_size, int max_size) {
+  void dump_list(char *add_to, int &curr_size, int max_size,
+      const call_site *sites) {
     int size_alloc = 2 * SINGLE_LINE_SIZE_ESTIMATE;  // room for one line.
     char *temp_str = (char *)malloc(size_alloc);
+    _lock->lock();
     memlink *current = _head;  // current will scoot through the list.
     while (current) {
-      temp_str[0] = '\0';
-      sprintf(temp_str, "\n\"%s[%d]\", \"size %d\", \"addr %p\"\n",
-          current->_where, current->_line, current->_size, current->_chunk);
+      const call_site &site = sites[current->_site];
+      if (site._line < 0)
+        snprintf(temp_str, size_alloc, "\n\"code %p\", \"size %d\", "
+            "\"addr %p\"\n", site._place, current->_size, current->_chunk);
+      else
+        snprintf(temp_str, size_alloc, "\n\"%s[%d]\", \"size %d\", "
+            "\"addr %p\"\n", site._place? (const char *)site._place : "unknown",
+            site._line, current->_size, current->_chunk);
       int len_add = strlen(temp_str);
       if (curr_size + len_add < max_size) {
         strcat(add_to, temp_str);
@@ -229,17 +361,46 @@ public:
 #endif
       current = current->_next;
     }
+    _lock->unlock();
     free(temp_str);
   }
 
+  //! adds the count and size of our chunks into the totals for their sites.
+  void total_sites(signed_long_long *counts, signed_long_long *sizes) {
+    _lock->lock();
+    for (memlink *current = _head; current; current = current->_next) {
+      counts[current->_site]++;
+      sizes[current->_site] += current->_size;
+    }
+    _lock->unlock();
+  }
+
 private:
   memlink *_head;  // our first, if any, item.
-  mutex_base *_lock;  // protects our bin from concurrent access.
+  mutex *_lock;  // protects our bin from concurrent access.
   int _count;  // current count of items held.
 };
 
 //////////////
 
+// a call site and the memory it holds, for sorting the sites by size.
+struct site_total
+{
+  signed_long_long _size;  // the bytes held by allocations from the site.
+  int _site;  // which call site it is.
+};
+
+// orders the call sites by how much memory they're holding, largest first.
+static int compare_site_sizes(const void *a, const void *b)
+{
+  signed_long_long size_a = ((const site_total *)a)->_size;
+  signed_long_long size_b = ((const site_total *)b)->_size;
+  if (size_a == size_b) return 0;
+  return size_a > size_b? -1 : 1;
+}
+
+//////////////
+
 class allocation_memories
 {
 public:
@@ -248,6 +409,8 @@ public:
     _bins = (memory_bin *)malloc(num_slots * sizeof(memory_bin));
     for (int i = 0; i < num_slots; i++)
       _bins[i].construct();
+    _sites = (call_site *)calloc(MAXIMUM_CALL_SITES, sizeof(call_site));
+    _sites[UNKNOWN_SITE]._state = READY_SITE;
   }
 
   void destruct() {
@@ -257,24 +420,58 @@ public:
     }
     free(_bins);
     _bins = NULL_POINTER;
+    free(_sites);
+    _sites = NULL_POINTER;
   }
 
   int compute_slot(void *ptr) {
-    return utility::hash_bytes(&ptr, sizeof(void *)) % _num_slots;
+    // the low bits of a heap address are mostly alignment, so they're dropped.
+    return int(((size_t(ptr) >> 4) * 2654435761U) % size_t(_num_slots));
+  }
+
+  //! returns the number for the call site at "place" and "line".
+  /*! the site is added if it hasn't been seen before.  sites are never
+  removed, so no locks are needed; a new site is claimed with an atomic swap
+  and the few threads that race to read it wait for it to be filled in. */
+  int intern_site(const void *place, int line) {
+    if (!place) return UNKNOWN_SITE;
+    un_int hash = un_int((size_t(place) >> 2) * 2654435761U) ^ un_int(line);
+    for (int probe = 0; probe < MAXIMUM_CALL_SITES; probe++) {
+      int index = int((hash + probe) & (MAXIMUM_CALL_SITES - 1));
+      call_site &site = _sites[index];
+      int state = __atomic_load_n(&site._state, __ATOMIC_ACQUIRE);
+      if (state == EMPTY_SITE) {
+        if (__atomic_compare_exchange_n(&site._state, &state, FILLING_SITE,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+          site._place = place;
+          site._line = line;
+          __atomic_store_n(&site._state, READY_SITE, __ATOMIC_RELEASE);
+          return index;
+        }
+      }
+      while (state == FILLING_SITE)
+        state = __atomic_load_n(&site._state, __ATOMIC_ACQUIRE);
+      if ( (site._place == place) && (site._line == line) ) return index;
+    }
+    return UNKNOWN_SITE;  // the table is full.
   }
 
-  void *provide_memory(int size_needed, char *file, int line) {
+  void *provide_memory(size_t size_needed, const void *place, int line,
+      int sampling) {
     void *new_allocation = malloc(size_needed);
+    if (!new_allocation) return NULL_POINTER;
+    thread_cache &cache = current_cache();
+    cache.count_allocation(size_needed);
+    if (!cache.take_sample(sampling)) return new_allocation;
+    memlink *new_guy = cache.grab_link();
+    new_guy->construct(new_allocation, int(size_needed),
+        intern_site(place, line));
     // slice and dice pointer to get appropriate hash bin.
     int slot = compute_slot(new_allocation);
 #ifdef DEBUG_MEMORY_CHECKER
     printf("using slot %d for %p\n", slot, new_allocation);
 #endif
-    _bins[slot].record_memory(new_allocation, size_needed, file, line);
-#ifdef MEMORY_CHECKER_STATISTICS
-    _stat_new_allocations += 1.0;
-    _stat_new_allocations_size += size_needed;
-#endif
+    _bins[slot].record_memory(new_guy);
     return new_allocation;
   }
 
@@ -283,7 +480,19 @@ public:
 #ifdef DEBUG_MEMORY_CHECKER
     printf("removing mem %p from slot %d.\n", to_drop, slot);
 #endif
-    return _bins[slot].release_memory(to_drop);
+    thread_cache &cache = current_cache();
+    memlink *goner = _bins[slot].release_memory(to_drop);
+    if (!goner) {
+      // we weren't tracking this one, but it still needs to go away.
+      cache.count_release(0);
+      free(to_drop);
+      return common::NOT_FOUND;
+    }
+    cache.count_release(goner->_size);
+    // now trash that goner's house.
+    goner->destruct();
+    cache.give_back_link(goner);
+    return common::OKAY;
   }
 
   //! this returns a newly created string with all current contents listed.
@@ -295,10 +504,8 @@ public:
     // count how many allocations we have overall.
     int full_count = 0;
     for (int i = 0; i < _num_slots; i++) {
-///if (_bins[i].count()) printf("%d adding count %d\n", i, _bins[i].count());
       full_count += _bins[i].count();
     }
-///printf("full count is %d\n", full_count);
     // calculate a guess for how much space we need to show all of those.
     int alloc_size = full_count * SINGLE_LINE_SIZE_ESTIMATE + RESERVED_AREA;
     char *to_return = (char *)malloc(alloc_size);
@@ -310,13 +517,66 @@ public:
     }
     int curr_size = strlen(to_return);  // how much in use so far.
     for (int i = 0; i < _num_slots; i++) {
-      _bins[i].dump_list(to_return, curr_size, alloc_size - RESERVED_AREA);
+      _bins[i].dump_list(to_return, curr_size, alloc_size - RESERVED_AREA,
+          _sites);
+    }
+    return to_return;
+  }
+
+  //! lists the call sites that hold the most memory, largest first.
+  char *report_sites(int sampling) {
+    signed_long_long *counts = (signed_long_long *)calloc(MAXIMUM_CALL_SITES,
+        sizeof(signed_long_long));
+    signed_long_long *sizes = (signed_long_long *)calloc(MAXIMUM_CALL_SITES,
+        sizeof(signed_long_long));
+    for (int i = 0; i < _num_slots; i++)
+      if (_bins[i].count()) _bins[i].total_sites(counts, sizes);
+    site_total *order = (site_total *)malloc(MAXIMUM_CALL_SITES
+        * sizeof(site_total));
+    int used = 0;
+    for (int i = 0; i < MAXIMUM_CALL_SITES; i++) {
+      if (!counts[i]) continue;
+      order[used]._size = sizes[i];
+      order[used++]._site = i;
+    }
+    qsort(order, used, sizeof(site_total), compare_site_sizes);
+
+    int alloc_size = used * SINGLE_LINE_SIZE_ESTIMATE + RESERVED_AREA;
+    char *to_return = (char *)malloc(alloc_size);
+    snprintf(to_return, RESERVED_AREA, "=====================\n"
+        "Outstanding Call Sites\n=====================\n%s",
+        sampling > 1? "(estimated from the sampled allocations)\n" : "");
+    int curr_size = strlen(to_return);
+    char *temp_str = (char *)malloc(2 * SINGLE_LINE_SIZE_ESTIMATE);
+    for (int i = 0; i < used; i++) {
+      const call_site &site = _sites[order[i]._site];
+      signed_long_long count = counts[order[i]._site] * sampling;
+      signed_long_long size = order[i]._size * sampling;
+      if (site._line < 0)
+        snprintf(temp_str, 2 * SINGLE_LINE_SIZE_ESTIMATE, "  %lld bytes in "
+            "%lld allocations from code %p\n", size, count, site._place);
+      else
+        snprintf(temp_str, 2 * SINGLE_LINE_SIZE_ESTIMATE, "  %lld bytes in "
+            "%lld allocations from %s[%d]\n", size, count,
+            site._place? (const char *)site._place : "unknown", site._line);
+      int len_add = strlen(temp_str);
+      if (curr_size + len_add >= alloc_size) break;
+      strcat(to_return, temp_str);
+      curr_size += len_add;
     }
+    free(temp_str);
+    free(order);
+    free(sizes);
+    free(counts);
     return to_return;
   }
 
   // this is fairly resource intensive, so don't dump the state out that often.
-  char *text_form(bool show_outstanding) {
+#ifdef MEMORY_CHECKER_STATISTICS
+  char *text_form(bool show_outstanding, int sampling) {
+#else
+  char *text_form(bool show_outstanding, int formal(sampling)) {
+#endif
     char *to_return = NULL_POINTER;
     if (show_outstanding) {
       to_return = report_allocations();
@@ -325,8 +585,11 @@ public:
       to_return[0] = '\0';
     }
 #ifdef MEMORY_CHECKER_STATISTICS
+    // our own thread's counts are brought up to date; other threads may
+    // still be holding a few of theirs.
+    current_cache().flush_statistics();
     char *temp_str = (char *)malloc(4 * SINGLE_LINE_SIZE_ESTIMATE);
-    
+
     sprintf(temp_str, "=================\n");
     strcat(to_return, temp_str);
     sprintf(temp_str, "Memory Statistics\n");
@@ -335,16 +598,18 @@ public:
     strcat(to_return, temp_str);
     sprintf(temp_str, "Measurements taken across entire program runtime:\n");
     strcat(to_return, temp_str);
-    sprintf(temp_str, "  %.0f new allocations.\n", _stat_new_allocations);
+    sprintf(temp_str, "  %lld new allocations.\n", _stat_new_allocations);
     strcat(to_return, temp_str);
     sprintf(temp_str, "  %.4f new Mbytes.\n",
-        _stat_new_allocations_size / MEGABYTE);
+        double(_stat_new_allocations_size) / MEGABYTE);
     strcat(to_return, temp_str);
-    sprintf(temp_str, "  %.0f freed deallocations.\n",
+    sprintf(temp_str, "  %lld freed deallocations.\n",
         _stat_freed_allocations);
     strcat(to_return, temp_str);
-    sprintf(temp_str, "  %.4f freed Mbytes.\n",
-        _stat_freed_allocations_size / MEGABYTE);
+    // only the tracked memory has a known size when it's freed.
+    sprintf(temp_str, "  %.4f freed Mbytes%s.\n",
+        double(_stat_tracked_freed_size) * sampling / MEGABYTE,
+        sampling > 1? " (estimated)" : "");
     strcat(to_return, temp_str);
 
     free(temp_str);
@@ -355,16 +620,34 @@ public:
 private:
   memory_bin *_bins;  //!< each bin manages a list of pointers, found by hash.
   int _num_slots;  //!< the number of hash slots we have.
+  call_site *_sites;  //!< the places that memory has been allocated from.
 };
 
 //////////////
 
+memory_checker &program_wide_memories()
+{
+  // the checker is kept in static storage, since it can't very well be
+  // created with new.
+  static memory_checker *_checker = NULL_POINTER;
+  static char _storage[sizeof(memory_checker)]
+      __attribute__((aligned(sizeof(void *))));
+  if (!_checker) {
+    memory_checker *created = (memory_checker *)_storage;
+    created->construct();
+    _checker = created;
+  }
+  return *_checker;
+}
+
 void memory_checker::construct()
 {
+  pthread_key_create(&__cache_key, whack_thread_cache);
   _mems = (allocation_memories *)malloc(sizeof(allocation_memories));
   _mems->construct(MAXIMUM_HASH_SLOTS);
   _unusable = false;
   _enabled = true;
+  _sampling = 1;
 }
 
 void memory_checker::destruct()
@@ -385,30 +668,76 @@ if (!_mems) printf("memory_checker::destruct being invoked twice!\n");
   _mems = NULL_POINTER;
 }
 
-void *memory_checker::provide_memory(size_t size, char *file, int line)
+void memory_checker::set_sampling(int one_in)
+{
+  _sampling = one_in < 1? 1 : one_in;
+}
+
+void *memory_checker::provide_memory(size_t size, const char *file, int line)
+{
+  if (_unusable || !_enabled) return malloc(size);
+  return _mems->provide_memory(size, file, line < 0? 0 : line, _sampling);
+}
+
+void *memory_checker::provide_memory(size_t size, const void *caller)
 {
   if (_unusable || !_enabled) return malloc(size);
-  return _mems->provide_memory(size, file, line);
+  return _mems->provide_memory(size, caller, -1, _sampling);
 }
 
 int memory_checker::release_memory(void *ptr)
 {
-  if (_unusable || !_enabled) {
+  if (!ptr) return common::OKAY;
+  if (_unusable) {
     free(ptr);
     return common::OKAY;
   }
+  // even while disabled, memory that was tracked earlier must be forgotten.
   return _mems->release_memory(ptr);
 }
 
 char *memory_checker::text_form(bool show_outstanding)
 {
   if (_unusable) return strdup("already destroyed memory_checker!\n");
-  return _mems->text_form(show_outstanding);
+  return _mems->text_form(show_outstanding, _sampling);
+}
+
+char *memory_checker::call_site_snapshot()
+{
+  if (_unusable) return strdup("already destroyed memory_checker!\n");
+  return _mems->report_sites(_sampling);
 }
 
+} //namespace.
+
 //////////////
 
-#endif  // enable memory hook
+// define the replacement new and delete operators.  each allocation is
+// charged to the code that invoked new.
+
+void *operator new(size_t size)
+{
+  if (!size) size = 1;  // every new must produce a unique pointer.
+  void *to_return = application::program_wide_memories().provide_memory(size,
+      __builtin_return_address(0));
+  if (!to_return) throw std::bad_alloc();
+  return to_return;
+}
+
+void *operator new[](size_t size)
+{
+  if (!size) size = 1;
+  void *to_return = application::program_wide_memories().provide_memory(size,
+      __builtin_return_address(0));
+  if (!to_return) throw std::bad_alloc();
+  return to_return;
+}
+
+void operator delete(void *ptr) throw ()
+{ application::program_wide_memories().release_memory(ptr); }
 
+void operator delete[](void *ptr) throw ()
+{ application::program_wide_memories().release_memory(ptr); }
 
+#endif  // enable memory hook
 
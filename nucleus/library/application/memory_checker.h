@@ -15,12 +15,13 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
-#include "definitions.h"
+#include <basis/definitions.h>
 
 #ifdef ENABLE_MEMORY_HOOK
 
-#include "build_configuration.h"
-uhh
+#include <stddef.h>
+
+namespace application {
 
 // forward.
 class allocation_memories;
@@ -28,7 +29,7 @@ class memory_checker;
 
 //////////////
 
-memory_checker BASIS_EXTERN &program_wide_memories();
+memory_checker &program_wide_memories();
   //!< a global version of the memory checker to access memory tracking.
   /*!< this accesses the singleton object that tracks all memory allocations
   occuring in the program via calls to new and delete.  it should be used
@@ -41,11 +42,18 @@ memory_checker BASIS_EXTERN &program_wide_memories();
   Provides allocation checking for heap memory for C++.  This is used as a
   replacement for the standard new and delete operations.  No object should
   really need to deal with this class directly; it is hooked in automatically
-  unless the ENABLE_MEMORY_HOOK macro is defined.  Generally, release builds
-  should not have this enabled, since it will slow things down tremendously.
+  when the ENABLE_MEMORY_HOOK macro is defined.
   NOTE: this object can absolutely not be hooked into callstack tracker, since
-  this object implements all c++ memory, including the tracker's.  This object
-  will use the backtrace information if it's available.
+  this object implements all c++ memory, including the tracker's.
+
+  Every allocation is charged to a call site, which is either the file and
+  line given to provide_memory() or the code address that invoked new.  Each
+  call site is recorded once and then referred to by a small number.  By
+  default every allocation is tracked, which is thorough but slow.  When a
+  sampling rate is set, only one allocation in that many is tracked, and the
+  others cost about as much as plain malloc and free do.  That is cheap enough
+  to leave on in a production service while still showing which call sites
+  are holding on to memory.
 */
 
 class memory_checker
@@ -62,20 +70,35 @@ public:
   //! reports on whether the memory checker is currently in service or not.
   bool enabled() const { return _enabled; }
 
-  void *provide_memory(size_t size, char *file, int line);
+  void set_sampling(int one_in);
+    //!< tracks only one out of every "one_in" allocations.
+    /*!< a rate of one (the default) tracks every allocation.  the choice of
+    allocations to track is made separately by each thread. */
+
+  int sampling() const { return _sampling; }
+    //!< the current sampling rate; one means everything is tracked.
+
+  void *provide_memory(size_t size, const char *file, int line);
     //!< returns a chunk of memory with the "size" specified.
     /*!< this is the replacement method for the new operator.  we will be
     calling this instead of the compiler provided new.  the "file" string
     should be a record of the location where this is invoked, such as is
-    provided by the __FILE__ macro.  the "line" should be set to the line
-    number within the "file", if applicable (use __LINE__). */
+    provided by the __FILE__ macro, and it must stay valid for the life of
+    the program.  the "line" should be set to the line number within the
+    "file", if applicable (use __LINE__).  if the "file" is NULL_POINTER, the
+    allocation is charged to an unknown call site. */
+
+  void *provide_memory(size_t size, const void *caller);
+    //!< like the above, but charges the memory to the code at "caller".
+    /*!< this is how the replacement new operators record where they were
+    invoked from, using the return address of their caller. */
 
   int release_memory(void *ptr);
-    //!< drops our record for the memory at "ptr".
+    //!< drops our record for the memory at "ptr" and frees it.
     /*!< this is the only way to remove an entry from our listings so that
     it will not be reported as a leak.  we do not currently gather any info
-    about where the release is invoked.  if there was a problem, the returned
-    outcome will not be OKAY. */
+    about where the release is invoked.  NOT_FOUND is returned if the memory
+    was not being tracked, which is normal for unsampled allocations. */
 
   char *text_form(bool show_outstanding);
     //!< returns a newly allocated string with the stats for this object.
@@ -83,12 +106,21 @@ public:
     displayed in the string also.  the invoker *must* free the returned
     pointer. */
 
+  char *call_site_snapshot();
+    //!< reports the outstanding allocations grouped by their call sites.
+    /*!< the sites holding the most memory are listed first.  when sampling,
+    the counts are scaled up by the sampling rate to estimate the full
+    picture.  the string is malloc'd and the invoker *must* free it. */
+
 private:
   allocation_memories *_mems;  //!< internal object tracks all allocations.
   bool _unusable;  //!< true after destruct is called.
   bool _enabled;  //!< true if the object is okay to use.
+  int _sampling;  //!< one out of this many allocations is tracked.
 };
 
+} //namespace.
+
 #else // enable memory hook.
   // this section disables the memory checker entirely.
   #define program_wide_memories()
@@ -46,12 +46,18 @@ using namespace structures;
 
 namespace application {
 
+const int HEADER_ALIGNMENT = 64;
+  // the user's memory starts on a boundary of this many bytes.
+
 shared_memory::shared_memory(int size, const char *identity)
 : _locking(new rendezvous(identity)),
+  _mutex(NULL_POINTER),
   _the_memory(NULL_POINTER),
   _valid(false),
   _identity(new astring(identity)),
-  _size(size)
+  _size(size),
+  _segment(NULL_POINTER),
+  _mapping(NULL_POINTER)
 {
   FUNCDEF("constructor");
   bool first_use = false;  // assume already existing until told otherwise.
@@ -78,7 +84,7 @@ shared_memory::shared_memory(int size, const char *identity)
     // getting to here means the memory was already allocated.  so we're fine.
   } else {
     // the shared memory segment was just created this time.
-    int ret = ftruncate(_the_memory, size);
+    int ret = ftruncate(_the_memory, header_size() + size);
     basis::un_int err = critical_events::system_error();  // get last error.
     if (ret) {
       printf("error truncating shared segment for %s, was told %s.",
@@ -89,7 +95,7 @@ shared_memory::shared_memory(int size, const char *identity)
   _valid = true;
 #elif defined(__WIN32__)
   _the_memory = ::CreateFileMapping((HANDLE)-1, NULL, PAGE_READWRITE,
-      0, size, to_unicode_temp(identity));
+      0, header_size() + size, to_unicode_temp(identity));
   basis::un_int err = critical_events::system_error();  // get last error.
   first_use = (err != ERROR_ALREADY_EXISTS);
   if (!_the_memory) {
@@ -107,22 +113,32 @@ shared_memory::shared_memory(int size, const char *identity)
   _the_memory = _bogus_shared_space().access();
   _valid = true;
 #endif
+  // the memory stays mapped for as long as we have it open.
+  _segment = locked_grab_memory();
+  if (!_segment) {
+    _valid = false;
+    _locking->unlock();
+    return;
+  }
+  _mapping = _segment + header_size();
   if (first_use) {
-    // initialize the new memory to all zeros.
-    abyte *contents = locked_grab_memory();
-    if (!contents) {
+    // initialize the new memory to all zeros and set up the mutex.
+    memset(_segment, 0, header_size() + size);
+    if (!interprocess_mutex::initialize(_segment)) {
+      printf("error creating the mutex for shared segment %s.\n",
+          special_filename(identity).s());
       _valid = false;
-       _locking->unlock();
-       return;
     }
-    memset(contents, 0, size);
-    locked_release_memory(contents);  // release the memory for now.
   }
+  _mutex = new interprocess_mutex(_segment);
   _locking->unlock();
 }
 
 shared_memory::~shared_memory()
 {
+  WHACK(_mutex);
+  locked_release_memory(_segment);
+  _mapping = NULL_POINTER;
 #ifdef __UNIX__
   if (_the_memory) {
     close(int(_the_memory));
@@ -141,6 +157,14 @@ shared_memory::~shared_memory()
 
 const astring &shared_memory::identity() const { return *_identity; }
 
+int shared_memory::header_size()
+{
+  return (interprocess_mutex::storage_size() + HEADER_ALIGNMENT - 1)
+      / HEADER_ALIGNMENT * HEADER_ALIGNMENT;
+}
+
+bool shared_memory::recovered() const { return _mutex && _mutex->recovered(); }
+
 astring shared_memory::special_filename(const astring &identity)
 {
   astring shared_file = identity;
@@ -168,24 +192,26 @@ bool shared_memory::first_usage(abyte *contents, int max_compare)
 
 abyte *shared_memory::lock()
 {
-  _locking->lock();
-  return locked_grab_memory();
+  if (!_valid || !_mutex->lock()) return NULL_POINTER;
+  return _mapping;
 }
 
 void shared_memory::unlock(abyte * &to_unlock)
 {
-  locked_release_memory(to_unlock);
-  _locking->unlock();
+  if (!to_unlock) return;
+  to_unlock = NULL_POINTER;
+  _mutex->unlock();
 }
 
 abyte *shared_memory::locked_grab_memory()
 {
-  FUNCDEF("locked_grab_memory")
+  FUNCDEF("locked_grab_memory");
   abyte *to_return = NULL_POINTER;
   if (!_the_memory) return to_return;
 #ifdef __UNIX__
-  to_return = (abyte *)mmap(NULL_POINTER, _size, PROT_READ | PROT_WRITE,
-      MAP_SHARED, int(_the_memory), 0);
+  to_return = (abyte *)mmap(NULL_POINTER, header_size() + _size,
+      PROT_READ | PROT_WRITE, MAP_SHARED, int(_the_memory), 0);
+  if (to_return == (abyte *)MAP_FAILED) to_return = NULL_POINTER;
 #elif defined(__WIN32__)
   to_return = (abyte *)::MapViewOfFile((HANDLE)_the_memory, FILE_MAP_ALL_ACCESS,
       0, 0, 0);
@@ -204,12 +230,13 @@ void shared_memory::locked_release_memory(abyte * &to_unlock)
 {
   if (!_the_memory || !to_unlock) return;
 #ifdef __UNIX__
-  munmap(to_unlock, _size);
+  munmap(to_unlock, header_size() + _size);
 #elif defined(__WIN32__)
   ::UnmapViewOfFile(to_unlock);
 #else
 //uhh.
 #endif
+  to_unlock = NULL_POINTER;
 }
 
 } //namespace.
@@ -17,6 +17,7 @@
 
 #include <basis/contracts.h>
 #include <filesystem/byte_filer.h>
+#include <processes/interprocess_mutex.h>
 #include <processes/rendezvous.h>
 
 namespace application {
@@ -24,7 +25,11 @@ namespace application {
 //! Implements storage for memory that can be shared between threads.
 /*!
   Provides a means to create shared memory chunks and access them from
-  anywhere in a program or from cooperating programs.
+  anywhere in a program or from cooperating programs.  The chunk is mapped
+  once when it's opened, and it's protected by an interprocess_mutex kept
+  at the front of the shared segment, so locking it does not touch the file
+  system.  The rendezvous is only used to make sure that one process at a
+  time creates the chunk and sets up that mutex.
 */
 
 class shared_memory : public virtual basis::root_object
@@ -65,13 +70,23 @@ public:
 
   basis::abyte *lock();
     //!< locks the shared memory and returns a pointer to the storage.
-    /*!< the synchronization supported is only within this program; this type
-    of shared memory is not intended for access from multiple processes,
-    just for access from multiple threads in the same app. */
+    /*!< this synchronizes all of the threads and processes that have the
+    chunk open.  if a process died while holding the lock, then the lock is
+    still granted, but recovered() will report that the contents may be
+    inconsistent. */
 
   void unlock(basis::abyte * &to_unlock);
     //!< returns control of the shared memory so others can access it.
-    /*!< calls to lock() must be paired up with calls to unlock(). */
+    /*!< calls to lock() must be paired up with calls to unlock().  the
+    pointer "to_unlock" is reset, since it shouldn't be used after this. */
+
+  bool recovered() const;
+    //!< true if the last lock() was recovered from an owner that died.
+
+  basis::abyte *memory() const { return _mapping; }
+    //!< returns the shared storage without locking it.
+    /*!< this is only for structures that do their own synchronization, such
+    as the shared_ring; anything else should use lock() and unlock(). */
 
   static basis::astring unique_shared_mem_identifier(int sequencer);
     //!< returns a unique identifier for a shared memory chunk.
@@ -81,7 +96,8 @@ public:
     for hoople library internals. */
 
 private:
-  processes::rendezvous *_locking;  //!< protects our shared memory.
+  processes::rendezvous *_locking;  //!< protects the creation of the memory.
+  processes::interprocess_mutex *_mutex;  //!< protects our shared memory.
 #ifdef __UNIX__
   int _the_memory;  //!< OS index of the memory.
 #elif defined(__WIN32__)
@@ -90,11 +106,16 @@ private:
   bool _valid;  //!< true if the memory creation succeeded.
   basis::astring *_identity;  //!< holds the name we were created with.
   int _size;  //!< size of memory chunk.
+  basis::abyte *_segment;  //!< the whole mapped segment, including our mutex.
+  basis::abyte *_mapping;  //!< where the user's part of the segment starts.
 
   // these do the actual work of getting the memory.
   basis::abyte *locked_grab_memory();
   void locked_release_memory(basis::abyte * &to_unlock);
 
+  static int header_size();
+    //!< the space reserved in front of the user's memory for the mutex.
+
   static basis::astring special_filename(const basis::astring &identity);
     //!< provides the name for our shared memory file, if needed.
 
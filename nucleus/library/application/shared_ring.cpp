@@ -0,0 +1,261 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : shared_ring                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "shared_ring.h"
+
+#include <basis/functions.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+
+#include <string.h>
+#ifdef __LINUX__
+  #include <limits.h>
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+using namespace basis;
+using namespace timely;
+
+namespace application {
+
+const un_int RING_MAGIC = 0x52696e67;
+  // marks a ring that has been set up in the shared memory.
+
+const int CACHE_LINE = 64;
+  // the counters that different processes hammer on are kept this far apart.
+
+const int SLOT_OVERHEAD = 2 * sizeof(un_int);
+  // each slot starts with its sequence number and the message length.
+
+//////////////
+
+// the bookkeeping at the front of the shared memory.  the sending and the
+// receiving sides each get their own cache lines.
+
+class ring_header
+{
+public:
+  un_int _magic;  //!< RING_MAGIC once the ring is set up.
+  un_int _slots;  //!< the number of slots.
+  un_int _slot_size;  //!< the largest message a slot holds.
+  un_int _mode;  //!< the ring_modes value that the ring was created with.
+  abyte _pad1[CACHE_LINE - 4 * sizeof(un_int)];
+  un_int _send_position;  //!< the next slot that a sender will claim.
+  un_int _freed_signal;  //!< bumped when a receiver frees a slot.
+  un_int _senders_waiting;  //!< the number of senders asleep on a full ring.
+  abyte _pad2[CACHE_LINE - 3 * sizeof(un_int)];
+  un_int _receive_position;  //!< the next slot that a receiver will claim.
+  un_int _sent_signal;  //!< bumped when a sender fills a slot.
+  un_int _receivers_waiting;  //!< the number of receivers asleep on empty.
+  abyte _pad3[CACHE_LINE - 3 * sizeof(un_int)];
+};
+
+//////////////
+
+// sleeps until the value at "address" is no longer "expected", or until
+// "timeout" milliseconds elapse.  a negative "timeout" waits forever.
+#ifdef __LINUX__
+static void sleep_on(un_int *address, un_int expected, int timeout)
+{
+  timespec duration;
+  duration.tv_sec = timeout / SECOND_ms;
+  duration.tv_nsec = long(timeout % SECOND_ms) * 1000000;
+  // the futex is not private, since other processes are waiting on it too.
+  syscall(SYS_futex, address, FUTEX_WAIT, expected,
+      negative(timeout)? NULL_POINTER : &duration, NULL_POINTER, 0);
+}
+#else
+static void sleep_on(un_int *formal(address), un_int formal(expected),
+    int formal(timeout))
+{ time_control::sleep_ms(1); }
+#endif
+
+// wakes up anyone sleeping on the "signal" if the "waiters" say there are any.
+static void wake_up(un_int *signal, un_int *waiters)
+{
+  // the fence orders our update to the ring before the check for waiters,
+  // which pairs with a waiter registering itself before looking at the ring.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(waiters, __ATOMIC_SEQ_CST)) return;
+  __atomic_add_fetch(signal, 1, __ATOMIC_SEQ_CST);
+#ifdef __LINUX__
+  syscall(SYS_futex, signal, FUTEX_WAKE, INT_MAX, NULL_POINTER, NULL_POINTER, 0);
+#endif
+}
+
+//////////////
+
+shared_ring::shared_ring(const astring &identity, int slots, int slot_size,
+    ring_modes mode)
+: _memory(NULL_POINTER),
+  _header(NULL_POINTER),
+  _ring(NULL_POINTER),
+  _slots(1),
+  _slot_size(slot_size),
+  _stride(0),
+  _mode(mode)
+{
+  while (_slots < slots) _slots <<= 1;
+  _stride = (SLOT_OVERHEAD + slot_size + sizeof(un_int) - 1)
+      / sizeof(un_int) * sizeof(un_int);
+  _memory = new shared_memory(sizeof(ring_header) + _slots * _stride,
+      identity.s());
+  if (!_memory->valid() || negative(slot_size)) return;
+  abyte *contents = _memory->lock();
+  if (!contents) return;
+  ring_header *header = (ring_header *)contents;
+  if (header->_magic != RING_MAGIC) {
+    // we're the first one here, so set up the ring.  each slot's sequence
+    // starts out as the position of the first send that can use it.
+    header->_slots = _slots;
+    header->_slot_size = _slot_size;
+    header->_mode = _mode;
+    abyte *ring = contents + sizeof(ring_header);
+    for (int i = 0; i < _slots; i++) *(un_int *)(ring + i * _stride) = i;
+    __atomic_store_n(&header->_magic, RING_MAGIC, __ATOMIC_RELEASE);
+  }
+  bool matches = (header->_slots == un_int(_slots))
+      && (header->_slot_size == un_int(_slot_size))
+      && (header->_mode == un_int(_mode));
+  _memory->unlock(contents);
+  if (!matches) return;  // someone else set it up differently.
+  _header = header;
+  _ring = _memory->memory() + sizeof(ring_header);
+}
+
+shared_ring::~shared_ring()
+{
+  _header = NULL_POINTER;
+  _ring = NULL_POINTER;
+  WHACK(_memory);
+}
+
+bool shared_ring::try_send(const abyte *message, int length)
+{
+  un_int position = __atomic_load_n(&_header->_send_position, __ATOMIC_RELAXED);
+  abyte *slot;
+  while (true) {
+    slot = _ring + (position & (_slots - 1)) * _stride;
+    un_int sequence = __atomic_load_n((un_int *)slot, __ATOMIC_ACQUIRE);
+    int difference = int(sequence - position);
+    if (!difference) {
+      // this slot is free for the taking.
+      if (_mode == SINGLE_SENDER_RECEIVER) {
+        __atomic_store_n(&_header->_send_position, position + 1,
+            __ATOMIC_RELAXED);
+        break;
+      }
+      if (__atomic_compare_exchange_n(&_header->_send_position, &position,
+          position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+      // someone else claimed it first, and the position has been updated.
+    } else if (difference < 0) {
+      return false;  // the receivers haven't freed this slot yet.
+    } else {
+      position = __atomic_load_n(&_header->_send_position, __ATOMIC_RELAXED);
+    }
+  }
+  ((un_int *)slot)[1] = un_int(length);
+  memcpy(slot + SLOT_OVERHEAD, message, length);
+  // publishing the sequence hands the slot over to the receivers.
+  __atomic_store_n((un_int *)slot, position + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool shared_ring::try_receive(byte_array &message)
+{
+  un_int position = __atomic_load_n(&_header->_receive_position,
+      __ATOMIC_RELAXED);
+  abyte *slot;
+  while (true) {
+    slot = _ring + (position & (_slots - 1)) * _stride;
+    un_int sequence = __atomic_load_n((un_int *)slot, __ATOMIC_ACQUIRE);
+    int difference = int(sequence - (position + 1));
+    if (!difference) {
+      // this slot has a message in it.
+      if (_mode == SINGLE_SENDER_RECEIVER) {
+        __atomic_store_n(&_header->_receive_position, position + 1,
+            __ATOMIC_RELAXED);
+        break;
+      }
+      if (__atomic_compare_exchange_n(&_header->_receive_position, &position,
+          position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (difference < 0) {
+      return false;  // nothing has been sent into this slot yet.
+    } else {
+      position = __atomic_load_n(&_header->_receive_position, __ATOMIC_RELAXED);
+    }
+  }
+  int length = int(((un_int *)slot)[1]);
+  message.reset(length);
+  memcpy(message.access(), slot + SLOT_OVERHEAD, length);
+  // the slot is next used by the send one whole trip around the ring later.
+  __atomic_store_n((un_int *)slot, position + _slots, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool shared_ring::send(const abyte *message, int length, int timeout)
+{
+  if (!valid() || negative(length) || (length > _slot_size)) return false;
+  bool sent = try_send(message, length);
+  if (!sent && timeout) {
+    time_stamp leave_at(timeout);
+    while (!sent) {
+      int remaining = -1;
+      if (!negative(timeout)) {
+        remaining = int(leave_at.value() - time_stamp().value());
+        if (remaining <= 0) return false;
+      }
+      // we register as waiting before trying again, so that a receiver
+      // freeing a slot after this try is sure to wake us.
+      un_int seen = __atomic_load_n(&_header->_freed_signal, __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&_header->_senders_waiting, 1, __ATOMIC_SEQ_CST);
+      sent = try_send(message, length);
+      if (!sent) sleep_on(&_header->_freed_signal, seen, remaining);
+      __atomic_sub_fetch(&_header->_senders_waiting, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+  if (sent) wake_up(&_header->_sent_signal, &_header->_receivers_waiting);
+  return sent;
+}
+
+bool shared_ring::receive(byte_array &message, int timeout)
+{
+  if (!valid()) return false;
+  bool received = try_receive(message);
+  if (!received && timeout) {
+    time_stamp leave_at(timeout);
+    while (!received) {
+      int remaining = -1;
+      if (!negative(timeout)) {
+        remaining = int(leave_at.value() - time_stamp().value());
+        if (remaining <= 0) return false;
+      }
+      un_int seen = __atomic_load_n(&_header->_sent_signal, __ATOMIC_SEQ_CST);
+      __atomic_add_fetch(&_header->_receivers_waiting, 1, __ATOMIC_SEQ_CST);
+      received = try_receive(message);
+      if (!received) sleep_on(&_header->_sent_signal, seen, remaining);
+      __atomic_sub_fetch(&_header->_receivers_waiting, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+  if (received) wake_up(&_header->_freed_signal, &_header->_senders_waiting);
+  return received;
+}
+
+} //namespace.
+
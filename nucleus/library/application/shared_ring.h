@@ -0,0 +1,105 @@
+#ifndef SHARED_RING_CLASS
+#define SHARED_RING_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : shared_ring                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "shared_memory.h"
+
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/contracts.h>
+
+namespace application {
+
+// forward.
+class ring_header;
+
+//! A channel for passing messages between processes through shared memory.
+/*!
+  The messages are kept in a ring of fixed size slots in a shared_memory
+  chunk.  Sending and receiving are lock-free; each slot carries a sequence
+  number that tells the senders and receivers whose turn it is to use it.
+  When the ring is full or empty, the waiting side sleeps on a futex in the
+  shared memory, and the other side only makes the system call to wake it
+  if someone is actually waiting.  Every process that opens the ring must
+  use the same identity, number of slots, slot size and mode.
+*/
+
+class shared_ring : public virtual basis::root_object
+{
+public:
+  //! who is allowed to use the ring at the same time.
+  enum ring_modes {
+    SINGLE_SENDER_RECEIVER,  //!< one sender and one receiver only.
+    MULTIPLE_SENDERS_RECEIVERS  //!< any number of senders and receivers.
+  };
+
+  shared_ring(const basis::astring &identity, int slots, int slot_size,
+          ring_modes mode = MULTIPLE_SENDERS_RECEIVERS);
+    //!< opens the ring named "identity", creating it if it's not there yet.
+    /*!< the ring holds "slots" messages (rounded up to a power of two) of up
+    to "slot_size" bytes each.  valid() should be checked afterwards. */
+
+  virtual ~shared_ring();
+
+  DEFINE_CLASS_NAME("shared_ring");
+
+  bool valid() const { return _header != NULL_POINTER; }
+    //!< true if the ring was opened successfully.
+
+  int slots() const { return _slots; }
+    //!< the number of messages that the ring can hold.
+
+  int maximum_message() const { return _slot_size; }
+    //!< the largest message that can be sent.
+
+  bool send(const basis::abyte *message, int length, int timeout = 0);
+    //!< adds the "message" of "length" bytes to the ring.
+    /*!< if the ring is full, this waits up to "timeout" milliseconds for
+    room.  a negative "timeout" waits forever.  false is returned if the
+    message is too large or there was no room for it. */
+
+  bool send(const basis::byte_array &message, int timeout = 0)
+  { return send(message.observe(), message.length(), timeout); }
+    //!< sends the contents of "message".
+
+  bool receive(basis::byte_array &message, int timeout = 0);
+    //!< takes the oldest message out of the ring and stores it in "message".
+    /*!< if the ring is empty, this waits up to "timeout" milliseconds for a
+    message to arrive.  a negative "timeout" waits forever. */
+
+private:
+  shared_memory *_memory;  //!< holds the ring.
+  ring_header *_header;  //!< the ring's bookkeeping in the shared memory.
+  basis::abyte *_ring;  //!< where the slots start.
+  int _slots;  //!< how many slots there are; always a power of two.
+  int _slot_size;  //!< the most bytes a slot can hold.
+  int _stride;  //!< distance between the starts of the slots.
+  ring_modes _mode;  //!< who's allowed to use the ring.
+
+  bool try_send(const basis::abyte *message, int length);
+    //!< adds the "message" if there's room, without waiting.
+  bool try_receive(basis::byte_array &message);
+    //!< takes a message out if there is one, without waiting.
+
+  // not appropriate.
+  shared_ring(const shared_ring &);
+  shared_ring &operator =(const shared_ring &);
+};
+
+} //namespace.
+
+#endif
+
@@ -0,0 +1,144 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : adaptive_mutex                                                    *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+// NOTE: like the mutex, this avoids new and delete so that it can be used
+//       by the memory checker.
+
+#include "adaptive_mutex.h"
+
+#include <stdlib.h>
+
+#ifdef __UNIX__
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+#ifdef __WIN32__
+  #include <synchapi.h>
+#endif
+
+namespace basis {
+
+const int MAXIMUM_SPINS = 200;
+  // the most times we'll try the lock before going to sleep on it.
+
+const int WINDOWS_SPIN_COUNT = 4000;
+  // windows does its own adaptive spinning on critical sections.
+
+#ifdef __UNIX__
+// tells the processor that we're spinning, which lets the other hyperthread
+// on a core get more done and saves some power.
+static inline void relax_processor()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// spinning is only worthwhile if the holder of the lock can run meanwhile.
+static bool spinning_helps()
+{
+  static int processors = 0;
+  int known = __atomic_load_n(&processors, __ATOMIC_RELAXED);
+  if (!known) {
+    known = int(sysconf(_SC_NPROCESSORS_ONLN));
+    if (known < 1) known = 1;
+    __atomic_store_n(&processors, known, __ATOMIC_RELAXED);
+  }
+  return known > 1;
+}
+#endif
+
+adaptive_mutex::adaptive_mutex()
+: c_spins(0)
+{
+#ifdef __WIN32__
+  c_os_mutex = (CRITICAL_SECTION *)malloc(sizeof(CRITICAL_SECTION));
+  InitializeCriticalSectionAndSpinCount((LPCRITICAL_SECTION)c_os_mutex,
+      WINDOWS_SPIN_COUNT);
+#elif defined(__UNIX__)
+  c_os_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+  pthread_mutex_init((pthread_mutex_t *)c_os_mutex, NULL_POINTER);
+#else
+  #pragma error("no implementation of mutexes for this OS yet!")
+#endif
+}
+
+adaptive_mutex::~adaptive_mutex()
+{
+  if (!c_os_mutex) return;
+#ifdef __WIN32__
+  DeleteCriticalSection((LPCRITICAL_SECTION)c_os_mutex);
+#elif defined(__UNIX__)
+  pthread_mutex_destroy((pthread_mutex_t *)c_os_mutex);
+#endif
+  free(c_os_mutex);
+  c_os_mutex = NULL_POINTER;
+}
+
+void adaptive_mutex::establish_lock() { lock(); }
+
+void adaptive_mutex::repeal_lock() { unlock(); }
+
+bool adaptive_mutex::try_lock()
+{
+#ifdef __WIN32__
+  return !!TryEnterCriticalSection((LPCRITICAL_SECTION)c_os_mutex);
+#elif defined(__UNIX__)
+  return !pthread_mutex_trylock((pthread_mutex_t *)c_os_mutex);
+#endif
+}
+
+void adaptive_mutex::lock()
+{
+#ifdef __WIN32__
+  EnterCriticalSection((LPCRITICAL_SECTION)c_os_mutex);
+#elif defined(__UNIX__)
+  pthread_mutex_t *os_mutex = (pthread_mutex_t *)c_os_mutex;
+  if (!pthread_mutex_trylock(os_mutex)) return;  // it was free.
+  if (spinning_helps()) {
+    // we allow for a bit more spinning than has been needed lately, so that
+    // the average can grow when the lock starts being held longer.
+    int average = __atomic_load_n(&c_spins, __ATOMIC_RELAXED);
+    int limit = 2 * average + 10;
+    if (limit > MAXIMUM_SPINS) limit = MAXIMUM_SPINS;
+    int spun = 0;
+    bool got_it = false;
+    while (spun < limit) {
+      spun++;
+      relax_processor();
+      if (!pthread_mutex_trylock(os_mutex)) { got_it = true; break; }
+    }
+    // the average moves an eighth of the way towards this attempt.  a
+    // failed attempt pulls it up to the limit, which grows the next try.
+    __atomic_store_n(&c_spins, average + (spun - average) / 8,
+        __ATOMIC_RELAXED);
+    if (got_it) return;
+  }
+  pthread_mutex_lock(os_mutex);
+#endif
+}
+
+void adaptive_mutex::unlock()
+{
+#ifdef __WIN32__
+  LeaveCriticalSection((LPCRITICAL_SECTION)c_os_mutex);
+#elif defined(__UNIX__)
+  pthread_mutex_unlock((pthread_mutex_t *)c_os_mutex);
+#endif
+}
+
+} //namespace.
+
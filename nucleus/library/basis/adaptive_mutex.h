@@ -0,0 +1,66 @@
+#ifndef ADAPTIVE_MUTEX_CLASS
+#define ADAPTIVE_MUTEX_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : adaptive_mutex                                                    *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "contracts.h"
+
+namespace basis {
+
+//! A mutex that spins for a little while before putting a thread to sleep.
+/*!
+  When a lock is only ever held for a few instructions, the thread that
+  wants it is better off waiting briefly on the CPU than going to sleep in
+  the kernel and being woken back up.  This mutex keeps track of how long the
+  spinning usually takes to pay off and adjusts to that, and it falls back to
+  blocking when the lock is held for longer.  There is no spinning at all
+  with a single processor, since the holder couldn't run meanwhile.
+  Unlike the mutex, this lock is not recursive.
+*/
+
+class adaptive_mutex : public virtual base_synchronizer
+{
+public:
+  adaptive_mutex();  //!< Constructs a new adaptive mutex.
+
+  virtual ~adaptive_mutex();
+    //!< Destroys the mutex.  It should not be locked upon destruction.
+
+  void lock();
+    //!< Clamps down on the mutex, spinning and then waiting if it's busy.
+
+  bool try_lock();
+    //!< Grabs the mutex only if it's free right now, returning true if so.
+
+  void unlock();
+    //!< Gives up the possession of the mutex.
+
+  virtual void establish_lock();
+    //!< Satisfies base class requirements for locking.
+  virtual void repeal_lock();
+    //!< Satisfies base class requirements for unlocking.
+
+private:
+  void *c_os_mutex;  //!< OS version of the mutex.
+  int c_spins;  //!< the running average of the spins that were needed.
+
+  adaptive_mutex(const adaptive_mutex &);  //!< not allowed.
+  adaptive_mutex &operator =(const adaptive_mutex &);  //!< not allowed.
+};
+
+} //namespace.
+
+#endif
+
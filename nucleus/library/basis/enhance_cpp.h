@@ -27,9 +27,13 @@ namespace basis {
   cannot get its own name, and other really helpful features.
 */
 
-//hmmm: temporary to hide missing code.
-#define frame_tracking_instance
-#define __trail_of_function(a, b, c, d, e)
+#ifndef ENABLE_CALLSTACK_TRACKING
+  // without callstack tracking, the FUNCDEF and FUNCTION macros below only
+  // name the function.  otherwise the tracker is included at the bottom.
+  #define frame_tracking_instance
+  #define __trail_of_function(a, b, c, d, e)
+  #define update_current_stack_frame_line_number(line)
+#endif
 
 class enhance_cpp : public virtual root_object
 {
@@ -97,5 +101,10 @@ public:
 
 } //namespace.
 
+#ifdef ENABLE_CALLSTACK_TRACKING
+  // this comes after our macros, which the tracker relies on.
+  #include <application/callstack_tracker.h>
+#endif
+
 #endif
 
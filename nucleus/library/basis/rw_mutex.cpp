@@ -0,0 +1,96 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : rw_mutex                                                          *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+// NOTE: like the mutex, this avoids new and delete so that it can be used
+//       by the memory checker.
+
+#include "rw_mutex.h"
+
+#include <stdlib.h>
+
+#ifdef __UNIX__
+  #include <pthread.h>
+#endif
+#ifdef __WIN32__
+  #include <synchapi.h>
+#endif
+
+namespace basis {
+
+rw_mutex::rw_mutex()
+{
+#ifdef __WIN32__
+  c_os_lock = (SRWLOCK *)malloc(sizeof(SRWLOCK));
+  InitializeSRWLock((PSRWLOCK)c_os_lock);
+#elif defined(__UNIX__)
+  c_os_lock = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t));
+  pthread_rwlock_init((pthread_rwlock_t *)c_os_lock, NULL_POINTER);
+#else
+  #pragma error("no implementation of reader-writer locks for this OS yet!")
+#endif
+}
+
+rw_mutex::~rw_mutex()
+{
+  if (!c_os_lock) return;
+#ifdef __UNIX__
+  pthread_rwlock_destroy((pthread_rwlock_t *)c_os_lock);
+#endif
+  // the windows lock has nothing to tear down.
+  free(c_os_lock);
+  c_os_lock = NULL_POINTER;
+}
+
+void rw_mutex::establish_lock() { lock_write(); }
+
+void rw_mutex::repeal_lock() { unlock_write(); }
+
+void rw_mutex::lock_read()
+{
+#ifdef __WIN32__
+  AcquireSRWLockShared((PSRWLOCK)c_os_lock);
+#elif defined(__UNIX__)
+  pthread_rwlock_rdlock((pthread_rwlock_t *)c_os_lock);
+#endif
+}
+
+void rw_mutex::unlock_read()
+{
+#ifdef __WIN32__
+  ReleaseSRWLockShared((PSRWLOCK)c_os_lock);
+#elif defined(__UNIX__)
+  pthread_rwlock_unlock((pthread_rwlock_t *)c_os_lock);
+#endif
+}
+
+void rw_mutex::lock_write()
+{
+#ifdef __WIN32__
+  AcquireSRWLockExclusive((PSRWLOCK)c_os_lock);
+#elif defined(__UNIX__)
+  pthread_rwlock_wrlock((pthread_rwlock_t *)c_os_lock);
+#endif
+}
+
+void rw_mutex::unlock_write()
+{
+#ifdef __WIN32__
+  ReleaseSRWLockExclusive((PSRWLOCK)c_os_lock);
+#elif defined(__UNIX__)
+  pthread_rwlock_unlock((pthread_rwlock_t *)c_os_lock);
+#endif
+}
+
+} //namespace.
+
@@ -0,0 +1,103 @@
+#ifndef RW_MUTEX_CLASS
+#define RW_MUTEX_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : rw_mutex                                                          *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "contracts.h"
+
+namespace basis {
+
+//! A lock that many readers can hold at once, but only one writer.
+/*!
+  This suits structures that are looked at far more often than they are
+  changed, since the readers no longer wait on each other.  Unlike the mutex,
+  the write lock is not recursive; a thread that holds the write lock must
+  not try to get either lock again.  On unix, a thread can get the read lock
+  again while it holds it, since waiting writers do not hold up new readers
+  there; windows doesn't promise that, so it's best avoided.  When used as
+  a base_synchronizer (such as by an auto_synchronizer), the write lock is
+  what gets taken.
+*/
+
+class rw_mutex : public virtual base_synchronizer
+{
+public:
+  rw_mutex();  //!< Constructs a new reader-writer lock.
+
+  virtual ~rw_mutex();
+    //!< Destroys the lock.  It should not be held upon destruction.
+
+  void lock_read();
+    //!< Waits until no writer holds the lock and then shares it for reading.
+  void unlock_read();
+    //!< Gives up a read lock that was gotten with lock_read().
+
+  void lock_write();
+    //!< Waits until the lock is entirely free and then holds it exclusively.
+  void unlock_write();
+    //!< Gives up the write lock.
+
+  virtual void establish_lock();
+    //!< Satisfies base class requirements by locking for writing.
+  virtual void repeal_lock();
+    //!< Satisfies base class requirements by unlocking the write lock.
+
+private:
+  void *c_os_lock;  //!< OS version of the reader-writer lock.
+
+  rw_mutex(const rw_mutex &);  //!< not allowed.
+  rw_mutex &operator =(const rw_mutex &);  //!< not allowed.
+};
+
+//////////////
+
+//! Holds the read lock on an rw_mutex for the rest of the current scope.
+
+class auto_reader
+{
+public:
+  auto_reader(rw_mutex &locker) : _locker(locker) { _locker.lock_read(); }
+  ~auto_reader() { _locker.unlock_read(); }
+
+private:
+  rw_mutex &_locker;  //!< the lock being held.
+
+  // disallowed.
+  auto_reader(const auto_reader &);
+  auto_reader &operator =(const auto_reader &);
+};
+
+//! Holds the write lock on an rw_mutex for the rest of the current scope.
+/*! this is equivalent to using an auto_synchronizer on the rw_mutex, but it
+makes it clearer which side of the lock is intended. */
+
+class auto_writer
+{
+public:
+  auto_writer(rw_mutex &locker) : _locker(locker) { _locker.lock_write(); }
+  ~auto_writer() { _locker.unlock_write(); }
+
+private:
+  rw_mutex &_locker;  //!< the lock being held.
+
+  // disallowed.
+  auto_writer(const auto_writer &);
+  auto_writer &operator =(const auto_writer &);
+};
+
+} //namespace.
+
+#endif
+
@@ -0,0 +1,109 @@
+#ifndef SEQLOCK_CLASS
+#define SEQLOCK_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : seqlock                                                           *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "definitions.h"
+
+#include <string.h>
+
+namespace basis {
+
+//! Guards a small plain-data object so that readers never lock.
+/*!
+  A sequence counter is bumped before and after every change to the object,
+  so it's odd while a change is underway.  A reader copies the object and
+  then checks that the counter was even and did not move meanwhile; if it
+  did, the reader just tries again.  Thus readers never hold up a writer or
+  each other, and they never write to shared memory.  This fits snapshots of
+  a few numbers, such as statistics, that are read often.  The "contents"
+  must be plain data that can be copied with memcpy, since a reader might copy
+  it while it's halfway through being changed (that copy is thrown away).
+  Writers exclude each other by spinning, so changes should be brief.
+*/
+
+template <class contents>
+class seqlock
+{
+public:
+  seqlock() : _sequence(0) { memset((void *)&_data, 0, sizeof(contents)); }
+    //!< starts with the "contents" zeroed out.
+
+  seqlock(const contents &initial) : _sequence(0), _data(initial) {}
+    //!< starts with the "initial" contents.
+
+  contents read() const;
+    //!< returns a consistent copy of the contents.
+
+  void write(const contents &new_data) { begin_write() = new_data; end_write(); }
+    //!< replaces the contents with "new_data".
+
+  contents &begin_write();
+    //!< locks out other writers and returns the contents for changing.
+    /*!< end_write() must be called once the changes are complete. */
+
+  void end_write();
+    //!< publishes the changes made since begin_write().
+
+private:
+  un_int _sequence;  //!< odd while a change is being made.
+  contents _data;  //!< the object being guarded.
+
+  // not appropriate.
+  seqlock(const seqlock &);
+  seqlock &operator =(const seqlock &);
+};
+
+//////////////
+
+// implementations below...
+
+template <class contents>
+contents seqlock<contents>::read() const
+{
+  contents to_return;
+  while (true) {
+    un_int before = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+    if (before & 1) continue;  // a writer is busy.
+    memcpy((void *)&to_return, (const void *)&_data, sizeof(contents));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) == before)
+      return to_return;
+  }
+}
+
+template <class contents>
+contents &seqlock<contents>::begin_write()
+{
+  while (true) {
+    un_int current = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+    if (!(current & 1)
+        && __atomic_compare_exchange_n(&_sequence, &current, current + 1,
+            false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      break;
+  }
+  // the odd count must be visible before any of the changes are.
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  return _data;
+}
+
+template <class contents>
+void seqlock<contents>::end_write()
+{ __atomic_add_fetch(&_sequence, 1, __ATOMIC_RELEASE); }
+
+} //namespace.
+
+#endif
+
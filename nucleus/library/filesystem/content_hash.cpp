@@ -0,0 +1,76 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : content_hash                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "content_hash.h"
+#include "huge_file.h"
+
+#include <basis/array.h>
+#include <basis/functions.h>
+
+using namespace basis;
+using namespace structures;
+
+namespace filesystem {
+
+int content_hash::chunks(double file_size)
+{
+  if (file_size <= 0) return 1;
+  return int((file_size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+content_hash::wide_hash content_hash::hash_chunk(const byte_array &data,
+    int chunk_index)
+{
+  return checksums::wide_hash_bytes(data.observe(), data.length(),
+      wide_hash(chunk_index));
+}
+
+content_hash::wide_hash content_hash::combine(const wide_hash *chunk_hashes,
+    int count, double file_size)
+{
+  // the chunk hashes are laid out in little-endian order so the result is
+  // the same everywhere.
+  byte_array laid_out(count * 8);
+  for (int i = 0; i < count; i++)
+    for (int j = 0; j < 8; j++)
+      laid_out[i * 8 + j] = abyte(chunk_hashes[i] >> (j * 8));
+  return checksums::wide_hash_bytes(laid_out.observe(), laid_out.length(),
+      wide_hash(file_size));
+}
+
+bool content_hash::hash_file(const astring &path, wide_hash &hash)
+{
+  hash = 0;
+  huge_file to_read(path, "rb");
+  if (!to_read.good()) return false;
+  to_read.advise(huge_file::SEQUENTIAL_ACCESS);
+  huge_file::file_offset size = to_read.size();
+  int count = chunks(double(size));
+  array<wide_hash> chunk_hashes(count, NULL_POINTER, byte_array::SIMPLE_COPY);
+  byte_array chunk;
+  for (int i = 0; i < count; i++) {
+    huge_file::file_offset where = huge_file::file_offset(i) * CHUNK_SIZE;
+    int desired = int(minimum(huge_file::file_offset(CHUNK_SIZE), size - where));
+    int read = 0;
+    if (to_read.read_at(where, chunk, desired, read) != huge_file::OKAY)
+      return false;
+    if (read != desired) return false;  // the file changed underneath us.
+    chunk_hashes[i] = hash_chunk(chunk, i);
+  }
+  hash = combine(chunk_hashes.observe(), count, double(size));
+  return true;
+}
+
+} //namespace.
+
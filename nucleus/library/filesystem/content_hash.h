@@ -0,0 +1,63 @@
+#ifndef CONTENT_HASH_CLASS
+#define CONTENT_HASH_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : content_hash                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/definitions.h>
+#include <structures/checksums.h>
+
+namespace filesystem {
+
+//! Computes a strong hash over the entire contents of a file.
+/*!
+  The file is split into fixed size chunks and each chunk is hashed on its
+  own, with the chunk's position as the seed.  The chunk hashes are then
+  hashed together along with the file size to make the final value.  Since
+  the chunks are independent, they can be hashed in any order and by any
+  number of threads (see processes::file_hasher), and the result is always
+  the same as the serial hash_file() method produces here.
+*/
+
+class content_hash
+{
+public:
+  typedef structures::checksums::wide_hash wide_hash;
+
+  enum hashing_constants {
+    CHUNK_SIZE = 4 * basis::MEGABYTE  //!< the size of each hashed chunk.
+  };
+
+  static int chunks(double file_size);
+    //!< returns the number of chunks a file of "file_size" bytes is split into.
+    /*!< even an empty file has one (empty) chunk. */
+
+  static wide_hash hash_chunk(const basis::byte_array &data, int chunk_index);
+    //!< hashes the "data" found at the "chunk_index" within a file.
+
+  static wide_hash combine(const wide_hash *chunk_hashes, int count,
+          double file_size);
+    //!< produces the file's hash from its "count" "chunk_hashes".
+
+  static bool hash_file(const basis::astring &path, wide_hash &hash);
+    //!< hashes the file at "path" in a single thread.
+    /*!< false is returned if the file could not be completely read. */
+};
+
+} //namespace.
+
+#endif
+
@@ -13,7 +13,9 @@
 \*****************************************************************************/
 
 #include "directory.h"
+#include "file_info.h"
 #include "filename.h"
+#include "filename_list.h"
 
 #include <application/windoze_helper.h>
 #include <basis/astring.h>
@@ -30,6 +32,7 @@
 #include "../algorithms/sorts.h"
 #if defined(__UNIX__) || defined(__GNU_WINDOWS__)
   #include <dirent.h>
+  #include <fcntl.h>
   #include <fnmatch.h>
   #include <string.h>
   #include <unistd.h>
@@ -142,6 +145,32 @@ bool directory::move_down(const astring &subdir, const char *pattern)
 
 const string_array &directory::files() const { return *_files; }
 
+// how a directory entry should be treated by our scans.
+enum entry_kinds { ABNORMAL_ENTRY, FILE_ENTRY, DIRECTORY_ENTRY };
+
+// decides what kind of thing the "entry" read from "dir" is.  the type from
+// readdir is used where the filesystem supplies it, which saves a stat call
+// for nearly every entry.  links and unknown types are still stat'ed, so a
+// link is treated like whatever it points at.
+static entry_kinds classify(DIR *dir, dirent *entry)
+{
+#ifdef _DIRENT_HAVE_D_TYPE
+  switch (entry->d_type) {
+    case DT_REG: return FILE_ENTRY;
+    case DT_DIR: return DIRECTORY_ENTRY;
+    case DT_LNK: case DT_UNKNOWN: break;  // must look closer at these.
+    default: return ABNORMAL_ENTRY;  // devices, pipes and sockets.
+  }
+#endif
+  struct stat status;
+  if (fstatat(dirfd(dir), entry->d_name, &status, 0)) return ABNORMAL_ENTRY;
+  if (S_ISDIR(status.st_mode)) return DIRECTORY_ENTRY;
+  if (S_ISCHR(status.st_mode) || S_ISBLK(status.st_mode)
+      || S_ISFIFO(status.st_mode) || S_ISSOCK(status.st_mode))
+    return ABNORMAL_ENTRY;
+  return FILE_ENTRY;
+}
+
 const string_array &directory::directories() const { return *_folders; }
 
 bool directory::rescan()
@@ -209,19 +238,18 @@ bool directory::rescan()
     if (!strcmp(file, par_dir.s())) add_it = false;
     // make sure that the filename matches the pattern also.
     if (add_it && !fnmatch(_pattern->s(), file, 0)) {
-      filename temp_name(*_path, file);
-      if (!temp_name.is_normal()) {
-//#ifdef DEBUG_DIRECTORY
-        LOG(astring("skipping abnormal file:  ") + temp_name);
-//#endif
-        entry = readdir(dir);
-        continue;  // cannot be adding goofy named pipes etc; cannot manage those.
-      }
       // add this to the appropriate list.
-      if (temp_name.is_directory())
+      entry_kinds kind = classify(dir, entry);
+      if (kind == DIRECTORY_ENTRY)
         _folders->concatenate(file);
-      else 
+      else if (kind == FILE_ENTRY)
         _files->concatenate(file);
+      else {
+//#ifdef DEBUG_DIRECTORY
+        LOG(astring("skipping abnormal file:  ") + filename(*_path, file));
+//#endif
+        // cannot be adding goofy named pipes etc; cannot manage those.
+      }
     }
     entry = readdir(dir);
   }
@@ -254,6 +282,50 @@ bool directory::remove_directory(const astring &path)
   return !rm_ret;
 }
 
+bool directory::read_entries(const astring &path, const char *pattern,
+    string_array &directories, filename_list *files, bool gather_stats)
+{
+  FUNCDEF("read_entries");
+  directories.reset();
+  if (files) files->reset();
+  DIR *dir = opendir(path.s());
+  if (!dir) return false;
+  string_array file_names;
+  for (dirent *entry = readdir(dir); entry; entry = readdir(dir)) {
+    const char *name = entry->d_name;
+    if ( (name[0] == '.') && ( !name[1] || ( (name[1] == '.') && !name[2]) ) )
+      continue;  // skip the current and parent directory entries.
+    // we can skip looking at files entirely if they weren't wanted.
+    entry_kinds kind = classify(dir, entry);
+    if (kind == DIRECTORY_ENTRY) {
+      directories.concatenate(name);
+    } else if (kind == FILE_ENTRY) {
+      if (files && !fnmatch(pattern, name, 0)) file_names.concatenate(name);
+    } else {
+#ifdef DEBUG_DIRECTORY
+      LOG(astring("skipping abnormal file:  ") + filename(path, name));
+#endif
+    }
+  }
+  shell_sort(directories.access(), directories.length());
+  if (files) {
+    shell_sort(file_names.access(), file_names.length());
+    for (int i = 0; i < file_names.length(); i++) {
+      file_info *info = new file_info(file_names[i], 0);
+      if (gather_stats) {
+        struct stat status;
+        if (!fstatat(dirfd(dir), file_names[i].s(), &status, 0)) {
+          info->_file_size = double(status.st_size);
+          info->_time.reset(status.st_mtime);
+        }
+      }
+      files->append(info);
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
 bool directory::recursive_create(const astring &directory_name)
 {
   FUNCDEF("recursive_create");
@@ -21,6 +21,9 @@
 
 namespace filesystem {
 
+// forward.
+class filename_list;
+
 //! Implements a scanner that finds all filenames in the directory specified.
 
 class directory : public virtual basis::root_object
@@ -97,6 +100,18 @@ public:
   static bool remove_directory(const basis::astring &path);
     //!< returns true if the directory "path" could be removed.
 
+  static bool read_entries(const basis::astring &path, const char *pattern,
+          structures::string_array &directories, filename_list *files,
+          bool gather_stats = false);
+    //!< lists the contents of "path" in a single pass over the directory.
+    /*!< every sub-directory is added to "directories", but only the files
+    matching "pattern" are added to "files" (and only if "files" is non-null).
+    the type reported by the directory entry is trusted where the OS gives
+    one, so most entries need no extra system call.  if "gather_stats" is
+    true, then each file's size and timestamp are filled in from a single
+    fstatat call.  both lists come back sorted.  false is returned if the
+    directory could not be read. */
+
   static bool recursive_create(const basis::astring &directory_name);
     //!< returns true if the "directory_name" can be created or already exists.
     /*!< false returns indicate that the operating system wouldn't let us
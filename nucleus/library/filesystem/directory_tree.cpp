@@ -27,6 +27,9 @@
 #include <textual/string_manipulation.h>
 
 #include <stdio.h>
+#if defined(__UNIX__) || defined(__GNU_WINDOWS__)
+  #include <fnmatch.h>
+#endif
 
 using namespace basis;
 using namespace loggers;
@@ -167,32 +170,24 @@ void directory_tree::traverse(const astring &path, const char *pattern,
   LOG(astring("working on node ") + add_to._dirname);
 #endif
 
-  // open the directory.
-  directory curr(path, "*");
-  if (!curr.good()) return;
-
-  if (!_ignore_files) {
-    // add all the files to the current node.
-    directory curr_stringent(path, pattern);
-    add_to._files = curr_stringent.files();
-  }
+  // read the directory in one pass, gathering the files unless they're not
+  // wanted.
+  string_array dirs;
+  if (!directory::read_entries(path, pattern, dirs,
+      _ignore_files? NULL_POINTER : &add_to._files))
+    return;
 
   // now iterate across the directories here and add a sub-node for each one,
-  // and recursively traverse that sub-node also.
-  const string_array &dirs = curr.directories();
+  // and recursively traverse that sub-node also.  only the branches that were
+  // here before we started can match, so the new ones aren't searched.
+  int existing_branches = add_to.branches();
   for (int i = 0; i < dirs.length(); i++) {
     filename_tree *new_branch = NULL_POINTER;
     astring new_path = path + filename::default_separator() + dirs[i];
 #ifdef DEBUG_DIRECTORY_TREE
     LOG(astring("seeking path: ") + new_path);
 #endif
-    if (!filename(new_path).is_normal()) {
-//#ifdef DEBUG_DIRECTORY_TREE
-      LOG(astring("bailing on weird dir: ") + new_path);
-//#endif
-      continue;  // only regular directories please.
-    }
-    for (int q = 0; q < add_to.branches(); q++) {
+    for (int q = 0; q < existing_branches; q++) {
       filename_tree *curr_kid = (filename_tree *)add_to.branch(q);
 #ifdef DEBUG_DIRECTORY_TREE
       LOG(astring("curr kid: ") + curr_kid->_dirname);
@@ -249,6 +244,18 @@ bool directory_tree::reset(const astring &path, const char *pattern)
   return true;
 }
 
+bool directory_tree::adopt(const astring &path, const char *pattern,
+    filename_tree *scanned)
+{
+  if (!scanned) return false;
+  WHACK(_real_tree);
+  *_path = path;
+  *_pattern = pattern;
+  _real_tree = scanned;
+  _scanned_okay = true;
+  return true;
+}
+
 dir_tree_iterator *directory_tree::start_at(filename_tree *start,
     traversal_types type) const
 {
@@ -993,6 +1000,67 @@ outcome directory_tree::remove_path(const astring &zap_item)
   return common::OKAY;
 }
 
+outcome directory_tree::refresh_path(const astring &changed, bool just_size)
+{
+  FUNCDEF("refresh_path");
+  filename item(changed);
+  filename_tree *parent = seek(item.dirname().raw(), false);
+  if (!parent) return common::NOT_FOUND;  // the parent isn't in our tree.
+  filename name = item.basename();
+
+  // find out what we have for this name already.
+  filename_tree *kid = NULL_POINTER;
+  for (int i = 0; i < parent->branches(); i++) {
+    filename_tree *curr = (filename_tree *)parent->branch(i);
+    if (curr->_dirname.raw().iequals(item.raw())) {
+      kid = curr;
+      break;
+    }
+  }
+  int file_index = parent->_files.locate(name);
+
+  bool exists = item.exists();
+  bool is_dir = exists && item.is_directory();
+  // toss whatever no longer matches what's really there.
+  if (kid && !is_dir) {
+    parent->prune(kid);
+    WHACK(kid);
+  }
+  if (!negative(file_index) && (!exists || is_dir)) {
+    parent->_files.zap(file_index, file_index);
+    file_index = common::NOT_FOUND;
+  }
+  if (!exists) return common::OKAY;
+
+  if (is_dir) {
+    // an existing directory hears about its contents separately, but a new
+    // one needs to be scanned.
+    if (!kid) {
+#ifdef DEBUG_DIRECTORY_TREE
+      LOG(astring("scanning new directory ") + item.raw());
+#endif
+      kid = new filename_tree;
+      kid->_depth = parent->_depth + 1;
+      parent->attach(kid);
+      traverse(item.raw(), _pattern->s(), *kid);
+      calculate(kid, just_size);
+    }
+    return common::OKAY;
+  }
+
+  if (_ignore_files) return common::OKAY;
+#if defined(__UNIX__) || defined(__GNU_WINDOWS__)
+  if (fnmatch(_pattern->s(), name.raw().s(), 0)) return common::OKAY;
+#endif
+  if (negative(file_index)) {
+    parent->_files += new file_info(name, 0);
+    file_index = parent->_files.elements() - 1;
+  }
+  parent->_files.borrow(file_index)->calculate(parent->_dirname.raw(),
+      just_size);
+  return common::OKAY;
+}
+
 basis::outcome directory_tree::make_directories(const basis::astring new_root)
 {
   FUNCDEF("make_directories");
@@ -68,6 +68,17 @@ public:
     if the process was started successfully at "path"; there might be
     problems with subdirectories, but at least the "path" got validated. */
 
+  bool adopt(const basis::astring &path, const char *pattern,
+          filename_tree *scanned);
+    //!< replaces our contents with a tree that was "scanned" elsewhere.
+    /*!< this lets a separate scanner (such as the parallel tree_scanner in
+    the processes library) build the tree.  the "scanned" tree must be rooted
+    at "path" and have been built with the "pattern".  we take ownership of
+    "scanned".  false is returned if it was NULL_POINTER. */
+
+  bool ignoring_files() const { return _ignore_files; }
+    //!< returns true if only the directories are being gathered.
+
   filename_tree *seek(const basis::astring &dir_name, bool ignore_initial) const;
     //!< finds the "dir_name" in our tree.
     /*!< locates the node that corresponds to the directory name contained in
@@ -104,6 +115,17 @@ public:
     removed in the filesystem.  if the item is still really there, then the
     next rescan will put it back into the tree. */
 
+  basis::outcome refresh_path(const basis::astring &changed,
+          bool just_size = false);
+    //!< brings the tree up to date for a single "changed" path.
+    /*!< the full path is expected here, and its directory must already be in
+    the tree.  a file is added or has its information recalculated, a new
+    directory is scanned, and anything that's no longer on disk is removed
+    from the tree.  only the directory holding the "changed" item is
+    visited, so this is much cheaper than a rescan when just a few things
+    have changed (see directory_watcher).  NOT_FOUND is returned if the
+    parent directory is not part of the tree. */
+
   basis::outcome make_directories(const basis::astring new_root);
     //!< creates all of the directories in this object, but start at the "new_root".
 
@@ -0,0 +1,224 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : directory_watcher                                                 *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "directory.h"
+#include "directory_tree.h"
+#include "directory_watcher.h"
+#include "filename.h"
+
+#include <basis/functions.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/int_hash.h>
+#include <structures/string_hash.h>
+
+#ifdef __LINUX__
+  #include <errno.h>
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#endif
+
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+
+namespace filesystem {
+
+//#define DEBUG_DIRECTORY_WATCHER
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int WATCH_HASH_BITS = 10;
+  // the size of the table mapping watch ids to directories.
+
+const int EXPECTED_CHANGES = 200;
+  // a rough guess at how many paths change between gathers.
+
+const int EVENT_BUFFER_SIZE = 64 * KILOBYTE;
+  // how much event data is read at a time.
+
+#ifdef __LINUX__
+const int WATCHED_EVENTS = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE
+    | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+  // the events that can change what a directory_tree would hold.
+#endif
+
+//////////////
+
+class watched_paths : public int_hash<astring>
+{
+public:
+  watched_paths() : int_hash<astring>(WATCH_HASH_BITS) {}
+};
+
+//////////////
+
+directory_watcher::directory_watcher()
+: _descriptor(-1),
+  _paths(new watched_paths),
+  _events(0),
+  _rescans(0)
+{
+  FUNCDEF("constructor");
+#ifdef __LINUX__
+  _descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (negative(_descriptor))
+    LOG(a_sprintf("change notification is unavailable, error %d", errno));
+#endif
+}
+
+directory_watcher::~directory_watcher()
+{
+#ifdef __LINUX__
+  if (!negative(_descriptor)) close(_descriptor);
+#endif
+  WHACK(_paths);
+}
+
+bool directory_watcher::good() const { return !negative(_descriptor); }
+
+int directory_watcher::watches() const { return _paths->elements(); }
+
+bool directory_watcher::add_watch(const astring &path)
+{
+  FUNCDEF("add_watch");
+#ifdef __LINUX__
+  if (!good()) return false;
+  int id = inotify_add_watch(_descriptor, path.s(), WATCHED_EVENTS);
+  if (negative(id)) {
+#ifdef DEBUG_DIRECTORY_WATCHER
+    LOG(a_sprintf("failed to watch %s, error %d", path.s(), errno));
+#endif
+    return false;
+  }
+  // re-watching a directory hands back the same id, so we just replace it.
+  _paths->add(id, new astring(path));
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool directory_watcher::watch_tree(const astring &path)
+{
+  if (!add_watch(path)) return false;
+  string_array dirs;
+  if (!directory::read_entries(path, "*", dirs, NULL_POINTER)) return true;
+  bool to_return = true;
+  for (int i = 0; i < dirs.length(); i++) {
+    if (!watch_tree(path + filename::default_separator() + dirs[i]))
+      to_return = false;
+  }
+  return to_return;
+}
+
+void directory_watcher::unwatch_all()
+{
+#ifdef __LINUX__
+  // closing and reopening drops the watches and any queued events together.
+  if (!negative(_descriptor)) close(_descriptor);
+  _descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  _paths->reset();
+}
+
+bool directory_watcher::gather(string_array &changed, bool &overflowed)
+{
+  FUNCDEF("gather");
+  changed.reset();
+  overflowed = false;
+  if (!good()) return false;
+#ifdef __LINUX__
+  string_hash<int> seen(EXPECTED_CHANGES);
+    // remembers which paths are already listed so bursts are coalesced.
+  byte_array buffer(EVENT_BUFFER_SIZE);
+  while (true) {
+    int len = int(read(_descriptor, buffer.access(), buffer.length()));
+    if (len <= 0) {
+      if (negative(len) && (errno == EINTR)) continue;
+      break;  // nothing left to read for now.
+    }
+    for (int posn = 0; posn < len; ) {
+      const inotify_event *event = (const inotify_event *)(buffer.observe()
+          + posn);
+      posn += int(sizeof(inotify_event)) + event->len;
+      _events++;
+      if (event->mask & IN_Q_OVERFLOW) {
+        overflowed = true;
+        continue;
+      }
+      if (event->mask & IN_IGNORED) {
+        // the directory is gone or was unwatched.
+        _paths->zap(event->wd);
+        continue;
+      }
+      astring *dir = _paths->find(event->wd);
+      if (!dir) continue;  // a leftover from a directory we dropped.
+      if (!event->len) continue;  // about the directory itself; the parent
+        // will have told us what happened to it.
+      astring path = *dir + filename::default_separator() + event->name;
+      if ( (event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM) ) {
+        // the watches below a moved directory still think they're in the
+        // old place, so only a fresh start will straighten that out.
+        overflowed = true;
+      }
+      if ( (event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) ) {
+        // if it's already gone again, then the parent will tell us so.
+        if (!watch_tree(path) && filename(path).exists()) overflowed = true;
+      }
+      if (!seen.find(path)) {
+        seen.add(path, new int(changed.length()));
+        changed += path;
+      }
+    }
+  }
+#ifdef DEBUG_DIRECTORY_WATCHER
+  if (changed.length())
+    LOG(a_sprintf("gathered %d changed paths.", changed.length()));
+#endif
+#endif
+  return true;
+}
+
+int directory_watcher::update(directory_tree &target, bool just_size,
+    bool &rescanned)
+{
+  FUNCDEF("update");
+  rescanned = false;
+  string_array changed;
+  bool overflowed;
+  if (!gather(changed, overflowed)) return 0;
+
+  if (overflowed) {
+    // we've lost track, so everything is scanned again.  the watches are
+    // set up first so that nothing can slip by during the scan.
+    LOG(astring("change events were lost; rescanning ") + target.path());
+    _rescans++;
+    rescanned = true;
+    astring top = target.path();
+    unwatch_all();
+    watch_tree(top);
+    target.reset(top);
+    target.calculate(just_size);
+    return changed.length();
+  }
+
+  for (int i = 0; i < changed.length(); i++)
+    target.refresh_path(changed[i], just_size);
+  return changed.length();
+}
+
+} //namespace.
+
@@ -0,0 +1,99 @@
+#ifndef DIRECTORY_WATCHER_CLASS
+#define DIRECTORY_WATCHER_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : directory_watcher                                                 *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <structures/string_array.h>
+
+namespace filesystem {
+
+// forward.
+class directory_tree;
+class watched_paths;
+
+//! Keeps track of the changes happening under a directory hierarchy.
+/*!
+  The operating system's change notification (inotify on Linux) is used to
+  find out which paths have been created, modified or deleted, so that a
+  directory_tree can be kept current without rescanning all of it.  Nothing
+  here blocks; the pending changes are simply collected whenever gather() or
+  update() are invoked.  On platforms without change notification, good()
+  returns false and the caller should stick with periodic rescans.
+*/
+
+class directory_watcher : public virtual basis::root_object
+{
+public:
+  directory_watcher();
+  virtual ~directory_watcher();
+
+  DEFINE_CLASS_NAME("directory_watcher");
+
+  bool good() const;
+    //!< true if change notification is available and working.
+
+  bool watch_tree(const basis::astring &path);
+    //!< starts watching the "path" and every directory below it.
+    /*!< false is returned if any part could not be watched, which usually
+    means the system's limit on watches was reached. */
+
+  void unwatch_all();
+    //!< stops watching everything and drops any pending changes.
+
+  int watches() const;  //!< the number of directories being watched.
+
+  bool gather(structures::string_array &changed, bool &overflowed);
+    //!< collects the paths that changed since the last gather.
+    /*!< each path is only listed once, no matter how many events were seen
+    for it, and paths are listed in the order they were first seen.  new
+    directories are watched automatically.  if "overflowed" is true, then
+    events were lost (or a directory was moved) and the list is incomplete;
+    the caller must rescan the whole hierarchy.  false is returned if the
+    watcher is not good(). */
+
+  int update(directory_tree &target, bool just_size, bool &rescanned);
+    //!< brings the "target" up to date with the changes seen so far.
+    /*!< the "target" should be the tree for the top-most path being watched.
+    files and directories that changed are added, refreshed or removed in the
+    tree, so the cost is proportional to the changes rather than the tree's
+    size.  if the events overflowed, then the whole tree is rescanned and
+    re-watched and "rescanned" is set to true.  "just_size" is passed along
+    to the tree's calculations.  the number of changed paths is returned. */
+
+  int events_seen() const { return _events; }
+    //!< the total number of notifications received so far.
+  int rescans() const { return _rescans; }
+    //!< how many times the events overflowed and forced a full rescan.
+
+private:
+  int _descriptor;  //!< the notification handle, or negative if none.
+  watched_paths *_paths;  //!< maps the watch ids onto their directories.
+  int _events;  //!< the number of events received.
+  int _rescans;  //!< the number of full rescans required.
+
+  bool add_watch(const basis::astring &path);
+    //!< watches one directory without recursing.
+
+  // not appropriate.
+  directory_watcher(const directory_watcher &);
+  directory_watcher &operator =(const directory_watcher &);
+};
+
+} //namespace.
+
+#endif
+
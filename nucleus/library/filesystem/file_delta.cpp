@@ -0,0 +1,681 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_delta                                                        *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "file_delta.h"
+#include "filename.h"
+#include "heavy_file_ops.h"
+#include "huge_file.h"
+
+#include <basis/functions.h>
+#include <structures/checksums.h>
+#include <structures/object_packers.h>
+
+#include <math.h>
+#include <stdio.h>
+
+using namespace basis;
+using namespace structures;
+
+namespace filesystem {
+
+//#define DEBUG_FILE_DELTA
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(to_print) printf("%s::%s: %s\n", static_class_name(), func, astring(to_print).s())
+
+typedef content_hash::wide_hash wide_hash;
+typedef huge_file::file_offset file_offset;
+
+const int TAG_BITS = 16;
+  // the size of the table used to find blocks by their weak checksum.
+
+const int TAG_COUNT = 1 << TAG_BITS;
+  // the number of slots in that table.
+
+const int COPY_PIECE = 1 * MEGABYTE;
+  // the most that's copied out of the old file at a time by the receiver.
+
+const int SMALLEST_LITERAL = 256;
+  // literal bytes aren't started in a piece with less room than this.
+
+// the types of instructions found in a delta piece.
+enum delta_operations {
+  COPY_OPERATION = 1,  // followed by the new start, old start and length.
+  LITERAL_OPERATION = 2,  // followed by the new start and the bytes.
+  FINISH_OPERATION = 3,  // followed by the file's size and its content hash.
+  ABANDON_OPERATION = 4  // the delta was given up; the whole file follows.
+};
+
+const int COPY_SIZE = 1 + 3 * 8;  // the packed size of a copy operation.
+const int LITERAL_OVERHEAD = 1 + 8 + 8;  // everything in a literal but bytes.
+const int FINISH_SIZE = 1 + 2 * 8;  // the packed size of a finish operation.
+
+// file offsets are packed as two 32-bit halves, since the general purpose
+// double packing is several times larger.
+
+void attach_offset(byte_array &packed_form, double offset)
+{
+  unsigned long long value = (unsigned long long)offset;
+  attach(packed_form, un_int(value >> 32));
+  attach(packed_form, un_int(value));
+}
+
+bool detach_offset(byte_array &packed_form, double &offset)
+{
+  un_int high, low;
+  if (!detach(packed_form, high) || !detach(packed_form, low)) return false;
+  offset = double(((unsigned long long)high << 32) | low);
+  return true;
+}
+
+void attach_hash(byte_array &packed_form, wide_hash hash)
+{
+  attach(packed_form, un_int(hash >> 32));
+  attach(packed_form, un_int(hash));
+}
+
+bool detach_hash(byte_array &packed_form, wide_hash &hash)
+{
+  un_int high, low;
+  if (!detach(packed_form, high) || !detach(packed_form, low)) return false;
+  hash = (wide_hash(high) << 32) | low;
+  return true;
+}
+
+int tag_of(un_int weak) { return int((weak ^ (weak >> TAG_BITS)) & (TAG_COUNT - 1)); }
+
+//////////////
+
+file_signature::file_signature()
+: _filename(),
+  _block_size(0),
+  _file_size(0),
+  _weak(0, NULL_POINTER, byte_array::SIMPLE_COPY | byte_array::EXPONE),
+  _strong(0, NULL_POINTER, byte_array::SIMPLE_COPY | byte_array::EXPONE)
+{}
+
+file_signature::~file_signature() {}
+
+int file_signature::default_block_size(double file_size)
+{
+  int size = int(sqrt(file_size));
+  size = (size + KILOBYTE - 1) / KILOBYTE * KILOBYTE;  // round up to a KB.
+  return maximum(int(MINIMUM_BLOCK), minimum(int(MAXIMUM_BLOCK), size));
+}
+
+un_int file_signature::weak_sum(const abyte *data, int length)
+{
+  // the low half sums the bytes and the high half weights them by their
+  // distance from the end, so either can be updated as the window slides.
+  un_int low = 0, high = 0;
+  for (int i = 0; i < length; i++) {
+    low += data[i];
+    high += un_int(length - i) * data[i];
+  }
+  return (low & 0xFFFF) | (high << 16);
+}
+
+un_int file_signature::roll(un_int sum, abyte leaving, abyte entering,
+    int length)
+{
+  un_int low = (sum & 0xFFFF) - leaving + entering;
+  un_int high = (sum >> 16) - un_int(length) * leaving + low;
+  return (low & 0xFFFF) | (high << 16);
+}
+
+bool file_signature::compute(const astring &path, const astring &name,
+    int block_size)
+{
+  _filename = name;
+  _weak.reset();
+  _strong.reset();
+  huge_file to_read(path, "rb");
+  if (!to_read.good()) return false;
+  to_read.advise(huge_file::SEQUENTIAL_ACCESS);
+  file_offset size = to_read.size();
+  _file_size = double(size);
+  _block_size = block_size > 0? block_size : default_block_size(_file_size);
+  // the blocks are read a few at a time to keep the reads large.
+  int per_read = maximum(1, int(content_hash::CHUNK_SIZE) / _block_size);
+  byte_array chunk;
+  for (file_offset where = 0; where < size; ) {
+    int desired = int(minimum(file_offset(per_read) * _block_size, size - where));
+    int read = 0;
+    if ( (to_read.read_at(where, chunk, desired, read) != huge_file::OKAY)
+        || (read != desired) )
+      return false;
+    for (int i = 0; i < read; i += _block_size) {
+      int length = minimum(_block_size, read - i);
+      _weak += weak_sum(chunk.observe() + i, length);
+      _strong += checksums::wide_hash_bytes(chunk.observe() + i, length);
+    }
+    where += read;
+  }
+  return true;
+}
+
+int file_signature::packed_size() const
+{
+  return _filename.packed_size() + 2 * sizeof(int) + 8
+      + _weak.length() * (4 + 8);
+}
+
+void file_signature::pack(byte_array &packed_form) const
+{
+  _filename.pack(packed_form);
+  attach(packed_form, _block_size);
+  attach_offset(packed_form, _file_size);
+  attach(packed_form, _weak.length());
+  for (int i = 0; i < _weak.length(); i++) {
+    attach(packed_form, _weak[i]);
+    attach_hash(packed_form, _strong[i]);
+  }
+}
+
+bool file_signature::unpack(byte_array &packed_form)
+{
+  int count;
+  if (!_filename.unpack(packed_form) || !detach(packed_form, _block_size)
+      || !detach_offset(packed_form, _file_size) || !detach(packed_form, count))
+    return false;
+  if ( (_block_size <= 0) || (count < 0) ) return false;
+  _weak.reset(count);
+  _strong.reset(count);
+  for (int i = 0; i < count; i++) {
+    if (!detach(packed_form, _weak[i]) || !detach_hash(packed_form, _strong[i]))
+      return false;
+  }
+  return true;
+}
+
+//////////////
+
+const file_signature *signature_list::find(const astring &name) const
+{
+  for (int i = 0; i < elements(); i++)
+    if (get(i)->_filename == name) return get(i);
+  return NULL_POINTER;
+}
+
+int signature_list::packed_size() const { return amorph_packed_size(*this); }
+
+void signature_list::pack(byte_array &packed_form) const
+{ amorph_pack(packed_form, *this); }
+
+bool signature_list::unpack(byte_array &packed_form)
+{ return amorph_unpack(packed_form, *this); }
+
+//////////////
+
+// one step in rebuilding the new file.
+
+class delta_operation
+{
+public:
+  bool _copy;  // true for copying from the old file, false for literal bytes.
+  double _new_start;  // where this lands in the new file.
+  double _old_start;  // where a copy comes from in the old file.
+  double _length;  // how many bytes are covered.
+};
+
+//////////////
+
+// the complete recipe for sending one file, along with how far along it is.
+
+class delta_plan
+{
+public:
+  astring _filename;  // the file this plan is for.
+  double _file_size;  // the size of the new file.
+  wide_hash _file_hash;  // the new file's content hash.
+  array<delta_operation> _operations;  // the steps in order.
+  int _next_operation;  // the step that's next to be sent.
+  double _operation_offset;  // how much of a literal step was already sent.
+  bool _finished;  // true once the final piece has been produced.
+
+  delta_plan()
+  : _file_size(0), _file_hash(0),
+    _operations(0, NULL_POINTER, byte_array::SIMPLE_COPY | byte_array::EXPONE),
+    _next_operation(0), _operation_offset(0), _finished(false) {}
+
+  void add(bool copy, double new_start, double old_start, double length) {
+    if (length <= 0) return;
+    if (_operations.length()) {
+      // runs of blocks that are in the same order in both files are merged.
+      delta_operation &last = _operations[_operations.last()];
+      if (copy && last._copy && (last._old_start + last._length == old_start)
+          && (last._new_start + last._length == new_start)) {
+        last._length += length;
+        return;
+      }
+    }
+    delta_operation to_add;
+    to_add._copy = copy;
+    to_add._new_start = new_start;
+    to_add._old_start = old_start;
+    to_add._length = length;
+    _operations += to_add;
+  }
+
+  bool build(const astring &full_file, const file_signature &signature);
+};
+
+// reads the new file while a plan is being built.  the content hash is
+// computed along the way, since every byte gets read anyway.
+
+class delta_reader
+{
+public:
+  byte_array _buffer;  // the part of the file that's in memory.
+  file_offset _buffer_start;  // the file offset of the buffer's first byte.
+
+  delta_reader(huge_file &file, file_offset size)
+  : _buffer_start(0), _file(file), _size(size), _next_read(0), _chunk(0),
+    _chunk_hashes(content_hash::chunks(double(size)), NULL_POINTER,
+        byte_array::SIMPLE_COPY) {}
+
+  // ensures everything before "up_to" is in the buffer.
+  bool ensure(file_offset up_to) {
+    byte_array piece;
+    while ( (_next_read < up_to) && (_next_read < _size) ) {
+      int desired = int(minimum(file_offset(content_hash::CHUNK_SIZE),
+          _size - _next_read));
+      int read = 0;
+      if ( (_file.read_at(_next_read, piece, desired, read) != huge_file::OKAY)
+          || (read != desired) )
+        return false;
+      _chunk_hashes[_chunk] = content_hash::hash_chunk(piece, _chunk);
+      _chunk++;
+      _next_read += read;
+      _buffer += piece;
+    }
+    return true;
+  }
+
+  // drops the part of the buffer that lies before "keep_from".
+  void trim(file_offset keep_from) {
+    if (keep_from - _buffer_start < content_hash::CHUNK_SIZE) return;
+    int dropping = int(keep_from - _buffer_start);
+    _buffer.zap(0, dropping - 1);
+    _buffer_start += dropping;
+  }
+
+  const abyte *at(file_offset where) const
+  { return _buffer.observe() + (where - _buffer_start); }
+
+  wide_hash file_hash() {
+    if (!_size) _chunk_hashes[0] = content_hash::hash_chunk(byte_array(), 0);
+    return content_hash::combine(_chunk_hashes.observe(),
+        _chunk_hashes.length(), double(_size));
+  }
+
+private:
+  huge_file &_file;
+  file_offset _size;
+  file_offset _next_read;
+  int _chunk;
+  array<wide_hash> _chunk_hashes;
+};
+
+bool delta_plan::build(const astring &full_file, const file_signature &signature)
+{
+  _filename = signature._filename;
+  _operations.reset();
+  _next_operation = 0;
+  _operation_offset = 0;
+  _finished = false;
+
+  huge_file to_read(full_file, "rb");
+  if (!to_read.good()) return false;
+  to_read.advise(huge_file::SEQUENTIAL_ACCESS);
+  file_offset size = to_read.size();
+  _file_size = double(size);
+  const int block = signature._block_size;
+  if (block <= 0) return false;
+
+  // the old file's last block may be short; it can only match at the end.
+  int blocks = signature.blocks();
+  int last_length = blocks? int(signature._file_size
+      - double(blocks - 1) * block) : 0;
+  int full_blocks = (last_length == block)? blocks : maximum(0, blocks - 1);
+
+  // bucket the full blocks by a tag from their weak sums, so each position
+  // in the new file only checks the few blocks that could possibly match.
+  array<int> heads(TAG_COUNT + 1, NULL_POINTER, byte_array::SIMPLE_COPY);
+  array<int> order(maximum(full_blocks, 1), NULL_POINTER, byte_array::SIMPLE_COPY);
+  for (int i = 0; i <= TAG_COUNT; i++) heads[i] = 0;
+  for (int i = 0; i < full_blocks; i++) heads[tag_of(signature._weak[i]) + 1]++;
+  for (int i = 0; i < TAG_COUNT; i++) heads[i + 1] += heads[i];
+  array<int> filled = heads;
+  for (int i = 0; i < full_blocks; i++)
+    order[filled[tag_of(signature._weak[i])]++] = i;
+
+  delta_reader reader(to_read, size);
+  file_offset position = 0;  // the start of the window.
+  file_offset literal_start = 0;  // where the unmatched bytes began.
+  un_int sum = 0;
+  bool have_sum = false;
+  while (full_blocks && (position + block <= size)) {
+    // we need the byte after the window for rolling along.
+    if (!reader.ensure(position + block + 1)) return false;
+    const abyte *window = reader.at(position);
+    if (!have_sum) {
+      sum = file_signature::weak_sum(window, block);
+      have_sum = true;
+    }
+    int found = -1;
+    int tag = tag_of(sum);
+    bool have_strong = false;
+    wide_hash strong = 0;
+    for (int i = heads[tag]; i < heads[tag + 1]; i++) {
+      int candidate = order[i];
+      if (signature._weak[candidate] != sum) continue;
+      if (!have_strong) {
+        strong = checksums::wide_hash_bytes(window, block);
+        have_strong = true;
+      }
+      if (signature._strong[candidate] == strong) {
+        found = candidate;
+        break;
+      }
+    }
+    if (found >= 0) {
+      add(false, double(literal_start), 0, double(position - literal_start));
+      add(true, double(position), double(found) * block, block);
+      position += block;
+      literal_start = position;
+      have_sum = false;
+      reader.trim(position - block);
+      continue;
+    }
+    if (position + block == size) break;  // nothing left to roll in.
+    sum = file_signature::roll(sum, window[0], window[block], block);
+    position++;
+    reader.trim(position - block);
+  }
+
+  // the end of the file may match the old file's short last block.
+  if (!reader.ensure(size)) return false;
+  file_offset tail_start = size - last_length;
+  if ( (last_length > 0) && (last_length < block)
+      && (tail_start >= literal_start) && (tail_start >= reader._buffer_start)
+      && (file_signature::weak_sum(reader.at(tail_start), last_length)
+          == signature._weak[blocks - 1])
+      && (checksums::wide_hash_bytes(reader.at(tail_start), last_length)
+          == signature._strong[blocks - 1]) ) {
+    add(false, double(literal_start), 0, double(tail_start - literal_start));
+    add(true, double(tail_start), double(blocks - 1) * block, last_length);
+  } else {
+    add(false, double(literal_start), 0, double(size - literal_start));
+  }
+  _file_hash = reader.file_hash();
+  return true;
+}
+
+//////////////
+
+delta_source::delta_source()
+: _signatures(new signature_list),
+  _plan(NULL_POINTER),
+  _copied(0),
+  _literal(0)
+{}
+
+delta_source::~delta_source()
+{
+  WHACK(_plan);
+  WHACK(_signatures);
+}
+
+void delta_source::add(file_signature *to_add)
+{
+  for (int i = 0; i < _signatures->elements(); i++) {
+    if (_signatures->get(i)->_filename == to_add->_filename) {
+      _signatures->zap(i, i);
+      if (_plan && (_plan->_filename == to_add->_filename)) WHACK(_plan);
+      break;
+    }
+  }
+  _signatures->append(to_add);
+}
+
+bool delta_source::covers(const astring &name) const
+{ return !!_signatures->find(name); }
+
+void delta_source::forget(const astring &name)
+{
+  for (int i = 0; i < _signatures->elements(); i++) {
+    if (_signatures->get(i)->_filename == name) {
+      _signatures->zap(i, i);
+      break;
+    }
+  }
+  if (_plan && (_plan->_filename == name)) WHACK(_plan);
+}
+
+void delta_source::abandon(file_transfer_header &last_action,
+    byte_array &storage)
+{
+  forget(last_action._filename);
+  byte_array piece;
+  attach(piece, abyte(ABANDON_OPERATION));
+  last_action._byte_start = 0;
+  last_action._length = piece.length();
+  last_action.pack(storage);
+  storage += piece;
+  // the whole file gets sent from the start after this.
+  last_action._length = 0;
+}
+
+outcome delta_source::fill(const astring &full_file,
+    file_transfer_header &last_action, byte_array &storage, int room,
+    bool &finished)
+{
+  FUNCDEF("fill");
+  finished = false;
+  const file_signature *signature = _signatures->find(last_action._filename);
+  if (!signature) return common::NOT_FOUND;
+  if (!_plan || (_plan->_filename != last_action._filename)) {
+    // this is a new file for us, so work out how to send it.
+    WHACK(_plan);
+    _plan = new delta_plan;
+    if (!_plan->build(full_file, *signature)) {
+      LOG(astring("could not plan delta for ") + full_file);
+      WHACK(_plan);
+      return common::FAILURE;
+    }
+#ifdef DEBUG_FILE_DELTA
+    LOG(a_sprintf("planned %d operations for ", _plan->_operations.length())
+        + full_file);
+#endif
+  }
+  if (_plan->_finished) {
+    // asked again after the last piece; there's nothing more to send.
+    finished = true;
+    return common::OKAY;
+  }
+
+  huge_file to_read(full_file, "rb");
+  if (!to_read.good()) return common::FAILURE;
+  byte_array piece;
+  double piece_start = -1;  // where in the new file this piece begins.
+  while (_plan->_next_operation < _plan->_operations.length()) {
+    const delta_operation &current = _plan->_operations[_plan->_next_operation];
+    if (piece_start < 0) piece_start = current._new_start + _plan->_operation_offset;
+    if (current._copy) {
+      if (piece.length() + COPY_SIZE > room) break;
+      attach(piece, abyte(COPY_OPERATION));
+      attach_offset(piece, current._new_start);
+      attach_offset(piece, current._old_start);
+      attach_offset(piece, current._length);
+      _copied += current._length;
+      _plan->_next_operation++;
+      continue;
+    }
+    int space = room - piece.length() - LITERAL_OVERHEAD;
+    if (space < SMALLEST_LITERAL) break;
+    int length = int(minimum(double(space),
+        current._length - _plan->_operation_offset));
+    double where = current._new_start + _plan->_operation_offset;
+    byte_array literal;
+    int read = 0;
+    if ( (to_read.read_at(file_offset(where), literal, length, read)
+        != huge_file::OKAY) || (read != length) ) {
+      LOG(astring("file changed while being sent: ") + full_file);
+      WHACK(_plan);
+      return common::FAILURE;
+    }
+    attach(piece, abyte(LITERAL_OPERATION));
+    attach_offset(piece, where);
+    attach(piece, literal);
+    _literal += length;
+    _plan->_operation_offset += length;
+    if (_plan->_operation_offset >= current._length) {
+      _plan->_next_operation++;
+      _plan->_operation_offset = 0;
+    }
+  }
+  if ( (_plan->_next_operation >= _plan->_operations.length())
+      && (piece.length() + FINISH_SIZE <= room) ) {
+    attach(piece, abyte(FINISH_OPERATION));
+    attach_offset(piece, _plan->_file_size);
+    attach_hash(piece, _plan->_file_hash);
+    finished = true;
+  }
+  if (!piece.length()) return common::OKAY;  // no room for anything.
+
+  last_action._byte_start = piece_start < 0? _plan->_file_size : piece_start;
+  last_action._length = piece.length();
+  last_action.pack(storage);
+  storage += piece;
+  _plan->_finished = finished;
+  return common::OKAY;
+}
+
+//////////////
+
+delta_target::~delta_target() {}
+
+const char *delta_target::partial_suffix() { return ".delta_part"; }
+
+outcome delta_target::apply_piece(const astring &target_file,
+    double byte_start, byte_array &piece, bool &finished)
+{
+  FUNCDEF("apply_piece");
+  finished = false;
+  astring partial = target_file + partial_suffix();
+  // a piece at the very start means a fresh copy is being built.
+  if (!byte_start) filename(partial).unlink();
+  if (!filename(partial).exists()) {
+    huge_file create(partial, "w");
+  }
+  huge_file *output = new huge_file(partial, "r+b");
+  if (!output->good()) {
+    WHACK(output);
+    return heavy_file_operations::TARGET_ACCESS_ERROR;
+  }
+  huge_file *old_file = NULL_POINTER;  // only opened if there are copies.
+  outcome to_return = common::OKAY;
+
+  while (piece.length()) {
+    abyte operation;
+    if (!detach(piece, operation)) { to_return = common::GARBAGE; break; }
+    if (operation == ABANDON_OPERATION) {
+      // the sender couldn't finish the delta, so the old file stays as it is
+      // until the whole file arrives.
+      WHACK(old_file);
+      WHACK(output);
+      filename(partial).unlink();
+      return common::INCOMPLETE;
+    } else if (operation == COPY_OPERATION) {
+      double new_start, old_start, length;
+      if (!detach_offset(piece, new_start) || !detach_offset(piece, old_start)
+          || !detach_offset(piece, length)) {
+        to_return = common::GARBAGE;
+        break;
+      }
+      if (!old_file) old_file = new huge_file(target_file, "rb");
+      if (!old_file->good()) {
+        to_return = heavy_file_operations::SOURCE_MISSING;
+        break;
+      }
+      // large runs are copied a piece at a time to keep memory use bounded.
+      byte_array chunk;
+      for (double done = 0; done < length; ) {
+        int desired = int(minimum(double(COPY_PIECE), length - done));
+        int read = 0, wrote = 0;
+        if ( (old_file->read_at(file_offset(old_start + done), chunk, desired,
+            read) != huge_file::OKAY) || (read != desired)
+            || (output->write_at(file_offset(new_start + done), chunk, wrote)
+                != huge_file::OKAY) || (wrote != read) ) {
+          to_return = heavy_file_operations::TARGET_ACCESS_ERROR;
+          break;
+        }
+        done += read;
+      }
+      if (to_return != common::OKAY) break;
+    } else if (operation == LITERAL_OPERATION) {
+      double new_start;
+      byte_array literal;
+      if (!detach_offset(piece, new_start) || !detach(piece, literal)) {
+        to_return = common::GARBAGE;
+        break;
+      }
+      int wrote = 0;
+      if ( (output->write_at(file_offset(new_start), literal, wrote)
+          != huge_file::OKAY) || (wrote != literal.length()) ) {
+        to_return = heavy_file_operations::TARGET_ACCESS_ERROR;
+        break;
+      }
+    } else if (operation == FINISH_OPERATION) {
+      double size;
+      wide_hash expected;
+      if (!detach_offset(piece, size) || !detach_hash(piece, expected)) {
+        to_return = common::GARBAGE;
+        break;
+      }
+      output->seek(size, byte_filer::FROM_START);
+      output->truncate();
+      WHACK(output);
+      WHACK(old_file);
+      // the new copy must be exactly what the sender has before it replaces
+      // the old one; a stale signature could otherwise corrupt the file.
+      wide_hash found;
+      if (!content_hash::hash_file(partial, found) || (found != expected)) {
+        LOG(astring("delta did not reproduce the file; keeping old copy of ")
+            + target_file);
+        filename(partial).unlink();
+        return common::FAILURE;
+      }
+      if (rename(partial.s(), target_file.s())) {
+        LOG(astring("could not replace file with its new copy: ") + target_file);
+        filename(partial).unlink();
+        return heavy_file_operations::TARGET_ACCESS_ERROR;
+      }
+      finished = true;
+    } else {
+      to_return = common::GARBAGE;
+      break;
+    }
+  }
+  WHACK(old_file);
+  WHACK(output);
+  // a broken piece means the rest of this delta is useless.
+  if (to_return != common::OKAY) filename(partial).unlink();
+  return to_return;
+}
+
+} //namespace.
+
@@ -0,0 +1,201 @@
+#ifndef FILE_DELTA_CLASS
+#define FILE_DELTA_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_delta                                                        *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "content_hash.h"
+
+#include <basis/array.h>
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <structures/amorph.h>
+
+/*!
+  These classes send a changed file by describing it in terms of an older
+  copy that the other side already has, in the manner of rsync.  The side
+  holding the old copy makes a file_signature listing a weak rolling
+  checksum and a strong hash for each fixed size block of its file.  The
+  side holding the new copy slides a window across its file looking for
+  those blocks at any offset.  Wherever one is found, only an instruction
+  to copy that block from the old file is sent; everything else is sent as
+  literal bytes.  The receiver builds the new file beside the old one and
+  swaps it into place once the whole file hash has been verified.
+*/
+
+namespace filesystem {
+
+// forward.
+class delta_plan;
+class file_transfer_header;
+
+//! The block checksums for a file that the receiving side already has.
+
+class file_signature : public virtual basis::packable
+{
+public:
+  typedef content_hash::wide_hash wide_hash;
+
+  enum signature_constants {
+    MINIMUM_BLOCK = 2 * basis::KILOBYTE,  //!< the smallest block used.
+    MAXIMUM_BLOCK = 128 * basis::KILOBYTE  //!< the largest block used.
+  };
+
+  basis::astring _filename;  //!< the file's name within the transfer.
+  int _block_size;  //!< the size of every block but the last.
+  double _file_size;  //!< the size of the file that was signed.
+  basis::array<basis::un_int> _weak;  //!< rolling checksum of each block.
+  basis::array<wide_hash> _strong;  //!< strong hash of each block.
+
+  file_signature();
+  virtual ~file_signature();
+
+  DEFINE_CLASS_NAME("file_signature");
+
+  static int default_block_size(double file_size);
+    //!< picks a block size that balances signature size against precision.
+    /*!< this is about the square root of the "file_size", as rsync uses. */
+
+  bool compute(const basis::astring &path, const basis::astring &name,
+          int block_size = 0);
+    //!< reads the file at "path" and fills in its signature under "name".
+    /*!< if "block_size" is zero, then the default_block_size() is used.
+    false is returned if the file could not be read. */
+
+  int blocks() const { return _weak.length(); }  //!< the number of blocks.
+
+  static basis::un_int weak_sum(const basis::abyte *data, int length);
+    //!< calculates the rolling checksum over "length" bytes of "data".
+  static basis::un_int roll(basis::un_int sum, basis::abyte leaving,
+          basis::abyte entering, int length);
+    //!< slides the window for "sum" forward by one byte.
+    /*!< the "leaving" byte drops out of the front of the "length" byte
+    window and the "entering" byte is added at the end. */
+
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+//////////////
+
+//! A collection of signatures, such as all those for one transfer.
+
+class signature_list
+: public structures::amorph<file_signature>, public virtual basis::packable
+{
+public:
+  DEFINE_CLASS_NAME("signature_list");
+
+  const file_signature *find(const basis::astring &name) const;
+    //!< locates the signature for the file called "name", if there is one.
+
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+//////////////
+
+//! Sends files as deltas against the signatures provided by the receiver.
+/*!
+  This is used by heavy_file_operations::buffer_files() for any file that
+  has a signature.  The first time a file is reached, it is read completely
+  to find the blocks that the receiver already has; after that, the pieces
+  are produced from that plan without any further searching.
+*/
+
+class delta_source : public virtual basis::root_object
+{
+public:
+  delta_source();
+  virtual ~delta_source();
+
+  DEFINE_CLASS_NAME("delta_source");
+
+  void add(file_signature *to_add);
+    //!< takes over the signature "to_add" for use in later transfers.
+    /*!< any previous signature for the same file is replaced. */
+
+  const signature_list &signatures() const { return *_signatures; }
+    //!< the files that will be sent as deltas.
+
+  bool covers(const basis::astring &name) const;
+    //!< returns true if the file called "name" will be sent as a delta.
+
+  basis::outcome fill(const basis::astring &full_file,
+          file_transfer_header &last_action, basis::byte_array &storage,
+          int room, bool &finished);
+    //!< adds the next piece of the delta for "full_file" to the "storage".
+    /*!< the "last_action" names the file (and is packed as the piece's
+    header), and at most "room" bytes are added for the piece.  when the
+    final piece of the file has been stored, "finished" is set to true.
+    any failure means the file can't be sent as a delta any more, and the
+    caller should abandon() it. */
+
+  void abandon(file_transfer_header &last_action, basis::byte_array &storage);
+    //!< gives up on sending the file named in "last_action" as a delta.
+    /*!< the file is forgotten, and a piece telling the receiver to throw out
+    its partial copy is added to the "storage".  the "last_action" is left at
+    the start of the file, so the whole file can be sent right after it. */
+
+  void forget(const basis::astring &name);
+    //!< stops sending the file called "name" as a delta.
+
+  double copied_bytes() const { return _copied; }
+    //!< how many bytes were sent as instructions to copy existing blocks.
+  double literal_bytes() const { return _literal; }
+    //!< how many bytes had to be sent as they are.
+
+private:
+  signature_list *_signatures;  //!< the receiver's signatures.
+  delta_plan *_plan;  //!< how the current file is being sent.
+  double _copied;  //!< bytes that the receiver copied itself.
+  double _literal;  //!< bytes that we sent across.
+
+  // not appropriate.
+  delta_source(const delta_source &);
+  delta_source &operator =(const delta_source &);
+};
+
+//////////////
+
+//! Rebuilds files on the receiving side from the pieces a delta_source made.
+
+class delta_target : public virtual basis::root_object
+{
+public:
+  virtual ~delta_target();
+
+  DEFINE_CLASS_NAME("delta_target");
+
+  static const char *partial_suffix();
+    //!< added to the file's name while the new copy is being built.
+
+  static basis::outcome apply_piece(const basis::astring &target_file,
+          double byte_start, basis::byte_array &piece, bool &finished);
+    //!< applies the "piece" of a delta to the "target_file".
+    /*!< the "byte_start" comes from the piece's header; a piece starting
+    at zero begins a new copy of the file.  when the final piece arrives, the
+    new copy is checked against the sender's hash and then replaces the
+    "target_file", and "finished" is set to true.  if the check fails, the
+    old file is left alone and common::FAILURE is returned.  a piece made by
+    delta_source::abandon() returns common::INCOMPLETE, which means the whole
+    file is being sent instead.  the partial copy never outlives a failure. */
+};
+
+} //namespace.
+
+#endif
+
@@ -23,6 +23,8 @@
 #include <structures/object_packers.h>
 
 #include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #define DEBUG_FILE_INFO
   // uncomment for noisy version.
@@ -35,11 +37,15 @@ using namespace structures;
 
 namespace filesystem {
 
+const int HAS_CONTENT_HASH = 0x2;
+  // flags the packed form when the content hash follows the checksum.
+
 file_info::file_info()
 : filename(astring::empty_string()),
   _file_size(0),
   _time(),
   _checksum(),
+  _content_hash(0),
   c_secondary(),
   c_attachment()
 {}
@@ -50,6 +56,7 @@ file_info::file_info(const filename &to_copy, double file_size,
   _file_size(file_size),
   _time(time),
   _checksum(checksum),
+  _content_hash(0),
   c_secondary(),
   c_attachment()
 {}
@@ -59,6 +66,7 @@ file_info::file_info(const file_info &to_copy)
   _file_size(to_copy._file_size),
   _time(to_copy._time),
   _checksum(to_copy._checksum),
+  _content_hash(to_copy._content_hash),
   c_secondary(to_copy.c_secondary),
   c_attachment(to_copy.c_attachment)
 {
@@ -90,20 +98,19 @@ bool file_info::calculate(const astring &prefix, bool just_size, int checksum_ed
   filename full;
   if (prefix.t()) full = prefix + "/" + *this;
   else full = *this;
-  if (!full.exists()) {
+  // one stat tells us whether the file is there, its time and its size.
+  struct stat status;
+  if (stat(full.raw().s(), &status)) {
 #ifdef DEBUG_FILE_INFO
     LOG(astring("failed to find file: ") + full.raw());
 #endif
     return false;
   }
-  // get time again.
-  _time = file_time(full);
-
-//#ifdef DEBUG_FILE_INFO
-//  astring temptext;
-//  _time.text_form(temptext);
-//  LOG(astring("file calculate on ") + full.raw() + " time=" + temptext);
-//#endif
+  _time = file_time(status.st_mtime);
+  _file_size = double(status.st_size);
+  _content_hash = 0;  // any previous hash may no longer be accurate.
+  if (just_size)
+    return true;  // done for that case; no need to open the file.
 
   // open the file for reading.
   huge_file to_read(full.raw(), "rb");
@@ -113,10 +120,6 @@ bool file_info::calculate(const astring &prefix, bool just_size, int checksum_ed
 #endif
     return false;  // why did that happen?
   }
-  // set the size appropriately.
-  _file_size = to_read.length();
-  if (just_size)
-    return true;  // done for that case.
 
   // now read the file and compute a checksum.
   uint16 curr_sum = 0;  // the current checksum being computed.
@@ -185,6 +188,7 @@ int file_info::packed_size() const
       + structures::packed_size(_file_size)
       + _time.packed_size()
       + PACKED_SIZE_INT32
+      + (_content_hash? 2 * PACKED_SIZE_INT32 : 0)
       + c_secondary.packed_size()
       + structures::packed_size(c_attachment);
 }
@@ -192,17 +196,23 @@ int file_info::packed_size() const
 void file_info::pack(byte_array &packed_form) const
 {
   FUNCDEF("pack");
-  filename::pack(packed_form);
+  // the hash is flagged along with the filename and only sent if we have it.
+  pack_flagged(packed_form, _content_hash? HAS_CONTENT_HASH : 0);
   attach(packed_form, _file_size);
   _time.pack(packed_form);
   attach(packed_form, _checksum);
+  if (_content_hash) {
+    attach(packed_form, un_int(_content_hash >> 32));
+    attach(packed_form, un_int(_content_hash));
+  }
   c_secondary.pack(packed_form);
   attach(packed_form, c_attachment);
 }
 
 bool file_info::unpack(byte_array &packed_form)
 {
-  if (!filename::unpack(packed_form))
+  int flags;
+  if (!unpack_flagged(packed_form, flags))
     return false;
   if (!detach(packed_form, _file_size))
     return false;
@@ -210,6 +220,13 @@ bool file_info::unpack(byte_array &packed_form)
     return false;
   if (!detach(packed_form, _checksum))
     return false;
+  _content_hash = 0;
+  if (flags & HAS_CONTENT_HASH) {
+    un_int hash_high, hash_low;
+    if (!detach(packed_form, hash_high) || !detach(packed_form, hash_low))
+      return false;
+    _content_hash = (checksums::wide_hash(hash_high) << 32) | hash_low;
+  }
   if (!c_secondary.unpack(packed_form))
     return false;
   if (!detach(packed_form, c_attachment))
@@ -227,6 +244,7 @@ file_info &file_info::operator = (const file_info &to_copy)
   _file_size = to_copy._file_size;
   c_secondary = to_copy.c_secondary;
   _checksum = to_copy._checksum;
+  _content_hash = to_copy._content_hash;
   return *this;
 }
 
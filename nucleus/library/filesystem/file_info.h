@@ -20,6 +20,7 @@
 
 #include <basis/definitions.h>
 #include <basis/enhance_cpp.h>
+#include <structures/checksums.h>
 
 namespace filesystem {
 
@@ -34,12 +35,19 @@ public:
     EQUAL_CHECKSUM = 0x1,   // the files have the same checksum, however computed.
     EQUAL_TIMESTAMP = 0x2,  // the files have exactly equal timestamps.
     EQUAL_FILESIZE = 0x4,   // the files have the same sizes.
+    EQUAL_CONTENT = 0x8,    // the files have the same full content hash.
     EQUAL_CHECKSUM_TIMESTAMP_FILESIZE = EQUAL_CHECKSUM & EQUAL_TIMESTAMP & EQUAL_FILESIZE
   };
 
   double _file_size;  //!< the size of the file.
   file_time _time;  //!< the file's access time.
   int _checksum;  //!< the checksum for the file.
+  structures::checksums::wide_hash _content_hash;
+    //!< a strong hash over the whole file, or zero if it hasn't been computed.
+    /*!< calculate() does not fill this in, since it means reading the entire
+    file.  see content_hash and processes::file_hasher.  the hash is only
+    packed when it's been computed, so file_infos without one keep the same
+    packed form as versions that predate it. */
 
   file_info();  //!< blank constructor.
 
@@ -38,21 +38,13 @@ using namespace basis;
 
 namespace filesystem {
 
-file_time::file_time() : _when(0) { reset(""); } 
+file_time::file_time() : _when(0) {}
 
 file_time::file_time(FILE *the_FILE) : _when(0) { reset(the_FILE); }
 
 file_time::file_time(const time_t &t) : _when(t) {}
 
-file_time::file_time(const astring &filename)
-: _when(0)
-{
-  FILE *ptr = fopen(filename.s(), "r");
-  if (ptr) {
-    reset(ptr);
-    fclose(ptr);
-  }
-}
+file_time::file_time(const astring &filename) : _when(0) { reset(filename); }
 
 file_time::~file_time() {}
 
@@ -70,11 +62,10 @@ void file_time::reset(const time_t &t) { _when = t; }
 
 void file_time::reset(const astring &filename)
 {
-  FILE *ptr = fopen(filename.s(), "r");
-  if (ptr) {
-    reset(ptr);
-    fclose(ptr);
-  }
+  // a stat is all we need; there's no reason to open the file.
+  struct stat stat_buffer;
+  if (!filename || stat(filename.s(), &stat_buffer)) return;
+  _when = stat_buffer.st_mtime;
 }
 
 void file_time::reset(FILE *the_FILE_in)
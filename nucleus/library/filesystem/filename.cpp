@@ -463,17 +463,27 @@ int filename::packed_size() const
 }
 
 void filename::pack(byte_array &packed_form) const
+{ pack_flagged(packed_form, 0); }
+
+bool filename::unpack(byte_array &packed_form)
+{
+  int flags;
+  return unpack_flagged(packed_form, flags);
+}
+
+void filename::pack_flagged(byte_array &packed_form, int flags) const
 {
-  attach(packed_form, int(_had_directory));
+  attach(packed_form, int(_had_directory) | (flags & ~0x1));
   astring::pack(packed_form);
 }
 
-bool filename::unpack(byte_array &packed_form)
+bool filename::unpack_flagged(byte_array &packed_form, int &flags)
 {
   int temp;
   if (!detach(packed_form, temp))
     return false;
-  _had_directory = temp;
+  _had_directory = temp & 0x1;
+  flags = temp & ~0x1;
   if (!astring::unpack(packed_form))
     return false;
   return true;
@@ -225,6 +225,14 @@ public:
   virtual bool unpack(basis::byte_array &packed_form);
   virtual int packed_size() const;
 
+  void pack_flagged(basis::byte_array &packed_form, int flags) const;
+    //!< packs like pack() does, but also stores some "flags" for derived types.
+    /*!< the flags share the integer that records whether a directory was
+    given, so they must leave the lowest bit alone.  with no flags, the
+    packed form is exactly what pack() makes. */
+  bool unpack_flagged(basis::byte_array &packed_form, int &flags);
+    //!< undoes pack_flagged(), returning any "flags" that were stored.
+
   bool compare_prefix(const filename &to_compare, basis::astring &sequel);
     //!< examines "this" filename to see if it's a prefix of "to_compare".
     /*!< this returns true if all of "this" is the same as the first portion
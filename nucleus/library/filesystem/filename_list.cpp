@@ -146,6 +146,8 @@ bool filename_list::member_with_state(const file_info &to_check, file_info::file
         return false;
       if ((how & file_info::EQUAL_CHECKSUM) && (to_check._checksum != get(i)->_checksum) )
         return false;
+      if ((how & file_info::EQUAL_CONTENT) && (to_check._content_hash != get(i)->_content_hash) )
+        return false;
       return true;
     }
   }
@@ -0,0 +1,210 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : hash_cache                                                        *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "byte_filer.h"
+#include "filename.h"
+#include "hash_cache.h"
+
+#include <basis/functions.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/object_packers.h>
+#include <structures/string_array.h>
+#include <structures/string_hash.h>
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+
+namespace filesystem {
+
+//#define DEBUG_HASH_CACHE
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const char *SIDECAR_SIGNATURE = "hash_cache_1";
+  // marks the start of a sidecar file, and changes if the format does.
+
+const int EXPECTED_FILES = 10000;
+  // a rough guess at how many files the cache will remember.
+
+//////////////
+
+class cache_entry
+{
+public:
+  content_hash::wide_hash _hash;
+  bool _used;  // true if this entry was touched since loading.
+
+  cache_entry(content_hash::wide_hash hash = 0, bool used = false)
+  : _hash(hash), _used(used) {}
+};
+
+class hash_cache_table : public string_hash<cache_entry>
+{
+public:
+  hash_cache_table() : string_hash<cache_entry>(EXPECTED_FILES) {}
+};
+
+//////////////
+
+// these are used with the table's apply() method.
+
+bool pack_entry(const astring &key, cache_entry &current, void *data_link)
+{
+  byte_array &packed_form = *(byte_array *)data_link;
+  key.pack(packed_form);
+  attach(packed_form, un_int(current._hash >> 32));
+  attach(packed_form, un_int(current._hash));
+  return true;
+}
+
+bool find_unused(const astring &key, cache_entry &current, void *data_link)
+{
+  if (!current._used) *(string_array *)data_link += key;
+  return true;
+}
+
+//////////////
+
+hash_cache::hash_cache(const astring &sidecar)
+: _sidecar(new astring(sidecar)),
+  _table(new hash_cache_table)
+{
+  if (_sidecar->t() && filename(*_sidecar).exists()) load();
+}
+
+hash_cache::~hash_cache()
+{
+  WHACK(_table);
+  WHACK(_sidecar);
+}
+
+const astring &hash_cache::sidecar() const { return *_sidecar; }
+
+int hash_cache::elements() const { return _table->elements(); }
+
+bool hash_cache::identity(const astring &path, astring &id)
+{
+  double size;
+  return identity(path, id, size);
+}
+
+bool hash_cache::identity(const astring &path, astring &id, double &size)
+{
+  struct stat status;
+  if (stat(path.s(), &status)) return false;
+#ifdef __LINUX__
+  // the nanoseconds catch files rewritten within the same second.
+  long nanoseconds = status.st_mtim.tv_nsec;
+#else
+  long nanoseconds = 0;
+#endif
+  // astring's formatting doesn't handle long longs, so the C library does it.
+  char printed[120];
+  snprintf(printed, sizeof(printed), "%llx:%llx:%llx:%llx.%lx",
+      (unsigned long long)status.st_dev, (unsigned long long)status.st_ino,
+      (unsigned long long)status.st_size, (unsigned long long)status.st_mtime,
+      nanoseconds);
+  id = printed;
+  size = double(status.st_size);
+  return true;
+}
+
+bool hash_cache::lookup(const astring &id, wide_hash &hash)
+{
+  cache_entry *found = _table->find(id);
+  if (!found) return false;
+  found->_used = true;
+  hash = found->_hash;
+  return true;
+}
+
+void hash_cache::store(const astring &id, wide_hash hash)
+{
+  _table->add(id, new cache_entry(hash, true));
+}
+
+int hash_cache::forget_unused()
+{
+  string_array unused;
+  _table->apply(find_unused, &unused);
+  for (int i = 0; i < unused.length(); i++) _table->zap(unused[i]);
+  return unused.length();
+}
+
+bool hash_cache::load()
+{
+  FUNCDEF("load");
+  if (!*_sidecar) return false;
+  byte_filer in(*_sidecar, "rb");
+  if (!in.good()) return false;
+  byte_array packed_form;
+  in.read(packed_form, int(in.length()));
+  in.close();
+
+  astring signature;
+  int count;
+  if (!signature.unpack(packed_form) || (signature != astring(SIDECAR_SIGNATURE))
+      || !detach(packed_form, count)) {
+    LOG(astring("ignoring sidecar with the wrong format: ") + *_sidecar);
+    return false;
+  }
+  _table->reset();
+  for (int i = 0; i < count; i++) {
+    astring id;
+    un_int high, low;
+    if (!id.unpack(packed_form) || !detach(packed_form, high)
+        || !detach(packed_form, low)) {
+      LOG(astring("sidecar was truncated: ") + *_sidecar);
+      return false;
+    }
+    _table->add(id, new cache_entry((wide_hash(high) << 32) | low));
+  }
+#ifdef DEBUG_HASH_CACHE
+  LOG(a_sprintf("loaded %d hashes from ", count) + *_sidecar);
+#endif
+  return true;
+}
+
+bool hash_cache::save()
+{
+  FUNCDEF("save");
+  if (!*_sidecar) return false;
+  byte_array packed_form;
+  astring(SIDECAR_SIGNATURE).pack(packed_form);
+  attach(packed_form, _table->elements());
+  _table->apply(pack_entry, &packed_form);
+
+  // write to a temporary file first and then swap it into place.
+  astring temporary = *_sidecar + ".new";
+  byte_filer out(temporary, "wb");
+  if (!out.good()) return false;
+  bool worked = out.write(packed_form) == packed_form.length();
+  out.close();
+  if (!worked || rename(temporary.s(), _sidecar->s())) {
+    LOG(astring("failed to save the sidecar: ") + *_sidecar);
+    filename(temporary).unlink();
+    return false;
+  }
+  return true;
+}
+
+} //namespace.
+
@@ -0,0 +1,94 @@
+#ifndef HASH_CACHE_CLASS
+#define HASH_CACHE_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : hash_cache                                                        *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "content_hash.h"
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+
+namespace filesystem {
+
+// forward.
+class hash_cache_table;
+
+//! Remembers the content hashes of files so unchanged files are never re-read.
+/*!
+  Each hash is recorded under the file's identity, which is made from its
+  device, inode, size and modification time.  Any change to the file gives
+  it a new identity, so a stale hash can't be found.  Since the path isn't
+  part of the identity, renamed or moved files still hit the cache.  The
+  cache can be kept in a "sidecar" file between runs.  This class is not
+  thread-safe.
+*/
+
+class hash_cache : public virtual basis::root_object
+{
+public:
+  typedef content_hash::wide_hash wide_hash;
+
+  hash_cache(const basis::astring &sidecar = basis::astring::empty_string());
+    //!< creates a cache that is stored in the "sidecar" file.
+    /*!< if the "sidecar" is empty, then the cache only lives in memory.
+    otherwise, the sidecar is loaded now if it exists. */
+
+  virtual ~hash_cache();
+
+  DEFINE_CLASS_NAME("hash_cache");
+
+  const basis::astring &sidecar() const;  //!< where the cache is stored.
+
+  int elements() const;  //!< the number of hashes remembered.
+
+  static bool identity(const basis::astring &path, basis::astring &id);
+    //!< fills "id" with the identity of the file at "path".
+    /*!< false is returned if the file can't be examined. */
+  static bool identity(const basis::astring &path, basis::astring &id,
+          double &size);
+    //!< like identity() above, but also reports the "size" of the file.
+
+  bool lookup(const basis::astring &id, wide_hash &hash);
+    //!< finds the "hash" recorded for the file identity "id".
+
+  void store(const basis::astring &id, wide_hash hash);
+    //!< records the "hash" for the file identity "id".
+
+  int forget_unused();
+    //!< drops every entry that wasn't looked up or stored since loading.
+    /*!< this keeps the sidecar from collecting the identities of files
+    that have changed or been deleted.  it only makes sense after all of the
+    files of interest have been visited.  the number dropped is returned. */
+
+  bool load();
+    //!< reads the sidecar file, replacing what's in memory.
+  bool save();
+    //!< writes the cache out to the sidecar file.
+    /*!< the file is replaced in one step, so a crash can't leave a partial
+    sidecar behind. */
+
+private:
+  basis::astring *_sidecar;  //!< the file where we're stored.
+  hash_cache_table *_table;  //!< the remembered hashes.
+
+  // not appropriate.
+  hash_cache(const hash_cache &);
+  hash_cache &operator =(const hash_cache &);
+};
+
+} //namespace.
+
+#endif
+
@@ -13,6 +13,7 @@
 \*****************************************************************************/
 
 #include "directory.h"
+#include "file_delta.h"
 #include "filename.h"
 #include "filename_list.h"
 #include "heavy_file_ops.h"
@@ -22,6 +23,19 @@
 #include <basis/guards.h>
 #include <structures/object_packers.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef __UNIX__
+  #include <unistd.h>
+#endif
+#ifdef __LINUX__
+  #include <linux/fs.h>
+  #include <sys/ioctl.h>
+  #include <sys/sendfile.h>
+#endif
+
 using namespace basis;
 using namespace structures;
 
@@ -39,6 +53,12 @@ namespace filesystem {
 // the smallest we let the packing area's available space get before we stop filling it.
 const int MINIMUM_ARRAY_SIZE = 1024;
 
+#ifdef __LINUX__
+// the most we ask the kernel to copy in one call, so huge files still make
+// steady progress without overflowing the return value.
+const size_t KERNEL_COPY_LIMIT = size_t(1) * size_t(GIGABYTE);
+#endif
+
 //////////////
 
 file_transfer_header::file_transfer_header(const file_time &time_stamp)
@@ -132,24 +152,31 @@ outcome heavy_file_operations::copy_file(const astring &source,
   filename targ_dir = target_path.dirname();
   if (!directory::recursive_create(targ_dir.raw())) return TARGET_DIR_ERROR;
 
-  // open the source for reading.
-  huge_file source_file(source, "rb");
-  if (!source_file.good()) return SOURCE_MISSING;
+  copy_methods method_used;
+  outcome ret = kernel_copy(source, destination, method_used);
+  if (ret == common::NOT_IMPLEMENTED) {
+    // the kernel couldn't do it for us, so we'll shovel the bytes ourselves.
+    huge_file source_file(source, "rb");
+    if (!source_file.good()) return SOURCE_MISSING;
 //hmmm: could be source is not accessible instead.
+    source_file.advise(huge_file::SEQUENTIAL_ACCESS);
 
-  // open target file for writing.
-  huge_file target_file(destination, "wb");
-  if (!target_file.good()) return TARGET_ACCESS_ERROR;
+    // open target file for writing.
+    huge_file target_file(destination, "wb");
+    if (!target_file.good()) return TARGET_ACCESS_ERROR;
 
-  byte_array chunk;
-  int bytes_read = 0;
-  outcome ret;
-  while ( (ret = source_file.read(chunk, copy_chunk_factor, bytes_read))
-      == huge_file::OKAY) {
-    int bytes_stored;
-    ret = target_file.write(chunk, bytes_stored);
-    if (bytes_stored != bytes_read) return TARGET_ACCESS_ERROR;
-    if (source_file.eof()) break;  // time to escape.
+    byte_array chunk;
+    int bytes_read = 0;
+    while ( (ret = source_file.read(chunk, copy_chunk_factor, bytes_read))
+        == huge_file::OKAY) {
+      int bytes_stored;
+      ret = target_file.write(chunk, bytes_stored);
+      if (bytes_stored != bytes_read) return TARGET_ACCESS_ERROR;
+      // a short read means we hit the end, since huge_file reads fully.
+      if (bytes_read < copy_chunk_factor) break;
+    }
+  } else if (ret != OKAY) {
+    return ret;
   }
 
   // set the time on the target file from the source's time.
@@ -164,9 +191,87 @@ outcome heavy_file_operations::copy_file(const astring &source,
   return OKAY;
 }
 
+#ifndef __LINUX__
+outcome heavy_file_operations::kernel_copy(const astring &formal(source),
+    const astring &formal(destination), copy_methods &method_used)
+#else
+outcome heavy_file_operations::kernel_copy(const astring &source,
+    const astring &destination, copy_methods &method_used)
+#endif
+{
+  FUNCDEF("kernel_copy");
+  method_used = BUFFERED_COPY;
+#ifndef __LINUX__
+  return common::NOT_IMPLEMENTED;  // no kernel support for this here.
+#else
+  int source_fd = open(source.s(), O_RDONLY);
+  if (source_fd < 0) return SOURCE_MISSING;
+  struct stat status;
+  if (fstat(source_fd, &status) || !S_ISREG(status.st_mode)
+      || !status.st_size) {
+    // files that claim to be empty may still have contents (such as the ones
+    // in /proc), so those are left for a real read.
+    close(source_fd);
+    return common::NOT_IMPLEMENTED;
+  }
+  int target_fd = open(destination.s(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (target_fd < 0) {
+    close(source_fd);
+    return TARGET_ACCESS_ERROR;
+  }
+
+  outcome to_return = common::NOT_IMPLEMENTED;
+#ifdef FICLONE
+  // a clone is nearly free on filesystems that can share blocks.
+  if (!ioctl(target_fd, FICLONE, source_fd)) {
+    method_used = REFLINK_COPY;
+    to_return = OKAY;
+  }
+#endif
+
+  off_t remaining = status.st_size;
+  off_t copied = 0;
+  // try copy_file_range first since it can do server-side copies on network
+  // filesystems, and then sendfile.  either one may bail out right away if
+  // the files don't support it, in which case we try the next approach.
+  for (int approach = 0; (to_return != OKAY) && (approach < 2); approach++) {
+    while (remaining > 0) {
+      size_t request = size_t(minimum(off_t(KERNEL_COPY_LIMIT), remaining));
+      ssize_t ret;
+      if (!approach)
+        ret = copy_file_range(source_fd, NULL_POINTER, target_fd,
+            NULL_POINTER, request, 0);
+      else
+        ret = sendfile(target_fd, source_fd, NULL_POINTER, request);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      if (!ret) break;  // the file must have shrunk on us.
+      copied += ret;
+      remaining -= ret;
+    }
+    if (!remaining || (copied && (remaining > 0))) {
+      // either we finished, or we got part way and can't pick up the pieces.
+      if (remaining > 0) {
+        LOG(astring("kernel copy failed part way through: ") + source);
+        to_return = TARGET_ACCESS_ERROR;
+        break;
+      }
+      method_used = KERNEL_COPY;
+      to_return = OKAY;
+    }
+  }
+
+  close(source_fd);
+  close(target_fd);
+  return to_return;
+#endif
+}
+
 outcome heavy_file_operations::write_file_chunk(const astring &target,
     double byte_start, const byte_array &chunk, bool truncate,
-    int copy_chunk_factor)
+    int formal(copy_chunk_factor))
 {
   FUNCDEF("write_file_chunk");
   if (byte_start < 0) return BAD_INPUT;
@@ -188,23 +293,11 @@ outcome heavy_file_operations::write_file_chunk(const astring &target,
   huge_file target_file(target, "r+b");
     // open the file for updating (either read or write).
   if (!target_file.good()) return TARGET_ACCESS_ERROR;
-  double curr_len = target_file.length();
   target_file.touch();
 
-  if (curr_len < byte_start) {
-    byte_array new_chunk;
-    while (curr_len < byte_start) {
-      target_file.seek(0, byte_filer::FROM_END);  // go to the end of the file.
-      new_chunk.reset(minimum(copy_chunk_factor,
-          int(curr_len - byte_start + 1)));
-      int written;
-      outcome ret = target_file.write(new_chunk, written);
-      if (written < new_chunk.length()) return TARGET_ACCESS_ERROR;
-      curr_len = target_file.length();
-    }
-  }
+  // writing past the end fills any gap with zeros for us, so the chunk can
+  // simply be stored at its proper location.
   target_file.seek(byte_start, byte_filer::FROM_START);
-    // jump to the proper location in the file.
   int wrote;
   outcome ret = target_file.write(chunk, wrote);
   if (wrote != chunk.length()) return TARGET_ACCESS_ERROR;
@@ -237,7 +330,7 @@ basis::outcome heavy_file_operations::advance(const filename_list &to_transfer,
 
 outcome heavy_file_operations::buffer_files(const astring &source_root,
     const filename_list &to_transfer, file_transfer_header &last_action,
-    byte_array &storage, int maximum_bytes)
+    byte_array &storage, int maximum_bytes, delta_source *deltas)
 {
   FUNCDEF("buffer_files");
   storage.reset();  // clear out the current contents.
@@ -281,6 +374,30 @@ outcome heavy_file_operations::buffer_files(const astring &source_root,
     }
 
     astring full_file = source_root + "/" + last_action._filename;
+
+    if (deltas && deltas->covers(last_action._filename)) {
+      // this file goes across as changes against the receiver's copy.
+      bool finished;
+      int size_before = storage.length();
+      outcome ret = deltas->fill(full_file, last_action, storage,
+          int(remaining_in_array), finished);
+      if (ret != OKAY) {
+        // the receiver is told to drop its partial copy, and then the whole
+        // file is sent from the start, since it's no longer a delta.
+        LOG(astring("sending whole file after delta failed: ") + full_file);
+        deltas->abandon(last_action, storage);
+        fresh_file = true;
+        continue;
+      } else if (!finished) {
+        if (storage.length() == size_before) break;  // no room left.
+        continue;
+      }
+      fresh_file = true;
+      to_return = advance(to_transfer, last_action);
+      if (to_return != OKAY) break;
+      continue;
+    }
+
     huge_file current(full_file, "rb");
     if (!current.good()) {
       // we need to skip this file.
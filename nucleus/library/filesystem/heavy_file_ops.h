@@ -22,6 +22,9 @@
 
 namespace filesystem {
 
+// forward.
+class delta_source;
+
 //! describes one portion of an ongoing file transfer.
 /*! this is just a header describing an attached byte package.  it is expected
 that the bytes follow this in the communication stream. */
@@ -84,7 +87,23 @@ public:
           int copy_chunk_factor = heavy_file_operations::copy_chunk_factor());
     //!< copies a file from the "source" location to the "destination".
     /*!< the outcomes could be from this class or from common::outcomes.
-    the "copy_chunk_factor" is the read buffer size to use while copying. */
+    the "copy_chunk_factor" is the read buffer size to use while copying.
+    the copy is done by the OS kernel with kernel_copy() when possible, and
+    only falls back to reading and writing the file here if that fails. */
+
+  enum copy_methods {
+    REFLINK_COPY,  //!< the target shares the source's blocks until changed.
+    KERNEL_COPY,  //!< the bytes were copied without leaving the kernel.
+    BUFFERED_COPY  //!< the bytes were read into memory and written back out.
+  };
+
+  static basis::outcome kernel_copy(const basis::astring &source,
+          const basis::astring &destination, copy_methods &method_used);
+    //!< copies "source" to "destination" without passing through user space.
+    /*!< a reflink clone is tried first, then copy_file_range, and finally
+    sendfile.  NOT_IMPLEMENTED is returned if none of those are supported
+    for these files (or on this OS); the caller must then copy the bytes
+    itself.  this does not create the target's directory or set its time. */
 
   static basis::outcome write_file_chunk(const basis::astring &target, double byte_start,
           const basis::byte_array &chunk, bool truncate = true,
@@ -100,12 +119,17 @@ public:
 
   static basis::outcome buffer_files(const basis::astring &source_root,
           const filename_list &to_transfer, file_transfer_header &last_action,
-          basis::byte_array &storage, int maximum_bytes);
+          basis::byte_array &storage, int maximum_bytes,
+          delta_source *deltas = NULL_POINTER);
     //!< reads files in "to_transfer" and packs them into a "storage" buffer.
     /*!< the maximum size allowed in storage is "maximum_bytes".  the record
     of the last file piece stored in "last_action" allows the next chunk
     to be sent in subsequent calls.  note that the buffer "storage" is cleared
-    out before bytes are stored into it; this is not an additive operation. */
+    out before bytes are stored into it; this is not an additive operation.
+    if "deltas" is provided, then any file it covers is sent as a delta
+    against the receiver's copy instead (see delta_source); the receiver
+    must pass those pieces to delta_target rather than write_file_chunk.
+    a file whose delta can't be produced is abandoned and then sent whole. */
 
 private:
   static basis::outcome advance(const filename_list &to_transfer,
@@ -20,12 +20,23 @@
 #include <basis/guards.h>
 #include <application/windoze_helper.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 //#ifndef __WIN32__
 #include <sys/time.h>
 //#else
 //  #include <time.h>
 //#endif
+#ifdef __UNIX__
+  #include <unistd.h>
+#endif
+#ifdef __WIN32__
+  #include <io.h>
+#endif
 
 #undef LOG
 #define LOG(to_print) printf("%s::%s: %s\n", static_class_name(), func, astring(to_print).s())
@@ -37,10 +48,74 @@ using namespace basis;
 
 namespace filesystem {
 
+// these perform a single positional transfer on the descriptor, returning
+// the number of bytes processed or a negative number on failure.  neither of
+// them moves the OS file position, so they can run concurrently.
+
+#ifdef __UNIX__
+static int positional_read(int fd, abyte *buffer, int size,
+    huge_file::file_offset where)
+{
+  ssize_t ret;
+  do {
+    ret = ::pread(fd, buffer, size_t(size), off_t(where));
+  } while ( (ret < 0) && (errno == EINTR) );
+  return int(ret);
+}
+
+static int positional_write(int fd, const abyte *buffer, int size,
+    huge_file::file_offset where)
+{
+  ssize_t ret;
+  do {
+    ret = ::pwrite(fd, buffer, size_t(size), off_t(where));
+  } while ( (ret < 0) && (errno == EINTR) );
+  return int(ret);
+}
+#elif defined(__WIN32__)
+static int positional_read(int fd, abyte *buffer, int size,
+    huge_file::file_offset where)
+{
+  OVERLAPPED spot;
+  memset(&spot, 0, sizeof(spot));
+  spot.Offset = DWORD(where & 0xFFFFFFFF);
+  spot.OffsetHigh = DWORD(where >> 32);
+  DWORD processed = 0;
+  if (!ReadFile((HANDLE)_get_osfhandle(fd), buffer, DWORD(size), &processed,
+      &spot)) {
+    // reading at or past the end is not an error for us.
+    return GetLastError() == ERROR_HANDLE_EOF? 0 : -1;
+  }
+  return int(processed);
+}
+
+static int positional_write(int fd, const abyte *buffer, int size,
+    huge_file::file_offset where)
+{
+  OVERLAPPED spot;
+  memset(&spot, 0, sizeof(spot));
+  spot.Offset = DWORD(where & 0xFFFFFFFF);
+  spot.OffsetHigh = DWORD(where >> 32);
+  DWORD processed = 0;
+  if (!WriteFile((HANDLE)_get_osfhandle(fd), buffer, DWORD(size), &processed,
+      &spot))
+    return -1;
+  return int(processed);
+}
+#endif
+
+//////////////
+
 huge_file::huge_file(const astring &filename, const astring &permissions)
 : _real_file(new byte_filer(filename, permissions)),
-  _file_pointer(0)
+  _descriptor(-1),
+  _appending(permissions.find('a') >= 0),
+  _position(0)
 {
+  // we only borrow the stdio file for its descriptor.  none of our I/O goes
+  // through the stdio buffers, so they can never hold stale data.
+  if (_real_file->good())
+    _descriptor = fileno((FILE *)_real_file->file_handle());
 }
 
 huge_file::~huge_file()
@@ -50,243 +125,144 @@ huge_file::~huge_file()
 
 const astring &huge_file::name() const { return _real_file->name(); }
 
-void huge_file::flush() { _real_file->flush(); }
+bool huge_file::good() const { return _descriptor >= 0; }
 
-bool huge_file::truncate() { return _real_file->truncate(); }
+void huge_file::flush() { _real_file->flush(); }
 
-double huge_file::length()
+huge_file::file_offset huge_file::size() const
 {
-  FUNCDEF("length");
-
-//trying to read to see if we're past endpoint.
-//  if this approach works, length may want to close and reopen file for
-//  reading, since we can't add any bytes to it for writing just to find
-//  the length out.
-
-
-  double save_posn = _file_pointer;
-  // skip to the beginning of the file so we can try to find the end.
-  _file_pointer = 0;
-  _real_file->seek(0, byte_filer::FROM_START);
-  size_t naive_size = _real_file->length();
-  if (naive_size < _real_file->file_size_limit()) {
-    // lucked out; we are within normal file size limitations.
-    seek(save_posn, byte_filer::FROM_START);
-    return double(naive_size);
-  }
-  
-  double best_highest = 0.0;  // the maximum we've safely seeked to.
+  if (!good()) return 0;
+#ifdef __WIN32__
+  struct _stati64 status;
+  if (_fstati64(_descriptor, &status)) return 0;
+#else
+  struct stat status;
+  if (fstat(_descriptor, &status)) return 0;
+#endif
+  return file_offset(status.st_size);
+}
 
-  size_t big_jump = byte_filer::file_size_limit();
-    // try with the largest possible seek at first.
+double huge_file::length() { return double(size()); }
 
-  while (true) {
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("best highest=%.0f", best_highest));
-#endif
-    // iterate until we reach our exit condition, which seems like it must
-    // always occur eventually unless the file is being monkeyed with.
-    bool seek_ret = _real_file->seek(int(big_jump), byte_filer::FROM_CURRENT);
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  seek ret=%d", int(seek_ret)));
-#endif
-    byte_array temp_bytes;
-    int bytes_read = _real_file->read(temp_bytes, 1);
-    if (bytes_read < 1)
-      seek_ret = false;
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  read %d bytes", bytes_read));
-#endif
-    bool at_eof = _real_file->eof();
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  at_eof=%d", int(at_eof)));
-#endif
-    if (seek_ret && !at_eof) {
-#ifdef DEBUG_HUGE_FILE
-      LOG("seek worked, incrementing best highest and trying same jump again");
-#endif
-      // the seek worked, so we'll just jump forward again.
-      best_highest += double(big_jump);
-      _file_pointer += double(big_jump);
-      continue;
-    } else if (seek_ret && at_eof) {
-#ifdef DEBUG_HUGE_FILE
-      LOG("seek worked but found eof exactly.");
-#endif
-      // the seek did worked, but apparently we've also found the end point.
-      best_highest += double(big_jump);
-      _file_pointer += double(big_jump);
-      break;
-    } else {
-      // that seek was too large, so we need to back down and try a smaller
-      // seek size.
-#ifdef DEBUG_HUGE_FILE
-      LOG("seek failed, going back to best highest and trying same jump again");
+bool huge_file::eof() const { return !good() || (_position >= size()); }
+
+bool huge_file::truncate()
+{
+  if (!good()) return false;
+#ifdef __WIN32__
+  return !_chsize_s(_descriptor, _position);
+#else
+  return !ftruncate(_descriptor, off_t(_position));
 #endif
-      _file_pointer = 0;
-      _real_file->seek(0, byte_filer::FROM_START); 
-      outcome worked = seek(best_highest, byte_filer::FROM_START);
-        // this uses our version to position at large sizes.
-      if (worked != OKAY) {
-        // this is a bad failure; it says that the file size changed or
-        // something malfunctioned.  we should always be able to get back to
-        // the last good size we found if the file is static.
-        LOG(a_sprintf("failed to seek back to best highest %.0f on ",
-            best_highest) + _real_file->name());
-        // try to repair our ideas about the file by starting the process
-        // over.
-//hmmm: count the number of times restarted and bail after N.
-        seek_ret = _real_file->seek(0, byte_filer::FROM_START);
-        _file_pointer = 0;
-        if (!seek_ret) {
-          // the heck with this.  we can't even go back to the start.  this
-          // file seems to be screwed up now.
-          LOG(astring("failed to seek back to start of file!  on ")
-              + _real_file->name());
-          return 0;
-        }
-        // reset the rest of the positions for our failed attempt to return
-        // to what we already thought was good.
-        _file_pointer = 0;
-        big_jump = byte_filer::file_size_limit();
-        best_highest = 0;
-        continue;
-      }
-      // okay, nothing bad happened when we went back to our last good point.
-      if (big_jump <= 0) {
-        // success in finding the smallest place that we can't seek between.
-#ifdef DEBUG_HUGE_FILE
-        LOG("got down to smallest big jump, 0!");
+}
+
+#if defined(__UNIX__) && defined(POSIX_FADV_SEQUENTIAL)
+void huge_file::advise(access_patterns pattern, file_offset start,
+    file_offset length)
+{
+  if (!good()) return;
+  int advice = POSIX_FADV_NORMAL;
+  switch (pattern) {
+    case SEQUENTIAL_ACCESS: advice = POSIX_FADV_SEQUENTIAL; break;
+    case RANDOM_ACCESS: advice = POSIX_FADV_RANDOM; break;
+    case DONE_ACCESSING: advice = POSIX_FADV_DONTNEED; break;
+    default: break;
+  }
+  posix_fadvise(_descriptor, off_t(start), off_t(length), advice);
+}
+#else
+void huge_file::advise(access_patterns formal(pattern),
+    file_offset formal(start), file_offset formal(length))
+{}  // nothing to do without fadvise.
 #endif
-        break;
-      }
-      // formula expects that the maximum file size is a power of 2.
-      big_jump /= 2;
+
+outcome huge_file::seek_to(file_offset new_position, byte_filer::origins origin)
+{
 #ifdef DEBUG_HUGE_FILE
-      LOG(a_sprintf("restraining big jump down to %u.", big_jump));
+  FUNCDEF("seek_to");
 #endif
-      continue;
-    }
+  file_offset target;
+  switch (origin) {
+    case byte_filer::FROM_START: target = new_position; break;
+    case byte_filer::FROM_CURRENT: target = _position + new_position; break;
+    // note that a positive offset backs up from the end here, which is how
+    // this class has always treated FROM_END.
+    case byte_filer::FROM_END: target = size() - new_position; break;
+    default: return BAD_INPUT;  // unknown origin.
   }
-
-  // go back to where we started out.
-  seek(0, byte_filer::FROM_START);
-  seek(save_posn, byte_filer::FROM_CURRENT);
 #ifdef DEBUG_HUGE_FILE
-  LOG(a_sprintf("saying file len is %.0f.", best_highest + 1.0));
+  LOG(a_sprintf("moving from %lld to %lld", _position, target));
 #endif
-  return best_highest + 1.0;
+  if (target < 0) return BAD_INPUT;
+  _position = target;
+  return OKAY;
 }
 
-bool huge_file::good() const { return _real_file->good(); }
+outcome huge_file::move_to(double absolute_posn)
+{ return seek_to(file_offset(absolute_posn), byte_filer::FROM_START); }
 
-bool huge_file::eof() const { return _real_file->eof(); }
+outcome huge_file::seek(double new_position, byte_filer::origins origin)
+{ return seek_to(file_offset(new_position), origin); }
 
-outcome huge_file::move_to(double absolute_posn)
+outcome huge_file::read_at(file_offset where, byte_array &to_fill,
+    int desired_size, int &size_read) const
 {
-#ifdef DEBUG_HUGE_FILE
-  FUNCDEF("move_to");
-#endif
-  double difference = absolute_posn - _file_pointer;
-    // calculate the size we want to offset.
-#ifdef DEBUG_HUGE_FILE
-  LOG(a_sprintf("abs_pos=%.0f difference=%.0f old_filepoint=%.0f",
-      absolute_posn, difference, _file_pointer));
-#endif
-  // if we're at the same place, we don't have to do anything.
-  if (difference < 0.000001) {
-#ifdef DEBUG_HUGE_FILE
-    LOG("difference was minimal, saying we're done.");
-#endif
-    return OKAY;
+  size_read = 0;
+  if (!good() || (where < 0) || negative(desired_size)) {
+    to_fill.reset();
+    return BAD_INPUT;
   }
-  while (absolute_value(difference) > 0.000001) {
-    double seek_size = minimum(double(byte_filer::file_size_limit() - 1),
-        absolute_value(difference));
-    if (difference < 0)
-      seek_size *= -1.0;  // flip sign of seek.
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  seeksize=%d", int(seek_size)));
-#endif
-    bool seek_ret = _real_file->seek(int(seek_size),
-        byte_filer::FROM_CURRENT);
-    if (!seek_ret) {
-#ifdef DEBUG_HUGE_FILE
-      LOG(a_sprintf("failed to seek %d from current", int(seek_size)));
-#endif
-      return FAILURE;  // seek failed somehow.
+  to_fill.reset(desired_size);
+  // keep going until we have everything, since the OS is allowed to hand us
+  // less than we asked for.
+  while (size_read < desired_size) {
+    int ret = positional_read(_descriptor, to_fill.access() + size_read,
+        desired_size - size_read, where + size_read);
+    if (ret < 0) {
+      to_fill.zap(size_read, to_fill.length() - 1);
+      return FAILURE;  // couldn't read the bytes.
     }
-    _file_pointer += seek_size;
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  now_filepoint=%.0f", _file_pointer));
-#endif
-    difference = absolute_posn - _file_pointer;
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  now_difference=%.0f", difference));
-#endif
+    if (!ret) break;  // hit the end of the file.
+    size_read += ret;
   }
+  to_fill.zap(size_read, to_fill.length() - 1);
   return OKAY;
 }
 
-outcome huge_file::seek(double new_position, byte_filer::origins origin)
+outcome huge_file::write_at(file_offset where, const byte_array &to_write,
+    int &size_written)
 {
-#ifdef DEBUG_HUGE_FILE
-  FUNCDEF("seek");
-#endif
-  if (origin == byte_filer::FROM_CURRENT) {
-    return move_to(_file_pointer + new_position);
-  } else if (origin == byte_filer::FROM_START) {
-    _file_pointer = 0;
-    if (!_real_file->seek(0, byte_filer::FROM_START))
-      return FAILURE;
-    return move_to(new_position);
-  } else if (origin == byte_filer::FROM_END) {
-#ifdef DEBUG_HUGE_FILE
-    LOG("into precarious FROM_END case.");
-#endif
-    double file_len = length();  // could take a scary long time possibly.
-#ifdef DEBUG_HUGE_FILE
-    LOG(a_sprintf("  FROM_END got len %.0f.", file_len));
-#endif
-    _file_pointer = file_len;
-      // it's safe, although not efficient, for us to call the length()
-      // method here.  our current version of length() uses the byte_filer's
-      // seek method directly and only FROM_CURRENT and FROM_START from this
-      // class's seek method.
-    _real_file->seek(0, byte_filer::FROM_END);
-    return move_to(_file_pointer - new_position);
+  size_written = 0;
+  if (!good() || (where < 0)) return BAD_INPUT;
+  while (size_written < to_write.length()) {
+    int ret = positional_write(_descriptor, to_write.observe() + size_written,
+        to_write.length() - size_written, where + size_written);
+    if (ret <= 0) return FAILURE;  // couldn't write the bytes.
+    size_written += ret;
   }
-  // unknown origin.
-  return BAD_INPUT;
+  return OKAY;
 }
 
 outcome huge_file::read(byte_array &to_fill, int desired_size, int &size_read)
 {
-  FUNCDEF("read");
-  size_read = 0;
-  int ret = _real_file->read(to_fill, desired_size);
-  if (ret < 0)
-    return FAILURE;  // couldn't read the bytes.
-  _file_pointer += double(size_read);
-  size_read = ret;
-  return OKAY; 
+  outcome ret = read_at(_position, to_fill, desired_size, size_read);
+  _position += size_read;
+  return ret;
 }
 
 outcome huge_file::write(const byte_array &to_write, int &size_written)
 {
-  FUNCDEF("write");
-  size_written = 0;
-  int ret = _real_file->write(to_write);
-  if (ret < 0)
-    return FAILURE;  // couldn't write the bytes.
-  _file_pointer += double(size_written);
-  size_written = ret;
-  return OKAY;
+  // the OS puts appended data at the end no matter what; we just need to
+  // know where that was.
+  if (_appending) _position = size();
+  outcome ret = write_at(_position, to_write, size_written);
+  _position += size_written;
+  return ret;
 }
 
 basis::outcome huge_file::touch()
 {
-  FUNCDEF("touch")
+  FUNCDEF("touch");
   if (filename(_real_file->name()).exists()) {
     // file exists, so just update time.
 #ifndef __WIN32__
@@ -316,7 +292,7 @@ basis::outcome huge_file::touch()
     byte_array junk(1);
     int written;
     outcome ret = write(junk, written);
-    if (ret != OKAY) ret;
+    if (ret != OKAY) return ret;
     if (!truncate())
       return FAILURE;
   }
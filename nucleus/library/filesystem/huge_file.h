@@ -27,9 +27,20 @@ namespace filesystem {
 //! Supports reading and writing to very large files, > 4 gigabytes.
 /*!
   The standard file I/O functions only handle files up to 4 gigabytes.  This
-  class extends the range to essentially unlimited sizes, as long as the
-  operating system can accurately do relative seeks and can read/write to
-  files of the size needed.
+  class extends the range to essentially unlimited sizes by working directly
+  with the operating system's 64-bit file offsets.  The length is found with a
+  single status call and seeks are just a change of our own file pointer,
+  since all reads and writes are positional (pread and pwrite on unix).
+
+  The double-based methods are kept for older code; the file_offset methods
+  are exact for any size and should be preferred.
+
+  The sequential methods (read, write, seek and friends) share the object's
+  file pointer and must only be used by one thread at a time.  The positional
+  methods (read_at and write_at) never touch the file pointer, so several
+  threads can safely fill different regions of the same file concurrently.
+  Positional writes should not be used on files opened for appending, since
+  the OS will add that data to the end regardless of the offset.
 */
 
 class huge_file
@@ -50,6 +61,9 @@ public:
     BAD_INPUT = basis::common::BAD_INPUT
   };
 
+  typedef basis::signed_long_long file_offset;
+    //!< a position or size within the file, in bytes.
+
   const basis::astring &name() const;
     //!< returns the name of the file this operates on.
 
@@ -59,18 +73,28 @@ public:
   bool eof() const;
     //!< reports when the file pointer has reached the end of the file.
 
+  file_offset size() const;
+    //!< returns the current length of the file, or zero if it's not good().
+
   double length();
-    //!< expensive operation accesses the file to find length.
+    //!< returns the size() as a double for older callers.
+
+  file_offset position() const { return _position; }
+    //!< returns where the file pointer currently is.
 
-  double file_pointer() const { return _file_pointer; }
+  double file_pointer() const { return double(_position); }
     //!< returns where we currently are in the file.
 
+  basis::outcome seek_to(file_offset new_position,
+          byte_filer::origins origin = byte_filer::FROM_START);
+    //!< moves the file pointer to "new_position" based on the "origin".
+    /*!< this never touches the file itself, so it is very cheap.  BAD_INPUT
+    is returned if the resulting position would be before the file start. */
+
   basis::outcome seek(double new_position,
           byte_filer::origins origin = byte_filer::FROM_CURRENT);
     //!< move the file pointer to "new_position" if possible.
-    /*!< the relative seek is the easiest type of seek to accomplish with a
-    huge file.  the other types are also supported, but take a bit more to
-    implement. */
+    /*!< this is a wrapper around seek_to() for older callers. */
 
   basis::outcome move_to(double absolute_posn);
     //!< simpler seek just goes from current location to "absolute_posn".
@@ -83,6 +107,19 @@ public:
     //!< stores the array "to_write" into the file.
     /*!< "size_written" reports how many bytes got written. */
 
+  basis::outcome read_at(file_offset where, basis::byte_array &to_fill,
+          int desired_size, int &size_read) const;
+    //!< reads up to "desired_size" bytes starting at offset "where".
+    /*!< the file pointer is not used or changed, and this may be called from
+    several threads at once. */
+
+  basis::outcome write_at(file_offset where, const basis::byte_array &to_write,
+          int &size_written);
+    //!< stores "to_write" at offset "where" without moving the file pointer.
+    /*!< writing past the current end of the file extends it, and any gap is
+    filled with zeros.  like read_at(), this is safe to call concurrently for
+    different regions of the file. */
+
   bool truncate();
     //!< truncates the file after the current position.
 
@@ -92,9 +129,29 @@ public:
   void flush();
     //!< forces any pending writes to actually be saved to the file.
 
+  enum access_patterns {
+    NORMAL_ACCESS,  //!< no particular pattern is expected.
+    SEQUENTIAL_ACCESS,  //!< the file will be read from front to back.
+    RANDOM_ACCESS,  //!< reads will jump around the file.
+    DONE_ACCESSING  //!< the cached pages are no longer needed.
+  };
+
+  void advise(access_patterns pattern, file_offset start = 0,
+          file_offset length = 0);
+    //!< tells the OS how the region at "start" will be used.
+    /*!< a "length" of zero means through the end of the file.  this is only
+    a hint for the OS's caching and read-ahead; it is ignored where the OS
+    does not support it. */
+
 private:
-  byte_filer *_real_file;  //!< supports us but is subject to 4g limit.
-  double _file_pointer;  //!< position in the file if OS is tracking us.
+  byte_filer *_real_file;  //!< opens the file for us with the right modes.
+  int _descriptor;  //!< the OS file descriptor we perform all I/O on.
+  bool _appending;  //!< true if the file was opened in append mode.
+  file_offset _position;  //!< our own file pointer for sequential access.
+
+  // not to be called.
+  huge_file(const huge_file &);
+  huge_file &operator =(const huge_file &);
 };
 
 } //namespace.
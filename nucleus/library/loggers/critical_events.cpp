@@ -27,6 +27,12 @@
 
 #include <stdio.h>
 #include <errno.h>
+#ifdef __UNIX__
+  #include <fcntl.h>
+  #include <signal.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
 
 using namespace basis;
 using namespace structures;
@@ -101,24 +107,190 @@ astring critical_events::critical_events_directory()
 void critical_events::set_critical_events_directory(const astring &directory)
 { hidden_critical_events_dir() = directory; }
 
+astring critical_events::short_application_name()
+{
+  astring app_name = application_configuration::application_name();
+  int indy = app_name.find('/', app_name.end(), true);
+  if (non_negative(indy)) app_name.zap(0, indy);
+  indy = app_name.find('\\', app_name.end(), true);
+  if (non_negative(indy)) app_name.zap(0, indy);
+  return app_name;
+}
+
 void critical_events::write_to_critical_events(const char *to_write)
 {
   astring filename = critical_events_directory();
   filename += "/runtime_issues.log";
   FILE *errfile = fopen(filename.s(), "ab");
   if (errfile) {
-    astring app_name = application_configuration::application_name();
-    int indy = app_name.find('/', app_name.end(), true);
-    if (non_negative(indy)) app_name.zap(0, indy);
-    indy = app_name.find('\\', app_name.end(), true);
-    if (non_negative(indy)) app_name.zap(0, indy);
     fprintf(errfile, "%s [%s]:%s", time_stamp::notarize(true).s(),
-        app_name.s(), parser_bits::platform_eol_to_chars());
+        short_application_name().s(), parser_bits::platform_eol_to_chars());
     fprintf(errfile, "%s%s", to_write, parser_bits::platform_eol_to_chars());
     fclose(errfile);
   }
 }
 
+//////////////
+
+#ifdef __UNIX__
+
+const int CRASH_TEXT_SIZE = 1024;
+  // room for the crash log's name and for the note that starts a crash.
+
+static char __crash_log_name[CRASH_TEXT_SIZE];  // where crashes are recorded.
+static char __crash_note[CRASH_TEXT_SIZE];  // starts each crash's entry.
+
+// the signals that mean the program has crashed.
+static const int __crash_signals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+static const char *__crash_signal_names[] = { "SIGSEGV", "SIGABRT", "SIGBUS",
+    "SIGFPE", "SIGILL" };
+const int CRASH_SIGNALS = sizeof(__crash_signals) / sizeof(int);
+
+const int CRASH_STACK_SIZE = 64 * KILOBYTE;
+  // a separate stack for the handler, since the crash may be a stack overflow.
+
+static bool __crash_dumps_installed = false;  // true once handlers are set.
+static __thread char *__crash_stack = NULL_POINTER;  // this thread's stack.
+
+static void write_crash_text(int fd, const char *text)
+{
+  int length = int(strlen(text));
+  int written = 0;
+  while (written < length) {
+    int ret = int(write(fd, text + written, length - written));
+    if (ret <= 0) {
+      if (ret < 0 && errno == EINTR) continue;
+      break;
+    }
+    written += ret;
+  }
+}
+
+// stores "value" as a decimal number that's padded to "digits" with zeros.
+static char *put_crash_number(char *to_fill, long value, int digits)
+{
+  for (int i = digits - 1; i >= 0; i--) {
+    to_fill[i] = char('0' + value % 10);
+    value /= 10;
+  }
+  return to_fill + digits;
+}
+
+// writes the time of the crash.  the time zone can't be looked up safely in
+// a signal handler, so the time is given in UTC.
+static void write_crash_time(int fd)
+{
+  timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  long seconds = long(now.tv_sec % 86400);
+  // the calendar date is worked out from the days since 1970 with plain
+  // arithmetic, using eras of 400 years that start on march first.
+  long days = long(now.tv_sec / 86400) + 719468;
+  long era = days / 146097;
+  long day_of_era = days - era * 146097;
+  long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524
+      - day_of_era / 146096) / 365;
+  long day_of_year = day_of_era
+      - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  long shifted_month = (5 * day_of_year + 2) / 153;
+  long day = day_of_year - (153 * shifted_month + 2) / 5 + 1;
+  long month = shifted_month < 10? shifted_month + 3 : shifted_month - 9;
+  long year = era * 400 + year_of_era + (month <= 2? 1 : 0);
+
+  char text[40];
+  char *pos = put_crash_number(text, year, 4);
+  *pos++ = '-';
+  pos = put_crash_number(pos, month, 2);
+  *pos++ = '-';
+  pos = put_crash_number(pos, day, 2);
+  *pos++ = ' ';
+  pos = put_crash_number(pos, seconds / 3600, 2);
+  *pos++ = ':';
+  pos = put_crash_number(pos, seconds / 60 % 60, 2);
+  *pos++ = ':';
+  pos = put_crash_number(pos, seconds % 60, 2);
+  *pos++ = '.';
+  pos = put_crash_number(pos, now.tv_nsec / 1000000, 3);
+  strcpy(pos, " UTC");
+  write_crash_text(fd, text);
+}
+
+// records the crash using only calls that are safe within a signal handler.
+static void crash_dump_handler(int signal_number)
+{
+  int fd = open(__crash_log_name, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd >= 0) {
+    const char *name = "an unknown signal";
+    for (int i = 0; i < CRASH_SIGNALS; i++)
+      if (__crash_signals[i] == signal_number) name = __crash_signal_names[i];
+    write_crash_time(fd);
+    write_crash_text(fd, __crash_note);
+    write_crash_text(fd, name);
+    write_crash_text(fd, parser_bits::platform_eol_to_chars());
+#ifdef ENABLE_CALLSTACK_TRACKING
+    application::callstack_tracker::write_trace(fd);
+#else
+    write_crash_text(fd, "(callstack tracking is not enabled in this build.)");
+    write_crash_text(fd, parser_bits::platform_eol_to_chars());
+#endif
+    close(fd);
+  }
+  // the handler was reset before we were called, so raising the signal again
+  // lets it end the program the way it normally would have.
+  raise(signal_number);
+}
+
+#endif
+
+void critical_events::install_crash_dumps()
+{
+#ifdef __UNIX__
+  astring filename = critical_events_directory() + "/runtime_issues.log";
+  strncpy(__crash_log_name, filename.s(), CRASH_TEXT_SIZE - 1);
+  // the time is added when the crash happens.
+  astring note = a_sprintf(" [%s]:%scrashed by ",
+      short_application_name().s(), parser_bits::platform_eol_to_chars());
+  strncpy(__crash_note, note.s(), CRASH_TEXT_SIZE - 1);
+
+  __crash_dumps_installed = true;
+  attach_crash_stack();
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = crash_dump_handler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+  for (int i = 0; i < CRASH_SIGNALS; i++)
+    sigaction(__crash_signals[i], &action, NULL_POINTER);
+#endif
+}
+
+void critical_events::attach_crash_stack()
+{
+#ifdef __UNIX__
+  if (!__crash_dumps_installed || __crash_stack) return;
+  __crash_stack = new char[CRASH_STACK_SIZE];
+  stack_t handler_stack;
+  handler_stack.ss_sp = __crash_stack;
+  handler_stack.ss_size = CRASH_STACK_SIZE;
+  handler_stack.ss_flags = 0;
+  sigaltstack(&handler_stack, NULL_POINTER);
+#endif
+}
+
+void critical_events::detach_crash_stack()
+{
+#ifdef __UNIX__
+  if (!__crash_stack) return;
+  stack_t handler_stack;
+  memset(&handler_stack, 0, sizeof(handler_stack));
+  handler_stack.ss_flags = SS_DISABLE;
+  sigaltstack(&handler_stack, NULL_POINTER);
+  delete [] __crash_stack;
+  __crash_stack = NULL_POINTER;
+#endif
+}
+
 void critical_events::write_to_console(const char *guards_message_space)
 { fprintf(stderr, "%s", (char *)guards_message_space); fflush(stderr); }
 
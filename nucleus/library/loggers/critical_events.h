@@ -125,6 +125,23 @@ public:
     serious events written to error logging functions.  If you use the
     functions in this file, you are likely already writing to this log. */
 
+  static void install_crash_dumps();
+    //!< records crashes of the program in the critical events log file.
+    /*!< handlers are installed for the signals that a crash raises, such as
+    SIGSEGV and SIGABRT.  they note the signal and the callstack (for builds
+    with ENABLE_CALLSTACK_TRACKING) using only calls that are safe in a signal
+    handler, then let the signal end the program as usual.  the log file is
+    chosen now, so the critical events directory should already be set.  the
+    handlers run on a separate stack so that stack overflows are caught, but
+    each thread needs its own; the calling thread and any ethread get one,
+    while other threads must use attach_crash_stack() themselves. */
+
+  static void attach_crash_stack();
+    //!< gives the calling thread a stack for the crash handlers to run on.
+    /*!< this does nothing until install_crash_dumps() has been called. */
+  static void detach_crash_stack();
+    //!< releases the calling thread's crash stack before the thread exits.
+
   static void set_critical_events_directory(const basis::astring &directory);
     //!< sets the internal location where the critical events will be logged.
     /*!< this is postponed to a higher level, although the default
@@ -196,6 +213,9 @@ public:
 private:
   static basis::astring &hidden_critical_events_dir();
 
+  static basis::astring short_application_name();
+    //!< the program's name without any directories.
+
   static void FL_continuable_error_real(const char *file, int line,
       const char *error_class, const char *error_function, const char *info,
       const char *title);
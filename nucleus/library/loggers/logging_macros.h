@@ -25,9 +25,6 @@
 #include <loggers/logging_filters.h>
 #include <timely/time_stamp.h>
 
-///hmmm: very temporary until the call stack tracking is available again.
-#define update_current_stack_frame_line_number(x)
-
 //! Logs a string "to_log" on "the_logger" using the "filter".
 /*! The filter is checked before the string is allowed to come into
 existence, which saves allocations when the item would never be printed
@@ -0,0 +1,472 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : child_supervisor                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 1994-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "child_supervisor.h"
+#include "ethread.h"
+#include "launch_process.h"
+
+#include <basis/functions.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/byte_hasher.h>
+#include <structures/hash_table.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __LINUX__
+  #include <poll.h>
+  #include <spawn.h>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/syscall.h>
+#endif
+
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+
+extern char **environ;
+
+namespace processes {
+
+//#define DEBUG_CHILD_SUPERVISOR
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int EXPECTED_CHILDREN = 200;
+  // a rough guess at how many children will be around at once.
+
+const int FINISHED_KEPT = 1000;
+  // the number of exited children whose exit values are kept for await_exit().
+
+const int MAXIMUM_EVENTS = 64;
+  // the most exits handled in one pass of the supervisor thread.
+
+const int FALLBACK_PAUSE = 40;
+  // how often processes are checked when pidfds are not available.
+
+//////////////
+
+#ifdef __LINUX__
+// opens a pidfd for "pid", or returns negative with errno set.
+static int open_pidfd(un_int pid)
+{
+#ifdef SYS_pidfd_open
+  return int(syscall(SYS_pidfd_open, pid_t(pid), 0));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+#endif
+
+// turns a status from waitpid into an exit value.
+static int exit_value_of(int status)
+{
+  if (WIFEXITED(status)) return WEXITSTATUS(status);
+  if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+  return -1;
+}
+
+//////////////
+
+// what's known about one of our children.
+
+class child_record
+{
+public:
+  int _pidfd;  //!< the child's pidfd, or negative once it's exited.
+  int _exit_value;  //!< the child's exit value, once it's exited.
+
+  child_record(int pidfd = -1) : _pidfd(pidfd), _exit_value(0) {}
+};
+
+class child_records : public hash_table<int, child_record>
+{
+public:
+  int _running;  //!< how many of the children haven't exited.
+  int_array _finished;  //!< the children that have exited, oldest first.
+
+  child_records()
+      : hash_table<int, child_record>(rotating_byte_hasher(), EXPECTED_CHILDREN),
+        _running(0) {}
+};
+
+//////////////
+
+class supervisor_thread : public ethread
+{
+public:
+  supervisor_thread(child_supervisor &parent) : ethread(), _parent(parent) {}
+
+  DEFINE_CLASS_NAME("supervisor_thread");
+
+  virtual void perform_activity(void *formal(data)) { _parent.handle_exits(); }
+
+private:
+  child_supervisor &_parent;
+};
+
+//////////////
+
+SAFE_STATIC(child_supervisor, __program_supervisor, )
+
+child_supervisor::child_supervisor()
+: _lock(new mutex),
+  _report_lock(new mutex),
+  _children(new child_records),
+  _observers(new array<child_observer *>(0, NULL_POINTER,
+      byte_array::SIMPLE_COPY)),
+  _thread(new supervisor_thread(*this)),
+  _epoll(-1),
+  _waker(-1)
+{
+#ifdef __LINUX__
+  FUNCDEF("constructor");
+  if (!supported()) return;
+  _epoll = epoll_create1(EPOLL_CLOEXEC);
+  _waker = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (negative(_epoll) || negative(_waker)) {
+    LOG("failed to create the epoll or eventfd descriptors.");
+    return;
+  }
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = 0;  // no child has this id.
+  epoll_ctl(_epoll, EPOLL_CTL_ADD, _waker, &event);
+  _thread->start(NULL_POINTER);
+#endif
+}
+
+child_supervisor::~child_supervisor()
+{
+  _thread->cancel();
+#ifdef __LINUX__
+  if (!negative(_waker)) {
+    // wake the thread up so it can see that it's been stopped.
+    eventfd_write(_waker, 1);
+  }
+#endif
+  _thread->stop();
+  WHACK(_thread);
+  {
+    // the children are left running, but we stop watching them.
+    auto_synchronizer l(*_lock);
+    WHACK(_children);
+  }
+#ifdef __LINUX__
+  if (!negative(_epoll)) close(_epoll);
+  if (!negative(_waker)) close(_waker);
+#endif
+  WHACK(_observers);
+  WHACK(_report_lock);
+  WHACK(_lock);
+}
+
+child_supervisor &child_supervisor::program_wide()
+{ return __program_supervisor(); }
+
+bool child_supervisor::supported()
+{
+#ifdef __LINUX__
+  static int known = -1;  // not checked yet.
+  if (negative(known)) {
+    int fd = open_pidfd(getpid());
+    known = !negative(fd);
+    if (known) close(fd);
+  }
+  return known;
+#else
+  return false;
+#endif
+}
+
+#ifndef __LINUX__
+un_int child_supervisor::spawn(const astring &formal(app_name_in),
+    const astring &formal(parameters), un_int &child_id)
+#else
+un_int child_supervisor::spawn(const astring &app_name_in,
+    const astring &parameters, un_int &child_id)
+#endif
+{
+  FUNCDEF("spawn");
+  child_id = 0;
+#ifndef __LINUX__
+  return ENOSYS;
+#else
+  astring app_name = app_name_in;
+  if (app_name[0] == '"') app_name.zap(0, 0);
+  if (app_name[app_name.end()] == '"') app_name.zap(app_name.end(), app_name.end());
+  char_star_array parms = launch_process::break_line(app_name, parameters);
+  // posix_spawn uses vfork semantics, so the parent's memory isn't copied.
+  pid_t kid;
+  int ret = posix_spawn(&kid, app_name.s(), NULL_POINTER, NULL_POINTER,
+      parms.access(), environ);
+  if (ret) return ret;
+  child_id = kid;
+  if (!watch(kid))
+    LOG(a_sprintf("failed to watch child %d; it will not be reaped.", kid));
+#ifdef DEBUG_CHILD_SUPERVISOR
+  LOG(a_sprintf("started child %d: ", kid) + app_name + " " + parameters);
+#endif
+  return 0;
+#endif
+}
+
+#ifndef __LINUX__
+bool child_supervisor::watch(un_int formal(child_id))
+#else
+bool child_supervisor::watch(un_int child_id)
+#endif
+{
+#ifndef __LINUX__
+  return false;
+#else
+  if (negative(_epoll)) return false;
+  int pidfd = open_pidfd(child_id);
+  if (negative(pidfd)) return false;
+  auto_synchronizer l(*_lock);
+  child_record *found = _children->find(child_id);
+  if (found && !negative(found->_pidfd)) {
+    // we're already watching this one.
+    close(pidfd);
+    return true;
+  }
+  epoll_event event;
+  event.events = EPOLLIN;
+  event.data.u64 = child_id;
+  if (epoll_ctl(_epoll, EPOLL_CTL_ADD, pidfd, &event)) {
+    close(pidfd);
+    return false;
+  }
+  _children->add(child_id, new child_record(pidfd));
+  _children->_running++;
+  return true;
+#endif
+}
+
+bool child_supervisor::supervising(un_int child_id)
+{
+  auto_synchronizer l(*_lock);
+  child_record *found = _children->find(child_id);
+  return found && !negative(found->_pidfd);
+}
+
+int child_supervisor::children()
+{
+  auto_synchronizer l(*_lock);
+  return _children->_running;
+}
+
+bool child_supervisor::reap(un_int child_id, int &exit_value)
+{
+  child_record *found = _children->find(child_id);
+  if (!found || negative(found->_pidfd)) return false;
+  int status = 0;
+  pid_t ret = waitpid(child_id, &status, WNOHANG);
+  if (!ret) return false;  // still running.
+  // it's gone; if it wasn't our child to wait for, the exit value is unknown.
+  found->_exit_value = (ret == pid_t(child_id))? exit_value_of(status) : -1;
+#ifdef __LINUX__
+  epoll_ctl(_epoll, EPOLL_CTL_DEL, found->_pidfd, NULL_POINTER);
+  close(found->_pidfd);
+#endif
+  found->_pidfd = -1;
+  exit_value = found->_exit_value;
+  _children->_running--;
+  _children->_finished += child_id;
+  // only a limited number of the exit values are kept around.
+  while (_children->_finished.length() > FINISHED_KEPT) {
+    int oldest = _children->_finished[0];
+    _children->_finished.zap(0, 0);
+    child_record *old = _children->find(oldest);
+    if (old && negative(old->_pidfd)) _children->zap(oldest);
+  }
+  return true;
+}
+
+void child_supervisor::handle_exits()
+{
+#ifdef __LINUX__
+  FUNCDEF("handle_exits");
+  epoll_event events[MAXIMUM_EVENTS];
+  int_array exited;
+  int_array values;
+  while (!_thread->should_stop()) {
+    int count = epoll_wait(_epoll, events, MAXIMUM_EVENTS, -1);
+    if (negative(count)) {
+      if (errno == EINTR) continue;
+      LOG(a_sprintf("epoll_wait failed with error %d; no longer reaping.", errno));
+      break;
+    }
+    exited.reset();
+    values.reset();
+    {
+      auto_synchronizer l(*_lock);
+      for (int i = 0; i < count; i++) {
+        un_int child_id = un_int(events[i].data.u64);
+        if (!child_id) continue;  // just the waker.
+        int exit_value;
+        if (reap(child_id, exit_value)) {
+          exited += child_id;
+          values += exit_value;
+        }
+      }
+    }
+    for (int i = 0; i < exited.length(); i++) report(exited[i], values[i]);
+  }
+#endif
+}
+
+void child_supervisor::report(un_int child_id, int exit_value)
+{
+#ifdef DEBUG_CHILD_SUPERVISOR
+  FUNCDEF("report");
+  LOG(a_sprintf("child %d exited with %d.", child_id, exit_value));
+#endif
+  auto_synchronizer r(*_report_lock);
+  array<child_observer *> observers;
+  {
+    auto_synchronizer l(*_lock);
+    observers = *_observers;
+  }
+  for (int i = 0; i < observers.length(); i++)
+    observers[i]->child_exited(child_id, exit_value);
+}
+
+bool child_supervisor::await_exit(un_int child_id, int timeout, int &exit_value)
+{
+  int pidfd = -1;
+  {
+    auto_synchronizer l(*_lock);
+    child_record *found = _children->find(child_id);
+    if (!found) return false;  // not ours, or already collected.
+    if (negative(found->_pidfd)) {
+      exit_value = found->_exit_value;
+      _children->zap(child_id);
+      return true;
+    }
+    // our own copy of the pidfd can't be closed out from under us.
+    pidfd = dup(found->_pidfd);
+  }
+#ifdef __LINUX__
+  pollfd waiting;
+  waiting.fd = pidfd;
+  waiting.events = POLLIN;
+  waiting.revents = 0;
+  int ret;
+  do {
+    ret = poll(&waiting, 1, timeout);
+  } while (negative(ret) && (errno == EINTR));
+  close(pidfd);
+#endif
+  bool reaped_it;
+  {
+    auto_synchronizer l(*_lock);
+    child_record *found = _children->find(child_id);
+    if (!found) return false;  // someone else collected it.
+    reaped_it = reap(child_id, exit_value);
+    if (!reaped_it && !negative(found->_pidfd)) return false;  // still going.
+    exit_value = found->_exit_value;
+    _children->zap(child_id);
+  }
+  // the observers hear about it even when we did the reaping here.
+  if (reaped_it) report(child_id, exit_value);
+  return true;
+}
+
+bool child_supervisor::alive(un_int pid)
+{
+#ifdef __LINUX__
+  int pidfd = open_pidfd(pid);
+  if (!negative(pidfd)) {
+    // a process that has exited but not been reaped is readable.
+    pollfd check;
+    check.fd = pidfd;
+    check.events = POLLIN;
+    check.revents = 0;
+    int ret = poll(&check, 1, 0);
+    close(pidfd);
+    return !ret;
+  }
+  if (errno == ESRCH) return false;
+#endif
+  return !kill(pid, 0) || (errno == EPERM);
+}
+
+bool child_supervisor::await_any_exit(const int_set &pids, int timeout)
+{
+#ifdef __LINUX__
+  if (supported()) {
+    array<pollfd> waiting(0, NULL_POINTER, byte_array::SIMPLE_COPY);
+    bool gone = false;
+    for (int i = 0; i < pids.elements(); i++) {
+      pollfd to_add;
+      to_add.fd = open_pidfd(pids[i]);
+      to_add.events = POLLIN;
+      to_add.revents = 0;
+      if (negative(to_add.fd)) {
+        if (errno == ESRCH) gone = true;
+        continue;
+      }
+      waiting += to_add;
+    }
+    if (!gone && waiting.length()) {
+      int ret;
+      do {
+        ret = poll(waiting.access(), waiting.length(), timeout);
+      } while (negative(ret) && (errno == EINTR));
+      gone = (ret > 0);
+    }
+    for (int i = 0; i < waiting.length(); i++) close(waiting[i].fd);
+    return gone;
+  }
+#endif
+  // without pidfds, we can only check on the processes every so often.
+  time_stamp leave_at(timeout);
+  while (true) {
+    for (int i = 0; i < pids.elements(); i++)
+      if (!alive(pids[i])) return true;
+    if (!negative(timeout) && (time_stamp() >= leave_at)) return false;
+    time_control::sleep_ms(FALLBACK_PAUSE);
+  }
+}
+
+void child_supervisor::add_observer(child_observer *to_add)
+{
+  auto_synchronizer l(*_lock);
+  for (int i = 0; i < _observers->length(); i++)
+    if ((*_observers)[i] == to_add) return;
+  *_observers += to_add;
+}
+
+void child_supervisor::remove_observer(child_observer *to_remove)
+{
+  // waiting for the report lock means no report is still in progress.
+  auto_synchronizer r(*_report_lock);
+  auto_synchronizer l(*_lock);
+  for (int i = _observers->length() - 1; i >= 0; i--)
+    if ((*_observers)[i] == to_remove) _observers->zap(i, i);
+}
+
+} //namespace.
+
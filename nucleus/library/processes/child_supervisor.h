@@ -0,0 +1,137 @@
+#ifndef CHILD_SUPERVISOR_CLASS
+#define CHILD_SUPERVISOR_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : child_supervisor                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 1994-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/array.h>
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <basis/mutex.h>
+#include <structures/set.h>
+
+namespace processes {
+
+// forward.
+class child_records;
+class supervisor_thread;
+
+//! Receives notice from the child_supervisor when a child process exits.
+
+class child_observer : public virtual basis::root_object
+{
+public:
+  virtual void child_exited(basis::un_int child_id, int exit_value) = 0;
+    //!< invoked on the supervisor's thread just after "child_id" is reaped.
+    /*!< the "exit_value" is the child's exit code, or 128 plus the signal
+    number if the child was killed by a signal.  this should not take long,
+    since no other exits are reported until it returns. */
+};
+
+//////////////
+
+//! Starts child processes and reaps them as soon as they exit.
+/*!
+  Children are started with posix_spawn, which doesn't copy the parent's
+  page tables the way fork does, so starting a program from a large process
+  stays cheap.  Each child is tracked by a pidfd that's watched with epoll
+  by a thread that sleeps until some child exits; nothing is polled while
+  the children are running.  This needs Linux 5.3 or later; supported()
+  reports whether it's available, and launch_process falls back to fork
+  and SIGCHLD when it's not.
+*/
+
+class child_supervisor : public virtual basis::root_object
+{
+public:
+  child_supervisor();
+  virtual ~child_supervisor();
+
+  DEFINE_CLASS_NAME("child_supervisor");
+
+  static bool supported();
+    //!< true if pidfds can be used to supervise children here.
+
+  static child_supervisor &program_wide();
+    //!< the supervisor shared by everything in the program.
+
+  basis::un_int spawn(const basis::astring &app_name,
+          const basis::astring &parameters, basis::un_int &child_id);
+    //!< starts "app_name" with the "parameters" and supervises it.
+    /*!< zero is returned on success, and the new process's id is stored in
+    "child_id".  otherwise the OS error code is returned. */
+
+  bool watch(basis::un_int child_id);
+    //!< starts supervising a child process that was started elsewhere.
+
+  bool supervising(basis::un_int child_id);
+    //!< true if "child_id" is one of our children that hasn't exited yet.
+
+  int children();
+    //!< returns the number of children that are still running.
+
+  bool await_exit(basis::un_int child_id, int timeout, int &exit_value);
+    //!< waits up to "timeout" milliseconds for "child_id" to exit.
+    /*!< true is returned if it exited, in which case its "exit_value" is
+    filled in.  a negative "timeout" waits forever.  the exit values of the
+    most recently exited children are kept until they're collected here, but
+    each one can only be collected once. */
+
+  static bool await_any_exit(const structures::int_set &pids, int timeout);
+    //!< waits up to "timeout" milliseconds for any of the "pids" to exit.
+    /*!< these can be any processes, not just our children.  true is
+    returned if one or more of them are gone. */
+
+  static bool alive(basis::un_int pid);
+    //!< true if the process "pid" still exists and hasn't exited.
+
+  void add_observer(child_observer *to_add);
+    //!< "to_add" will be told about every child that exits.
+    /*!< the observer is not owned by the supervisor and must be removed
+    before it's destroyed. */
+
+  void remove_observer(child_observer *to_remove);
+    //!< stops telling "to_remove" about exits.
+    /*!< once this returns, the observer will not be invoked again. */
+
+private:
+  friend class supervisor_thread;
+  basis::mutex *_lock;  //!< protects the children and the observers.
+  basis::mutex *_report_lock;  //!< held while observers are told of exits.
+  child_records *_children;  //!< the children being watched.
+  basis::array<child_observer *> *_observers;  //!< who hears about exits.
+  supervisor_thread *_thread;  //!< waits for children to exit.
+  int _epoll;  //!< the epoll descriptor that all the pidfds are in.
+  int _waker;  //!< an eventfd that wakes up the thread to stop.
+
+  bool reap(basis::un_int child_id, int &exit_value);
+    //!< collects the exit value of "child_id" if it has exited.
+    /*!< the lock must already be held.  false is returned if the child is
+    still running or isn't ours. */
+
+  void handle_exits();
+    //!< waits for children to exit and reports them, until we're stopped.
+
+  void report(basis::un_int child_id, int exit_value);
+    //!< tells the observers that "child_id" exited with "exit_value".
+
+  // not appropriate.
+  child_supervisor(const child_supervisor &);
+  child_supervisor &operator =(const child_supervisor &);
+};
+
+} //namespace.
+
+#endif
+
@@ -27,6 +27,7 @@
 //  #include <process.h>
 //#elif defined(__UNIX__) || defined(__GNU_WINDOWS__)
   #include <pthread.h>
+  #include <time.h>
 //#else
   //#error unknown OS for thread support.
 //#endif
@@ -52,9 +53,6 @@ const int MAXIMUM_CREATE_ATTEMPTS = 20;
 const int MINIMUM_SLEEP_PERIOD = 10;
   // this is the smallest time we'll sleep for if we're slack.
 
-const int MAXIMUM_SLEEP_PERIOD = 200;
-  // the number of milliseconds we use for breaking up longer sleep periods.
-
 const int SNOOZE_FOR_RETRY = 100;
   // how long to sleep when a thread creation fails.
 
@@ -84,6 +82,94 @@ const int SNOOZE_FOR_RETRY = 100;
 
 #endif
 
+//////////////
+
+// adds "duration" milliseconds onto the time "to_move".
+static void add_ms(timespec &to_move, int duration)
+{
+  to_move.tv_sec += duration / SECOND_ms;
+  to_move.tv_nsec += long(duration % SECOND_ms) * 1000000;
+  if (to_move.tv_nsec >= 1000000000) {
+    to_move.tv_sec++;
+    to_move.tv_nsec -= 1000000000;
+  } else if (to_move.tv_nsec < 0) {
+    to_move.tv_sec--;
+    to_move.tv_nsec += 1000000000;
+  }
+}
+
+// returns true if time "a" comes before time "b".
+static bool earlier(const timespec &a, const timespec &b)
+{ return (a.tv_sec < b.tv_sec) || ( (a.tv_sec == b.tv_sec) && (a.tv_nsec < b.tv_nsec) ); }
+
+// the monotonic clock's time, "duration" milliseconds from now.
+static timespec from_now(int duration = 0)
+{
+  timespec to_return;
+  clock_gettime(CLOCK_MONOTONIC, &to_return);
+  add_ms(to_return, duration);
+  return to_return;
+}
+
+//////////////
+
+// a condition variable that the thread sleeps on, so that anyone can wake it.
+// the deadlines are absolute times on the monotonic clock, which keeps tight
+// intervals from drifting and isn't fooled by changes to the wall clock.
+// darwin can't put a condition variable on the monotonic clock, so there the
+// wait is turned into a relative one instead.
+
+class thread_alarm
+{
+public:
+  pthread_mutex_t _lock;  //!< protects the alarm and the thread's state.
+  pthread_cond_t _ring;  //!< signalled whenever the thread's state changes.
+  timespec _next_activation;  //!< the next time perform_activity is called.
+  bool _rescheduled;  //!< true if the next activation was set explicitly.
+  bool _woken;  //!< true if wake_now() was called since the last snooze.
+
+  thread_alarm() : _next_activation(from_now()), _rescheduled(false),
+      _woken(false) {
+    pthread_mutex_init(&_lock, NULL_POINTER);
+    pthread_condattr_t attribs;
+    pthread_condattr_init(&attribs);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&attribs, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&_ring, &attribs);
+    pthread_condattr_destroy(&attribs);
+  }
+
+  ~thread_alarm() {
+    pthread_cond_destroy(&_ring);
+    pthread_mutex_destroy(&_lock);
+  }
+
+  void lock() { pthread_mutex_lock(&_lock); }
+  void unlock() { pthread_mutex_unlock(&_lock); }
+  void ring() { pthread_cond_broadcast(&_ring); }
+
+  void wait_until(const timespec &when) {
+#ifdef __APPLE__
+    timespec now = from_now();
+    if (!earlier(now, when)) return;
+    timespec remaining;
+    remaining.tv_sec = when.tv_sec - now.tv_sec;
+    remaining.tv_nsec = when.tv_nsec - now.tv_nsec;
+    if (remaining.tv_nsec < 0) {
+      remaining.tv_sec--;
+      remaining.tv_nsec += 1000000000;
+    }
+    pthread_cond_timedwait_relative_np(&_ring, &_lock, &remaining);
+#else
+    pthread_cond_timedwait(&_ring, &_lock, &when);
+#endif
+  }
+    //!< the lock must be held.  spurious wakeups are left to the caller.
+};
+
+//////////////
+
 ethread::ethread()
 : _thread_ready(false),
   _thread_active(false),
@@ -96,7 +182,7 @@ ethread::ethread()
 //#endif
   _sleep_time(0),
   _periodic(false),
-  _next_activation(new time_stamp),
+  _alarm(new thread_alarm),
   _how(TIGHT_INTERVAL)  // unused.
 {
   FUNCDEF("constructor [one-shot]");
@@ -114,7 +200,7 @@ ethread::ethread(int sleep_timer, timed_thread_types how)
 //#endif
   _sleep_time(sleep_timer),
   _periodic(true),
-  _next_activation(new time_stamp),
+  _alarm(new thread_alarm),
   _how(how)
 {
   FUNCDEF("constructor [periodic]");
@@ -126,7 +212,7 @@ ethread::ethread(int sleep_timer, timed_thread_types how)
 ethread::~ethread()
 {
   stop();
-  WHACK(_next_activation);
+  WHACK(_alarm);
 //#ifndef _MSC_VER
   WHACK(_handle);
 //#endif
@@ -136,11 +222,43 @@ ethread::~ethread()
 
 ///void ethread::post_thread() {}
 
-// the reschedule operation assumes that assignment to a time stamp
-// object (based on a real numbers) happens indivisibly.
 void ethread::reschedule(int delay)
 {
-  *_next_activation = time_stamp(delay);  // start after the delay.
+  _alarm->lock();
+  _alarm->_next_activation = from_now(delay);  // start after the delay.
+  _alarm->_rescheduled = true;
+  _alarm->ring();
+  _alarm->unlock();
+}
+
+void ethread::wake_now()
+{
+  _alarm->lock();
+  _alarm->_next_activation = from_now();
+  _alarm->_rescheduled = true;
+  _alarm->_woken = true;
+  _alarm->ring();
+  _alarm->unlock();
+}
+
+void ethread::cancel()
+{
+  _alarm->lock();
+  _stop_thread = true;
+  _alarm->ring();
+  _alarm->unlock();
+}
+
+bool ethread::snooze(int duration)
+{
+  timespec wake_at = from_now(duration);
+  _alarm->lock();
+  while (!_stop_thread && !_alarm->_woken && earlier(from_now(), wake_at))
+    _alarm->wait_until(wake_at);
+  _alarm->_woken = false;
+  bool to_return = !_stop_thread;
+  _alarm->unlock();
+  return to_return;
 }
 
 bool ethread::start(void *thread_data)
@@ -150,7 +268,11 @@ bool ethread::start(void *thread_data)
   _data = thread_data;  // store the thread's data pointer.
   _stop_thread = false;  // don't stop now.
   _thread_ready = true;  // we're starting it now.
-  _next_activation->reset();  // make "now" the next time to activate.
+  _alarm->lock();
+  _alarm->_next_activation = from_now();  // make "now" the next time to activate.
+  _alarm->_rescheduled = false;
+  _alarm->_woken = false;
+  _alarm->unlock();
   bool success = false;
   int error = 0;
   int attempts = 0;
@@ -198,28 +320,23 @@ void ethread::stop()
 {
   cancel();  // tell thread to leave.
   if (!thread_started()) return;  // not running.
-  while (!thread_finished()) {
-/*
-#ifdef _MSC_VER
-    int result = 0;
-    if (!GetExitCodeThread((HANDLE)_handle, (LPDWORD)&result)
-        || (result != STILL_ACTIVE)) {
-      exempt_stop();
-      break;
-    }
-#endif
-*/
-    time_control::sleep_ms(10);  // wait for thread to leave.
-  }
+  // the thread rings the alarm on its way out, so we just wait for that.
+  _alarm->lock();
+  while (!thread_finished())
+    pthread_cond_wait(&_alarm->_ring, &_alarm->_lock);
+  _alarm->unlock();
 }
 
 void ethread::exempt_stop()
 {
+  _alarm->lock();
   _thread_active = false;
   _thread_ready = false;
 //#ifdef _MSC_VER
 //  _handle = 0;
 //#endif
+  _alarm->ring();
+  _alarm->unlock();
 }
 
 //#if defined(__UNIX__) || defined(__GNU_WINDOWS__)
@@ -240,6 +357,7 @@ void *ethread::one_shot_thread_driver(void *hidden_pointer)
 #ifdef COUNT_THREADS
   _current_threads().increment();
 #endif
+  critical_events::attach_crash_stack();  // crashes can be recorded here too.
 ///  manager->pre_thread();
   manager->_thread_active = true;
   manager->perform_activity(manager->_data);
@@ -248,6 +366,7 @@ void *ethread::one_shot_thread_driver(void *hidden_pointer)
 #ifdef COUNT_THREADS
   _current_threads().decrement();
 #endif
+  critical_events::detach_crash_stack();
 //#ifndef _MSC_VER
   pthread_exit(NULL_POINTER);
   return NULL_POINTER;
@@ -274,16 +393,27 @@ void *ethread::periodic_thread_driver(void *hidden_pointer)
 #ifdef COUNT_THREADS
   _current_threads().increment();
 #endif
+  critical_events::attach_crash_stack();  // crashes can be recorded here too.
 ///  manager->pre_thread();
 
+  thread_alarm &alarm = *manager->_alarm;
   while (!manager->_stop_thread) {
-    // for TIGHT_INTERVAL, we reset the next active time here.  this is safe
-    // relative to the reschedule() method, since we're about to do
-    // perform_activity() right now anyway.  this brings about a pretty hard
-    // interval; if perform_activity() takes N milliseconds, then there will
-    // only be sleep_time - N (min zero) ms before the next invocation.
-    if (manager->_how == TIGHT_INTERVAL)
-      *manager->_next_activation = time_stamp(manager->_sleep_time);
+    // for TIGHT_INTERVAL, we schedule the next activation here, a whole
+    // period past the deadline we just woke up for.  this is safe relative to
+    // the reschedule() method, since we're about to do perform_activity()
+    // right now anyway.  this brings about a hard interval that doesn't
+    // drift; if perform_activity() takes N milliseconds, then there will only
+    // be sleep_time - N (min zero) ms before the next invocation.
+    alarm.lock();
+    if (manager->_how == TIGHT_INTERVAL) {
+      timespec now = from_now();
+      add_ms(alarm._next_activation, manager->_sleep_time);
+      // if we've fallen a whole period behind, skip the missed activations.
+      if (earlier(alarm._next_activation, now))
+        alarm._next_activation = now;
+    }
+    alarm._rescheduled = false;
+    alarm.unlock();
 
     manager->_thread_active = true;
     manager->perform_activity(manager->_data);
@@ -291,35 +421,25 @@ void *ethread::periodic_thread_driver(void *hidden_pointer)
 
     // SLACK_INTERVAL means between activations.  we reset the next activation
     // here to ensure we wait the period specified for sleep time, including
-    // whatever time was taken for the activity itself.
-    if (manager->_how == SLACK_INTERVAL)
-      *manager->_next_activation = time_stamp(manager->_sleep_time);
-
-    // we do the sleep timing in chunks so that there's not such a huge wait
-    // when the user stops the thread before the sleep interval elapses.
-    // snooze until time for the next activation.
-    while (!manager->_stop_thread) {
-      int time_diff = int(manager->_next_activation->value()
-          - time_stamp().value());
-      if (time_diff < 0) time_diff = 0;  // time keeps on slipping.
-      // make sure we take our time if we're slack intervalled.
-      if (manager->_how == SLACK_INTERVAL) {
-        if (time_diff < MINIMUM_SLEEP_PERIOD)
-          time_diff = MINIMUM_SLEEP_PERIOD;
-      }
-      if (time_diff > MAXIMUM_SLEEP_PERIOD)
-        time_diff = MAXIMUM_SLEEP_PERIOD;
-      if (!manager->_stop_thread)
-        time_control::sleep_ms(time_diff);
-      if (time_stamp() >= *manager->_next_activation)
-        break;
-    }
+    // whatever time was taken for the activity itself.  a reschedule() that
+    // came in during the activity is honored instead.
+    alarm.lock();
+    if ( (manager->_how == SLACK_INTERVAL) && !alarm._rescheduled )
+      alarm._next_activation = from_now(maximum(manager->_sleep_time,
+          MINIMUM_SLEEP_PERIOD));
+
+    // snooze until time for the next activation, unless we're woken first.
+    while (!manager->_stop_thread
+        && earlier(from_now(), alarm._next_activation))
+      alarm.wait_until(alarm._next_activation);
+    alarm.unlock();
   }
 ///  manager->post_thread();
   manager->exempt_stop();
 #ifdef COUNT_THREADS
   _current_threads().decrement();
 #endif
+  critical_events::detach_crash_stack();
 //#ifndef _MSC_VER
   pthread_exit(NULL_POINTER);
   return NULL_POINTER;
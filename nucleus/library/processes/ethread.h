@@ -22,6 +22,9 @@
 
 namespace processes {
 
+// forward.
+class thread_alarm;
+
 //! Provides a platform-independent object for adding threads to a program.
 /*!
   This greatly simplifies creating and managing threads by hiding all the
@@ -54,11 +57,13 @@ public:
     start() is invoked, the thread's action (via the perform_activity()
     method) will be performed at regular intervals (using the specified value
     for "sleep_timer").  the thread will continue activating until the stop()
-    method is called.  a faster interval is used internally during sleep
-    periods such that calling stop() will not consume the whole "sleep_timer"
-    period.  if the "how" is TIGHT_INTERVAL, then the thread will activate
-    every "sleep_timer" milliseconds, as accurately as possible.  if the "how"
-    is SLACK_INTERVAL, then the thread will activate after a delay of
+    method is called.  the thread sleeps until its next activation, but
+    stop(), cancel(), reschedule() and wake_now() all interrupt that sleep
+    right away.  if the "how" is TIGHT_INTERVAL, then the thread will activate
+    every "sleep_timer" milliseconds, as accurately as possible; each
+    activation is scheduled from the previous one's deadline rather than from
+    when the thread happened to wake up, so the period does not drift.  if
+    the "how" is SLACK_INTERVAL, then the thread will activate after a delay of
     "sleep_timer" milliseconds from its last activation.  the latter mode
     allows the thread to consume its entire intended operation time knowing
     that there will still be slack time between when it is active.  the
@@ -81,9 +86,23 @@ public:
     perform_activity() invocation completes.  the thread may be restarted
     with start(). */
 
-  void cancel() { _stop_thread = true; }
+  void cancel();
     //!< stops the thread but does not wait until it has terminated.
-    /*!< this is appropriate for use within the perform_activity() method. */
+    /*!< this is appropriate for use within the perform_activity() method.
+    a thread sleeping between activations, or in snooze(), is woken up so
+    that it can leave. */
+
+  void wake_now();
+    //!< interrupts the thread's sleep so it gets to work immediately.
+    /*!< a periodic thread activates now instead of at its next scheduled
+    time, and a thread waiting in snooze() returns early. */
+
+  bool snooze(int duration);
+    //!< sleeps for up to "duration" milliseconds on the thread's behalf.
+    /*!< this is for use within perform_activity() by single-shot threads that
+    need to wait between bouts of work.  the sleep ends early if the thread is
+    stopped, cancelled or woken.  true is returned unless the thread should
+    stop now. */
 
 //  virtual void pre_thread();
     //!< invoked just after after start(), when the OS thread is created.
@@ -110,7 +129,9 @@ public:
   void reschedule(int delay = 0);
     //!< causes a periodic thread to activate after "delay" milliseconds from now.
     /*!< this resets the normal activation period, but after the next
-    activation occurs, the normal activation interval takes over again. */
+    activation occurs, the normal activation interval takes over again.  the
+    thread is woken up if it was already asleep, so a "delay" of zero makes
+    it activate right away. */
 
   int sleep_time() const { return _sleep_time; }
     //!< returns the current periodic thread interval.
@@ -155,7 +176,7 @@ private:
 //#endif
   int _sleep_time;  //!< threads perform at roughly this interval.
   bool _periodic;  //!< true if this thread should run repeatedly.
-  timely::time_stamp *_next_activation;  //!< the next time perform_activity is called.
+  thread_alarm *_alarm;  //!< tracks the next activation and wakes the thread.
   timed_thread_types _how;  //!< how is the period evaluated?
 
   // the OS level thread functions.
@@ -0,0 +1,387 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_copier                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "ethread.h"
+#include "file_copier.h"
+
+#include <basis/functions.h>
+#include <filesystem/directory.h>
+#include <filesystem/file_time.h>
+#include <filesystem/filename.h>
+#include <filesystem/heavy_file_ops.h>
+#include <filesystem/huge_file.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/amorph.h>
+#include <timely/time_stamp.h>
+
+#ifdef __UNIX__
+  #include <errno.h>
+  #include <semaphore.h>
+#endif
+#ifdef __WIN32__
+  #include <windows.h>
+#endif
+
+using namespace basis;
+using namespace filesystem;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+
+namespace processes {
+
+//#define DEBUG_FILE_COPIER
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+#undef AUTO_LOCK
+#define AUTO_LOCK auto_synchronizer l(*_lock)
+
+const int PIPELINE_DEPTH = 2;
+  // the number of buffers passed between the reader and the writer.
+
+//////////////
+
+// a counting semaphore used to pass the buffers back and forth.
+
+class copy_signal
+{
+public:
+#ifdef __UNIX__
+  copy_signal(int initial) { sem_init(&_sem, 0, initial); }
+  ~copy_signal() { sem_destroy(&_sem); }
+  void post() { sem_post(&_sem); }
+  void wait() { while (sem_wait(&_sem) && (errno == EINTR)) {} }
+private:
+  sem_t _sem;
+#elif defined(__WIN32__)
+  copy_signal(int initial)
+  : _sem(CreateSemaphore(NULL_POINTER, initial, PIPELINE_DEPTH + 1,
+        NULL_POINTER)) {}
+  ~copy_signal() { CloseHandle(_sem); }
+  void post() { ReleaseSemaphore(_sem, 1, NULL_POINTER); }
+  void wait() { WaitForSingleObject(_sem, INFINITE); }
+private:
+  HANDLE _sem;
+#endif
+};
+
+//////////////
+
+// one of the buffers travelling through the pipeline.
+
+struct pipeline_slot
+{
+  byte_array _data;
+  int _filled;  // the number of valid bytes, where zero means the end.
+  bool _failed;  // true if the reader couldn't read this piece.
+};
+
+// reads the source file into the pipeline's buffers in order.
+
+class pipeline_reader : public ethread
+{
+public:
+  pipeline_reader(huge_file &source, pipeline_slot *slots, int buffer_size,
+      copy_signal &empties, copy_signal &fulls, const bool &quitting)
+  : ethread(), _source(source), _slots(slots), _buffer_size(buffer_size),
+    _empties(empties), _fulls(fulls), _quitting(quitting) {}
+
+  DEFINE_CLASS_NAME("pipeline_reader");
+
+  virtual void perform_activity(void *formal(ptr)) {
+    huge_file::file_offset position = 0;
+    for (int index = 0; ; index = (index + 1) % PIPELINE_DEPTH) {
+      _empties.wait();
+      pipeline_slot &slot = _slots[index];
+      if (_quitting) {
+        // the writer gave up, so there's no point in reading more.
+        slot._filled = 0;
+        slot._failed = false;
+        _fulls.post();
+        return;
+      }
+      outcome ret = _source.read_at(position, slot._data, _buffer_size,
+          slot._filled);
+      slot._failed = (ret != huge_file::OKAY);
+      position += slot._filled;
+      _fulls.post();
+      // a short read means we reached the end, and the writer will see that
+      // the next buffer is empty.
+      if (slot._failed || !slot._filled) return;
+      if (slot._filled < _buffer_size) {
+        // hand over an empty buffer to mark the end.
+        index = (index + 1) % PIPELINE_DEPTH;
+        _empties.wait();
+        _slots[index]._filled = 0;
+        _slots[index]._failed = false;
+        _fulls.post();
+        return;
+      }
+    }
+  }
+
+private:
+  huge_file &_source;
+  pipeline_slot *_slots;
+  int _buffer_size;
+  copy_signal &_empties;
+  copy_signal &_fulls;
+  const bool &_quitting;
+};
+
+//////////////
+
+// copies files from the copier's shared work list until it's empty.
+
+class copy_worker : public ethread
+{
+public:
+  copy_worker(file_copier &parent) : ethread(), _parent(parent) {}
+
+  DEFINE_CLASS_NAME("copy_worker");
+
+  virtual void perform_activity(void *formal(ptr)) {
+    for (int index = _parent.grab_next_file(); !negative(index);
+        index = _parent.grab_next_file()) {
+      _parent.perform_copy(_parent._sources->get(index),
+          _parent._destinations->get(index), true);
+    }
+  }
+
+private:
+  file_copier &_parent;
+};
+
+//////////////
+
+file_copier::file_copier(int pool_size, int buffer_size)
+: _lock(new mutex),
+  _pool_size(maximum(1, pool_size)),
+  _buffer_size(maximum(int(KILOBYTE), buffer_size)),
+  _bytes(0),
+  _files(0),
+  _failures(0),
+  _kernel_copies(0),
+  _busy_time(0),
+  _sources(NULL_POINTER),
+  _destinations(NULL_POINTER),
+  _next_file(0),
+  _first_failure(common::OKAY)
+{}
+
+file_copier::~file_copier()
+{
+  WHACK(_lock);
+}
+
+void file_copier::reset_statistics()
+{
+  AUTO_LOCK;
+  _bytes = 0;
+  _files = 0;
+  _failures = 0;
+  _kernel_copies = 0;
+  _busy_time = 0;
+}
+
+double file_copier::bytes_copied() const { AUTO_LOCK; return _bytes; }
+
+int file_copier::files_copied() const { AUTO_LOCK; return _files; }
+
+int file_copier::failures() const { AUTO_LOCK; return _failures; }
+
+int file_copier::kernel_copies() const { AUTO_LOCK; return _kernel_copies; }
+
+double file_copier::busy_time() const { AUTO_LOCK; return _busy_time; }
+
+double file_copier::megabytes_per_second() const
+{
+  AUTO_LOCK;
+  if (_busy_time <= 0) return 0;
+  return _bytes / double(MEGABYTE) / (_busy_time / double(SECOND_ms));
+}
+
+double file_copier::files_per_second() const
+{
+  AUTO_LOCK;
+  if (_busy_time <= 0) return 0;
+  return double(_files) / (_busy_time / double(SECOND_ms));
+}
+
+astring file_copier::text_form() const
+{
+  return a_sprintf("copied %d files (%d by the kernel, %d failed), %.1f MB "
+      "in %.0f ms: %.1f MB/s, %.1f files/s", files_copied(), kernel_copies(),
+      failures(), bytes_copied() / double(MEGABYTE), busy_time(),
+      megabytes_per_second(), files_per_second());
+}
+
+void file_copier::record(const outcome &result, double bytes, bool kernel)
+{
+  AUTO_LOCK;
+  if (result != common::OKAY) {
+    _failures++;
+    if (_first_failure == common::OKAY) _first_failure = result;
+    return;
+  }
+  _files++;
+  _bytes += bytes;
+  if (kernel) _kernel_copies++;
+}
+
+int file_copier::grab_next_file()
+{
+  AUTO_LOCK;
+  if (!_sources || (_next_file >= _sources->length())) return common::NOT_FOUND;
+  return _next_file++;
+}
+
+outcome file_copier::copy_file(const astring &source,
+    const astring &destination)
+{
+  time_stamp started;
+  outcome to_return = perform_copy(source, destination, true);
+  AUTO_LOCK;
+  _busy_time += time_stamp().value() - started.value();
+  return to_return;
+}
+
+outcome file_copier::copy_pipelined(const astring &source,
+    const astring &destination)
+{
+  time_stamp started;
+  outcome to_return = perform_copy(source, destination, false);
+  AUTO_LOCK;
+  _busy_time += time_stamp().value() - started.value();
+  return to_return;
+}
+
+outcome file_copier::copy_files(const string_array &sources,
+    const string_array &destinations)
+{
+  FUNCDEF("copy_files");
+  if (sources.length() != destinations.length()) return common::BAD_INPUT;
+  time_stamp started;
+  {
+    AUTO_LOCK;
+    _sources = &sources;
+    _destinations = &destinations;
+    _next_file = 0;
+    _first_failure = common::OKAY;
+  }
+  // there's no point in starting more threads than there are files.
+  int workers = minimum(_pool_size, sources.length());
+  amorph<copy_worker> pool;
+  for (int i = 0; i < workers; i++) {
+    pool.append(new copy_worker(*this));
+    pool.borrow(i)->start(NULL_POINTER);
+  }
+  // the stop waits for each worker to run out of files.
+  for (int i = 0; i < workers; i++) pool.borrow(i)->stop();
+
+  AUTO_LOCK;
+  _sources = NULL_POINTER;
+  _destinations = NULL_POINTER;
+  _busy_time += time_stamp().value() - started.value();
+#ifdef DEBUG_FILE_COPIER
+  LOG(a_sprintf("%d workers copied %d files.", workers, sources.length()));
+#endif
+  return _first_failure;
+}
+
+outcome file_copier::perform_copy(const astring &source,
+    const astring &destination, bool allow_kernel)
+{
+  // check that the source exists...
+  filename source_path(source);
+  if (!source_path.exists()) {
+    record(heavy_file_operations::SOURCE_MISSING, 0, false);
+    return heavy_file_operations::SOURCE_MISSING;
+  }
+  file_time source_time(source_path);  // get the time on the source.
+
+  // make sure the target directory exists...
+  filename target_path(destination);
+  if (!directory::recursive_create(target_path.dirname().raw())) {
+    record(heavy_file_operations::TARGET_DIR_ERROR, 0, false);
+    return heavy_file_operations::TARGET_DIR_ERROR;
+  }
+
+  outcome ret = common::NOT_IMPLEMENTED;
+  heavy_file_operations::copy_methods method
+      = heavy_file_operations::BUFFERED_COPY;
+  if (allow_kernel)
+    ret = heavy_file_operations::kernel_copy(source, destination, method);
+  double bytes = 0;
+  if (ret == common::NOT_IMPLEMENTED)
+    ret = pipeline(source, destination, bytes);
+  else if (ret == common::OKAY)
+    bytes = double(huge_file(destination, "rb").size());
+  if (ret == common::OKAY) source_time.set_time(target_path);
+  record(ret, bytes, method != heavy_file_operations::BUFFERED_COPY);
+  return ret;
+}
+
+outcome file_copier::pipeline(const astring &source,
+    const astring &destination, double &bytes)
+{
+  bytes = 0;
+  huge_file source_file(source, "rb");
+  if (!source_file.good()) return heavy_file_operations::SOURCE_MISSING;
+  source_file.advise(huge_file::SEQUENTIAL_ACCESS);
+  huge_file target_file(destination, "wb");
+  if (!target_file.good()) return heavy_file_operations::TARGET_ACCESS_ERROR;
+
+  pipeline_slot slots[PIPELINE_DEPTH];
+  copy_signal empties(PIPELINE_DEPTH);
+  copy_signal fulls(0);
+  bool quitting = false;
+  pipeline_reader reader(source_file, slots, _buffer_size, empties, fulls,
+      quitting);
+  reader.start(NULL_POINTER);
+
+  outcome to_return = common::OKAY;
+  huge_file::file_offset position = 0;
+  for (int index = 0; ; index = (index + 1) % PIPELINE_DEPTH) {
+    fulls.wait();
+    pipeline_slot &slot = slots[index];
+    if (slot._failed) {
+      to_return = common::FAILURE;
+      break;
+    }
+    if (!slot._filled) break;  // that's the end of the file.
+    // the reader is busy filling the other buffer while we write this one.
+    int written = 0;
+    outcome ret = target_file.write_at(position, slot._data, written);
+    if ( (ret != huge_file::OKAY) || (written != slot._filled) ) {
+      to_return = heavy_file_operations::TARGET_ACCESS_ERROR;
+      // let the reader know it should stop, and make sure it isn't stuck
+      // waiting for a buffer.
+      quitting = true;
+      empties.post();
+      break;
+    }
+    position += written;
+    empties.post();
+  }
+  reader.stop();
+  bytes = double(position);
+  return to_return;
+}
+
+} //namespace.
+
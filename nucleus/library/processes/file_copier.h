@@ -0,0 +1,137 @@
+#ifndef FILE_COPIER_CLASS
+#define FILE_COPIER_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_copier                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <basis/mutex.h>
+#include <basis/outcome.h>
+#include <structures/string_array.h>
+
+namespace processes {
+
+//! A multi-threaded engine for copying large files and large numbers of files.
+/*!
+  Single files are copied inside the OS kernel when possible (see
+  heavy_file_operations::kernel_copy()).  When the kernel can't help, the
+  file is copied through a double-buffered pipeline where a reader thread
+  fills one buffer while the calling thread writes out the other, so reads
+  and writes overlap rather than strictly alternating.
+
+  Many files can be copied at once with copy_files(), which hands them out to
+  a bounded pool of worker threads.  This is a big win for lots of small
+  files, where the time is dominated by opening and closing them.
+
+  The copier keeps running totals of what it has copied so that throughput
+  can be reported in megabytes and files per second.  The statistics methods
+  are thread-safe, but only one copy operation should be run on a copier at
+  a time.
+*/
+
+class file_copier : public virtual basis::root_object
+{
+public:
+  enum copier_defaults {
+    DEFAULT_POOL_SIZE = 8,  //!< how many files are copied concurrently.
+    DEFAULT_BUFFER_SIZE = 1 * basis::MEGABYTE
+      //!< the size of each buffer in the read/write pipeline.
+  };
+
+  file_copier(int pool_size = DEFAULT_POOL_SIZE,
+          int buffer_size = DEFAULT_BUFFER_SIZE);
+    //!< creates a copier that runs up to "pool_size" copies at once.
+    /*!< the pipelined copy uses two buffers of "buffer_size" bytes. */
+
+  virtual ~file_copier();
+
+  DEFINE_CLASS_NAME("file_copier");
+
+  int pool_size() const { return _pool_size; }
+    //!< the maximum number of files copied at the same time.
+
+  basis::outcome copy_file(const basis::astring &source,
+          const basis::astring &destination);
+    //!< copies the "source" file to the "destination".
+    /*!< the target's directory is created if needed, and the target gets the
+    source's timestamp.  the outcomes are from heavy_file_operations. */
+
+  basis::outcome copy_pipelined(const basis::astring &source,
+          const basis::astring &destination);
+    //!< like copy_file(), but always uses the reader/writer pipeline.
+    /*!< this is mainly useful for comparing against the kernel copy. */
+
+  basis::outcome copy_files(const structures::string_array &sources,
+          const structures::string_array &destinations);
+    //!< copies each of the "sources" to the matching "destinations".
+    /*!< the files are spread across the pool of worker threads.  if any of
+    the copies fail, the first failure is returned after all of the other
+    files have been attempted.  BAD_INPUT is returned if the lists are not
+    the same length. */
+
+  void reset_statistics();
+    //!< zeroes the running totals.
+
+  double bytes_copied() const;  //!< the total bytes copied so far.
+  int files_copied() const;  //!< the number of files successfully copied.
+  int failures() const;  //!< the number of files that could not be copied.
+  int kernel_copies() const;
+    //!< how many of the files were copied by the OS kernel.
+  double busy_time() const;
+    //!< the milliseconds spent inside copy operations so far.
+
+  double megabytes_per_second() const;  //!< the copying throughput in bytes.
+  double files_per_second() const;  //!< the copying throughput in files.
+
+  basis::astring text_form() const;
+    //!< reports the statistics and throughput in a readable form.
+
+private:
+  friend class copy_worker;
+  basis::mutex *_lock;  //!< protects our statistics and the work list.
+  int _pool_size;  //!< how many worker threads we use.
+  int _buffer_size;  //!< the size of each pipeline buffer.
+  double _bytes;  //!< the total bytes copied.
+  int _files;  //!< the number of files copied.
+  int _failures;  //!< the number of files that could not be copied.
+  int _kernel_copies;  //!< how many files the kernel copied for us.
+  double _busy_time;  //!< the milliseconds spent copying.
+
+  // the shared work list used by copy_files().
+  const structures::string_array *_sources;
+  const structures::string_array *_destinations;
+  int _next_file;  //!< the next index to hand out to a worker.
+  basis::outcome _first_failure;  //!< the first error seen by the workers.
+
+  basis::outcome perform_copy(const basis::astring &source,
+          const basis::astring &destination, bool allow_kernel);
+    //!< does the real work for copy_file() and copy_pipelined().
+  basis::outcome pipeline(const basis::astring &source,
+          const basis::astring &destination, double &bytes);
+    //!< copies the file through the double-buffered reader and writer.
+  int grab_next_file();
+    //!< provides the index of the next file for a worker, or -1 if done.
+  void record(const basis::outcome &result, double bytes, bool kernel);
+    //!< adds a finished copy into the statistics.
+
+  // not appropriate.
+  file_copier(const file_copier &);
+  file_copier &operator =(const file_copier &);
+};
+
+} //namespace.
+
+#endif
+
@@ -0,0 +1,295 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_hasher                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "ethread.h"
+#include "file_hasher.h"
+
+#include <basis/array.h>
+#include <basis/functions.h>
+#include <filesystem/directory_tree.h>
+#include <filesystem/file_info.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <filesystem/hash_cache.h>
+#include <filesystem/huge_file.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/amorph.h>
+#include <timely/time_stamp.h>
+
+using namespace basis;
+using namespace filesystem;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+
+namespace processes {
+
+//#define DEBUG_FILE_HASHER
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+#undef AUTO_LOCK
+#define AUTO_LOCK auto_synchronizer l(*_lock)
+
+//////////////
+
+// a file waiting to be hashed, along with the hashes of its chunks.
+
+class hash_target
+{
+public:
+  astring _path;  // where the file lives.
+  astring _id;  // the file's identity for the cache.
+  file_info *_info;  // where the result goes, if this came from a tree.
+  huge_file::file_offset _size;  // the size seen when the file was queued.
+  array<content_hash::wide_hash> _chunks;  // the hash of each chunk.
+  bool _failed;  // true if any chunk couldn't be read.
+
+  hash_target(const astring &path, const astring &id, file_info *info,
+      huge_file::file_offset size)
+  : _path(path), _id(id), _info(info), _size(size),
+    _chunks(content_hash::chunks(double(size)), NULL_POINTER,
+        byte_array::SIMPLE_COPY),
+    _failed(false) {}
+};
+
+class hash_batch : public amorph<hash_target> {};
+
+//////////////
+
+// one of the hashing threads.  it keeps the file it's working on open in
+// case the next chunk it's handed comes from the same file.
+
+class hash_worker : public ethread
+{
+public:
+  hash_worker(file_hasher &parent) : ethread(), _parent(parent) {}
+
+  DEFINE_CLASS_NAME("hash_worker");
+
+  virtual void perform_activity(void *formal(ptr)) {
+    huge_file *file = NULL_POINTER;
+    int open_target = -1;
+    byte_array chunk;
+    int target, chunk_index;
+    while (_parent.next_job(target, chunk_index)) {
+      hash_target &current = *_parent._batch->borrow(target);
+      if (target != open_target) {
+        WHACK(file);
+        file = new huge_file(current._path, "rb");
+        file->advise(huge_file::SEQUENTIAL_ACCESS);
+        open_target = target;
+      }
+      huge_file::file_offset where = huge_file::file_offset(chunk_index)
+          * content_hash::CHUNK_SIZE;
+      int desired = int(minimum(huge_file::file_offset(content_hash::CHUNK_SIZE),
+          current._size - where));
+      int read = 0;
+      bool worked = file->good()
+          && (file->read_at(where, chunk, desired, read) == huge_file::OKAY)
+          && (read == desired);  // a short read means the file changed.
+      _parent.chunk_done(target, chunk_index,
+          worked? content_hash::hash_chunk(chunk, chunk_index) : 0, read, worked);
+    }
+    WHACK(file);
+  }
+
+private:
+  file_hasher &_parent;
+};
+
+//////////////
+
+file_hasher::file_hasher(int threads, const astring &sidecar)
+: _lock(new mutex),
+  _threads(maximum(1, threads)),
+  _cache(new hash_cache(sidecar)),
+  _batch(new hash_batch),
+  _next_target(0),
+  _next_chunk(0),
+  _bytes_read(0),
+  _files_hashed(0),
+  _cache_hits(0),
+  _hash_time(0)
+{}
+
+file_hasher::~file_hasher()
+{
+  WHACK(_batch);
+  WHACK(_cache);
+  WHACK(_lock);
+}
+
+hash_cache &file_hasher::cache() { return *_cache; }
+
+bool file_hasher::save_cache()
+{
+  AUTO_LOCK;
+  _cache->forget_unused();
+  return _cache->save();
+}
+
+double file_hasher::bytes_read() const { AUTO_LOCK; return _bytes_read; }
+
+int file_hasher::files_hashed() const { AUTO_LOCK; return _files_hashed; }
+
+int file_hasher::cache_hits() const { AUTO_LOCK; return _cache_hits; }
+
+double file_hasher::hash_time() const { AUTO_LOCK; return _hash_time; }
+
+astring file_hasher::text_form() const
+{
+  AUTO_LOCK;
+  return a_sprintf("%d threads hashed %d files (%.0f bytes) in %.0f ms, "
+      "with %d cache hits", _threads, _files_hashed, _bytes_read, _hash_time,
+      _cache_hits);
+}
+
+bool file_hasher::next_job(int &target, int &chunk)
+{
+  AUTO_LOCK;
+  while (_next_target < _batch->elements()) {
+    hash_target &current = *_batch->borrow(_next_target);
+    if (_next_chunk < current._chunks.length()) {
+      target = _next_target;
+      chunk = _next_chunk++;
+      return true;
+    }
+    _next_target++;
+    _next_chunk = 0;
+  }
+  return false;
+}
+
+void file_hasher::chunk_done(int target, int chunk, wide_hash hash, int size,
+    bool worked)
+{
+  // each chunk has its own slot, but the failure flag and counters are shared.
+  hash_target &current = *_batch->borrow(target);
+  current._chunks[chunk] = hash;
+  AUTO_LOCK;
+  _bytes_read += size;
+  if (!worked) current._failed = true;
+}
+
+bool file_hasher::run_batch()
+{
+  FUNCDEF("run_batch");
+  int total_chunks = 0;
+  for (int i = 0; i < _batch->elements(); i++)
+    total_chunks += _batch->borrow(i)->_chunks.length();
+  _next_target = 0;
+  _next_chunk = 0;
+
+  // there's no point in starting more threads than there are chunks.
+  int to_start = minimum(_threads, total_chunks);
+  hash_worker **workers = new hash_worker *[to_start];
+  for (int i = 0; i < to_start; i++) workers[i] = new hash_worker(*this);
+  for (int i = 0; i < to_start; i++) workers[i]->start(NULL_POINTER);
+  // each worker exits once the work list is empty.
+  for (int i = 0; i < to_start; i++) workers[i]->stop();
+  for (int i = 0; i < to_start; i++) WHACK(workers[i]);
+  delete [] workers;
+
+  bool all_worked = true;
+  for (int i = 0; i < _batch->elements(); i++) {
+    hash_target &current = *_batch->borrow(i);
+    if (current._failed) {
+      LOG(astring("failed to hash ") + current._path);
+      all_worked = false;
+      continue;
+    }
+    wide_hash hash = content_hash::combine(current._chunks.observe(),
+        current._chunks.length(), double(current._size));
+    if (current._info) current._info->_content_hash = hash;
+    _cache->store(current._id, hash);
+    _files_hashed++;
+  }
+  _batch->reset();
+  return all_worked;
+}
+
+bool file_hasher::hash_file(const astring &path, wide_hash &hash)
+{
+  time_stamp started;
+  _bytes_read = 0;
+  _files_hashed = 0;
+  _cache_hits = 0;
+  hash = 0;
+  astring id;
+  double size;
+  if (!hash_cache::identity(path, id, size)) return false;
+  bool worked = true;
+  if (_cache->lookup(id, hash)) {
+    _cache_hits++;
+  } else {
+    file_info result;
+    _batch->append(new hash_target(path, id, &result,
+        huge_file::file_offset(size)));
+    worked = run_batch();
+    hash = result._content_hash;
+  }
+  _hash_time = time_stamp().value() - started.value();
+  return worked;
+}
+
+bool file_hasher::hash_tree(directory_tree &tree)
+{
+  FUNCDEF("hash_tree");
+  time_stamp started;
+  _bytes_read = 0;
+  _files_hashed = 0;
+  _cache_hits = 0;
+  bool all_worked = true;
+
+  dir_tree_iterator *ted = tree.start(directory_tree::prefix);
+  filename curr;
+  while (directory_tree::current_dir(*ted, curr)) {
+    filename_list *files = directory_tree::access(*ted);
+    for (int i = 0; files && (i < files->elements()); i++) {
+      file_info *info = files->borrow(i);
+      if (info->_content_hash) continue;  // already known.
+      astring path = filename(curr.raw(), info->raw()).raw();
+      astring id;
+      double size;
+      if (!hash_cache::identity(path, id, size)) {
+#ifdef DEBUG_FILE_HASHER
+        LOG(astring("could not find ") + path);
+#endif
+        all_worked = false;
+        continue;
+      }
+      if (_cache->lookup(id, info->_content_hash)) {
+        _cache_hits++;
+        continue;
+      }
+      _batch->append(new hash_target(path, id, info,
+          huge_file::file_offset(size)));
+    }
+    directory_tree::next(*ted);
+  }
+  directory_tree::throw_out(ted);
+
+  if (!run_batch()) all_worked = false;
+  _hash_time = time_stamp().value() - started.value();
+#ifdef DEBUG_FILE_HASHER
+  LOG(text_form());
+#endif
+  return all_worked;
+}
+
+} //namespace.
+
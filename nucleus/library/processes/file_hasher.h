@@ -0,0 +1,124 @@
+#ifndef FILE_HASHER_CLASS
+#define FILE_HASHER_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : file_hasher                                                       *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <basis/mutex.h>
+#include <filesystem/content_hash.h>
+
+// forward.
+namespace filesystem {
+  class directory_tree;
+  class hash_cache;
+}
+
+namespace processes {
+
+// forward.
+class hash_batch;
+class hash_worker;
+
+//! Computes full content hashes for files using a pool of threads.
+/*!
+  Every file is split into the chunks defined by filesystem::content_hash,
+  and all of the chunks from all of the files being hashed go into one list
+  of work.  The worker threads each pull the next chunk from that list,
+  read it with a positional read and hash it.  This keeps all the threads
+  busy whether there is one enormous file or thousands of small ones.  The
+  resulting hashes are identical to content_hash::hash_file().
+
+  A filesystem::hash_cache remembers the hash for each file identity, so
+  files that haven't changed since they were last hashed are never read
+  again.  Giving the hasher a "sidecar" file keeps the cache between runs.
+  Only one hashing run should be active at a time on a given hasher.
+*/
+
+class file_hasher : public virtual basis::root_object
+{
+public:
+  typedef filesystem::content_hash::wide_hash wide_hash;
+
+  enum hasher_defaults {
+    DEFAULT_THREADS = 4  //!< the number of worker threads used for hashing.
+  };
+
+  file_hasher(int threads = DEFAULT_THREADS,
+          const basis::astring &sidecar = basis::astring::empty_string());
+    //!< creates a hasher that will use up to "threads" workers.
+    /*!< if the "sidecar" is not empty, the cache of hashes is loaded from
+    that file and can be saved back to it with save_cache(). */
+
+  virtual ~file_hasher();
+
+  DEFINE_CLASS_NAME("file_hasher");
+
+  int threads() const { return _threads; }
+    //!< returns the number of worker threads used per hashing run.
+
+  filesystem::hash_cache &cache();  //!< provides access to the cache.
+
+  bool save_cache();
+    //!< drops hashes for files that weren't seen and saves the sidecar.
+
+  bool hash_file(const basis::astring &path, wide_hash &hash);
+    //!< hashes the file at "path", splitting the reading across threads.
+    /*!< false is returned if the file could not be completely read. */
+
+  bool hash_tree(filesystem::directory_tree &tree);
+    //!< fills in the content hash for every file in the "tree".
+    /*!< only files that don't have a hash yet are visited, so this is cheap
+    to call again after some parts of the tree were recalculated.  false is
+    returned if any file could not be hashed; those files keep a hash of
+    zero. */
+
+  double bytes_read() const;  //!< bytes read from disk by the last run.
+  int files_hashed() const;  //!< files whose hash was computed last run.
+  int cache_hits() const;  //!< files whose hash came from the cache.
+  double hash_time() const;  //!< milliseconds taken by the last run.
+
+  basis::astring text_form() const;
+    //!< reports the statistics for the last run.
+
+private:
+  friend class hash_worker;
+  basis::mutex *_lock;  //!< protects the work list and our counters.
+  int _threads;  //!< the number of workers we start.
+  filesystem::hash_cache *_cache;  //!< remembers hashes of unchanged files.
+  hash_batch *_batch;  //!< the files being hashed in the current run.
+  int _next_target;  //!< the file holding the next chunk to hand out.
+  int _next_chunk;  //!< the next chunk to hand out within that file.
+  double _bytes_read;  //!< bytes read during the current run.
+  int _files_hashed;  //!< files hashed during the current run.
+  int _cache_hits;  //!< files found in the cache during the current run.
+  double _hash_time;  //!< the duration of the last run.
+
+  bool run_batch();
+    //!< hashes everything in the batch and returns true if all worked.
+  bool next_job(int &target, int &chunk);
+    //!< hands out the next piece of work, or returns false when none is left.
+  void chunk_done(int target, int chunk, wide_hash hash, int size, bool worked);
+    //!< records the result of hashing a chunk.
+
+  // not appropriate.
+  file_hasher(const file_hasher &);
+  file_hasher &operator =(const file_hasher &);
+};
+
+} //namespace.
+
+#endif
+
@@ -0,0 +1,79 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : interprocess_mutex                                                *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "interprocess_mutex.h"
+
+#include <errno.h>
+#include <pthread.h>
+
+using namespace basis;
+
+namespace processes {
+
+interprocess_mutex::interprocess_mutex(void *storage)
+: _storage(storage),
+  _recovered(false)
+{}
+
+interprocess_mutex::~interprocess_mutex() { _storage = NULL_POINTER; }
+
+int interprocess_mutex::storage_size() { return sizeof(pthread_mutex_t); }
+
+bool interprocess_mutex::initialize(void *storage)
+{
+  pthread_mutexattr_t attribs;
+  if (pthread_mutexattr_init(&attribs)) return false;
+  // the mutex must work across processes, must survive the death of its
+  // owner, and can be locked again by the thread that holds it.  darwin has
+  // no robust mutexes, so there it's just shared between the processes.
+  int ret = pthread_mutexattr_setpshared(&attribs, PTHREAD_PROCESS_SHARED);
+#ifndef __APPLE__
+  if (!ret) ret = pthread_mutexattr_setrobust(&attribs, PTHREAD_MUTEX_ROBUST);
+#endif
+  if (!ret) ret = pthread_mutexattr_settype(&attribs, PTHREAD_MUTEX_RECURSIVE);
+  if (!ret) ret = pthread_mutex_init((pthread_mutex_t *)storage, &attribs);
+  pthread_mutexattr_destroy(&attribs);
+  return !ret;
+}
+
+bool interprocess_mutex::handle_lock_result(int result)
+{
+  _recovered = false;
+#ifndef __APPLE__
+  if (result == EOWNERDEAD) {
+    // the last owner died holding the lock.  we have it now, but the mutex
+    // must be marked as fixed or it becomes unusable once we unlock it.
+    pthread_mutex_consistent((pthread_mutex_t *)_storage);
+    _recovered = true;
+    return true;
+  }
+#endif
+  return !result;
+}
+
+bool interprocess_mutex::lock()
+{ return handle_lock_result(pthread_mutex_lock((pthread_mutex_t *)_storage)); }
+
+bool interprocess_mutex::try_lock()
+{ return handle_lock_result(pthread_mutex_trylock((pthread_mutex_t *)_storage)); }
+
+void interprocess_mutex::unlock()
+{ pthread_mutex_unlock((pthread_mutex_t *)_storage); }
+
+void interprocess_mutex::establish_lock() { lock(); }
+
+void interprocess_mutex::repeal_lock() { unlock(); }
+
+} //namespace.
+
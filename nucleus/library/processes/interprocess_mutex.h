@@ -0,0 +1,91 @@
+#ifndef INTERPROCESS_MUTEX_CLASS
+#define INTERPROCESS_MUTEX_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : interprocess_mutex                                                *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/contracts.h>
+#include <basis/enhance_cpp.h>
+
+namespace processes {
+
+//! A mutex that lives in shared memory and synchronizes separate processes.
+/*!
+  The rendezvous also locks between processes, but every lock and unlock
+  goes to the file system.  This mutex is instead kept in memory shared by
+  the cooperating processes, so locking it costs nothing more than a basis
+  mutex does unless some other process is holding it.  The mutex is robust:
+  if a process dies while holding it, the next locker gets the lock anyway
+  and is told via recovered() that the protected data may be half-updated.
+  (Darwin lacks robust mutexes, so there a dead owner's lock is never freed.)
+  Like the basis mutex, it can be locked again by the thread that holds it,
+  as long as the unlocks match the locks.
+*/
+
+class interprocess_mutex : public virtual basis::base_synchronizer
+{
+public:
+  interprocess_mutex(void *storage);
+    //!< operates on the mutex kept in "storage", which is not owned by us.
+    /*!< the "storage" must be storage_size() bytes of shared memory that were
+    set up with initialize() by whoever created that memory. */
+
+  virtual ~interprocess_mutex();
+    //!< does not affect the mutex in the storage, which others may still use.
+
+  DEFINE_CLASS_NAME("interprocess_mutex");
+
+  static int storage_size();
+    //!< the number of bytes needed to hold the mutex in shared memory.
+
+  static bool initialize(void *storage);
+    //!< sets up a new mutex in "storage", which must be shared memory.
+    /*!< this must only be done once, by the creator of the memory, before any
+    other process can see it. */
+
+  bool lock();
+    //!< waits until the mutex is ours.
+    /*!< false is returned only if the mutex is unusable, which happens when a
+    previous owner died and the lock was not recovered properly. */
+
+  bool try_lock();
+    //!< grabs the mutex if it's free, but returns false rather than waiting.
+
+  void unlock();
+    //!< gives up the mutex so that others can have it.
+
+  bool recovered() const { return _recovered; }
+    //!< true if the last lock was taken from a process that died holding it.
+    /*!< whatever the mutex protects may have been left inconsistent. */
+
+  // these implement the base_synchronizer interface.
+  virtual void establish_lock();
+  virtual void repeal_lock();
+
+private:
+  void *_storage;  //!< where the real mutex lives in the shared memory.
+  bool _recovered;  //!< true if the last lock recovered from a dead owner.
+
+  bool handle_lock_result(int result);
+    //!< deals with what locking returned, recovering from a dead owner.
+
+  // not appropriate.
+  interprocess_mutex(const interprocess_mutex &);
+  interprocess_mutex &operator =(const interprocess_mutex &);
+};
+
+} //namespace.
+
+#endif
+
@@ -10,6 +10,7 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include "child_supervisor.h"
 #include "launch_process.h"
 
 #include <application/windoze_helper.h>
@@ -56,7 +57,7 @@ mutex &__process_synchronizer() {
   return __hidden_synch;
 }
 
-int_set __our_kids() {
+int_set &__our_kids() {
   static int_set __hidden_kids;
   return __hidden_kids;
 }
@@ -143,7 +144,7 @@ char_star_array launch_process::break_line(astring &app, const astring &paramete
     last_posn = posns[i] + 1;
   }
   // catch anything left after last separator.
-  if (last_posn < parameters.length() - 1) {
+  if (last_posn < parameters.length()) {
     int len = parameters.length() - last_posn;
     to_return += new char[len + 1];
     parameters.substring(last_posn, parameters.length() - 1)
@@ -179,6 +180,14 @@ basis::un_int launch_process::run(const astring &app_name_in, const astring &com
   // unix / linux implementation.
   if (flag & RETURN_IMMEDIATELY) {
     // they want to get back right away.
+#ifdef __LINUX__
+    if (child_supervisor::supported()) {
+      // the supervisor starts the child without forking and reaps it as soon
+      // as it exits.
+      return child_supervisor::program_wide().spawn(app_name_in, command_line,
+          child_id);
+    }
+#endif
     pid_t kid_pid = fork();
 #ifdef DEBUG_LAUNCH_PROCESS
     LOG(a_sprintf("launch fork returned %d\n", kid_pid));
@@ -0,0 +1,293 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : proc_scanner                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "proc_scanner.h"
+
+#include <basis/functions.h>
+#include <structures/byte_hasher.h>
+#include <structures/hash_table.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __LINUX__
+  #include <dirent.h>
+  #include <fcntl.h>
+  #include <strings.h>
+  #include <unistd.h>
+#endif
+
+using namespace basis;
+using namespace structures;
+
+namespace processes {
+
+const int PROC_BUFFER_SIZE = 4 * KILOBYTE;
+  // plenty for a stat file, and for the program path at the start of a
+  // command line.
+
+const int EXPECTED_PROCESSES = 1000;
+  // a rough guess at how many processes are running.
+
+//////////////
+
+// what we remember about a process between snapshots.
+
+class known_process
+{
+public:
+  process_entry _entry;  //!< the information reported for the process.
+  double _started;  //!< when the process started, in clock ticks since boot.
+
+  known_process() : _started(0) {}
+};
+
+class known_processes : public hash_table<int, known_process>
+{
+public:
+  known_processes()
+      : hash_table<int, known_process>(rotating_byte_hasher(),
+            EXPECTED_PROCESSES) {}
+};
+
+//////////////
+
+// returns true if the directory "name" is all digits, like a process id.
+static bool is_pid(const char *name)
+{
+  if (!name[0]) return false;
+  for (const char *c = name; *c; c++)
+    if ( (*c < '0') || (*c > '9') ) return false;
+  return true;
+}
+
+// makes a kernel thread's name, or other bracketed path, safe to treat as a
+// filename by replacing any slashes inside the brackets.
+static void patch_brackets(astring &path)
+{
+  int brackets_in = 0;
+  for (int i = 0; i < path.length(); i++) {
+    if (path[i] == '[') brackets_in++;
+    else if (path[i] == ']') brackets_in--;
+    if (brackets_in && ( (path[i] == '/') || (path[i] == '\\') ) )
+      path[i] = '#';
+  }
+}
+
+//////////////
+
+proc_scanner::proc_scanner()
+: _known(new known_processes),
+  _buffer(PROC_BUFFER_SIZE),
+  _paths_read(0)
+{}
+
+proc_scanner::~proc_scanner() { WHACK(_known); }
+
+bool proc_scanner::supported()
+{
+#ifdef __LINUX__
+  return !access("/proc/self/stat", R_OK);
+#else
+  return false;
+#endif
+}
+
+#ifndef __LINUX__
+int proc_scanner::read_file(int formal(proc_dir), const char *formal(pid),
+    const char *formal(which))
+#else
+int proc_scanner::read_file(int proc_dir, const char *pid, const char *which)
+#endif
+{
+  _buffer[0] = '\0';
+#ifndef __LINUX__
+  return -1;
+#else
+  char path[64];
+  snprintf(path, sizeof(path), "%s/%s", pid, which);
+  int fd = openat(proc_dir, path, O_RDONLY);
+  if (negative(fd)) return -1;
+  int length = 0;
+  while (length < PROC_BUFFER_SIZE - 1) {
+    ssize_t ret = read(fd, _buffer.access() + length,
+        PROC_BUFFER_SIZE - 1 - length);
+    if (ret <= 0) break;
+    length += int(ret);
+  }
+  close(fd);
+  _buffer[length] = '\0';
+  return length;
+#endif
+}
+
+bool proc_scanner::read_stat(int proc_dir, const char *pid,
+    process_entry &to_fill, astring &name, double &started)
+{
+  if (read_file(proc_dir, pid, "stat") <= 0) return false;
+  // the name is in parentheses, but it can hold parentheses too, so the
+  // last closing one is where the name ends.
+  char *text = (char *)_buffer.access();
+  char *open_paren = strchr(text, '(');
+  char *close_paren = strrchr(text, ')');
+  if (!open_paren || !close_paren || (close_paren < open_paren)) return false;
+  name = astring(astring::UNTERMINATED, open_paren + 1,
+      int(close_paren - open_paren - 1));
+  // the fields after the name start with the state, which is the third.
+  const int PARENT_FIELD = 4, THREADS_FIELD = 20, START_FIELD = 22;
+  int field = 3;
+  char *current = close_paren + 1;
+  while (*current && (field <= START_FIELD)) {
+    while (*current == ' ') current++;
+    if (field == PARENT_FIELD) to_fill._parent_process_id = un_int(atol(current));
+    else if (field == THREADS_FIELD) to_fill._threads = un_int(atol(current));
+    else if (field == START_FIELD) started = strtod(current, NULL_POINTER);
+    while (*current && (*current != ' ')) current++;
+    field++;
+  }
+  return field > START_FIELD;
+}
+
+bool proc_scanner::read_path(int proc_dir, const char *pid,
+    const astring &name, astring &path)
+{
+  int length = read_file(proc_dir, pid, "cmdline");
+  if (negative(length)) return false;
+  if (!length || !_buffer[0]) {
+    // kernel threads have no command line, so they're listed by their names.
+    path = astring("[") + name + "]";
+  } else {
+    // the program is the first of the null separated arguments.
+    path = (const char *)_buffer.observe();
+  }
+  patch_brackets(path);
+  return true;
+}
+
+bool proc_scanner::snapshot(process_entry_array &to_fill)
+{
+  to_fill.reset();
+  _paths_read = 0;
+#ifndef __LINUX__
+  return false;
+#else
+  DIR *dir = opendir("/proc");
+  if (!dir) return false;
+  int proc_dir = dirfd(dir);
+  known_processes *still_here = new known_processes;
+  astring name;
+  dirent *entry;
+  while ( (entry = readdir(dir)) ) {
+    if (!is_pid(entry->d_name)) continue;
+    int pid = atoi(entry->d_name);
+    known_process *found = _known->acquire(pid);
+    if (!found) found = new known_process;
+    double started = 0;
+    if (!read_stat(proc_dir, entry->d_name, found->_entry, name, started)) {
+      // the process must have exited since the directory was listed.
+      WHACK(found);
+      continue;
+    }
+    if ( (found->_entry._process_id != un_int(pid))
+        || (found->_started != started) ) {
+      // this is a new process, or at least a new one using an old id.
+      astring path;
+      if (!read_path(proc_dir, entry->d_name, name, path)) {
+        WHACK(found);
+        continue;
+      }
+      _paths_read++;
+      found->_entry._process_id = pid;
+      found->_entry.path(path);
+      found->_started = started;
+    }
+    to_fill += found->_entry;
+    still_here->add(pid, found);
+  }
+  closedir(dir);
+  // anything left in the old list has exited.
+  WHACK(_known);
+  _known = still_here;
+  return true;
+#endif
+}
+
+#ifndef __LINUX__
+bool proc_scanner::query(un_int formal(process_id),
+    process_entry &formal(to_fill))
+#else
+bool proc_scanner::query(un_int process_id, process_entry &to_fill)
+#endif
+{
+#ifndef __LINUX__
+  return false;
+#else
+  int proc_dir = open("/proc", O_RDONLY | O_DIRECTORY);
+  if (negative(proc_dir)) return false;
+  char pid[32];
+  snprintf(pid, sizeof(pid), "%u", process_id);
+  astring name, path;
+  double started;
+  bool worked = read_stat(proc_dir, pid, to_fill, name, started)
+      && read_path(proc_dir, pid, name, path);
+  close(proc_dir);
+  if (!worked) return false;
+  to_fill._process_id = process_id;
+  to_fill.path(path);
+  return true;
+#endif
+}
+
+bool proc_scanner::find_process_by_name(const astring &app_name, int_set &pids)
+{
+  pids.clear();
+#ifndef __LINUX__
+  return false;
+#else
+  DIR *dir = opendir("/proc");
+  if (!dir) return false;
+  int proc_dir = dirfd(dir);
+  // only a kernel thread can have a bracketed name.
+  bool kernel_thread = (app_name[0] == '[');
+  process_entry unused;
+  astring name, path;
+  double started;
+  dirent *entry;
+  while ( (entry = readdir(dir)) ) {
+    if (!is_pid(entry->d_name)) continue;
+    int length = read_file(proc_dir, entry->d_name, "cmdline");
+    if (negative(length)) continue;
+    if (!length || !_buffer[0]) {
+      if (!kernel_thread) continue;
+      if (!read_stat(proc_dir, entry->d_name, unused, name, started)
+          || !read_path(proc_dir, entry->d_name, name, path)
+          || !path.iequals(app_name))
+        continue;
+    } else {
+      // compare just the last component of the program's path.
+      const char *program = (const char *)_buffer.observe();
+      const char *base = program;
+      for (const char *c = program; *c; c++)
+        if ( (*c == '/') || (*c == '\\') ) base = c + 1;
+      if (strcasecmp(base, app_name.s())) continue;
+    }
+    pids.add(atoi(entry->d_name));
+  }
+  closedir(dir);
+  return pids.elements() > 0;
+#endif
+}
+
+} //namespace.
+
@@ -0,0 +1,101 @@
+#ifndef PROC_SCANNER_CLASS
+#define PROC_SCANNER_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : proc_scanner                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "process_entry.h"
+
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/contracts.h>
+#include <structures/set.h>
+
+namespace processes {
+
+// forward.
+class known_processes;
+
+//! Lists the running processes by reading the /proc file system directly.
+/*!
+  This is much cheaper than running the ps program and parsing what it
+  prints, which means a shell and ps get started for every look at the
+  process list.  Each process's "stat" file gives its parent and thread
+  count, and its "cmdline" gives the program's path.  The command lines of
+  processes seen on the previous snapshot are not read again, as long as
+  their start times show that they're still the same processes.  The file
+  contents are read into one buffer that's kept around between scans.
+  This is only supported on Linux; elsewhere, supported() returns false.
+*/
+
+class proc_scanner : public virtual basis::nameable
+{
+public:
+  proc_scanner();
+  virtual ~proc_scanner();
+
+  DEFINE_CLASS_NAME("proc_scanner");
+
+  static bool supported();
+    //!< returns true if the process list can be read from /proc here.
+
+  bool snapshot(process_entry_array &to_fill);
+    //!< replaces the contents of "to_fill" with the processes running now.
+    /*!< the paths are the same as process_control reports: the program
+    from the command line, or the bracketed name for a kernel thread. */
+
+  bool query(basis::un_int process_id, process_entry &to_fill);
+    //!< fills in the information for just the process "process_id".
+    /*!< false is returned if that process isn't running. */
+
+  bool find_process_by_name(const basis::astring &app_name,
+          structures::int_set &pids);
+    //!< finds the processes whose program is named "app_name".
+    /*!< this matches the same processes as process_control's
+    find_process_in_list(), but only reads each command line and never
+    builds the full process list. */
+
+  int paths_read() const { return _paths_read; }
+    //!< the number of command lines that the last snapshot() had to read.
+
+private:
+  known_processes *_known;  //!< the processes seen on the last snapshot.
+  basis::byte_array _buffer;  //!< holds the contents of each file read.
+  int _paths_read;  //!< command lines read on the last snapshot.
+
+  int read_file(int proc_dir, const char *pid, const char *which);
+    //!< reads the file "which" for the process "pid" into our buffer.
+    /*!< the number of bytes read is returned, or a negative number if the
+    file couldn't be read.  the buffer is always null terminated. */
+
+  bool read_stat(int proc_dir, const char *pid, process_entry &to_fill,
+          basis::astring &name, double &started);
+    //!< reads the "stat" file for "pid" to fill in the parent and threads.
+    /*!< the short "name" of the program and the time that it "started" are
+    also reported. */
+
+  bool read_path(int proc_dir, const char *pid, const basis::astring &name,
+          basis::astring &path);
+    //!< finds the program's "path" from the command line for "pid".
+    /*!< the "name" from the stat file is used if the command line's empty. */
+
+  // not appropriate.
+  proc_scanner(const proc_scanner &);
+  proc_scanner &operator =(const proc_scanner &);
+};
+
+} //namespace.
+
+#endif
+
@@ -27,6 +27,7 @@
 
 #include "process_entry.h"
 #include "process_control.h"
+#include "proc_scanner.h"
 
 #include <application/windoze_helper.h>
 #include <basis/astring.h>
@@ -77,6 +78,15 @@ namespace processes {
 class process_implementation_hider
 {
 public:
+#ifdef __LINUX__
+  proc_scanner *scanner;  //!< reads /proc when that's available.
+
+  process_implementation_hider()
+      : scanner(proc_scanner::supported()? new proc_scanner : NULL_POINTER) {}
+
+  ~process_implementation_hider() { WHACK(scanner); }
+#endif
+
 #ifdef _MSC_VER
   // psapi members:
   application_instance psapi_dll;
@@ -205,10 +215,25 @@ bool process_control::query_processes(process_entry_array &to_fill)
     return get_processes_with_psapi(to_fill);
   }
 #else
+#ifdef __LINUX__
+  if (_ptrs->scanner) return _ptrs->scanner->snapshot(to_fill);
+#endif
   return get_processes_with_ps(to_fill);
 #endif
 }
 
+bool process_control::find_process(const astring &app_name, int_set &pids)
+{
+  pids.clear();
+  if (!_healthy) return false;
+#ifdef __LINUX__
+  if (_ptrs->scanner) return _ptrs->scanner->find_process_by_name(app_name, pids);
+#endif
+  process_entry_array processes;
+  if (!query_processes(processes)) return false;
+  return find_process_in_list(processes, app_name, pids);
+}
+
 #ifdef _MSC_VER
 bool process_control::initialize_psapi_support()
 {
@@ -295,6 +320,13 @@ process_entry process_control::query_process(basis::un_int to_query)
   FUNCDEF("query_process");
   process_entry to_return;
 
+#ifdef __LINUX__
+  if (_ptrs->scanner) {
+    _ptrs->scanner->query(to_query, to_return);
+    return to_return;
+  }
+#endif
+
   process_entry_array to_fill;
   bool got_em = query_processes(to_fill);
   if (!got_em) return to_return;
@@ -304,13 +336,6 @@ process_entry process_control::query_process(basis::un_int to_query)
       return to_fill[i];
   }
 
-//hmmm: implement more specifically.
-#ifndef _MSC_VER
-//put in the single process grabber deal.
-#else
-//grab the entry from the list.
-#endif
-
   return to_return;
 }
 
@@ -516,7 +541,8 @@ bool process_control::get_processes_with_ps(process_entry_array &to_fill)
   // we ask the operating system to give us a list of processes.
   a_sprintf tmpfile("/tmp/proc_list_%d_%d.txt", application_configuration::process_id(),
       _rando->inclusive(1, 400000));
-  a_sprintf cmd("ps wax --format \"%%p %%a\" >%s", tmpfile.s());
+  // "ww" keeps ps from cutting long command lines off at the screen width.
+  a_sprintf cmd("ps wwax --format \"%%p %%a\" >%s", tmpfile.s());
 //hmmm: add more info as we expand the process entry.
   FILE *output = NULL_POINTER;  // initialize now to establish variable for our macro.
   int sysret = system(cmd.s());
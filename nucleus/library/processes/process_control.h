@@ -52,6 +52,14 @@ public:
 
   bool query_processes(process_entry_array &to_fill);
     //!< finds the processes that are running and drops them into "to_fill".
+    /*!< on Linux, the list is read from /proc by a proc_scanner, which only
+    has to look at the command lines of processes that are new since the
+    last query. */
+
+  bool find_process(const basis::astring &app_name, structures::int_set &pids);
+    //!< finds the "pids" of all the processes running the program "app_name".
+    /*!< this is the same as find_process_in_list() on a fresh process list,
+    except that on Linux no process list is built at all. */
 
   bool zap_process(basis::un_int to_zap);
     //!< preemptively zaps the process "to_zap".
@@ -72,6 +80,13 @@ public:
   void sort_by_pid(process_entry_array &to_sort);
     // sorts the list by process id.
 
+//#ifndef _MSC_VER
+  bool get_processes_with_ps(process_entry_array &to_fill);
+    //!< asks the ps program what processes exist.
+    /*!< this works on any unix, but it starts a shell and ps every time.
+    query_processes() only uses it where /proc can't be read. */
+//#endif
+
 private:
   process_implementation_hider *_ptrs;  //!< our OS baggage.
 //#ifndef _MSC_VER
@@ -81,9 +96,6 @@ private:
 //#endif
   bool _healthy;  //!< true if construction succeeded.
 
-//#ifndef _MSC_VER
-  bool get_processes_with_ps(process_entry_array &to_fill);
-    //!< asks the ps program what processes exist.
 /*
 #else
   // fill in our function pointers to access the kernel functions appropriate
@@ -14,61 +14,109 @@
 
 #include "safe_roller.h"
 
-#include <basis/functions.h>
-#include <basis/mutex.h>
-#include <structures/roller.h>
-#include <structures/static_memory_gremlin.h>
-
 using namespace basis;
-using namespace structures;
 
 namespace processes {
 
-SAFE_STATIC(mutex, __roller_synch, )
-
 void safe_add(int &to_change, int addition)
-{
-  auto_synchronizer l(__roller_synch());
-  to_change += addition;
-}
+{ __atomic_add_fetch(&to_change, addition, __ATOMIC_SEQ_CST); }
 
 //////////////
 
 safe_roller::safe_roller(int start_of_range, int end_of_range)
-: _rolling(new int_roller(start_of_range, end_of_range)),
-  _lock(new mutex)
+: _issued(0),
+  _start_of_range(start_of_range),
+  _span(signed_long_long(end_of_range) - start_of_range)
 {
+  // a broken range would leave nothing to divide by, so it just issues the
+  // start of the range over and over.
+  if (_span < 1) _span = 1;
 }
 
-safe_roller::~safe_roller()
+safe_roller::~safe_roller() {}
+
+signed_long_long safe_roller::claim(int count)
+{ return __atomic_fetch_add(&_issued, count, __ATOMIC_RELAXED); }
+
+int safe_roller::next_id() { return id_at(claim(1)); }
+
+int safe_roller::current() const
+{ return id_at(__atomic_load_n(&_issued, __ATOMIC_RELAXED)); }
+
+void safe_roller::set_current(int new_current)
 {
-  WHACK(_rolling);
-  WHACK(_lock);
+  signed_long_long position = signed_long_long(new_current) - _start_of_range;
+  if ( (position < 0) || (position >= _span) ) position = 0;
+  __atomic_store_n(&_issued, position, __ATOMIC_RELAXED);
 }
 
-int safe_roller::next_id()
+//////////////
+
+const int RESERVATION_SLOTS = 8;
+  // how many block_rollers each thread can keep a block for at once.  once
+  // they're all held, any other roller issues its ids one at a time.
+
+const int STALE_RESERVATION = 4096;
+  // a block that the thread hasn't used in this many ids is given up so that
+  // its slot can go to a roller that's busier.
+
+// a block of ids that a thread has reserved from a block_roller.
+
+struct id_reservation
 {
-  _lock->lock();
-  int to_return = _rolling->next_id();
-  _lock->unlock();
-  return to_return;
-}
+  int _owner;  // the serial number of the roller that the block came from.
+  signed_long_long _next;  // the position of the next id to issue.
+  signed_long_long _limit;  // the position just after the block.
+  signed_long_long _last_used;  // the thread's clock when last issued from.
+};
 
-int safe_roller::current() const
+static __thread id_reservation __reservations[RESERVATION_SLOTS];
+  // the blocks held by the current thread.  these start out zeroed, and no
+  // roller has a serial number of zero.
+
+static __thread signed_long_long __reservation_clock = 0;
+  // counts the ids that the current thread has issued from any block.
+
+static int __next_roller_serial = 0;
+  // the serial numbers are never reused, so a reservation left over from a
+  // roller that's been destroyed can never be mistaken for a new one's.
+
+block_roller::block_roller(int start_of_range, int end_of_range,
+    int block_size)
+: _source(start_of_range, end_of_range),
+  _block_size(block_size < 1 ? 1 : block_size),
+  _serial(__atomic_add_fetch(&__next_roller_serial, 1, __ATOMIC_RELAXED))
 {
-  _lock->lock();
-  int to_return = _rolling->current();
-  _lock->unlock();
-  return to_return;
 }
 
-void safe_roller::set_current(int new_current)
+block_roller::~block_roller() {}
+
+int block_roller::next_id()
 {
-  _lock->lock();
-  _rolling->set_current(new_current);
-  _lock->unlock();
+  signed_long_long now = ++__reservation_clock;
+  id_reservation *held = NULL_POINTER;
+  id_reservation *spare = NULL_POINTER;
+  for (int i = 0; i < RESERVATION_SLOTS; i++) {
+    id_reservation &curr = __reservations[i];
+    if (curr._owner == _serial) { held = &curr; break; }
+    if (!spare && ( !curr._owner || (curr._next >= curr._limit)
+        || (now - curr._last_used > STALE_RESERVATION) ) )
+      spare = &curr;
+  }
+  if (!held) {
+    // every slot is busy with another roller, so we don't get a block.
+    if (!spare) return _source.next_id();
+    held = spare;
+    held->_owner = _serial;
+    held->_limit = 0;
+  }
+  if (held->_next >= held->_limit) {
+    held->_next = _source.claim(_block_size);
+    held->_limit = held->_next + _block_size;
+  }
+  held->_last_used = now;
+  return _source.id_at(held->_next++);
 }
 
 } //namespace.
 
-
@@ -15,15 +15,15 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
-#include <basis/mutex.h>
-#include <structures/roller.h>
+#include <basis/definitions.h>
 
 namespace processes {
 
 //! Implements a thread-safe roller object.
 /*!
   Integers can be generated by this object without concern for corruption by
-  multiple threads.
+  multiple threads.  No lock is involved; each id is claimed with a single
+  atomic addition to a counter, which is then wrapped into the range.
 */
 
 class safe_roller
@@ -51,11 +51,21 @@ public:
 
   void set_current(int new_current);
     //!< allows the current id to be manipulated.
-    /*!< this must be done with care lest existing ids be re-used. */
+    /*!< this must be done with care lest existing ids be re-used.  a value
+    outside of the range resets the roller to the start of the range. */
 
 private:
-  structures::int_roller *_rolling;  //!< the id generator.
-  basis::mutex *_lock;  //!< thread synchronization.
+  basis::signed_long_long _issued;  //!< how many ids have been claimed.
+  int _start_of_range;  //!< the first id in the range.
+  basis::signed_long_long _span;  //!< how many ids are in the range.
+
+  basis::signed_long_long claim(int count);
+    //!< reserves "count" ids and returns the position of the first one.
+  int id_at(basis::signed_long_long position) const
+  { return _start_of_range + int(position % _span); }
+    //!< turns a claimed "position" into the id for it.
+
+  friend class block_roller;  // reserves its ids in blocks through claim().
 
   // forbidden...
   safe_roller(const safe_roller &);
@@ -64,6 +74,50 @@ private:
 
 //////////////
 
+//! A roller that gives each thread its own block of ids to issue.
+/*!
+  The safe_roller is cheap, but all of its threads still fight over the one
+  counter.  This roller has each thread reserve a block of ids at a time and
+  then hand them out without touching any shared memory.  The ids are still
+  unique within the range, but they are not issued in order across threads,
+  and a block that a thread stops using before it's finished is skipped.
+  Thus this is suited to ids that just need to be distinct, such as
+  sequence numbers on requests.  Each thread holds blocks for a handful of
+  rollers at once; when more rollers than that are busy on a thread, the
+  extra ones fall back to issuing their ids one at a time.
+*/
+
+class block_roller
+{
+public:
+  enum { DEFAULT_BLOCK_SIZE = 64 };
+
+  block_roller(int start_of_range = 0, int end_of_range = MAXINT32,
+          int block_size = DEFAULT_BLOCK_SIZE);
+    //!< Provides numbers between the start and end, "block_size" per thread.
+    /*!< the range behaves like the safe_roller's range.  the "block_size"
+    should be much smaller than the range. */
+
+  ~block_roller();
+
+  int next_id();
+    //!< returns a unique (per instance of this type) id.
+
+  int block_size() const { return _block_size; }
+    //!< the number of ids that a thread reserves at once.
+
+private:
+  safe_roller _source;  //!< the blocks of ids are claimed from here.
+  int _block_size;  //!< how many ids are reserved at once.
+  int _serial;  //!< identifies this roller to each thread's reservations.
+
+  // forbidden...
+  block_roller(const block_roller &);
+  block_roller &operator =(const block_roller &);
+};
+
+//////////////
+
 void safe_add(int &to_change, int addition);
   //!< thread-safe integer addition.
   /*!< the number passed in "addition" is atomically added to the number
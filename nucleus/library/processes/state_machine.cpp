@@ -68,6 +68,13 @@ namespace processes {
   int indy = state_index(state); \
   if (negative(indy)) return
 
+const int DENSE_STATE_SLACK = 64;
+  // the state ids can spread across this many more slots than there are
+  // states and still be looked up with a dense table.
+
+const int MAXIMUM_TRIGGER_TABLE = 1024;
+  // the largest span of triggers for one state that gets a dense table.
+
 //////////////
 
 struct override { int current; int next; int duration;
@@ -109,18 +116,41 @@ struct override { int current; int next; int duration;
 		}
 	};
 
+// a range transition's triggers, for searching the ranges in order.
+struct range_entry {
+  int low, high;  // the inclusive range of triggers.
+  int transition;  // the index of the range transition.
+
+  range_entry(int low_in = 0, int high_in = 0, int transition_in = 0)
+    : low(low_in), high(high_in), transition(transition_in) {}
+};
+
 struct state_info {
   int state_id;  // id for this state.
   array<transition_info> transitions;
 
-  state_info() : state_id(0) {}  // blank.
-  state_info(int state_id_in) : state_id(state_id_in) {}
+  // these are filled in by compile().
+  int timed;  // index of the timed transition, or negative if none.
+  int lowest_trigger;  // the trigger that the trigger table starts at.
+  int_array trigger_table;  // range transition index for each trigger.
+  array<range_entry> ranges;  // sorted ranges, when the table's too sparse.
+
+  state_info(int state_id_in = 0)  // zero is blank.
+    : state_id(state_id_in), timed(common::NOT_FOUND), lowest_trigger(0) {}
 };
 
 //////////////
 
 class state_machine_override_array : public array<override> {};
-class state_machine_state_array : public array<state_info> {};
+
+class state_machine_state_array : public array<state_info>
+{
+public:
+  int _lowest_state;  //!< the state id that the dense lookup starts at.
+  int_array _dense_lookup;  //!< the index of each state id, if compiled.
+
+  state_machine_state_array() : _lowest_state(0) {}
+};
 
 //////////////
 
@@ -238,6 +268,14 @@ int transition_map::states() const { return _state_list->length(); }
 
 int transition_map::state_index(int state_id) const
 {
+  const state_machine_state_array &list = *_state_list;
+  if (list._dense_lookup.length()) {
+    int offset = state_id - list._lowest_state;
+    if ( (offset < 0) || (offset >= list._dense_lookup.length()) )
+      return common::NOT_FOUND;
+    return list._dense_lookup[offset];
+  }
+  // the state ids were too spread out for a table, so we search for them.
   for (int i = 0; i < states(); i++)
     if ((*_state_list)[i].state_id == state_id) return i;
   return common::NOT_FOUND;
@@ -259,7 +297,12 @@ int transition_map::transition_index(int state_index, int next, int &start)
 
 // configurational functions:
 
-void transition_map::reconfigure() { _valid = false; }
+void transition_map::reconfigure()
+{
+  _valid = false;
+  // the states can change now, so the compiled lookups are tossed.
+  _state_list->_dense_lookup.reset();
+}
 
 outcome transition_map::validate(int &examine)
 {
@@ -271,10 +314,86 @@ outcome transition_map::validate(int &examine)
     // a state is unreachable from the starting state.
   if (!check_overlapping(examine)) return OVERLAPPING_RANGES;
     // bad (overlapping) ranges were found in one state.
+  compile();
   _valid = true;  // set us to operational.
   return OKAY;
 }
 
+void transition_map::compile()
+{
+  state_machine_state_array &list = *_state_list;
+  // find the span of the state ids to see if a dense table is reasonable.
+  list._dense_lookup.reset();
+  int lowest = 0, highest = 0;
+  for (int i = 0; i < states(); i++) {
+    int id = list[i].state_id;
+    if (!i || (id < lowest)) lowest = id;
+    if (!i || (id > highest)) highest = id;
+  }
+  double span = double(highest) - double(lowest) + 1;
+  if (states() && (span <= states() + DENSE_STATE_SLACK)) {
+    list._lowest_state = lowest;
+    list._dense_lookup.reset(int(span));
+    for (int i = 0; i < list._dense_lookup.length(); i++)
+      list._dense_lookup[i] = common::NOT_FOUND;
+    for (int i = 0; i < states(); i++)
+      list._dense_lookup[list[i].state_id - lowest] = i;
+  }
+
+  // now build each state's lookups for its timed and range transitions.
+  for (int i = 0; i < states(); i++) {
+    state_info &state = list[i];
+    state.timed = common::NOT_FOUND;
+    state.trigger_table.reset();
+    state.ranges.reset();
+    for (int j = 0; j < state.transitions.length(); j++) {
+      transition_info &tran = state.transitions[j];
+      if (tran.type == transition_info::TIMED) state.timed = j;
+      else if (tran.type == transition_info::RANGE) {
+        // keep the ranges sorted by their low ends; they don't overlap.
+        int k = state.ranges.length();
+        while (k && (state.ranges[k - 1].low > tran.low_trigger)) k--;
+        state.ranges.insert(k, 1);
+        state.ranges[k] = range_entry(tran.low_trigger, tran.high_trigger, j);
+      }
+    }
+    if (!state.ranges.length()) continue;
+    double trigger_span = double(state.ranges[state.ranges.last()].high)
+        - double(state.ranges[0].low) + 1;
+    if (trigger_span > MAXIMUM_TRIGGER_TABLE) continue;  // ranges are searched.
+    state.lowest_trigger = state.ranges[0].low;
+    state.trigger_table.reset(int(trigger_span));
+    for (int j = 0; j < state.trigger_table.length(); j++)
+      state.trigger_table[j] = common::NOT_FOUND;
+    for (int j = 0; j < state.ranges.length(); j++) {
+      range_entry &range = state.ranges[j];
+      for (int trig = range.low; trig <= range.high; trig++)
+        state.trigger_table[trig - state.lowest_trigger] = range.transition;
+    }
+  }
+}
+
+int transition_map::range_transition(int state_index, int trigger) const
+{
+  const state_info &state = (*_state_list)[state_index];
+  if (state.trigger_table.length()) {
+    int offset = trigger - state.lowest_trigger;
+    if ( (offset < 0) || (offset >= state.trigger_table.length()) )
+      return common::NOT_FOUND;
+    return state.trigger_table[offset];
+  }
+  // binary search for the range that might hold the trigger.
+  int low = 0, high = state.ranges.length() - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    const range_entry &range = state.ranges[mid];
+    if (trigger < range.low) high = mid - 1;
+    else if (trigger > range.high) low = mid + 1;
+    else return range.transition;
+  }
+  return common::NOT_FOUND;
+}
+
 bool transition_map::add_state(int state_number)
 {
   if (valid()) return false;  // this is operational; no more config!
@@ -360,22 +479,14 @@ bool transition_map::pulse(state_machine &m, int trigger)
     LOG(astring("(%s) transition_map::pulse: bad logic error; state is missing.", m._name->s()));
 #endif
   FIND_STATE(m._current) false;  // logic error!
-  state_info &found = (*_state_list)[indy];
-  for (int i = 0; i < found.transitions.length(); i++) {
-    if (found.transitions[i].type == transition_info::RANGE) {
-      // found the right type of transition.
-      transition_info &tran = found.transitions[i];
-      if ( (tran.low_trigger <= trigger)
-            && (tran.high_trigger >= trigger) ) {
-        // found a transition with an acceptable range.
-        MOVE_STATE(m, tran.next_state, state_machine::RANGE, trigger);
-        int trig = m.update();
-        if (trig) return pulse(m, trig);
-        return true;
-      }
-    }
-  }
-  return false;
+  int tran_index = range_transition(indy, trigger);
+  if (negative(tran_index)) return false;  // no range holds the trigger.
+  // found a transition with an acceptable range.
+  MOVE_STATE(m, (*_state_list)[indy].transitions[tran_index].next_state,
+      state_machine::RANGE, trigger);
+  int trig = m.update();
+  if (trig) return pulse(m, trig);
+  return true;
 }
 
 bool transition_map::time_slice(state_machine &m)
@@ -391,21 +502,19 @@ bool transition_map::time_slice(state_machine &m)
   FIND_STATE(m._current) false;  // logic error!
 
   state_info &found = (*_state_list)[indy];
-  for (int i = 0; i < found.transitions.length(); i++) {
-    if (found.transitions[i].type == transition_info::TIMED) {
-      // found the right type of transition.
-      transition_info &tran = found.transitions[i];
-      int duration = tran.time_span;
-      int override = m.duration_override(m._current, tran.next_state);
-      if (override) duration = override;
-      if (*m._start < time_stamp(-duration)) {
-        // found a transition with an expired time.
-        MOVE_STATE(m, tran.next_state, state_machine::TIMED, 0);
-        int trig = m.update();
-        if (trig) return pulse(m, trig);
-        return true;
-      }
-    }
+  if (negative(found.timed)) return false;  // no timed transition here.
+  transition_info &tran = found.transitions[found.timed];
+  int duration = tran.time_span;
+  if (m._overrides->length()) {
+    int override = m.duration_override(m._current, tran.next_state);
+    if (override) duration = override;
+  }
+  if (*m._start < time_stamp(-duration)) {
+    // found a transition with an expired time.
+    MOVE_STATE(m, tran.next_state, state_machine::TIMED, 0);
+    int trig = m.update();
+    if (trig) return pulse(m, trig);
+    return true;
   }
   return false;
 }
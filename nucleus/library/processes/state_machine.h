@@ -224,7 +224,9 @@ public:
     OVERLAPPING_RANGES means that one state has two transitions that do not
     have mutually exclusive ranges.  UNREACHABLE means that a state is not
     reachable from the starting state.  for all of these cases, the "examine"
-    parameter is set to a state related to the problem. */
+    parameter is set to a state related to the problem.  once the map is
+    valid, it is compiled into lookup tables so that pulses and time slices
+    take constant time. */
 
   void reconfigure();
     //!< puts the transition_map back into an unvalidated state.
@@ -324,6 +326,19 @@ private:
 
   int state_index(int state_id) const;
     //!< returns the index of "state_id" in states, if it exists.
+    /*!< once compiled, this is a table lookup unless the state ids are too
+    sparse for a table, in which case the states are searched. */
+
+  void compile();
+    //!< builds the lookup tables that the validated map operates with.
+    /*!< the state ids get a dense table from id to index, as long as they're
+    not spread too thinly.  each state records its timed transition and gets
+    a table from trigger to range transition, or a sorted list of its ranges
+    if the triggers are too spread out for a table. */
+
+  int range_transition(int state_index, int trigger) const;
+    //!< finds the range transition for "trigger" in the state at "state_index".
+    /*!< a negative number is returned if no range holds the trigger. */
 
   int transition_index(int state_index, int next, int &start);
     //!< locates a transition into "next" for a state in our list.
@@ -0,0 +1,240 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : tree_scanner                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "ethread.h"
+#include "tree_scanner.h"
+
+#include <basis/array.h>
+#include <basis/functions.h>
+#include <filesystem/directory.h>
+#include <filesystem/directory_tree.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <filesystem/filename_tree.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/string_array.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+
+using namespace basis;
+using namespace filesystem;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+
+namespace processes {
+
+//#define DEBUG_TREE_SCANNER
+  // uncomment for noisier version.
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+#undef AUTO_LOCK
+#define AUTO_LOCK auto_synchronizer l(*_lock)
+
+const int IDLE_PAUSE = 1;
+  // how long a worker without anything to do waits before looking again.
+
+//////////////
+
+// one of the scanning threads, along with its own queue of directories.
+
+class scan_worker : public ethread
+{
+public:
+  mutex _queue_lock;  // protects the queue.
+  array<filename_tree *> _queue;  // directories waiting to be read.
+  int _head;  // the oldest entry in the queue, which is where thieves take.
+
+  scan_worker(tree_scanner &parent)
+  : ethread(), _queue(0, NULL_POINTER, byte_array::SIMPLE_COPY | byte_array::EXPONE),
+    _head(0), _parent(parent) {}
+
+  DEFINE_CLASS_NAME("scan_worker");
+
+  void push(filename_tree *to_add) {
+    auto_synchronizer l(_queue_lock);
+    _queue.concatenate(to_add);
+  }
+
+  // takes the newest entry, which keeps our own work depth-first.
+  filename_tree *pop() {
+    auto_synchronizer l(_queue_lock);
+    if (_queue.length() <= _head) return NULL_POINTER;
+    filename_tree *to_return = _queue[_queue.last()];
+    _queue.zap(_queue.last(), _queue.last());
+    if (_queue.length() == _head) {
+      // we emptied it, so the consumed space at the front can go.
+      _queue.reset();
+      _head = 0;
+    }
+    return to_return;
+  }
+
+  // takes the oldest entry, which is the one nearest the top of the tree.
+  filename_tree *steal() {
+    auto_synchronizer l(_queue_lock);
+    if (_queue.length() <= _head) return NULL_POINTER;
+    return _queue[_head++];
+  }
+
+  virtual void perform_activity(void *formal(ptr)) {
+    while (true) {
+      filename_tree *node = pop();
+      if (!node) node = _parent.steal_node(*this);
+      if (!node) {
+        if (_parent.finished()) return;
+        // someone else is still reading and may find more for us to do.
+        time_control::sleep_ms(IDLE_PAUSE);
+        continue;
+      }
+      _parent.read_node(*this, node);
+    }
+  }
+
+private:
+  tree_scanner &_parent;
+};
+
+//////////////
+
+tree_scanner::tree_scanner(int threads)
+: _lock(new mutex),
+  _threads(maximum(1, threads)),
+  _pending(0),
+  _directories(0),
+  _files(0),
+  _steals(0),
+  _scan_time(0),
+  _pattern("*"),
+  _ignore_files(false),
+  _gather_stats(true),
+  _workers(NULL_POINTER)
+{}
+
+tree_scanner::~tree_scanner()
+{
+  WHACK(_lock);
+}
+
+int tree_scanner::directories_scanned() const { AUTO_LOCK; return _directories; }
+
+int tree_scanner::files_found() const { AUTO_LOCK; return _files; }
+
+int tree_scanner::steals() const { AUTO_LOCK; return _steals; }
+
+double tree_scanner::scan_time() const { AUTO_LOCK; return _scan_time; }
+
+astring tree_scanner::text_form() const
+{
+  AUTO_LOCK;
+  return a_sprintf("%d threads read %d directories holding %d files in %.0f "
+      "ms (%d steals)", _threads, _directories, _files, _scan_time, _steals);
+}
+
+bool tree_scanner::finished() const { AUTO_LOCK; return !_pending; }
+
+filename_tree *tree_scanner::steal_node(scan_worker &thief)
+{
+  for (int i = 0; i < _threads; i++) {
+    if (_workers[i] == &thief) continue;
+    filename_tree *found = _workers[i]->steal();
+    if (found) {
+      AUTO_LOCK;
+      _steals++;
+      return found;
+    }
+  }
+  return NULL_POINTER;
+}
+
+void tree_scanner::read_node(scan_worker &worker, filename_tree *node)
+{
+  FUNCDEF("read_node");
+  string_array dirs;
+  const astring &path = node->_dirname.raw();
+  bool worked = directory::read_entries(path, _pattern, dirs,
+      _ignore_files? NULL_POINTER : &node->_files, _gather_stats);
+#ifdef DEBUG_TREE_SCANNER
+  if (!worked) LOG(astring("could not read directory ") + path);
+#endif
+  if (!worked) dirs.reset();
+  // the children are attached in sorted order, just as the directory_tree
+  // would do, and then handed to our queue for reading.
+  for (int i = 0; i < dirs.length(); i++) {
+    filename_tree *kid = new filename_tree;
+    kid->_dirname = filename(path + filename::default_separator() + dirs[i],
+        astring::empty_string());
+    kid->_depth = node->_depth + 1;
+    node->attach(kid);
+  }
+  {
+    // count the children before we're done with this node, so the scan
+    // can't look finished in between.
+    AUTO_LOCK;
+    _pending += dirs.length() - 1;
+    _directories++;
+    _files += node->_files.elements();
+  }
+  // queue the kids in reverse so that pop() visits them in order.
+  for (int i = node->branches() - 1; i >= 0; i--)
+    worker.push((filename_tree *)node->branch(i));
+}
+
+bool tree_scanner::scan(directory_tree &target, const astring &path,
+    const char *pattern, bool gather_stats)
+{
+  FUNCDEF("scan");
+  time_stamp started;
+  {
+    AUTO_LOCK;
+    _pending = 1;
+    _directories = 0;
+    _files = 0;
+    _steals = 0;
+    _pattern = pattern;
+    _ignore_files = target.ignoring_files();
+    _gather_stats = gather_stats;
+  }
+
+  // the top-level must be readable for the scan to count as good.
+  string_array check;
+  if (!directory::read_entries(path, pattern, check, NULL_POINTER))
+    return false;
+
+  filename_tree *root = new filename_tree;
+  root->_dirname = filename(path, astring::empty_string());
+
+  _workers = new scan_worker *[_threads];
+  for (int i = 0; i < _threads; i++) _workers[i] = new scan_worker(*this);
+  _workers[0]->push(root);
+  for (int i = 0; i < _threads; i++) _workers[i]->start(NULL_POINTER);
+  // each worker exits once there's nothing left to read anywhere.
+  for (int i = 0; i < _threads; i++) _workers[i]->stop();
+  for (int i = 0; i < _threads; i++) WHACK(_workers[i]);
+  delete [] _workers;
+  _workers = NULL_POINTER;
+
+  target.adopt(path, pattern, root);
+  AUTO_LOCK;
+  _scan_time = time_stamp().value() - started.value();
+#ifdef DEBUG_TREE_SCANNER
+  LOG(text_form());
+#endif
+  return true;
+}
+
+} //namespace.
+
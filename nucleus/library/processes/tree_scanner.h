@@ -0,0 +1,116 @@
+#ifndef TREE_SCANNER_CLASS
+#define TREE_SCANNER_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : tree_scanner                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <basis/mutex.h>
+
+// forward.
+namespace filesystem {
+  class directory_tree;
+  class filename_tree;
+}
+
+namespace processes {
+
+// forward.
+class scan_worker;
+
+//! Builds a directory_tree by scanning its sub-directories in parallel.
+/*!
+  Each worker thread keeps its own queue of directories waiting to be read.
+  A worker takes the newest directory off its own queue, reads it with a
+  single pass (see filesystem::directory::read_entries()), and queues up the
+  sub-directories it found.  When a worker's queue runs dry, it steals the
+  oldest directory from another worker's queue; those tend to be the highest
+  in the tree and so carry the most remaining work with them.
+
+  Optionally, each file's size and timestamp are gathered during the scan
+  with one fstatat per file, which makes a later directory_tree::calculate()
+  with "just_size" unnecessary.  Files are never opened by the scanner.
+
+  The resulting tree has the same shape and ordering as one built by the
+  directory_tree constructor.  Only one scan should be run at a time on a
+  given scanner.
+*/
+
+class tree_scanner : public virtual basis::root_object
+{
+public:
+  enum scanner_defaults {
+    DEFAULT_THREADS = 8  //!< the number of worker threads used for scanning.
+  };
+
+  tree_scanner(int threads = DEFAULT_THREADS);
+    //!< creates a scanner that will use up to "threads" workers.
+
+  virtual ~tree_scanner();
+
+  DEFINE_CLASS_NAME("tree_scanner");
+
+  int threads() const { return _threads; }
+    //!< returns the number of worker threads used per scan.
+
+  bool scan(filesystem::directory_tree &target, const basis::astring &path,
+          const char *pattern = "*", bool gather_stats = true);
+    //!< fills the "target" with the tree found at "path".
+    /*!< only files matching "pattern" are listed, but all sub-directories
+    are included, just as with directory_tree.  if the "target" is set to
+    ignore files, then only directories are gathered.  if "gather_stats" is
+    true, then the file sizes and times are filled in.  false is returned
+    if the top-level "path" could not be read. */
+
+  int directories_scanned() const;
+    //!< the number of directories read during the last scan.
+  int files_found() const;  //!< the number of files listed by the last scan.
+  int steals() const;
+    //!< how many times a worker took a directory from another's queue.
+  double scan_time() const;  //!< milliseconds taken by the last scan.
+
+  basis::astring text_form() const;
+    //!< reports the statistics for the last scan.
+
+private:
+  friend class scan_worker;
+  basis::mutex *_lock;  //!< protects our counters.
+  int _threads;  //!< the number of workers we start.
+  int _pending;  //!< directories that are queued or being read right now.
+  int _directories;  //!< directories read so far.
+  int _files;  //!< files listed so far.
+  int _steals;  //!< how many directories were stolen.
+  double _scan_time;  //!< the duration of the last scan.
+  const char *_pattern;  //!< the pattern for the current scan.
+  bool _ignore_files;  //!< true if files are not wanted this time.
+  bool _gather_stats;  //!< true if file sizes and times are wanted.
+  scan_worker **_workers;  //!< the pool used during a scan.
+
+  void read_node(scan_worker &worker, filesystem::filename_tree *node);
+    //!< reads the directory for "node" and queues up its children.
+  filesystem::filename_tree *steal_node(scan_worker &thief);
+    //!< finds work for the "thief" in the other workers' queues.
+  bool finished() const;
+    //!< true when no directories remain to be read.
+
+  // not appropriate.
+  tree_scanner(const tree_scanner &);
+  tree_scanner &operator =(const tree_scanner &);
+};
+
+} //namespace.
+
+#endif
+
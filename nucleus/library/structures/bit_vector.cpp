@@ -19,6 +19,8 @@
 #include <basis/functions.h>
 #include <basis/guards.h>
 
+#include <string.h>
+
 //#define DEBUG_BIT_VECTOR
   // uncomment this to get debugging noise.
 
@@ -33,35 +35,96 @@ using namespace basis;
 
 namespace structures {
 
+typedef unsigned long long bit_word;
+
+const bit_word ALL_ONES = ~bit_word(0);
+
+// these helpers use the processor's bit scanning and counting instructions
+// when the compiler offers them.
+
+inline int lowest_bit(bit_word word)
+{
+#ifdef __GNUC__
+  return __builtin_ctzll(word);
+#else
+  int to_return = 0;
+  while (!(word & 1)) { word >>= 1; to_return++; }
+  return to_return;
+#endif
+}
+
+inline int bits_lit(bit_word word)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(word);
+#else
+  int to_return = 0;
+  while (word) { word &= word - 1; to_return++; }
+  return to_return;
+#endif
+}
+
+// returns a word with the bits from "low" through "high" set.
+inline bit_word span_mask(int low, int high)
+{
+  bit_word upper = (high >= 63)? ALL_ONES : ((bit_word(1) << (high + 1)) - 1);
+  return upper & (ALL_ONES << low);
+}
+
+//////////////
+
 bit_vector::bit_vector()
-: _implementation(new byte_array(0, NULL_POINTER)), _number_of_bits(0)
+: _words(new array<bit_word>(0, NULL_POINTER, array<bit_word>::SIMPLE_COPY
+      | array<bit_word>::EXPONE)),
+  _number_of_bits(0),
+  _bytes(new byte_array)
 {}
 
 bit_vector::bit_vector(int number_of_bits, const abyte *initial)
-: _implementation(new byte_array(0, NULL_POINTER)), _number_of_bits(0)
+: _words(new array<bit_word>(0, NULL_POINTER, array<bit_word>::SIMPLE_COPY
+      | array<bit_word>::EXPONE)),
+  _number_of_bits(0),
+  _bytes(new byte_array)
 {
   reset(number_of_bits);
   if (!initial) return;
-  _implementation->reset(number_of_packets(number_of_bits,
-      int(BITS_PER_BYTE)), initial);
+  int bytes = number_of_packets(number_of_bits, int(BITS_PER_BYTE));
+  bit_word *words = _words->access();
+  for (int i = 0; i < bytes; i++)
+    words[i / 8] |= bit_word(initial[i]) << (8 * (i % 8));
+  trim_last_word();
 }
 
 bit_vector::bit_vector(const bit_vector &to_copy)
-: _implementation(new byte_array(*to_copy._implementation)),
-  _number_of_bits(to_copy._number_of_bits)
+: _words(new array<bit_word>(*to_copy._words)),
+  _number_of_bits(to_copy._number_of_bits),
+  _bytes(new byte_array)
 {}
 
-bit_vector::~bit_vector() { WHACK(_implementation); }
+bit_vector::~bit_vector()
+{
+  WHACK(_words);
+  WHACK(_bytes);
+}
 
 bit_vector &bit_vector::operator = (const bit_vector &to_copy)
 {
   if (this == &to_copy) return *this;
-  *_implementation = *to_copy._implementation;
+  *_words = *to_copy._words;
   _number_of_bits = to_copy._number_of_bits;
   return *this;
 }
 
-bit_vector::operator const byte_array & () const { return *_implementation; }
+bit_vector::operator const byte_array & () const
+{
+  int bytes = number_of_packets(_number_of_bits, int(BITS_PER_BYTE));
+  _bytes->reset(bytes);
+  const bit_word *words = _words->observe();
+  abyte *fill = _bytes->access();
+  for (int i = 0; i < bytes; i++)
+    fill[i] = abyte(words[i / 8] >> (8 * (i % 8)));
+  return *_bytes;
+}
 
 int bit_vector::bits() const { return _number_of_bits; }
 
@@ -70,115 +133,201 @@ bool bit_vector::whole() const { return negative(find_first(0)); }
 bool bit_vector::empty() const { return negative(find_first(1)); }
 
 bool bit_vector::operator == (const bit_vector &that) const
-{ return compare(that, 0, _number_of_bits); }
+{
+  if (_number_of_bits != that._number_of_bits) return false;
+  return compare(that, 0, _number_of_bits - 1);
+}
+
+void bit_vector::trim_last_word()
+{
+  int extra = _number_of_bits % BITS_PER_WORD;
+  if (extra && _words->length())
+    _words->use(_words->length() - 1) &= span_mask(0, extra - 1);
+}
 
 bool bit_vector::on(int position) const
-{ return get_bit(into_two_dim(position)); }
+{
+  bounds_return(position, 0, _number_of_bits - 1, false);
+  return (_words->get(position / BITS_PER_WORD)
+      >> (position % BITS_PER_WORD)) & 1;
+}
 
 bool bit_vector::off(int position) const { return !on(position); }
 
 void bit_vector::resize(int number_of_bits)
 {
-//printf("resize invoked, old size %d, new size %d...\n", bits(), number_of_bits);
   if (negative(number_of_bits)) return;
   if (bits() == number_of_bits) return;
-  int old_size = bits();
+  int old_words = _words->length();
+  int new_words = words_needed(number_of_bits);
+  _words->resize(new_words);
+  // the words that are new need to start out clear.
+  if (new_words > old_words)
+    memset(_words->access() + old_words, 0,
+        (new_words - old_words) * sizeof(bit_word));
+  // the old last word's tail bits are already clear, but shrinking might
+  // leave some bits hanging off the new end.
   _number_of_bits = number_of_bits;
-  int number_of_bytes = number_of_packets(number_of_bits, int(BITS_PER_BYTE));
-  _implementation->resize(number_of_bytes);
-  // clear new space if the vector got larger.
-  if (old_size < number_of_bits) {
-    // lazy reset doesn't compute byte boundary, just does 8 bits.
-    for (int i = old_size; i < old_size + 8; i++) {
-      clear(i);
-//printf("clearing bit %d.\n", i);
-    }
-    // clear the bytes remaining.
-    int old_bytes = number_of_packets(old_size + 8, int(BITS_PER_BYTE));
-    for (int j = old_bytes; j < number_of_bytes; j++) {
-//printf("clearing bit %d through %d.\n", j * 8, j * 8 + 7);
-      _implementation->use(j) = 0;
-    }
-  }
+  trim_last_word();
 }
 
 void bit_vector::reset(int number_of_bits)
 {
   resize(number_of_bits);
-  memset(_implementation->access(), 0, _implementation->length());
+  memset(_words->access(), 0, _words->length() * sizeof(bit_word));
 }
 
-bit_vector::two_dim_location bit_vector::into_two_dim(int position) const
+void bit_vector::set_bit(int position, bool value)
 {
-  two_dim_location to_return;
-  to_return.c_byte = position / BITS_PER_BYTE;
-  to_return.c_offset = position % BITS_PER_BYTE;
-  return to_return;
+  bounds_return(position, 0, bits() - 1, );
+  bit_word mask = bit_word(1) << (position % BITS_PER_WORD);
+  if (value) _words->use(position / BITS_PER_WORD) |= mask;
+  else _words->use(position / BITS_PER_WORD) &= ~mask;
 }
 
-bool bit_vector::get_bit(const two_dim_location &pos_in2) const
+bool bit_vector::operator [](int position) const { return on(position); }
+
+void bit_vector::light(int position) { set_bit(position, true); }
+
+void bit_vector::clear(int position) { set_bit(position, false); }
+
+void bit_vector::set_range(int start, int end, bool value)
 {
-  bounds_return(pos_in2.c_byte * BITS_PER_BYTE + pos_in2.c_offset, 0,
-    _number_of_bits - 1, false);
-  abyte test_mask = abyte(1 << pos_in2.c_offset);
-  return TEST(abyte(_implementation->get(pos_in2.c_byte)), test_mask);
+  start = maximum(start, 0);
+  end = minimum(end, _number_of_bits - 1);
+  if (start > end) return;
+  bit_word *words = _words->access();
+  int first_word = start / BITS_PER_WORD;
+  int last_word = end / BITS_PER_WORD;
+  for (int w = first_word; w <= last_word; w++) {
+    int low = (w == first_word)? start % BITS_PER_WORD : 0;
+    int high = (w == last_word)? end % BITS_PER_WORD : BITS_PER_WORD - 1;
+    bit_word mask = span_mask(low, high);
+    if (value) words[w] |= mask;
+    else words[w] &= ~mask;
+  }
 }
 
-void bit_vector::set_bit(int position, bool value)
+int bit_vector::find_first(bool to_find) const
+{ return find_next(to_find, 0); }
+
+int bit_vector::find_next(bool to_find, int start) const
 {
-  bounds_return(position, 0, bits() - 1, );
-  set_bit(into_two_dim(position), value);
+  if (negative(start)) start = 0;
+  if (start >= _number_of_bits) return common::NOT_FOUND;
+  const bit_word *words = _words->observe();
+  int w = start / BITS_PER_WORD;
+  // look at the first word without the bits that come before the start.
+  bit_word curr = to_find? words[w] : ~words[w];
+  curr &= ALL_ONES << (start % BITS_PER_WORD);
+  while (true) {
+    if (curr) {
+      int found = w * BITS_PER_WORD + lowest_bit(curr);
+      // zeros past the end of the vector don't count.
+      if (found >= _number_of_bits) return common::NOT_FOUND;
+      return found;
+    }
+    if (++w >= _words->length()) return common::NOT_FOUND;
+    curr = to_find? words[w] : ~words[w];
+  }
+}
+
+int bit_vector::count() const
+{
+  int to_return = 0;
+  const bit_word *words = _words->observe();
+  for (int w = 0; w < _words->length(); w++) to_return += bits_lit(words[w]);
+  return to_return;
 }
 
-void bit_vector::set_bit(const two_dim_location &pos_in2, bool set_it)
+bool bit_vector::compare(const bit_vector &that, int start, int stop) const
 {
-  abyte test_mask = abyte(1 << pos_in2.c_offset);
-  if (set_it) SET(_implementation->use(pos_in2.c_byte), test_mask);
-  else CLEAR((abyte &)_implementation->get(pos_in2.c_byte), test_mask);
+  if (start > stop) return true;
+  if ( (start < 0) || (stop >= _number_of_bits) || (stop >= that.bits()) )
+    return false;
+  for (int posn = start; posn <= stop; posn += BITS_PER_WORD) {
+    int size = minimum(int(BITS_PER_WORD), stop - posn + 1);
+    if (extract(posn, size) != that.extract(posn, size)) return false;
+  }
+  return true;
 }
 
-bool bit_vector::operator [](int position) const
+bit_vector &bit_vector::operator &= (const bit_vector &that)
 {
-  bounds_return(position, 0, _number_of_bits - 1, false);
-  return get_bit(into_two_dim(position));
+  bit_word *words = _words->access();
+  const bit_word *others = that._words->observe();
+  int common_words = minimum(_words->length(), that._words->length());
+  for (int w = 0; w < common_words; w++) words[w] &= others[w];
+  for (int w = common_words; w < _words->length(); w++) words[w] = 0;
+  return *this;
 }
 
-void bit_vector::light(int position)
+bit_vector &bit_vector::operator |= (const bit_vector &that)
 {
-  bounds_return(position, 0, _number_of_bits - 1, );
-  set_bit(into_two_dim(position), true);
+  bit_word *words = _words->access();
+  const bit_word *others = that._words->observe();
+  int common_words = minimum(_words->length(), that._words->length());
+  for (int w = 0; w < common_words; w++) words[w] |= others[w];
+  trim_last_word();
+  return *this;
 }
 
-void bit_vector::clear(int position)
+bit_vector &bit_vector::operator ^= (const bit_vector &that)
 {
-  bounds_return(position, 0, _number_of_bits - 1, );
-  set_bit(into_two_dim(position), false);
+  bit_word *words = _words->access();
+  const bit_word *others = that._words->observe();
+  int common_words = minimum(_words->length(), that._words->length());
+  for (int w = 0; w < common_words; w++) words[w] ^= others[w];
+  trim_last_word();
+  return *this;
 }
 
-int bit_vector::find_first(bool to_find) const
+void bit_vector::invert()
 {
-  const abyte whole_set = abyte(0xFF);
-  // search through the whole bytes first.
-  for (int full_byte = 0; full_byte < _implementation->length(); full_byte++) {
-    if ( (to_find && _implementation->get(full_byte))
-         || (!to_find && (_implementation->get(full_byte) != whole_set)) ) {
-      // the first appropriate byte is searched for the first appropriate bit.
-      for (int i = full_byte * BITS_PER_BYTE; i < minimum
-          (int(_number_of_bits), (full_byte+1)*BITS_PER_BYTE); i++) {
-        if (on(i) == to_find) return i;
-      }
-      return common::NOT_FOUND;
-    }
-  }
-  return common::NOT_FOUND;
+  bit_word *words = _words->access();
+  for (int w = 0; w < _words->length(); w++) words[w] = ~words[w];
+  trim_last_word();
 }
 
-bool bit_vector::compare(const bit_vector &that, int start, int stop) const
+bit_vector bit_vector::operator & (const bit_vector &that) const
+{ bit_vector to_return(*this); to_return &= that; return to_return; }
+
+bit_vector bit_vector::operator | (const bit_vector &that) const
+{ bit_vector to_return(*this); to_return |= that; return to_return; }
+
+bit_vector bit_vector::operator ^ (const bit_vector &that) const
+{ bit_vector to_return(*this); to_return ^= that; return to_return; }
+
+bit_vector bit_vector::operator ~ () const
+{ bit_vector to_return(*this); to_return.invert(); return to_return; }
+
+bit_vector::bit_word bit_vector::extract(int start, int size) const
+{
+  const bit_word *words = _words->observe();
+  int w = start / BITS_PER_WORD;
+  int offset = start % BITS_PER_WORD;
+  bit_word to_return = words[w] >> offset;
+  // pull in the rest from the next word if the bits straddle two words.
+  if (offset && (offset + size > BITS_PER_WORD))
+    to_return |= words[w + 1] << (BITS_PER_WORD - offset);
+  if (size < BITS_PER_WORD) to_return &= span_mask(0, size - 1);
+  return to_return;
+}
+
+void bit_vector::deposit(int start, int size, bit_word source)
 {
-  for (int i = start; i <= stop; i++) {
-    if (on(i) != that.on(i)) return false;
+  bit_word *words = _words->access();
+  if (size < BITS_PER_WORD) source &= span_mask(0, size - 1);
+  int w = start / BITS_PER_WORD;
+  int offset = start % BITS_PER_WORD;
+  int first_size = minimum(size, int(BITS_PER_WORD) - offset);
+  bit_word mask = span_mask(offset, offset + first_size - 1);
+  words[w] = (words[w] & ~mask) | ((source << offset) & mask);
+  if (first_size < size) {
+    // the remainder goes into the bottom of the next word.
+    mask = span_mask(0, size - first_size - 1);
+    words[w + 1] = (words[w + 1] & ~mask) | ((source >> first_size) & mask);
   }
-  return true;
 }
 
 astring bit_vector::text_form() const
@@ -213,7 +362,10 @@ bit_vector bit_vector::subvector(int start, int end) const
   bounds_return(end, 0, bits() - 1, bit_vector());
   int size = end - start + 1;
   bit_vector to_return(size);
-  for (int i = start; i <= end; i++) to_return.set_bit(i - start, on(i));
+  for (int posn = 0; posn < size; posn += BITS_PER_WORD) {
+    int chunk = minimum(int(BITS_PER_WORD), size - posn);
+    to_return.deposit(posn, chunk, extract(start + posn, chunk));
+  }
   return to_return;
 }
 
@@ -222,96 +374,30 @@ bool bit_vector::overwrite(int start, const bit_vector &to_write)
   bounds_return(start, 0, bits() - 1, false);
   int end = start + to_write.bits() - 1;
   bounds_return(end, 0, bits() - 1, false);
-  for (int i = start; i <= end; i++) set_bit(i, to_write[i - start]);
+  for (int posn = 0; posn < to_write.bits(); posn += BITS_PER_WORD) {
+    int chunk = minimum(int(BITS_PER_WORD), to_write.bits() - posn);
+    deposit(start + posn, chunk, to_write.extract(posn, chunk));
+  }
   return true;
 }
 
-enum endian { LEFT_ENDIAN, RIGHT_ENDIAN };
-endian host_byte_order = LEFT_ENDIAN;  // bytes within words.
-endian host_bit_order = LEFT_ENDIAN;  // bits within bytes.
-
-// probably the treatment for right endian in either case
-// of bytes or bits is wrong.
-
 bool bit_vector::set(int start, int size, basis::un_int source)
 {
   bounds_return(start, 0, bits() - 1, false);
   int end = start + size - 1;
   bounds_return(end, 0, bits() - 1, false);
   bounds_return(size, 1, 32, false);
-  bit_vector from_int(32, (abyte *)&source);
-
-// is this algorithm even remotely near the truth?
-  if (host_bit_order == RIGHT_ENDIAN)
-    from_int._implementation->resize(size, byte_array::NEW_AT_BEGINNING);
-  else from_int.resize(size);  // left endian machine.
-  overwrite(start, from_int);
+  // the lowest bit of the "source" lands at "start".
+  deposit(start, size, source);
   return true;
 }
 
 basis::un_int bit_vector::get(int start, int size) const
 {
-  int end = start + size - 1;
-  bit_vector segment = subvector(start, end);
-  // padding to bytes.
-  int new_length = segment.bits();
-  if (new_length % 8) {
-    new_length = ( (new_length+8) / 8) * 8;
-    LOG(a_sprintf("new size is %d.", new_length));
-  }
-  segment.resize(new_length);
-
-  if (host_bit_order == RIGHT_ENDIAN) {
-    bit_vector new_segment(segment.bits());
-    for (int i = 0; i < segment.bits(); i += 8)
-      for (int j = i; j < i + BITS_PER_BYTE; j++)
-        if (j < segment.bits())
-          new_segment.set_bit(i + (7 - (j - i)), segment[j]);
-    segment = new_segment;  // copy the new form.
-  }
-
-  LOG("new seg after bit copy:");
-  LOG(segment);
-
-  basis::un_int to_return = 0;
-
-  int bytes_used = number_of_packets(segment.bits(), int(BITS_PER_BYTE));
-  // 4 = # of bytes in a int.
-  for (int i = minimum(4, bytes_used) - 1; i >= 0; i--) {
-#ifdef DEBUG_BIT_VECTOR
-    bit_vector tmp(8, &segment._implementation->get(i));
-    LOG(a_sprintf("%d: src bits %s", i, tmp.text_form().s()));
-#endif
-
-#ifdef DEBUG_BIT_VECTOR
-    bit_vector tmp4(32, (abyte *)&to_return);
-    LOG(a_sprintf("%d: pre shift dest %s", i, tmp4.text_form().s()));
-#endif
-    if (host_byte_order == LEFT_ENDIAN) to_return <<= 8;
-    else to_return >>= 8;
-#ifdef DEBUG_BIT_VECTOR
-    bit_vector tmp5(32, (abyte *)&to_return);
-    LOG(a_sprintf("%d: post shift dest %s", i, tmp5.text_form().s()));
-#endif
-
-    basis::un_int mask = segment._implementation->get(i);
-    if (host_byte_order == RIGHT_ENDIAN) mask <<= 23;
-#ifdef DEBUG_BIT_VECTOR
-    bit_vector tmp3(32, (abyte *)&to_return);
-    LOG(a_sprintf("%d: pre dest bits %s", i, tmp3.text_form().s()));
-#endif
-    SET(to_return, mask);
-#ifdef DEBUG_BIT_VECTOR
-    bit_vector tmp2(32, (abyte *)&to_return);
-    LOG(a_sprintf("%d: post dest bits %s", i, tmp2.text_form().s()));
-#endif
-  }
-
-#ifdef DEBUG_BIT_VECTOR
-  bit_vector tmp(32, (abyte *)&to_return);
-  LOG(a_sprintf("final bits %s", tmp.text_form().s()));
-#endif
-  return to_return;
+  bounds_return(start, 0, bits() - 1, 0);
+  bounds_return(size, 1, 32, 0);
+  size = minimum(size, bits() - start);
+  return basis::un_int(extract(start, size));
 }
 
 } //namespace.
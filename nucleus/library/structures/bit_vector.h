@@ -15,12 +15,17 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include <basis/array.h>
 #include <basis/astring.h>
 #include <basis/definitions.h>
 
 namespace structures {
 
 //! An array of bits with operations for manipulating and querying individual bits.
+/*!
+  The bits are stored in 64-bit words, so searches, comparisons and the
+  operations on ranges and whole vectors handle a word at a time.
+*/
 
 class bit_vector
 {
@@ -66,12 +71,41 @@ public:
     /*!< locates the position at which a bit equal to to_find is located or it
     returns common::NOT_FOUND if no bit of that value is in the vector. */
 
+  int find_next(bool to_find, int start) const;
+    //!< Seeks the first occurrence of "to_find" at or after "start".
+    /*!< returns common::NOT_FOUND if there's no such bit from "start" onward.
+    this is the cheap way to walk through the runs of ones and zeros. */
+
+  int count() const;
+    //!< returns the number of bits that are set in the vector.
+
   void light(int position);
     //!< sets the value of the bit at "position".
 
   void clear(int position);
     //!< clears the value of the bit at "position".
 
+  void set_range(int start, int end, bool value);
+    //!< sets all bits from "start" through "end" inclusive to the "value".
+    /*!< the range is clipped to the size of the vector. */
+  void light(int start, int end) { set_range(start, end, true); }
+    //!< sets all of the bits from "start" through "end" inclusive.
+  void clear(int start, int end) { set_range(start, end, false); }
+    //!< clears all of the bits from "start" through "end" inclusive.
+
+  // whole vector logical operations.  when the vectors have different sizes,
+  // "this" keeps its size and any bits past the end of "that" are treated as
+  // being zero in "that".
+  bit_vector &operator &= (const bit_vector &that);
+  bit_vector &operator |= (const bit_vector &that);
+  bit_vector &operator ^= (const bit_vector &that);
+  void invert();  //!< flips every bit in the vector.
+
+  bit_vector operator & (const bit_vector &that) const;
+  bit_vector operator | (const bit_vector &that) const;
+  bit_vector operator ^ (const bit_vector &that) const;
+  bit_vector operator ~ () const;
+
   void resize(int size);
     //!< Changes the size of the bit_vector to "size" bits.
     /*!< This keeps any bits that still fit.  Any new bits are set to zero. */
@@ -120,22 +154,30 @@ public:
 
   operator const basis::byte_array &() const;
     //!< returns a copy of the low-level implementation of the bit vector.
-    /*!< the first bit is stored at the bit in first byte, and so forth. */
+    /*!< the first bit is stored at the bit in first byte, and so forth.
+    the bytes are produced from the words when this is called, so this
+    should not be used in tight loops. */
 
 private:
-  basis::byte_array *_implementation;  //!< holds the real state of the bits.
+  typedef unsigned long long bit_word;  //!< the storage unit; 64 bits.
+  enum word_sizes { BITS_PER_WORD = 64 };
+
+  basis::array<bit_word> *_words;  //!< holds the real state of the bits.
+    /*!< any bits in the last word that are past the end of the vector are
+    always kept clear, so whole words can be compared and counted. */
   int _number_of_bits;  //!< the total number of bits possible in this vector.
+  mutable basis::byte_array *_bytes;  //!< the byte form handed out above.
+
+  static int words_needed(int bits)
+  { return (bits + BITS_PER_WORD - 1) / BITS_PER_WORD; }
 
-  struct two_dim_location { int c_byte; int c_offset; };
-    //!< a two-dimensional position given by byte number and offset within byte.
+  void trim_last_word();
+    //!< clears any bits in the last word that are beyond the vector's end.
 
-  two_dim_location into_two_dim(int position) const;
-    /*!< turns a bit position in the vector into a two dimensional position
-    of the byte number and a bit offset within that byte. */
-  bool get_bit(const two_dim_location &pos_in2) const;
-    //!< returns the value of the bit given its two dimensional location.
-  void set_bit(const two_dim_location &pos_in2, bool value);
-    //!< sets the value of the bit if "value", and clears it if not.
+  bit_word extract(int start, int size) const;
+    //!< returns "size" bits (up to 64) starting at "start", lowest bit first.
+  void deposit(int start, int size, bit_word source);
+    //!< stores the low "size" bits of "source" into the vector at "start".
 };
 
 //////////////
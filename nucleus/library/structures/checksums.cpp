@@ -71,6 +71,118 @@ basis::un_int checksums::short_checksum(const abyte *data, int length)
   return to_return;
 }
 
+// xxHash64 is by Yann Collet; see http://www.xxhash.com for the details.
+
+typedef checksums::wide_hash wide_hash;
+
+const wide_hash XX_PRIME_1 = 0x9E3779B185EBCA87ULL;
+const wide_hash XX_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const wide_hash XX_PRIME_3 = 0x165667B19E3779F9ULL;
+const wide_hash XX_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+const wide_hash XX_PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+// the bytes are always assembled in little-endian order so the hashes match
+// across platforms.  compilers turn these into plain loads where they can.
+inline wide_hash read_64(const abyte *p)
+{
+  return wide_hash(p[0]) | (wide_hash(p[1]) << 8) | (wide_hash(p[2]) << 16)
+      | (wide_hash(p[3]) << 24) | (wide_hash(p[4]) << 32)
+      | (wide_hash(p[5]) << 40) | (wide_hash(p[6]) << 48)
+      | (wide_hash(p[7]) << 56);
+}
+
+inline wide_hash read_32(const abyte *p)
+{
+  return wide_hash(p[0]) | (wide_hash(p[1]) << 8) | (wide_hash(p[2]) << 16)
+      | (wide_hash(p[3]) << 24);
+}
+
+inline wide_hash rotate_left(wide_hash x, int bits)
+{ return (x << bits) | (x >> (64 - bits)); }
+
+inline wide_hash xx_round(wide_hash accumulator, wide_hash input)
+{
+  accumulator += input * XX_PRIME_2;
+  return rotate_left(accumulator, 31) * XX_PRIME_1;
+}
+
+inline wide_hash xx_merge(wide_hash accumulator, wide_hash value)
+{
+  accumulator ^= xx_round(0, value);
+  return accumulator * XX_PRIME_1 + XX_PRIME_4;
+}
+
+checksums::wide_hash checksums::wide_hash_bytes(const abyte *data, int length,
+    wide_hash seed)
+{
+  const abyte *p = data;
+  const abyte *end = data + length;
+  wide_hash h64;
+
+  if (length >= 32) {
+    // four independent lanes keep the processor's pipelines full.
+    const abyte *limit = end - 32;
+    wide_hash v1 = seed + XX_PRIME_1 + XX_PRIME_2;
+    wide_hash v2 = seed + XX_PRIME_2;
+    wide_hash v3 = seed;
+    wide_hash v4 = seed - XX_PRIME_1;
+    do {
+      v1 = xx_round(v1, read_64(p)); p += 8;
+      v2 = xx_round(v2, read_64(p)); p += 8;
+      v3 = xx_round(v3, read_64(p)); p += 8;
+      v4 = xx_round(v4, read_64(p)); p += 8;
+    } while (p <= limit);
+    h64 = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12)
+        + rotate_left(v4, 18);
+    h64 = xx_merge(h64, v1);
+    h64 = xx_merge(h64, v2);
+    h64 = xx_merge(h64, v3);
+    h64 = xx_merge(h64, v4);
+  } else {
+    h64 = seed + XX_PRIME_5;
+  }
+  h64 += wide_hash(length);
+
+  // fold in whatever didn't fill a whole stripe.
+  while (p + 8 <= end) {
+    h64 ^= xx_round(0, read_64(p));
+    h64 = rotate_left(h64, 27) * XX_PRIME_1 + XX_PRIME_4;
+    p += 8;
+  }
+  if (p + 4 <= end) {
+    h64 ^= read_32(p) * XX_PRIME_1;
+    h64 = rotate_left(h64, 23) * XX_PRIME_2 + XX_PRIME_3;
+    p += 4;
+  }
+  while (p < end) {
+    h64 ^= wide_hash(*p) * XX_PRIME_5;
+    h64 = rotate_left(h64, 11) * XX_PRIME_1;
+    p++;
+  }
+
+  // the final avalanche spreads every input bit across the result.
+  h64 ^= h64 >> 33;
+  h64 *= XX_PRIME_2;
+  h64 ^= h64 >> 29;
+  h64 *= XX_PRIME_3;
+  h64 ^= h64 >> 32;
+  return h64;
+}
+
+const basis::un_int FNV_PRIME = 16777619u;
+  // the multiplier for each byte in the FNV-1a hash.
+
+basis::un_int checksums::fnv_hash(const abyte *data, int length,
+    basis::un_int previous)
+{
+  basis::un_int to_return = previous;
+  for (int i = 0; i < length; i++) {
+    to_return ^= data[i];
+    to_return *= FNV_PRIME;
+  }
+  return to_return;
+}
+
 basis::un_int checksums::hash_bytes(const void *key_data, int key_length)
 {
   if (!key_data) return 0;  // error!
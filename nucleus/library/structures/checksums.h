@@ -26,6 +26,7 @@ namespace structures {
 class checksums
 {
 public:
+  typedef unsigned long long wide_hash;  //!< a 64 bit hash value.
 
   static basis::abyte byte_checksum(const basis::abyte *data, int length);
     //!< simple byte-sized checksum based on additive roll-over.
@@ -49,6 +50,25 @@ public:
     //!< A different type of checksum with somewhat unknown properties.
     /*!< It attempts to be incorporate positioning of the bytes. */
 
+  static wide_hash wide_hash_bytes(const basis::abyte *data, int length,
+          wide_hash seed = 0);
+    //!< a fast 64 bit hash that is strong enough to compare whole files.
+    /*!< this is the xxHash64 algorithm, which chews through memory about as
+    fast as it can be read and gives the same answer on every platform.  it
+    is not a cryptographic hash, but accidental collisions are vanishingly
+    unlikely.  the "seed" lets callers produce independent hashes, such as
+    for each chunk of a larger piece of data. */
+
+  static const basis::un_int FNV_OFFSET_BASIS = 2166136261u;
+    //!< where an fnv_hash() starts out.
+
+  static basis::un_int fnv_hash(const basis::abyte *data, int length,
+          basis::un_int previous = FNV_OFFSET_BASIS);
+    //!< the FNV-1a hash of the "length" bytes at "data".
+    /*!< every byte stirs up the whole value, so keys that differ only in a
+    few bytes still spread out across a hash table.  the "previous" hash can
+    be passed in to continue a hash over several pieces of data. */
+
   static basis::un_int hash_bytes(const void *key_data, int key_length);
     //!< returns a value that can be used for indexing into a hash table.
     /*!< the returned value is loosely based on the "key_data" and the
@@ -70,7 +70,15 @@ public:
     //!< adds a "ptr" to the set of static objects under the "unique_name".
     /*!< the name must really be unique or objects will collide.  we recommend
     using an identifier based on a line number and filename where the static
-    is going to be placed (see the safe static implementation below). */
+    is going to be placed (see the safe static implementation below).  if the
+    name is already present, the object held for it is replaced. */
+
+  void enroll(const char *unique_name, basis::root_object *ptr);
+    //!< adds the "ptr" under the "unique_name" without checking for the name.
+    /*!< this never locks; the new object is just added to the front of our
+    list, so that the shutdown destroys the objects in the reverse order of
+    their creation.  the caller must ensure that the name is new, which the
+    SAFE_STATIC macros do by only creating each object once. */
 
   basis::root_object *get(const char *unique_name);
     //!< locates the pointer held for the "unique_name", if any.
@@ -82,19 +90,18 @@ public:
     //!< locates the name for "ptr" in our objects.
     /*!< if it does not exist, then NULL_POINTER is returned. */
 
-  void ensure_space_exists();
-    /*!< makes sure that the list of objects is large enough to contain all of
-    the identifiers that have been issued. */
+  template <class contents>
+  static contents *__create_static(const char *unique_name, contents *ptr)
+  { __hoople_globals().enroll(unique_name, ptr); return ptr; }
+    //!< records the new "ptr" for a SAFE_STATIC and hands it back.
 
 private:
-  basis::mutex c_lock;  //!< protects object's state.
-  int c_top_index;  //!< top place that's occupied in the list.
-  int c_actual_size;  //!< the real number of indices in list.
-  gremlin_object_record **c_pointers;  //!< storage for the static pointers.
+  basis::mutex c_lock;  //!< keeps put() calls from colliding.
+  gremlin_object_record *c_head;  //!< the most recently added object.
   bool c_show_debugging;  //!< if true, then the object will log noisily.
 
-  int locate(const char *unique_name);
-    //!< returns the index number of the "unique_name".
+  gremlin_object_record *locate(const char *unique_name);
+    //!< returns the record for the "unique_name", if there is one.
 };
 
 //////////////
@@ -150,45 +157,27 @@ future calls will refer to the stored string rather than recreating it again. */
   static const char *name = "file:" __FILE__ ":line:" #linenum
 
 //! this blob is just a chunk of macro implementation for SAFE_STATIC...
-/*! if the static object isn't initialized yet, we'll create it and store it
-in the static_memory_gremlin.  we make sure that the program isn't shutting
-down, because that imposes a new requirement--previously created statics might
-have already been destroyed.  thus, during the program shutdown, we carefully
-recreate any objects that were already toast. */
+/*! the object is created the first time through, and the compiler makes
+sure that only one thread gets to do that while any others wait for it.  after
+that, getting the object is just a check of whether the program is shutting
+down.  that check matters because previously created statics might have
+already been destroyed during the shutdown.  in that case we look for the
+object under its name and carefully recreate it if it was already toast. */
 #define SAFE_STATIC_IMPLEMENTATION(type, parms, linenum) \
-/*hmmm: bring all this back.*/ \
-/*  const char *func = "allocation"; */ \
-/*  frame_tracking_instance __trail_of_function("safe_static", func, \
-      __FILE__, __LINE__, true); */ \
   UNIQUE_NAME_BASED_ON_SOURCE(__uid_name, linenum); \
-/*  program_wide_memories(); */ \
-  static basis::root_object *_hidden = NULL_POINTER; \
-  /* if haven't initialized yet, then definitely need to lock carefully. */ \
-  if (structures::static_memory_gremlin::__program_is_dying() || !_hidden) { \
+  static type *_hidden = structures::static_memory_gremlin::__create_static \
+      (__uid_name, new type parms); \
+  if (structures::static_memory_gremlin::__program_is_dying()) { \
+    /* we can't rely on the pointer since we're shutting down currently. */ \
     basis::auto_synchronizer l(structures::static_memory_gremlin::__memory_gremlin_synchronizer()); \
-    if (structures::static_memory_gremlin::__program_is_dying()) { \
-      /* we can't rely on the pointer since we're shutting down currently. */ \
-      _hidden = structures::static_memory_gremlin::__hoople_globals().get(__uid_name); \
-    } \
-    if (!_hidden) {  /* make sure no one scooped us. */ \
-      /* try to retrieve an existing one first and use it if there. */ \
-      _hidden = structures::static_memory_gremlin::__hoople_globals().get(__uid_name); \
-      if (!_hidden) { \
-        _hidden = new type parms ; /* create the object finally. */ \
-        /* store our object using the unique name for it. */ \
-        if (!structures::static_memory_gremlin::__hoople_globals().put(__uid_name, _hidden)) { \
-          /* we failed to allocate space.  this is serious. */ \
-          throw __uid_name; \
-        } \
-      } \
+    basis::root_object *found = structures::static_memory_gremlin::__hoople_globals().get(__uid_name); \
+    if (!found) { \
+      found = new type parms; /* bring back the object that was destroyed. */ \
+      structures::static_memory_gremlin::__hoople_globals().enroll(__uid_name, found); \
     } \
+    return *dynamic_cast<type *>(found); \
   } \
-  if (!_hidden) { \
-    /* grab the pointer that was stored, in case we're late getting here. */ \
-    /* another thread might have scooped the object creation. */ \
-    _hidden = structures::static_memory_gremlin::__hoople_globals().get(__uid_name); \
-  } \
-  return *dynamic_cast<type *>(_hidden)
+  return *_hidden
 
 // historical note: the SAFE_STATIC approach has existed since about 1998.
 // however, the static_memory_gremlin's role in this started much later.
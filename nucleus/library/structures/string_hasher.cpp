@@ -12,6 +12,8 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include "checksums.h"
+#include "string_array.h"
 #include "string_hasher.h"
 
 #include <basis/functions.h>
@@ -83,5 +85,27 @@ basis::un_int astring_hasher::hash(const void *key_data, int key_length_in) cons
       real_key->length() + 1);
 }
 
+//////////////
+
+hashing_algorithm *string_array_hasher::clone() const
+{ return new string_array_hasher; }
+
+basis::un_int string_array_hasher::hash(const void *key_data,
+    int formal(key_length)) const
+{
+  if (!key_data) return 0;  // error.
+  const string_array *real_key = (const string_array *)key_data;
+  basis::un_int to_return = checksums::FNV_OFFSET_BASIS;
+  const abyte separator = 0xFF;
+  for (int i = 0; i < real_key->length(); i++) {
+    const astring &curr = real_key->get(i);
+    to_return = checksums::fnv_hash((const abyte *)curr.observe(),
+        curr.length(), to_return);
+    // mix in a separator so that ["ab", "c"] differs from ["a", "bc"].
+    to_return = checksums::fnv_hash(&separator, 1, to_return);
+  }
+  return to_return;
+}
+
 } //namespace.
 
@@ -48,6 +48,23 @@ public:
     //!< implements cloning of the algorithm object.
 };
 
+//////////////
+
+//! Hashes a string_array, such as an infoton classifier.
+/*! Unlike the string_hasher, every character of every string contributes to
+the hash value.  Classifiers often differ only by a few characters in the
+middle of their last component, so sampling the ends is not good enough. */
+
+class string_array_hasher : public virtual hashing_algorithm
+{
+public:
+  virtual basis::un_int hash(const void *key_data, int key_length) const;
+    //!< expects "key_data" to be a string_array pointer.
+
+  virtual hashing_algorithm *clone() const;
+    //!< implements cloning of the algorithm object.
+};
+
 } //namespace.
 
 #endif
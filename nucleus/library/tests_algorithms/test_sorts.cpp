@@ -83,7 +83,7 @@ basis::array<int> test_sorts::populate_random_array(int size)
 
 bool test_sorts::verify_ascending(const int *list, int size)
 {
-	FUNCDEF("verify_ascending")
+	FUNCDEF("verify_ascending");
 	int last = list[0];
 	for (int j = 1; j < size; j++) {
 		if (list[j] < last) return false;
@@ -94,7 +94,7 @@ bool test_sorts::verify_ascending(const int *list, int size)
 
 bool test_sorts::verify_descending(const int *list, int size)
 {
-	FUNCDEF("verify_descending")
+	FUNCDEF("verify_descending");
 	int last = list[0];
 	for (int j = 1; j < size; j++) {
 		if (list[j] > last) return false;
@@ -24,11 +24,11 @@ namespace system_checkup {
 #undef UNIT_BASE_THIS_OBJECT 
 #define UNIT_BASE_THIS_OBJECT testing
 #undef static_class_name
-#define static_class_name() astring("system_checkup")
+#define static_class_name() "system_checkup"
 
 bool check_system_characteristics(unit_base &testing)
 {
-  FUNCDEF("check_system_characteristics")
+  FUNCDEF("check_system_characteristics");
   // a big assumption is that the size of an unsigned character is just
   // one byte.  if this is not true, probably many things would break...
   int byte_size = sizeof(abyte);
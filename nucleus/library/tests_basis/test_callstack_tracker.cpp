@@ -0,0 +1,412 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_callstack_tracker                                            *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks the frames that the callstack tracker records for each thread,    *
+*  including a stack deeper than the frame ring, that the signal-safe trace   *
+*  dump matches the ordinary trace, and that the sampler folds a known stack. *
+*  Those only have anything to test when the build defines                    *
+*  ENABLE_CALLSTACK_TRACKING.  The crash dumps that use the tracker are       *
+*  checked in every build, by crashing child processes.                       *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/guards.h>
+#include <loggers/critical_events.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/ethread.h>
+#include <structures/static_memory_gremlin.h>
+#include <unit_test/unit_base.h>
+
+#ifdef __UNIX__
+  #include <signal.h>
+  #include <stdio.h>
+  #include <stdlib.h>
+  #include <sys/wait.h>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+#ifdef ENABLE_CALLSTACK_TRACKING
+  #include <application/callstack_tracker.h>
+  #include <pthread.h>
+  #include <string.h>
+#endif
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+#ifdef ENABLE_CALLSTACK_TRACKING
+
+const int EXTRA_FRAMES = 10;
+  // how far past the size of the frame ring the deep stack goes.
+
+static int __dump_descriptor = -1;
+  // where the signal handler writes the trace.
+
+static void dump_on_signal(int formal(signal))
+{ callstack_tracker::write_trace(__dump_descriptor); }
+  // writes our trace from inside a signal handler, as a crash dump does.
+
+static void *other_thread(void *depth_seen)
+{
+  callstack_tracker::push_frame("elsewhere", "other_thread", __FILE__, __LINE__);
+  *(int *)depth_seen = callstack_tracker::depth();
+  callstack_tracker::pop_frame();
+  return NULL_POINTER;
+}
+  // records how deep a brand new thread thinks it is after one call.
+
+#endif
+
+#ifdef __UNIX__
+
+static volatile bool __stop_recursing = false;
+  // never set; it just keeps the compiler from seeing an endless recursion.
+
+static int overflow_stack(int depth)
+{
+  volatile char filler[1024];
+  filler[0] = char(depth);
+  if (__stop_recursing) return 0;
+  return overflow_stack(depth + 1) + filler[0];
+}
+  // keeps calling itself until the stack runs out.
+
+// a thread that crashes by running out of stack, which needs the handler to
+// have a separate stack of its own on this thread.
+
+class stack_crasher : public processes::ethread
+{
+public:
+  DEFINE_CLASS_NAME("stack_crasher");
+  virtual void perform_activity(void *formal(ptr)) {
+    FUNCDEF("perform_activity");
+    overflow_stack(0);
+  }
+};
+
+#endif
+
+//////////////
+
+class test_callstack_tracker : public virtual unit_base, public virtual application_shell
+{
+public:
+  test_callstack_tracker() : application_shell() {}
+  DEFINE_CLASS_NAME("test_callstack_tracker");
+  virtual int execute();
+
+#ifdef ENABLE_CALLSTACK_TRACKING
+private:
+  static astring written_trace(bool from_signal);
+    //!< returns what write_trace() produces for the current thread.
+    /*!< if "from_signal" is true, the trace is written by a signal handler. */
+
+  static astring current_trace();
+    //!< returns the full_trace() for the current thread.
+
+  void test_frames();
+  void test_deep_stack();
+  void test_threads();
+  void test_sampling();
+#endif
+
+#ifdef __UNIX__
+private:
+  astring crash_log(bool on_thread, int &signal_seen);
+    //!< runs a child that crashes and returns what it put in the crash log.
+    /*!< the crash is on a thread with an overflowed stack if "on_thread" is
+    true.  the "signal_seen" is the signal that the child ended with. */
+
+  void test_crash_dumps();
+#endif
+};
+
+#ifdef ENABLE_CALLSTACK_TRACKING
+
+astring test_callstack_tracker::written_trace(bool from_signal)
+{
+  // a deep trace won't fit in a pipe that nobody is reading yet, so it goes
+  // to a scratch file that we read back afterwards.
+  char temp_name[] = "/tmp/test_callstack_XXXXXX";
+  int dump = mkstemp(temp_name);
+  if (dump < 0) return "mkstemp failed";
+  unlink(temp_name);
+  if (from_signal) {
+    __dump_descriptor = dump;
+    struct sigaction action, previous;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = dump_on_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, &previous);
+    raise(SIGUSR1);
+    sigaction(SIGUSR1, &previous, NULL_POINTER);
+    __dump_descriptor = -1;
+  } else {
+    callstack_tracker::write_trace(dump);
+  }
+  astring to_return;
+  char buffer[1024];
+  lseek(dump, 0, SEEK_SET);
+  int got;
+  while ( (got = int(read(dump, buffer, sizeof(buffer) - 1))) > 0) {
+    buffer[got] = '\0';
+    to_return += buffer;
+  }
+  close(dump);
+  return to_return;
+}
+
+astring test_callstack_tracker::current_trace()
+{
+  char *trace = callstack_tracker::full_trace();
+  astring to_return(trace);
+  free(trace);
+  return to_return;
+}
+
+void test_callstack_tracker::test_frames()
+{
+  FUNCDEF("test_frames");
+  int base = callstack_tracker::depth();
+  ASSERT_TRUE(base >= 2, "the FUNCDEFs in execute and here should be tracked");
+  astring trace = current_trace();
+  ASSERT_TRUE(trace.begins("\t\"test_callstack_tracker::test_frames\""),
+      "this function should be the innermost frame");
+  ASSERT_TRUE(trace.contains("test_callstack_tracker::execute"),
+      "the caller should be in the trace too");
+
+  ASSERT_TRUE(callstack_tracker::push_frame("alpha", "beta", "gamma.cpp", 10),
+      "a frame should be pushed");
+  ASSERT_EQUAL(callstack_tracker::depth(), base + 1, "the frame should be counted");
+  ASSERT_TRUE(callstack_tracker::highest() >= base + 1, "the highest should follow");
+  ASSERT_TRUE(callstack_tracker::update_line(27), "the line should be updated");
+  trace = current_trace();
+  ASSERT_TRUE(trace.begins("\t\"alpha::beta\", \"gamma.cpp\", \"line=27\"\n"),
+      "the new frame should be on top with its updated line");
+
+  // the signal-safe dump has to say exactly what the normal trace says.
+  ASSERT_EQUAL(written_trace(false), trace, "the written trace should match");
+  ASSERT_EQUAL(written_trace(true), trace,
+      "the trace written by a signal handler should match");
+
+  ASSERT_TRUE(callstack_tracker::pop_frame(), "the frame should be popped");
+  ASSERT_EQUAL(callstack_tracker::depth(), base, "the depth should be restored");
+  ASSERT_TRUE(current_trace().begins("\t\"test_callstack_tracker::test_frames\""),
+      "this function should be back on top");
+}
+
+void test_callstack_tracker::test_deep_stack()
+{
+  FUNCDEF("test_deep_stack");
+  int base = callstack_tracker::depth();
+  int pushes = FRAME_RING_SIZE + EXTRA_FRAMES;
+  for (int i = 0; i < pushes; i++)
+    callstack_tracker::push_frame("deep", "dive", "deep.cpp", i);
+  // the ring is full now, so any tracked call (such as the checks below)
+  // would write over the outermost frames.  everything is measured first.
+  int depth = callstack_tracker::depth();
+  int highest = callstack_tracker::highest();
+  astring trace = current_trace();
+  astring signal_trace = written_trace(true);
+
+  ASSERT_EQUAL(depth, base + pushes, "every frame should be counted even past the ring");
+  ASSERT_TRUE(highest >= base + pushes, "the highest should count the frames past the ring");
+  // only the innermost frames are kept, and the rest are noted.
+  ASSERT_TRUE(trace.begins(a_sprintf("\t\"deep::dive\", \"deep.cpp\", \"line=%d\"\n",
+      pushes - 1)), "the innermost frame should be on top");
+  ASSERT_TRUE(trace.contains(a_sprintf("\t\"deep::dive\", \"deep.cpp\", \"line=%d\"\n",
+      pushes - FRAME_RING_SIZE)), "the outermost kept frame should be listed");
+  ASSERT_FALSE(trace.contains(a_sprintf("\"line=%d\"\n", pushes - FRAME_RING_SIZE - 1)),
+      "frames that fell off of the ring should not be listed");
+  ASSERT_TRUE(trace.contains(a_sprintf("\t(%d outer frames were not kept)\n",
+      base + EXTRA_FRAMES)), "the lost frames should be noted");
+  ASSERT_FALSE(trace.contains("test_callstack_tracker::test_deep_stack"),
+      "this function should have fallen off of the ring");
+  ASSERT_EQUAL(signal_trace, trace,
+      "the signal handler's trace of a deep stack should match");
+
+  for (int i = 0; i < pushes; i++)
+    ASSERT_TRUE(callstack_tracker::pop_frame(), "each frame should be popped");
+  ASSERT_EQUAL(callstack_tracker::depth(), base, "the depth should be restored");
+  // the deep frames wrote over our callers, which can't be shown again until
+  // we've returned past them.
+  trace = current_trace();
+  ASSERT_FALSE(trace.contains("deep::dive"),
+      "the overwritten callers should not be shown as deep frames");
+  ASSERT_TRUE(trace.contains(a_sprintf("\t(%d outer frames were not kept)\n",
+      base)), "the overwritten callers should be noted");
+}
+
+void test_callstack_tracker::test_threads()
+{
+  FUNCDEF("test_threads");
+  int base = callstack_tracker::depth();
+  int depth_seen = -1;
+  pthread_t other;
+  ASSERT_FALSE(pthread_create(&other, NULL_POINTER, other_thread, &depth_seen),
+      "the other thread should start");
+  pthread_join(other, NULL_POINTER);
+  ASSERT_EQUAL(depth_seen, 1, "a new thread should have its own frames");
+  ASSERT_EQUAL(callstack_tracker::depth(), base,
+      "the other thread should not change our frames");
+}
+
+void test_callstack_tracker::test_sampling()
+{
+  FUNCDEF("test_sampling");
+  callstack_tracker::reset_samples();
+  ASSERT_TRUE(callstack_tracker::start_sampling(1), "sampling should start");
+  ASSERT_FALSE(callstack_tracker::start_sampling(1),
+      "sampling should not start twice");
+  // the known stack sits still until the sampler has seen it.  nothing that's
+  // tracked is called in the meantime, since that would add to the stack.
+  callstack_tracker::push_frame("sampled", "outer", "sampled.cpp", 1);
+  callstack_tracker::push_frame("sampled", "inner", "sampled.cpp", 2);
+  const char *expected = "test_callstack_tracker::test_sampling;"
+      "sampled::outer;sampled::inner ";
+  bool seen = false;
+  for (int i = 0; !seen && (i < 500); i++) {
+    usleep(10 * 1000);
+    char *samples = callstack_tracker::sampled_stacks();
+    seen = !!strstr(samples, expected);
+    free(samples);
+  }
+  callstack_tracker::pop_frame();
+  callstack_tracker::pop_frame();
+  callstack_tracker::stop_sampling();
+
+  char *samples = callstack_tracker::sampled_stacks();
+  astring folded(samples);
+  free(samples);
+  ASSERT_TRUE(seen, "the sampled stack should be folded with its callers first");
+  ASSERT_TRUE(folded.contains("test_callstack_tracker::execute;"
+      "test_callstack_tracker::test_sampling;sampled::outer;sampled::inner "),
+      "the folded stack should start at the outermost tracked function");
+  ASSERT_TRUE(callstack_tracker::start_sampling(1),
+      "sampling should start again after being stopped");
+  callstack_tracker::stop_sampling();
+  callstack_tracker::reset_samples();
+  samples = callstack_tracker::sampled_stacks();
+  folded = samples;
+  free(samples);
+  ASSERT_FALSE(folded.contains("sampled::"), "the samples should be thrown out");
+}
+
+#endif
+
+#ifdef __UNIX__
+
+astring test_callstack_tracker::crash_log(bool on_thread, int &signal_seen)
+{
+  signal_seen = 0;
+  char crash_dir[] = "/tmp/test_crash_dumps_XXXXXX";
+  if (!mkdtemp(crash_dir)) return "mkdtemp failed";
+  astring log_name = astring(crash_dir) + "/runtime_issues.log";
+  pid_t kid = fork();
+  if (!kid) {
+    // the directory is looked up first, so that the default isn't put back.
+    critical_events::critical_events_directory();
+    critical_events::set_critical_events_directory(crash_dir);
+    critical_events::install_crash_dumps();
+    if (on_thread) {
+      stack_crasher *crasher = new stack_crasher;
+      crasher->start(NULL_POINTER);
+      while (true) sleep(1);
+    }
+    raise(SIGSEGV);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(kid, &status, 0);
+  if (WIFSIGNALED(status)) signal_seen = WTERMSIG(status);
+
+  astring to_return;
+  FILE *log_file = fopen(log_name.s(), "rb");
+  if (log_file) {
+    char buffer[1024];
+    size_t got;
+    while ( (got = fread(buffer, 1, sizeof(buffer) - 1, log_file)) > 0) {
+      buffer[got] = '\0';
+      to_return += buffer;
+    }
+    fclose(log_file);
+  }
+  unlink(log_name.s());
+  rmdir(crash_dir);
+  return to_return;
+}
+
+void test_callstack_tracker::test_crash_dumps()
+{
+  FUNCDEF("test_crash_dumps");
+  time_t now = time(NULL_POINTER);
+  tm parts;
+  gmtime_r(&now, &parts);
+  // the crash is stamped in UTC with the time it happened.
+  astring today = a_sprintf("%04d-%02d-%02d ", parts.tm_year + 1900,
+      parts.tm_mon + 1, parts.tm_mday);
+
+  int signal_seen;
+  astring crash = crash_log(false, signal_seen);
+  ASSERT_EQUAL(signal_seen, int(SIGSEGV), "the child should still die by its signal");
+  ASSERT_TRUE(crash.begins(today), "the crash should be stamped with today's date");
+  ASSERT_TRUE(crash.contains(" UTC [test_callstack_tracker]:"),
+      "the crash should name the program");
+  ASSERT_TRUE(crash.contains("crashed by SIGSEGV"), "the signal should be named");
+#ifdef ENABLE_CALLSTACK_TRACKING
+  ASSERT_TRUE(crash.contains("test_callstack_tracker::test_crash_dumps"),
+      "the crash should list the stack");
+#endif
+
+  crash = crash_log(true, signal_seen);
+  ASSERT_EQUAL(signal_seen, int(SIGSEGV), "the overflowed thread should end the child");
+  ASSERT_TRUE(crash.contains("crashed by SIGSEGV"),
+      "a thread that overflowed its stack should still be recorded");
+#ifdef ENABLE_CALLSTACK_TRACKING
+  ASSERT_TRUE(crash.contains("stack_crasher::perform_activity"),
+      "the crashed thread's stack should be listed");
+#endif
+}
+
+#endif
+
+int test_callstack_tracker::execute()
+{
+  FUNCDEF("execute");
+#ifdef ENABLE_CALLSTACK_TRACKING
+  test_frames();
+  // the sampled stack is checked all the way out to this function, so that
+  // has to happen before the deep stack writes over our callers.
+  test_sampling();
+  test_deep_stack();
+  test_threads();
+#else
+  LOG("ENABLE_CALLSTACK_TRACKING is not defined for this build, so there is no callstack tracker to test.");
+#endif
+#ifdef __UNIX__
+  test_crash_dumps();
+#endif
+  return final_report();
+}
+
+HOOPLE_MAIN(test_callstack_tracker, )
+
@@ -0,0 +1,143 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_memory_checker                                               *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks the memory checker's tracking and its sampled mode.  This only    *
+*  has anything to test when the build defines ENABLE_MEMORY_HOOK.           *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <application/memory_checker.h>
+#include <basis/astring.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/static_memory_gremlin.h>
+#include <unit_test/unit_base.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int SAMPLING_RATE = 64;
+  // one allocation in this many is tracked during the sampled test.
+
+const int SAMPLED_ALLOCATIONS = 200 * SAMPLING_RATE;
+  // the number of allocations made while sampling.
+
+const int BLOCK_SIZE = 48;
+  // the size of each allocation made in the tests.
+
+//////////////
+
+class test_memory_checker : public virtual unit_base, public virtual application_shell
+{
+public:
+  test_memory_checker() : application_shell() {}
+  DEFINE_CLASS_NAME("test_memory_checker");
+  virtual int execute();
+
+#ifdef ENABLE_MEMORY_HOOK
+private:
+  static bool snapshot_mentions(const char *site);
+    //!< true if the call site snapshot lists the "site" as holding memory.
+
+  void test_full_tracking();
+  void test_sampling();
+#endif
+};
+
+#ifdef ENABLE_MEMORY_HOOK
+
+bool test_memory_checker::snapshot_mentions(const char *site)
+{
+  char *snapshot = program_wide_memories().call_site_snapshot();
+  bool to_return = !!strstr(snapshot, site);
+  free(snapshot);
+  return to_return;
+}
+
+void test_memory_checker::test_full_tracking()
+{
+  FUNCDEF("test_full_tracking");
+  memory_checker &checker = program_wide_memories();
+  checker.set_sampling(0);
+  ASSERT_EQUAL(checker.sampling(), 1, "the sampling rate should not go below one");
+
+  // with sampling off, every allocation is tracked and charged to its site.
+  void *block = checker.provide_memory(BLOCK_SIZE, "tracked_site", 17);
+  ASSERT_TRUE(block, "memory should be provided");
+  ASSERT_TRUE(snapshot_mentions("tracked_site[17]"),
+      "the call site should be holding memory");
+  ASSERT_EQUAL(checker.release_memory(block), common::OKAY,
+      "the allocation should have been tracked");
+  ASSERT_FALSE(snapshot_mentions("tracked_site[17]"),
+      "the call site should not be holding memory any more");
+}
+
+void test_memory_checker::test_sampling()
+{
+  FUNCDEF("test_sampling");
+  memory_checker &checker = program_wide_memories();
+  checker.set_sampling(SAMPLING_RATE);
+  ASSERT_EQUAL(checker.sampling(), SAMPLING_RATE, "the sampling rate should be as set");
+
+  void **blocks = (void **)malloc(SAMPLED_ALLOCATIONS * sizeof(void *));
+  for (int i = 0; i < SAMPLED_ALLOCATIONS; i++)
+    blocks[i] = checker.provide_memory(BLOCK_SIZE, "sampled_site", 23);
+  ASSERT_TRUE(snapshot_mentions("sampled_site[23]"),
+      "some of the sampled allocations should be charged to the site");
+  char *snapshot = checker.call_site_snapshot();
+  ASSERT_TRUE(strstr(snapshot, "estimated"), "the snapshot should say it is an estimate");
+  free(snapshot);
+
+  // releasing tells us which allocations were tracked; the rest should still
+  // be freed, but they're reported as unknown to the checker.
+  int tracked = 0;
+  for (int i = 0; i < SAMPLED_ALLOCATIONS; i++)
+    if (checker.release_memory(blocks[i]) == common::OKAY) tracked++;
+  free(blocks);
+  int expected = SAMPLED_ALLOCATIONS / SAMPLING_RATE;
+  LOG(a_sprintf("tracked %d of %d allocations; about %d were expected.",
+      tracked, SAMPLED_ALLOCATIONS, expected));
+  ASSERT_TRUE(tracked >= expected / 4, "too few allocations were sampled");
+  ASSERT_TRUE(tracked <= expected * 4, "too many allocations were sampled");
+  ASSERT_FALSE(snapshot_mentions("sampled_site[23]"),
+      "the sampled site should not be holding memory any more");
+
+  checker.set_sampling(1);
+}
+
+#endif
+
+int test_memory_checker::execute()
+{
+  FUNCDEF("execute");
+#ifdef ENABLE_MEMORY_HOOK
+  test_full_tracking();
+  test_sampling();
+#else
+  LOG("ENABLE_MEMORY_HOOK is not defined for this build, so there is no memory checker to test.");
+#endif
+  return final_report();
+}
+
+HOOPLE_MAIN(test_memory_checker, )
+
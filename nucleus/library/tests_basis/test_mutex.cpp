@@ -15,7 +15,10 @@
 #include <application/hoople_main.h>
 #include <basis/astring.h>
 #include <basis/guards.h>
+#include <basis/adaptive_mutex.h>
 #include <basis/mutex.h>
+#include <basis/rw_mutex.h>
+#include <basis/seqlock.h>
 #include <configuration/application_configuration.h>
 #include <loggers/critical_events.h>
 #include <loggers/program_wide_logger.h>
@@ -58,6 +61,16 @@ const int THREAD_PAUSE_HIGHEST = 48;
   // this is the range of random sleeps that a thread will take after
   // performing it's actions.
 
+const int CONTENTION_OPERATIONS = 4000000;
+  // how many operations are timed for each contention test, split among
+  // the threads.
+
+const int MOST_CONTENDERS = 16;
+  // the contention tests quadruple the number of threads up to this many.
+
+const int WRITE_EVERY = 100;
+  // in the read-mostly test, one operation out of this many is a write.
+
 const int MIN_SAME_THREAD_LOCKING_TESTS = 100;
 const int MAX_SAME_THREAD_LOCKING_TESTS = 1000;
   // the range of times we'll test recursively locking the mutex.
@@ -195,6 +208,134 @@ public:
 
 //////////////
 
+// the contention tests compare each of the new primitives against the plain
+// mutex doing the same job.
+
+enum contention_tests {
+  READ_MOSTLY,  // a pair of numbers that's read far more than it's written.
+  SHORT_HOLDS,  // a counter that's locked only long enough to bump it.
+  SNAPSHOTS  // a pair of numbers that's rewritten constantly and read.
+};
+
+// a pair that's only consistent if the second number is twice the first.
+struct number_pair {
+  int _first;
+  int _second;
+};
+
+// the state that the contending threads share.
+
+class contention_arena
+{
+public:
+  contention_arena(contention_tests test, bool fancy)
+  : _test(test), _fancy(fancy), _counter(0), _mistakes(0), _done(false) {
+    _pair._first = 0;
+    _pair._second = 0;
+  }
+
+  contention_tests _test;  // which test is being run.
+  bool _fancy;  // true to use the new primitive rather than the mutex.
+  mutex _plain;  // the mutex that's being compared against.
+  rw_mutex _shared;  // guards the pair in the read-mostly test.
+  adaptive_mutex _adaptive;  // guards the counter in the short holds test.
+  seqlock<number_pair> _snapshot;  // the pair for the snapshots test.
+  number_pair _pair;  // the pair when it's not in the seqlock.
+  int _counter;  // bumped in the short holds test.
+  int _mistakes;  // how many inconsistent pairs the readers saw.
+  bool _done;  // tells the snapshot writer to quit.
+
+  // checks whether the "pair" is consistent.
+  void check(const number_pair &pair) {
+    if (pair._second != 2 * pair._first)
+      __atomic_add_fetch(&_mistakes, 1, __ATOMIC_RELAXED);
+  }
+
+  // changes the pair, keeping it consistent.
+  static void bump(number_pair &pair) {
+    pair._first++;
+    pair._second = 2 * pair._first;
+  }
+
+  void operate(int which) {
+    switch (_test) {
+      case READ_MOSTLY: {
+        bool writing = !(which % WRITE_EVERY);
+        if (!_fancy) {
+          auto_synchronizer l(_plain);
+          if (writing) bump(_pair); else check(_pair);
+        } else if (writing) {
+          auto_writer l(_shared);
+          bump(_pair);
+        } else {
+          auto_reader l(_shared);
+          check(_pair);
+        }
+        break;
+      }
+      case SHORT_HOLDS: {
+        if (!_fancy) {
+          auto_synchronizer l(_plain);
+          _counter++;
+        } else {
+          auto_synchronizer l(_adaptive);
+          _counter++;
+        }
+        break;
+      }
+      case SNAPSHOTS: {
+        if (!_fancy) {
+          number_pair copy;
+          {
+            auto_synchronizer l(_plain);
+            copy = _pair;
+          }
+          check(copy);
+        } else {
+          check(_snapshot.read());
+        }
+        break;
+      }
+    }
+  }
+
+  // keeps changing the pair until the readers are done.
+  void keep_writing() {
+    while (!__atomic_load_n(&_done, __ATOMIC_RELAXED)) {
+      if (!_fancy) {
+        auto_synchronizer l(_plain);
+        bump(_pair);
+      } else {
+        bump(_snapshot.begin_write());
+        _snapshot.end_write();
+      }
+    }
+  }
+};
+
+// a thread that performs its share of a contention test.
+
+class contender : public ethread
+{
+public:
+  contender(contention_arena &arena, int operations, bool writer = false)
+  : ethread(), _arena(arena), _operations(operations), _writer(writer) {}
+
+  DEFINE_CLASS_NAME("contender");
+
+  void perform_activity(void *formal(data)) {
+    if (_writer) { _arena.keep_writing(); return; }
+    for (int i = 0; i < _operations; i++) _arena.operate(i);
+  }
+
+private:
+  contention_arena &_arena;
+  int _operations;  // how many operations this thread performs.
+  bool _writer;  // true if this thread just changes the snapshot.
+};
+
+//////////////
+
 #undef UNIT_BASE_THIS_OBJECT
 #define UNIT_BASE_THIS_OBJECT (*this)
 
@@ -208,8 +349,62 @@ public:
   DEFINE_CLASS_NAME("test_mutex");
 
   int execute();
+
+  double time_contention(contention_tests test, bool fancy, int threads);
+    //!< returns the operations per second for "threads" running the "test".
+    /*!< the new primitive is used if "fancy" is true, and otherwise the
+    plain mutex is. */
+
+  void test_contention();
+    //!< runs all of the contention tests with a range of threads.
 };
 
+double test_mutex::time_contention(contention_tests test, bool fancy,
+    int threads)
+{
+  FUNCDEF("time_contention");
+  contention_arena arena(test, fancy);
+  int per_thread = CONTENTION_OPERATIONS / threads;
+  contender *contenders[MOST_CONTENDERS];
+  for (int i = 0; i < threads; i++)
+    contenders[i] = new contender(arena, per_thread);
+  // the snapshots are changing the whole time that they're being read.
+  contender writer(arena, 0, true);
+  if (test == SNAPSHOTS) writer.start(NULL_POINTER);
+
+  time_stamp started;
+  for (int i = 0; i < threads; i++) contenders[i]->start(NULL_POINTER);
+  for (int i = 0; i < threads; i++) contenders[i]->stop();
+  double duration = time_stamp().value() - started.value();
+
+  __atomic_store_n(&arena._done, true, __ATOMIC_RELAXED);
+  writer.stop();
+  for (int i = 0; i < threads; i++) WHACK(contenders[i]);
+
+  ASSERT_EQUAL(arena._mistakes, 0, "no reader should see a half-changed pair");
+  if (test == SHORT_HOLDS)
+    ASSERT_EQUAL(arena._counter, per_thread * threads,
+        "every increment of the counter should be kept");
+  return double(per_thread) * threads / maximum(duration, 1.0) * SECOND_ms;
+}
+
+void test_mutex::test_contention()
+{
+  FUNCDEF("test_contention");
+  for (int threads = 1; threads <= MOST_CONTENDERS; threads *= 4) {
+    log(a_sprintf("%d threads: read-mostly %.0f ops/s with a mutex, %.0f with "
+        "an rw_mutex.", threads, time_contention(READ_MOSTLY, false, threads),
+        time_contention(READ_MOSTLY, true, threads)));
+    log(a_sprintf("%d threads: short holds %.0f ops/s with a mutex, %.0f with "
+        "an adaptive_mutex.", threads,
+        time_contention(SHORT_HOLDS, false, threads),
+        time_contention(SHORT_HOLDS, true, threads)));
+    log(a_sprintf("%d threads: snapshot reads %.0f ops/s with a mutex, %.0f "
+        "with a seqlock.", threads, time_contention(SNAPSHOTS, false, threads),
+        time_contention(SNAPSHOTS, true, threads)));
+  }
+}
+
 int test_mutex::execute()
 {
   FUNCDEF("execute");
@@ -238,6 +433,8 @@ int test_mutex::execute()
     ASSERT_TRUE(time_per_lock < 1.0, "mutex lock timing should be super fast");
   }
 
+  test_contention();
+
   amorph<ethread> thread_list;
 
   for (int i = 0; i < DEFAULT_FISH; i++) {
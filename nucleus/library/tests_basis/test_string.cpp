@@ -859,6 +859,10 @@ void test_string::run_test_29()
   ASSERT_EQUAL(b, a, "second comparison failed");
 }
 
+// this isn't a member of test_string, so its FUNCDEF borrows the class name.
+#undef static_class_name
+#define static_class_name() "test_string"
+
 void standard_sprintf_test(const char *parm_string)
 {
   FUNCDEF("standard_sprintf_test");
@@ -875,6 +879,8 @@ void standard_sprintf_test(const char *parm_string)
       parm_string, parm_string, basis::un_long(rando.inclusive(0, 2998238)));
 }
 
+#undef static_class_name
+
 void test_string::run_test_30()
 {
   // 30th test group checks astring sprintf.
@@ -103,7 +103,7 @@ struct testing_file_struct : public FILE {};
 
 int test_system_preconditions::execute()
 {
-  FUNCDEF("execute")
+  FUNCDEF("execute");
   // let's see what this system is called.
   log(astring("The name of this software system is: ")
       + application_configuration::software_product_name());
@@ -0,0 +1,194 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_directory_watcher                                            *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/environment.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/byte_filer.h>
+#include <filesystem/directory.h>
+#include <filesystem/directory_tree.h>
+#include <filesystem/directory_watcher.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int DIRECTORIES = 50;
+  // how many directories are in the watched tree.
+
+const int FILES_PER_DIRECTORY = 200;
+  // how many files start out in each directory.
+
+const int REWRITES = 20;
+  // how many times each changed file is written during a burst.
+
+class test_directory_watcher : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_directory_watcher() : application_shell() {}
+  DEFINE_CLASS_NAME("test_directory_watcher");
+  virtual int execute();
+
+private:
+  astring _top;  // the directory where all our files are created.
+
+  void write_file(const astring &name, int size);
+  void remove_tree(const astring &path);
+  bool same_as_disk(const directory_tree &live);
+};
+
+void test_directory_watcher::write_file(const astring &name, int size)
+{
+  byte_filer out(name, "wb");
+  out.write(byte_array(size, NULL_POINTER));
+}
+
+void test_directory_watcher::remove_tree(const astring &path)
+{
+  directory dir(path);
+  for (int i = 0; i < dir.files().length(); i++)
+    filename(path + "/" + dir.files()[i]).unlink();
+  for (int i = 0; i < dir.directories().length(); i++)
+    remove_tree(path + "/" + dir.directories()[i]);
+  directory::remove_directory(path);
+}
+
+bool test_directory_watcher::same_as_disk(const directory_tree &live)
+{
+  directory_tree fresh(_top);
+  fresh.calculate(true);
+  filename_list diffs;
+  directory_tree::compare_trees(fresh, live, diffs,
+      file_info::file_similarity(file_info::EQUAL_FILESIZE
+      | file_info::EQUAL_TIMESTAMP));
+  if (diffs.elements()) {
+    log(astring("live tree is missing or has stale entries:\n")
+        + diffs.text_form());
+    return false;
+  }
+  directory_tree::compare_trees(live, fresh, diffs, file_info::EQUAL_NAME);
+  if (diffs.elements()) {
+    log(astring("live tree has extra entries:\n") + diffs.text_form());
+    return false;
+  }
+  return true;
+}
+
+int test_directory_watcher::execute()
+{
+  FUNCDEF("execute");
+  _top = environment::TMP();
+  if (!_top) _top = "/tmp";
+  _top += a_sprintf("/zz_dir_watcher_%d", application_configuration::process_id());
+  for (int d = 0; d < DIRECTORIES; d++) {
+    astring dir = a_sprintf("%s/dir%02d", _top.s(), d);
+    directory::recursive_create(dir);
+    for (int f = 0; f < FILES_PER_DIRECTORY; f++)
+      write_file(a_sprintf("%s/file%03d", dir.s(), f), 10);
+  }
+
+  directory_watcher watcher;
+  if (!watcher.good()) {
+    log(astring("change notification isn't supported here; skipping."));
+    remove_tree(_top);
+    return final_report();
+  }
+  // watch before scanning, so nothing is missed in between.
+  ASSERT_TRUE(watcher.watch_tree(_top), "watching the tree should work");
+  ASSERT_EQUAL(watcher.watches(), DIRECTORIES + 1, "all dirs should be watched");
+  time_stamp started;
+  directory_tree live(_top);
+  live.calculate(true);
+  double scan_time = time_stamp().value() - started.value();
+
+  // a burst of writes to a few files should boil down to one change each.
+  for (int i = 0; i < REWRITES; i++) {
+    write_file(_top + "/dir03/file007", 100 + i);
+    write_file(_top + "/dir17/file100", 200 + i);
+  }
+  bool rescanned;
+  started.reset();
+  int changes = watcher.update(live, true, rescanned);
+  double update_time = time_stamp().value() - started.value();
+  ASSERT_EQUAL(changes, 2, "burst of writes should be coalesced");
+  ASSERT_FALSE(rescanned, "no rescan should be needed for a burst");
+  ASSERT_TRUE(same_as_disk(live), "modified files should be refreshed");
+  log(a_sprintf("full scan of %d files took %.0f ms; applying a burst of %d "
+      "events took %.0f ms.", DIRECTORIES * FILES_PER_DIRECTORY, scan_time,
+      watcher.events_seen(), update_time));
+
+  // new files, removed files and a whole new directory with contents.
+  write_file(_top + "/dir05/brand_new", 33);
+  filename(_top + "/dir06/file000").unlink();
+  filename(_top + "/dir06/file001").unlink();
+  directory::recursive_create(_top + "/dir07/deeper/deepest");
+  write_file(_top + "/dir07/deeper/a_file", 44);
+  write_file(_top + "/dir07/deeper/deepest/b_file", 55);
+  watcher.update(live, true, rescanned);
+  ASSERT_FALSE(rescanned, "no rescan should be needed for additions");
+  ASSERT_TRUE(same_as_disk(live), "additions and removals should show up");
+  ASSERT_TRUE(live.seek(_top + "/dir07/deeper/deepest", false),
+      "new directory should be in the tree");
+
+  // the new directories are watched too.
+  write_file(_top + "/dir07/deeper/deepest/c_file", 66);
+  watcher.update(live, true, rescanned);
+  ASSERT_TRUE(same_as_disk(live), "files in new directories should show up");
+
+  // removing a whole directory takes it out of the tree.
+  remove_tree(_top + "/dir07/deeper");
+  watcher.update(live, true, rescanned);
+  ASSERT_TRUE(same_as_disk(live), "removed directory should be gone");
+  ASSERT_FALSE(live.seek(_top + "/dir07/deeper", false),
+      "removed directory should not be found");
+
+  // moving a directory forces a full rescan, which gets it all right.
+  directory::recursive_create(_top + "/moving/inner");
+  write_file(_top + "/moving/inner/file", 77);
+  watcher.update(live, true, rescanned);
+  rename((_top + "/moving").s(), (_top + "/moved").s());
+  watcher.update(live, true, rescanned);
+  ASSERT_TRUE(rescanned, "moving a directory should cause a rescan");
+  ASSERT_EQUAL(watcher.rescans(), 1, "one rescan should have happened");
+  ASSERT_TRUE(same_as_disk(live), "moved directory should show up");
+
+  // nothing changed, so nothing is applied.
+  ASSERT_EQUAL(watcher.update(live, true, rescanned), 0,
+      "quiet tree should have no changes");
+
+  watcher.unwatch_all();
+  ASSERT_EQUAL(watcher.watches(), 0, "watches should be gone");
+
+  remove_tree(_top);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_directory_watcher, )
+
@@ -0,0 +1,219 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_file_copier                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/environment.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/directory.h>
+#include <filesystem/filename.h>
+#include <filesystem/heavy_file_ops.h>
+#include <filesystem/huge_file.h>
+#include <loggers/program_wide_logger.h>
+#include <mathematics/chaos.h>
+#include <processes/file_copier.h>
+#include <structures/static_memory_gremlin.h>
+#include <structures/string_array.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace mathematics;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int BIG_FILE_SIZE = 64 * MEGABYTE;
+  // the size of the file used to measure single file copies.
+
+const int SMALL_FILE_COUNT = 2000;
+  // how many small files are copied in the multi-file test.
+
+const int SMALL_FILE_SIZE = 4 * KILOBYTE;
+  // the largest size of each small file.
+
+class test_file_copier : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_file_copier() : application_shell() {}
+  DEFINE_CLASS_NAME("test_file_copier");
+  virtual int execute();
+
+private:
+  astring _top;  // the directory where all our files are created.
+
+  void create_file(const astring &name, int size, chaos &randomizer);
+  bool same_contents(const astring &first, const astring &second);
+  void remove_tree(const astring &path);
+  void test_single_file(chaos &randomizer);
+  void test_many_files(chaos &randomizer);
+};
+
+void test_file_copier::create_file(const astring &name, int size,
+    chaos &randomizer)
+{
+  huge_file target(name, "wb");
+  byte_array chunk;
+  huge_file::file_offset position = 0;
+  while (position < size) {
+    chunk.reset(minimum(int(MEGABYTE), int(size - position)));
+    for (int i = 0; i < chunk.length(); i++)
+      chunk[i] = abyte(randomizer.inclusive(0, 255));
+    int written = 0;
+    if (target.write_at(position, chunk, written) != huge_file::OKAY) return;
+    position += written;
+  }
+}
+
+bool test_file_copier::same_contents(const astring &first,
+    const astring &second)
+{
+  huge_file one(first, "rb");
+  huge_file two(second, "rb");
+  if (!one.good() || !two.good() || (one.size() != two.size())) return false;
+  byte_array chunk1, chunk2;
+  while (!one.eof()) {
+    int read1 = 0, read2 = 0;
+    one.read(chunk1, MEGABYTE, read1);
+    two.read(chunk2, MEGABYTE, read2);
+    if ( (read1 != read2) || !read1 || (chunk1 != chunk2) ) return false;
+  }
+  return true;
+}
+
+void test_file_copier::remove_tree(const astring &path)
+{
+  directory dir(path);
+  for (int i = 0; i < dir.files().length(); i++)
+    filename(path + "/" + dir.files()[i]).unlink();
+  for (int i = 0; i < dir.directories().length(); i++)
+    remove_tree(path + "/" + dir.directories()[i]);
+  directory::remove_directory(path);
+}
+
+void test_file_copier::test_single_file(chaos &randomizer)
+{
+  FUNCDEF("test_single_file");
+  astring source = _top + "/big_source";
+  create_file(source, BIG_FILE_SIZE, randomizer);
+
+  // the kernel copy, if this system supports it.
+  file_copier copier;
+  astring kernel_target = _top + "/copies/big_kernel";
+  ASSERT_EQUAL(copier.copy_file(source, kernel_target).value(),
+      heavy_file_operations::OKAY, "kernel copy should succeed");
+  ASSERT_TRUE(same_contents(source, kernel_target),
+      "kernel copy should match the source");
+  log(astring("kernel copy: ") + copier.text_form());
+
+  // the double-buffered pipeline.
+  copier.reset_statistics();
+  astring piped_target = _top + "/copies/big_piped";
+  ASSERT_EQUAL(copier.copy_pipelined(source, piped_target).value(),
+      heavy_file_operations::OKAY, "pipelined copy should succeed");
+  ASSERT_TRUE(same_contents(source, piped_target),
+      "pipelined copy should match the source");
+  ASSERT_EQUAL(copier.kernel_copies(), 0, "pipeline should not use kernel");
+  log(astring("pipelined copy: ") + copier.text_form());
+
+  // calling the kernel copy directly tells us which method it settled on.
+  astring plain_target = _top + "/copies/big_plain";
+  time_stamp started;
+  heavy_file_operations::copy_methods method;
+  outcome ret = heavy_file_operations::kernel_copy(source, plain_target,
+      method);
+  if (ret == heavy_file_operations::OKAY)
+    log(a_sprintf("kernel_copy used method %d in %.0f ms.", int(method),
+        time_stamp().value() - started.value()));
+  else
+    log(astring("kernel_copy is not supported here."));
+
+  // the empty file edge case goes down the buffered path.
+  astring empty_source = _top + "/empty_source";
+  create_file(empty_source, 0, randomizer);
+  astring empty_target = _top + "/copies/empty";
+  ASSERT_EQUAL(heavy_file_operations::copy_file(empty_source,
+      empty_target).value(), heavy_file_operations::OKAY,
+      "empty copy should succeed");
+  ASSERT_TRUE(same_contents(empty_source, empty_target),
+      "empty copy should match");
+
+  ASSERT_EQUAL(copier.copy_file(_top + "/not_there", empty_target).value(),
+      heavy_file_operations::SOURCE_MISSING, "missing source should fail");
+}
+
+void test_file_copier::test_many_files(chaos &randomizer)
+{
+  FUNCDEF("test_many_files");
+  string_array sources, targets;
+  for (int i = 0; i < SMALL_FILE_COUNT; i++) {
+    astring name = a_sprintf("%s/small/dir%02d/file%05d", _top.s(), i % 20, i);
+    if (i < 20) directory::recursive_create(filename(name).dirname().raw());
+    create_file(name, randomizer.inclusive(1, SMALL_FILE_SIZE), randomizer);
+    sources += name;
+    targets += a_sprintf("%s/small_copy/dir%02d/file%05d", _top.s(),
+        i % 20, i);
+  }
+
+  file_copier single(1);
+  ASSERT_EQUAL(single.copy_files(sources, targets).value(),
+      heavy_file_operations::OKAY, "single thread copies should work");
+  log(astring("1 thread: ") + single.text_form());
+
+  file_copier pool;
+  ASSERT_EQUAL(pool.copy_files(sources, targets).value(),
+      heavy_file_operations::OKAY, "pooled copies should work");
+  ASSERT_EQUAL(pool.files_copied(), SMALL_FILE_COUNT,
+      "every file should be copied");
+  log(a_sprintf("%d threads: ", pool.pool_size()) + pool.text_form());
+
+  int mismatches = 0;
+  for (int i = 0; i < sources.length(); i++)
+    if (!same_contents(sources[i], targets[i])) mismatches++;
+  ASSERT_EQUAL(mismatches, 0, "copied files should match their sources");
+
+  string_array short_list = targets;
+  short_list.zap(0, 0);
+  ASSERT_EQUAL(pool.copy_files(sources, short_list).value(),
+      heavy_file_operations::BAD_INPUT, "mismatched lists should be refused");
+}
+
+int test_file_copier::execute()
+{
+  FUNCDEF("execute");
+  chaos randomizer;
+  _top = environment::TMP();
+  if (!_top) _top = "/tmp";
+  _top += a_sprintf("/zz_file_copier_%d", application_configuration::process_id());
+  directory::recursive_create(_top);
+
+  test_single_file(randomizer);
+  test_many_files(randomizer);
+
+  remove_tree(_top);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_file_copier, )
+
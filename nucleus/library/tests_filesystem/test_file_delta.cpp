@@ -0,0 +1,325 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_file_delta                                                   *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/environment.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/byte_filer.h>
+#include <filesystem/content_hash.h>
+#include <filesystem/directory.h>
+#include <filesystem/file_delta.h>
+#include <filesystem/file_info.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <filesystem/heavy_file_ops.h>
+#include <filesystem/huge_file.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+typedef content_hash::wide_hash wide_hash;
+
+const int BIG_FILE_SIZE = 64 * MEGABYTE + 321;
+  // the size of the file that's changed slightly.  raising this to a gigabyte
+  // gives the figures for the big transfers this was designed for.
+
+const int CHANGED_REGIONS = 64;
+  // how many places in the big file get overwritten.
+
+const int CHANGE_SIZE = BIG_FILE_SIZE / CHANGED_REGIONS / 100;
+  // the size of each overwritten region, so about 1% of the file changes.
+
+const int TRANSFER_SIZE = 1 * MEGABYTE;
+  // the size of each buffer sent across, like the file transfer tentacle.
+
+class test_file_delta : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_file_delta() : application_shell(), _seed(12345) {}
+  DEFINE_CLASS_NAME("test_file_delta");
+  virtual int execute();
+
+private:
+  astring _top;  // the directory where all our files are created.
+  un_int _seed;  // the state of our random byte generator.
+
+  void random_fill(byte_array &data, int start, int length);
+  void write_file(const astring &path, const byte_array &data);
+  wide_hash hash_of(const astring &path);
+  double transfer(const astring &source, const astring &target,
+          delta_source *deltas, outcome &result,
+          const byte_array *changed = NULL_POINTER);
+};
+
+void test_file_delta::random_fill(byte_array &data, int start, int length)
+{
+  // a simple generator is plenty; the blocks just need to be distinct.
+  for (int i = start; i < start + length; i++) {
+    _seed = _seed * 1103515245 + 12345;
+    data[i] = abyte(_seed >> 16);
+  }
+}
+
+void test_file_delta::write_file(const astring &path, const byte_array &data)
+{
+  byte_filer out(path, "wb");
+  out.write(data);
+}
+
+wide_hash test_file_delta::hash_of(const astring &path)
+{
+  wide_hash to_return = 0;
+  content_hash::hash_file(path, to_return);
+  return to_return;
+}
+
+// moves the file at "source" onto the "target" the way the file transfer
+// tentacle would, returning the number of bytes that went across.  if the
+// "changed" contents are provided, the source file is rewritten with them
+// after the first buffer is sent.
+
+double test_file_delta::transfer(const astring &source, const astring &target,
+    delta_source *deltas, outcome &result, const byte_array *changed)
+{
+  filename_list to_send;
+  to_send += new file_info(filename("file"), 0);
+  file_transfer_header last_action((file_time()));
+  byte_array storage;
+  double sent = 0;
+  result = common::OKAY;
+  bool whole = !deltas;  // true once the pieces are plain file contents.
+  outcome ret;
+  do {
+    ret = heavy_file_operations::buffer_files(source, to_send, last_action,
+        storage, TRANSFER_SIZE, deltas);
+    sent += storage.length();
+    if (changed) {
+      write_file(source + "/file", *changed);
+      changed = NULL_POINTER;
+    }
+    while (storage.length()) {
+      file_transfer_header found((file_time()));
+      if (!found.unpack(storage) || (found._length > storage.length())) {
+        result = common::GARBAGE;
+        return sent;
+      }
+      byte_array piece = storage.subarray(0, found._length - 1);
+      storage.zap(0, found._length - 1);
+      if (!whole) {
+        bool finished;
+        outcome applied = delta_target::apply_piece(target + "/file",
+            found._byte_start, piece, finished);
+        if (applied != common::OKAY) result = applied;
+        // an abandoned delta is followed by the whole file.
+        if (applied == common::INCOMPLETE) whole = true;
+      } else {
+        heavy_file_operations::write_file_chunk(target + "/file",
+            found._byte_start, piece);
+      }
+    }
+  } while (ret == common::OKAY);
+  return sent;
+}
+
+int test_file_delta::execute()
+{
+  FUNCDEF("execute");
+  _top = environment::TMP();
+  if (!_top) _top = "/tmp";
+  _top += a_sprintf("/zz_file_delta_%d", application_configuration::process_id());
+  astring source_dir = _top + "/source";
+  astring target_dir = _top + "/target";
+  directory::recursive_create(source_dir);
+  directory::recursive_create(target_dir);
+  astring source = source_dir + "/file";
+  astring target = target_dir + "/file";
+
+  // the rolling checksum must match one computed from scratch.
+  {
+    byte_array data(5000);
+    random_fill(data, 0, data.length());
+    const int window = 700;
+    un_int sum = file_signature::weak_sum(data.observe(), window);
+    bool all_matched = true;
+    for (int i = 1; i + window <= data.length(); i++) {
+      sum = file_signature::roll(sum, data[i - 1], data[i + window - 1], window);
+      if (sum != file_signature::weak_sum(data.observe() + i, window))
+        all_matched = false;
+    }
+    ASSERT_TRUE(all_matched, "rolling checksum should match the full sum");
+  }
+
+  // signatures survive packing.
+  {
+    byte_array data(100 * KILOBYTE + 17);
+    random_fill(data, 0, data.length());
+    write_file(target, data);
+    file_signature sig;
+    ASSERT_TRUE(sig.compute(target, "file"), "signing should work");
+    ASSERT_EQUAL(sig._block_size, int(file_signature::MINIMUM_BLOCK),
+        "small files should use the smallest blocks");
+    ASSERT_EQUAL(sig.blocks(), 51, "the short last block should be counted");
+    byte_array packed;
+    sig.pack(packed);
+    ASSERT_EQUAL(packed.length(), sig.packed_size(), "packed size should be right");
+    file_signature copy;
+    ASSERT_TRUE(copy.unpack(packed), "unpacking should work");
+    ASSERT_EQUAL(copy.blocks(), sig.blocks(), "block count should survive");
+    ASSERT_TRUE(copy._strong[50] == sig._strong[50], "hashes should survive");
+    ASSERT_FALSE(sig.compute(_top + "/not_there", "file"),
+        "missing file can't be signed");
+  }
+
+  // the big file changes in scattered spots, and gains and loses a few bytes
+  // so that most of the blocks no longer sit at their old offsets.  only one
+  // copy of the contents is kept in memory, so the size can be raised.
+  {
+    byte_array data(BIG_FILE_SIZE);
+    random_fill(data, 0, data.length());
+    write_file(target, data);
+    for (int i = 0; i < CHANGED_REGIONS; i++) {
+      int where = int(double(i) * (BIG_FILE_SIZE - CHANGE_SIZE) / CHANGED_REGIONS)
+          + 7777;
+      random_fill(data, where, CHANGE_SIZE);
+    }
+    byte_array inserted(1000);
+    random_fill(inserted, 0, inserted.length());
+    const int insert_at = BIG_FILE_SIZE / 3, delete_at = BIG_FILE_SIZE / 3 * 2;
+    byte_filer out(source, "wb");
+    out.write(data.observe(), insert_at);
+    out.write(inserted);
+    out.write(data.observe() + insert_at, delete_at - insert_at);
+    out.write(data.observe() + delete_at + 500, BIG_FILE_SIZE - delete_at - 500);
+  }
+  wide_hash new_hash = hash_of(source);
+  double new_size = huge_file(source, "rb").length();
+
+  // the plain transfer sends everything.
+  astring plain_dir = _top + "/plain";
+  directory::recursive_create(plain_dir);
+  time_stamp started;
+  outcome result;
+  double plain_sent = transfer(source_dir, plain_dir, NULL_POINTER, result);
+  double plain_time = time_stamp().value() - started.value();
+  ASSERT_TRUE(hash_of(plain_dir + "/file") == new_hash, "plain copy should match");
+
+  // the delta transfer sends the signature and just the changes.
+  started.reset();
+  file_signature *sig = new file_signature;
+  ASSERT_TRUE(sig->compute(target, "file"), "signing the old file should work");
+  byte_array packed_signature;
+  sig->pack(packed_signature);
+  delta_source deltas;
+  deltas.add(sig);
+  ASSERT_TRUE(deltas.covers("file"), "the file should be covered");
+  double delta_sent = transfer(source_dir, target_dir, &deltas, result)
+      + packed_signature.length();
+  double delta_time = time_stamp().value() - started.value();
+  ASSERT_EQUAL(result.value(), common::OKAY, "applying the delta should work");
+  ASSERT_TRUE(hash_of(target) == new_hash, "delta copy should match");
+  ASSERT_FALSE(filename(target + delta_target::partial_suffix()).exists(),
+      "partial file should be gone");
+  ASSERT_TRUE(delta_sent < plain_sent / 10, "delta should be far smaller");
+  ASSERT_TRUE(deltas.literal_bytes() < new_size / 20,
+      "most of the file should be copied");
+  log(a_sprintf("%d MB file with %d%% changed: plain sent %.0f bytes in %.0f ms; "
+      "delta sent %.0f bytes (%.0f signature) in %.0f ms, with %.0f bytes "
+      "literal and %.0f copied", BIG_FILE_SIZE / MEGABYTE, 1, plain_sent,
+      plain_time, delta_sent, double(packed_signature.length()), delta_time,
+      deltas.literal_bytes(), deltas.copied_bytes()));
+
+  // a file with nothing in common still arrives intact.
+  byte_array other(300 * KILOBYTE + 5);
+  random_fill(other, 0, other.length());
+  write_file(source, other);
+  sig = new file_signature;
+  sig->compute(target, "file");
+  deltas.add(sig);
+  transfer(source_dir, target_dir, &deltas, result);
+  ASSERT_EQUAL(result.value(), common::OKAY, "unrelated delta should work");
+  ASSERT_TRUE(hash_of(target) == hash_of(source), "unrelated copy should match");
+
+  // an empty file empties the target.
+  write_file(source, byte_array());
+  sig = new file_signature;
+  sig->compute(target, "file");
+  deltas.add(sig);
+  transfer(source_dir, target_dir, &deltas, result);
+  ASSERT_EQUAL(result.value(), common::OKAY, "empty delta should work");
+  ASSERT_EQUAL(huge_file(target, "rb").length(), 0.0, "target should be empty");
+
+  // a signature that doesn't describe the target can't damage it.
+  byte_array small(200 * KILOBYTE);
+  random_fill(small, 0, small.length());
+  write_file(target, small);
+  sig = new file_signature;
+  sig->compute(target, "file");
+  deltas.add(sig);
+  small[small.length() / 2]++;
+  write_file(source, small);  // nearly every block can be copied...
+  random_fill(small, 0, small.length() / 2);
+  write_file(target, small);  // but the target they came from has changed.
+  wide_hash different_hash = hash_of(target);
+  transfer(source_dir, target_dir, &deltas, result);
+  ASSERT_EQUAL(result.value(), common::FAILURE, "stale signature should fail");
+  ASSERT_TRUE(hash_of(target) == different_hash,
+      "target should be left alone");
+  ASSERT_FALSE(filename(target + delta_target::partial_suffix()).exists(),
+      "failed partial file should be removed");
+
+  // a source that shrinks partway through its delta can't finish it, so the
+  // delta is abandoned and the whole file is sent in its place.
+  byte_array unrelated(3 * TRANSFER_SIZE);
+  random_fill(unrelated, 0, unrelated.length());
+  write_file(source, unrelated);
+  sig = new file_signature;
+  sig->compute(target, "file");
+  deltas.add(sig);
+  byte_array shrunk(100 * KILOBYTE);
+  random_fill(shrunk, 0, shrunk.length());
+  transfer(source_dir, target_dir, &deltas, result, &shrunk);
+  ASSERT_EQUAL(result.value(), common::INCOMPLETE,
+      "delta should have been abandoned");
+  ASSERT_FALSE(deltas.covers("file"), "abandoned file should be forgotten");
+  ASSERT_TRUE(hash_of(target) == hash_of(source),
+      "whole copy should match after abandoning delta");
+  ASSERT_FALSE(filename(target + delta_target::partial_suffix()).exists(),
+      "abandoned partial file should be removed");
+
+  filename(source).unlink();
+  filename(target).unlink();
+  filename(plain_dir + "/file").unlink();
+  directory::remove_directory(source_dir);
+  directory::remove_directory(target_dir);
+  directory::remove_directory(plain_dir);
+  directory::remove_directory(_top);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_file_delta, )
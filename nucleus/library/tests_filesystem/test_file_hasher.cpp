@@ -0,0 +1,209 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_file_hasher                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/environment.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/byte_filer.h>
+#include <filesystem/content_hash.h>
+#include <filesystem/directory.h>
+#include <filesystem/directory_tree.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <filesystem/hash_cache.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/file_hasher.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+typedef content_hash::wide_hash wide_hash;
+
+const int BIG_FILE_SIZE = 64 * MEGABYTE + 123;
+  // the size of the file used for timing; it doesn't end on a chunk boundary.
+
+const int SMALL_FILES = 200;
+  // how many little files are put into the tree alongside the big one.
+
+class test_file_hasher : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_file_hasher() : application_shell() {}
+  DEFINE_CLASS_NAME("test_file_hasher");
+  virtual int execute();
+
+private:
+  astring _top;  // the directory where all our files are created.
+
+  void write_file(const astring &path, int size, int flavor);
+  int count_unhashed(const directory_tree &tree);
+  void remove_tree(const astring &path);
+};
+
+void test_file_hasher::write_file(const astring &path, int size, int flavor)
+{
+  byte_array data(size);
+  for (int i = 0; i < size; i++) data[i] = abyte((i * 31 + flavor) ^ (i >> 11));
+  byte_filer out(path, "wb");
+  out.write(data);
+}
+
+int test_file_hasher::count_unhashed(const directory_tree &tree)
+{
+  int to_return = 0;
+  dir_tree_iterator *ted = tree.start(directory_tree::prefix);
+  filename curr;
+  while (directory_tree::current_dir(*ted, curr)) {
+    filename_list *files = directory_tree::access(*ted);
+    for (int i = 0; files && (i < files->elements()); i++)
+      if (!files->get(i)->_content_hash) to_return++;
+    directory_tree::next(*ted);
+  }
+  directory_tree::throw_out(ted);
+  return to_return;
+}
+
+void test_file_hasher::remove_tree(const astring &path)
+{
+  directory dir(path);
+  for (int i = 0; i < dir.files().length(); i++)
+    filename(path + "/" + dir.files()[i]).unlink();
+  for (int i = 0; i < dir.directories().length(); i++)
+    remove_tree(path + "/" + dir.directories()[i]);
+  directory::remove_directory(path);
+}
+
+int test_file_hasher::execute()
+{
+  FUNCDEF("execute");
+  _top = environment::TMP();
+  if (!_top) _top = "/tmp";
+  _top += a_sprintf("/zz_file_hasher_%d", application_configuration::process_id());
+  astring tree_path = _top + "/tree";
+  directory::recursive_create(tree_path + "/sub");
+
+  // the big file is hashed both ways; the answers must match.
+  astring big = tree_path + "/big_file";
+  write_file(big, BIG_FILE_SIZE, 0);
+  time_stamp started;
+  wide_hash serial_hash;
+  ASSERT_TRUE(content_hash::hash_file(big, serial_hash), "serial hash should work");
+  double serial_time = time_stamp().value() - started.value();
+
+  file_hasher hasher;
+  wide_hash parallel_hash;
+  ASSERT_TRUE(hasher.hash_file(big, parallel_hash), "parallel hash should work");
+  ASSERT_TRUE(parallel_hash == serial_hash, "both hashes should agree");
+  ASSERT_EQUAL(hasher.bytes_read(), double(BIG_FILE_SIZE),
+      "the whole file should be read once");
+  log(a_sprintf("%d MB file: serial hash took %.0f ms; ",
+      BIG_FILE_SIZE / MEGABYTE, serial_time) + hasher.text_form());
+
+  // the second time around, the cache knows the answer.
+  ASSERT_TRUE(hasher.hash_file(big, parallel_hash), "cached hash should work");
+  ASSERT_TRUE(parallel_hash == serial_hash, "cached hash should agree");
+  ASSERT_EQUAL(hasher.cache_hits(), 1, "the cache should be used");
+  ASSERT_EQUAL(hasher.bytes_read(), 0.0, "nothing should be read");
+
+  // a missing file can't be hashed.
+  ASSERT_FALSE(hasher.hash_file(_top + "/not_there", parallel_hash),
+      "missing file should fail");
+
+  // fill the tree with small files.
+  for (int i = 0; i < SMALL_FILES; i++)
+    write_file(a_sprintf("%s/sub/f%03d", tree_path.s(), i), 1000 + i, i);
+  write_file(tree_path + "/twin", 1000, 0);
+
+  astring sidecar = _top + "/hashes.cache";
+  directory_tree original(tree_path);
+  ASSERT_TRUE(original.calculate(true), "calculating sizes should work");
+  ASSERT_EQUAL(count_unhashed(original), SMALL_FILES + 2,
+      "calculate should not hash anything");
+  {
+    file_hasher with_sidecar(4, sidecar);
+    ASSERT_TRUE(with_sidecar.hash_tree(original), "hashing the tree should work");
+    ASSERT_EQUAL(count_unhashed(original), 0, "all files should be hashed");
+    ASSERT_EQUAL(with_sidecar.files_hashed(), SMALL_FILES + 2,
+        "every file should be read");
+    log(astring("first tree hash: ") + with_sidecar.text_form());
+    ASSERT_TRUE(with_sidecar.save_cache(), "saving the sidecar should work");
+  }
+
+  // a new hasher picks up where the old one left off.
+  file_hasher reloaded(4, sidecar);
+  ASSERT_EQUAL(reloaded.cache().elements(), SMALL_FILES + 2,
+      "the sidecar should hold every hash");
+  directory_tree again(tree_path);
+  again.calculate(true);
+  ASSERT_TRUE(reloaded.hash_tree(again), "rehashing the tree should work");
+  ASSERT_EQUAL(reloaded.cache_hits(), SMALL_FILES + 2,
+      "every file should come from the cache");
+  ASSERT_EQUAL(reloaded.bytes_read(), 0.0, "nothing should be read again");
+  log(astring("cached tree hash: ") + reloaded.text_form());
+
+  // files with identical contents hash the same.
+  filename_list diffs;
+  directory_tree::compare_trees(original, again, diffs, file_info::EQUAL_CONTENT);
+  ASSERT_EQUAL(diffs.elements(), 0, "identical trees should match");
+
+  // change one file without changing its size; only it is hashed again.
+  write_file(a_sprintf("%s/sub/f%03d", tree_path.s(), 17), 1017, 99);
+  directory_tree changed(tree_path);
+  changed.calculate(true);
+  ASSERT_TRUE(reloaded.hash_tree(changed), "hashing the changed tree should work");
+  ASSERT_EQUAL(reloaded.files_hashed(), 1, "only the changed file should be read");
+  ASSERT_EQUAL(reloaded.bytes_read(), 1017.0, "only its bytes should be read");
+
+  diffs.reset();
+  directory_tree::compare_trees(changed, original, diffs,
+      file_info::file_similarity(file_info::EQUAL_FILESIZE | file_info::EQUAL_CONTENT));
+  ASSERT_EQUAL(diffs.elements(), 1, "the change should be spotted");
+  if (diffs.elements())
+    ASSERT_TRUE(diffs.get(0)->raw().ends(astring("f017")),
+        "the changed file should be reported");
+
+  // the stale identity is dropped once a run goes by without it.
+  ASSERT_TRUE(reloaded.save_cache(), "saving again should work");
+  file_hasher last(4, sidecar);
+  ASSERT_EQUAL(last.cache().elements(), SMALL_FILES + 3,
+      "both identities for the changed file should be saved");
+  directory_tree final_tree(tree_path);
+  final_tree.calculate(true);
+  ASSERT_TRUE(last.hash_tree(final_tree), "hashing the final tree should work");
+  ASSERT_EQUAL(last.cache_hits(), SMALL_FILES + 2, "all should be cached");
+  ASSERT_TRUE(last.save_cache(), "saving the final sidecar should work");
+  ASSERT_EQUAL(last.cache().elements(), SMALL_FILES + 2,
+      "the stale entry should be forgotten");
+
+  remove_tree(_top);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_file_hasher, )
+
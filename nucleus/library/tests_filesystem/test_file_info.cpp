@@ -14,6 +14,7 @@
 #include <loggers/program_wide_logger.h>
 #include <loggers/critical_events.h>
 #include <mathematics/chaos.h>
+#include <structures/object_packers.h>
 #include <timely/time_stamp.h>
 #include <unit_test/unit_base.h>
 
@@ -22,6 +23,7 @@ using namespace basis;
 using namespace filesystem;
 using namespace loggers;
 using namespace mathematics;
+using namespace structures;
 using namespace timely;
 using namespace unit_test;
 
@@ -104,6 +106,39 @@ int test_file_info::execute()
   ASSERT_EQUAL(seconame, unstuffy.secondary(), "secondary name incorrect");
   ASSERT_EQUAL(randobytes, unstuffy.attachment(), "secondary attachment inaccurate");
 
+  // without a content hash, the packed form must be laid out just as it was
+  // before the hash existed, so that older peers can still read it.
+  byte_array old_layout;
+  ((filename &)testing).pack(old_layout);
+  attach(old_layout, testing._file_size);
+  testing._time.pack(old_layout);
+  attach(old_layout, testing._checksum);
+  astring(testing.secondary()).pack(old_layout);
+  attach(old_layout, testing.attachment());
+  packed.reset();
+  testing.pack(packed);
+  ASSERT_EQUAL(packed, old_layout, "unhashed packing should match the old layout");
+
+  // with a hash, it's carried along and the rest still comes back intact.
+  testing._content_hash = (checksums::wide_hash(0x8badf00d) << 32) | 0xfeedface;
+  packed.reset();
+  size = testing.packed_size();
+  testing.pack(packed);
+  ASSERT_EQUAL(size, packed.length(), "hashed packed size accuracy");
+  ASSERT_TRUE(unstuffy.unpack(packed), "hashed unpacking");
+  ASSERT_TRUE(unstuffy._content_hash == testing._content_hash,
+      "content hash should survive packing");
+  ASSERT_EQUAL(unstuffy._checksum, 1283412, "hashed checksum");
+  ASSERT_EQUAL(unstuffy.had_directory(), testing.had_directory(),
+      "directory flag should not be disturbed by the hash flag");
+  ASSERT_EQUAL(seconame, unstuffy.secondary(), "hashed secondary name");
+  ASSERT_EQUAL(randobytes, unstuffy.attachment(), "hashed attachment");
+
+  // an old style record leaves no stale hash behind.
+  ASSERT_TRUE(unstuffy.unpack(old_layout), "old layout unpacking");
+  ASSERT_FALSE(unstuffy._content_hash, "old layout should carry no hash");
+  ASSERT_EQUAL(unstuffy._checksum, 1283412, "old layout checksum");
+
   return final_report();
 }
 
@@ -118,7 +118,7 @@ bool test_filename::prepare_string_arrays_for_filenames(const astring &common_bi
     bool &exemplar_rooted, string_array &exemplar_pieces,
     bool &acolyte_rooted, string_array &acolyte_pieces)
 {
-  FUNCDEF("prepare_string_arrays_for_filenames")
+  FUNCDEF("prepare_string_arrays_for_filenames");
   bool to_return = true;  // success until we learn otherwise.
 
   // generate the acolyte, which will be tested again, very straightforwardly.
@@ -145,7 +145,7 @@ bool test_filename::prepare_string_arrays_for_filenames(const astring &common_bi
 
 int test_filename::execute()
 {
-  FUNCDEF("execute")
+  FUNCDEF("execute");
   {
     // first test group.
     filename gorgeola("");
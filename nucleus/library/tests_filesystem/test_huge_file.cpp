@@ -15,6 +15,7 @@
 #include <basis/functions.h>
 #include <basis/guards.h>
 #include <basis/astring.h>
+#include <basis/environment.h>
 #include <configuration/application_configuration.h>
 #include <filesystem/directory.h>
 #include <filesystem/filename.h>
@@ -22,8 +23,12 @@
 #include <loggers/critical_events.h>
 #include <loggers/program_wide_logger.h>
 #include <mathematics/chaos.h>
+#include <processes/ethread.h>
+#include <structures/amorph.h>
 #include <structures/static_memory_gremlin.h>
 #include <structures/string_array.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
 #include <unit_test/unit_base.h>
 
 using namespace application;
@@ -32,6 +37,7 @@ using namespace configuration;
 using namespace mathematics;
 using namespace filesystem;
 using namespace loggers;
+using namespace processes;
 using namespace structures;
 using namespace textual;
 using namespace timely;
@@ -39,15 +45,169 @@ using namespace unit_test;
 
 #define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
 
+const int WRITER_THREADS = 8;
+  // how many threads fill regions of the same file at once.
+
+const int REGION_SIZE = 4 * MEGABYTE;
+  // the number of bytes each writer thread is responsible for.
+
+const int PIECE_SIZE = 64 * KILOBYTE;
+  // the size of each positional write the threads perform.
+
+const huge_file::file_offset SPARSE_SIZE
+    = huge_file::file_offset(300) * huge_file::file_offset(GIGABYTE);
+  // a sparse file of this size is used to time length and seek operations.
+
+const int SIZING_RUNS = 100000;
+  // how many times the length of the sparse file is measured.
+
 class test_huge_file : public virtual unit_base, virtual public application_shell
 {
 public:
   test_huge_file() : application_shell() {}
   DEFINE_CLASS_NAME("test_huge_file");
   void run_file_scan();
+  void test_concurrent_regions();
+  void test_huge_offsets();
   virtual int execute();
 };
 
+// the byte expected at "position" in the region file.
+static abyte region_pattern(huge_file::file_offset position)
+{ return abyte((position / PIECE_SIZE) * 7 + position % 251); }
+
+// fills one region of a shared file using only positional writes.
+class region_writer : public ethread
+{
+public:
+  region_writer(huge_file &target, int region)
+  : ethread(), _target(target), _region(region), _failures(0) {}
+
+  DEFINE_CLASS_NAME("region_writer");
+
+  int failures() const { return _failures; }
+
+  virtual void perform_activity(void *formal(ptr)) {
+    byte_array piece(PIECE_SIZE);
+    huge_file::file_offset start = huge_file::file_offset(_region) * REGION_SIZE;
+    // write the pieces backwards so the file is extended out of order.
+    for (int offset = REGION_SIZE - PIECE_SIZE; offset >= 0;
+        offset -= PIECE_SIZE) {
+      for (int i = 0; i < PIECE_SIZE; i++)
+        piece[i] = region_pattern(start + offset + i);
+      int written = 0;
+      outcome ret = _target.write_at(start + offset, piece, written);
+      if ( (ret != huge_file::OKAY) || (written != PIECE_SIZE) ) _failures++;
+    }
+  }
+
+private:
+  huge_file &_target;
+  int _region;
+  int _failures;
+};
+
+astring temporary_name(const astring &suffix)
+{
+  astring tmpdir = environment::TMP();
+  if (!tmpdir) tmpdir = "/tmp";
+  return tmpdir + a_sprintf("/zz_huge_file_%d_", application_configuration
+      ::process_id()) + suffix;
+}
+
+void test_huge_file::test_concurrent_regions()
+{
+  FUNCDEF("test_concurrent_regions");
+  astring region_file = temporary_name("regions");
+  {
+    huge_file target(region_file, "w+b");
+    ASSERT_TRUE(target.good(), "should be able to create region file");
+    amorph<region_writer> writers;
+    for (int i = 0; i < WRITER_THREADS; i++)
+      writers.append(new region_writer(target, i));
+    time_stamp started;
+    for (int i = 0; i < WRITER_THREADS; i++) writers.borrow(i)->start(NULL_POINTER);
+    for (int i = 0; i < WRITER_THREADS; i++) writers.borrow(i)->stop();
+    double duration = time_stamp().value() - started.value();
+    for (int i = 0; i < WRITER_THREADS; i++)
+      ASSERT_EQUAL(writers.borrow(i)->failures(), 0, "writers should not fail");
+    ASSERT_TRUE(target.size() == huge_file::file_offset(WRITER_THREADS)
+        * REGION_SIZE, "file should be exactly as large as all the regions");
+    log(a_sprintf("%d threads wrote %d MB in %.0f ms.", WRITER_THREADS,
+        WRITER_THREADS * REGION_SIZE / MEGABYTE, duration));
+  }
+
+  // read everything back sequentially and check the pattern.
+  huge_file check(region_file, "rb");
+  check.advise(huge_file::SEQUENTIAL_ACCESS);
+  byte_array chunk;
+  huge_file::file_offset position = 0;
+  int mismatches = 0;
+  while (!check.eof()) {
+    int bytes_read = 0;
+    outcome ret = check.read(chunk, 3 * PIECE_SIZE / 2, bytes_read);
+    if ( (ret != huge_file::OKAY) || !bytes_read) break;
+    for (int i = 0; i < bytes_read; i++)
+      if (chunk[i] != region_pattern(position + i)) mismatches++;
+    position += bytes_read;
+  }
+  ASSERT_EQUAL(mismatches, 0, "region file contents should match the pattern");
+  ASSERT_TRUE(position == check.size(), "should read the whole region file");
+  ASSERT_TRUE(filename(region_file).unlink(), "should remove the region file");
+}
+
+void test_huge_file::test_huge_offsets()
+{
+  FUNCDEF("test_huge_offsets");
+  astring sparse_file = temporary_name("sparse");
+  huge_file target(sparse_file, "w+b");
+  ASSERT_TRUE(target.good(), "should be able to create sparse file");
+  // storing the last byte makes the OS create a sparse file of the full size.
+  byte_array last_bit(1);
+  last_bit[0] = 'z';
+  int written = 0;
+  outcome ret = target.write_at(SPARSE_SIZE - 1, last_bit, written);
+  if ( (ret != huge_file::OKAY) || (written != 1) ) {
+    // some filesystems can't hold a file this large; that's not our fault.
+    log(astring("skipping huge offset test; filesystem refused the sparse file."));
+    filename(sparse_file).unlink();
+    return;
+  }
+
+  time_stamp started;
+  double length = 0;
+  for (int i = 0; i < SIZING_RUNS; i++) length = target.length();
+  double sizing_time = time_stamp().value() - started.value();
+  ASSERT_EQUAL(length, double(SPARSE_SIZE), "length should be exact");
+
+  started.reset();
+  for (int i = 0; i < SIZING_RUNS; i++) {
+    target.seek(0, byte_filer::FROM_START);
+    target.seek(double(SPARSE_SIZE - 1), byte_filer::FROM_CURRENT);
+  }
+  double seeking_time = time_stamp().value() - started.value();
+  ASSERT_TRUE(target.position() == SPARSE_SIZE - 1, "seek should be exact");
+
+  byte_array found;
+  int bytes_read = 0;
+  ret = target.read(found, 10, bytes_read);
+  ASSERT_EQUAL(ret.value(), huge_file::OKAY, "should read the last byte");
+  ASSERT_EQUAL(bytes_read, 1, "only the last byte should be read");
+  ASSERT_EQUAL(int(found[0]), int('z'), "last byte should be what was stored");
+  ASSERT_TRUE(target.eof(), "should be at eof after reading the last byte");
+
+  ASSERT_EQUAL(target.seek(10, byte_filer::FROM_END).value(), huge_file::OKAY,
+      "should seek back from the end");
+  ASSERT_TRUE(target.position() == SPARSE_SIZE - 10, "end seek should be exact");
+  ASSERT_TRUE(target.truncate(), "should truncate the sparse file");
+  ASSERT_TRUE(target.size() == SPARSE_SIZE - 10, "truncation should be exact");
+
+  log(a_sprintf("%d lengths of a %.0f GB file took %.2f ms; %d pairs of "
+      "seeks took %.2f ms.", SIZING_RUNS, double(SPARSE_SIZE) / GIGABYTE,
+      sizing_time, SIZING_RUNS, seeking_time));
+  ASSERT_TRUE(filename(sparse_file).unlink(), "should remove the sparse file");
+}
+
 void test_huge_file::run_file_scan()
 {
   FUNCDEF("run_file_scan");
@@ -102,6 +262,8 @@ int test_huge_file::execute()
 {
   FUNCDEF("execute");
   run_file_scan();
+  test_concurrent_regions();
+  test_huge_offsets();
   return final_report();
 }
 
@@ -0,0 +1,190 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_tree_scanner                                                 *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/environment.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/byte_filer.h>
+#include <filesystem/directory.h>
+#include <filesystem/directory_tree.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/tree_scanner.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int FILES_PER_DIRECTORY = 100;
+  // how many files are dropped into each of the leaf directories.
+
+const int DIRECTORIES_PER_LEVEL = 10;
+  // the fan-out of the upper levels of the synthetic trees.
+
+const int TREE_SIZES[] = { 10000, 100000 };
+  // the number of files in each tree that's timed.  a million file tree can
+  // be tried by adding it here, but creating it takes far too long for the
+  // regular test runs.
+
+class test_tree_scanner : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_tree_scanner() : application_shell() {}
+  DEFINE_CLASS_NAME("test_tree_scanner");
+  virtual int execute();
+
+private:
+  astring _top;  // the directory where all our files are created.
+
+  void create_tree(const astring &path, int files);
+  int count_files(const directory_tree &tree);
+  void remove_tree(const astring &path);
+  void time_tree(int files);
+};
+
+void test_tree_scanner::create_tree(const astring &path, int files)
+{
+  abyte content[] = { 'x', 'y', 'z' };
+  byte_array to_write(3, content);
+  for (int i = 0; i < files; i++) {
+    int leaf = i / FILES_PER_DIRECTORY;
+    astring dir = a_sprintf("%s/d%02d/d%03d", path.s(),
+        leaf % DIRECTORIES_PER_LEVEL, leaf / DIRECTORIES_PER_LEVEL);
+    if (!(i % FILES_PER_DIRECTORY)) directory::recursive_create(dir);
+    byte_filer out(a_sprintf("%s/f%05d", dir.s(), i), "wb");
+    out.write(to_write);
+  }
+}
+
+int test_tree_scanner::count_files(const directory_tree &tree)
+{
+  int to_return = 0;
+  dir_tree_iterator *ted = tree.start(directory_tree::prefix);
+  filename curr;
+  while (directory_tree::current_dir(*ted, curr)) {
+    filename_list *files = directory_tree::access(*ted);
+    if (files) to_return += files->elements();
+    directory_tree::next(*ted);
+  }
+  directory_tree::throw_out(ted);
+  return to_return;
+}
+
+void test_tree_scanner::remove_tree(const astring &path)
+{
+  directory dir(path);
+  for (int i = 0; i < dir.files().length(); i++)
+    filename(path + "/" + dir.files()[i]).unlink();
+  for (int i = 0; i < dir.directories().length(); i++)
+    remove_tree(path + "/" + dir.directories()[i]);
+  directory::remove_directory(path);
+}
+
+void test_tree_scanner::time_tree(int files)
+{
+  FUNCDEF("time_tree");
+  astring path = a_sprintf("%s/tree_%d", _top.s(), files);
+  time_stamp started;
+  create_tree(path, files);
+  log(a_sprintf("created %d files in %.0f ms.", files,
+      time_stamp().value() - started.value()));
+
+  // the old way: a serial scan followed by getting all the sizes.
+  started.reset();
+  directory_tree serial(path);
+  ASSERT_TRUE(serial.good(), "serial scan should work");
+  ASSERT_TRUE(serial.calculate(true), "calculating sizes should work");
+  double serial_time = time_stamp().value() - started.value();
+
+  // the scanner with stats gathered along the way.
+  tree_scanner scanner;
+  directory_tree parallel;
+  started.reset();
+  ASSERT_TRUE(scanner.scan(parallel, path), "parallel scan should work");
+  double parallel_time = time_stamp().value() - started.value();
+  ASSERT_TRUE(parallel.good(), "parallel tree should be usable");
+
+  log(a_sprintf("%d files: serial scan plus sizes took %.0f ms, parallel "
+      "scan took %.0f ms; ", files, serial_time, parallel_time)
+      + scanner.text_form());
+
+  ASSERT_EQUAL(count_files(serial), files, "serial scan should see all files");
+  ASSERT_EQUAL(count_files(parallel), files,
+      "parallel scan should see all files");
+  ASSERT_EQUAL(scanner.files_found(), files, "scanner should count all files");
+
+  // the two trees should agree on every name, size and time.
+  filename_list diffs;
+  ASSERT_TRUE(directory_tree::compare_trees(serial, parallel, diffs,
+      file_info::file_similarity(file_info::EQUAL_FILESIZE
+      | file_info::EQUAL_TIMESTAMP)), "comparison should work");
+  ASSERT_EQUAL(diffs.elements(), 0, "trees should be identical");
+  diffs.reset();
+  ASSERT_TRUE(directory_tree::compare_trees(parallel, serial, diffs,
+      file_info::EQUAL_NAME), "reverse comparison should work");
+  ASSERT_EQUAL(diffs.elements(), 0, "trees should be identical in reverse");
+
+  // a scan that skips the files entirely.
+  tree_scanner single(1);
+  directory_tree parallel_dirs(path, "*", true);
+  ASSERT_TRUE(single.scan(parallel_dirs, path), "directory scan should work");
+  ASSERT_EQUAL(single.files_found(), 0, "no files should be listed");
+  ASSERT_EQUAL(single.directories_scanned(),
+      1 + DIRECTORIES_PER_LEVEL + files / FILES_PER_DIRECTORY,
+      "all directories should be seen");
+
+  started.reset();
+  remove_tree(path);
+  log(a_sprintf("removed %d files in %.0f ms.", files,
+      time_stamp().value() - started.value()));
+}
+
+int test_tree_scanner::execute()
+{
+  FUNCDEF("execute");
+  _top = environment::TMP();
+  if (!_top) _top = "/tmp";
+  _top += a_sprintf("/zz_tree_scanner_%d", application_configuration::process_id());
+  directory::recursive_create(_top);
+
+  // a missing directory should be refused.
+  tree_scanner scanner;
+  directory_tree empty;
+  ASSERT_FALSE(scanner.scan(empty, _top + "/not_there"),
+      "missing directory should fail");
+
+  for (int i = 0; i < int(sizeof(TREE_SIZES) / sizeof(int)); i++)
+    time_tree(TREE_SIZES[i]);
+
+  remove_tree(_top);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_tree_scanner, )
+
@@ -0,0 +1,216 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_child_supervisor                                             *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <basis/mutex.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/child_supervisor.h>
+#include <processes/launch_process.h>
+#include <structures/set.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+#ifdef __UNIX__
+  #include <signal.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int BENCHMARK_CHILDREN = 1000;
+  // how many children are started and reaped for timing each approach.
+
+const int BIG_HEAP_SIZE = 256 * MEGABYTE;
+  // a heap this large makes every fork copy a lot of page tables.
+
+const int EXIT_WAIT = 10 * SECOND_ms;
+  // the longest we wait for a child that should exit right away.
+
+//////////////
+
+// remembers the exits that the supervisor reports.
+
+class exit_recorder : public child_observer
+{
+public:
+  DEFINE_CLASS_NAME("exit_recorder");
+
+  virtual void child_exited(un_int child_id, int exit_value) {
+    auto_synchronizer l(_lock);
+    _exited.add(child_id);
+    _values += exit_value;
+  }
+
+  bool saw(un_int child_id) {
+    auto_synchronizer l(_lock);
+    return _exited.member(child_id);
+  }
+
+private:
+  mutex _lock;
+  int_set _exited;
+  int_array _values;
+};
+
+//////////////
+
+class test_child_supervisor : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_child_supervisor() : application_shell() {}
+  DEFINE_CLASS_NAME("test_child_supervisor");
+  virtual int execute();
+
+private:
+  double time_forking(int count);
+    //!< forks, execs and waits for "count" children, returning the time taken.
+
+  double time_spawning(child_supervisor &super, int count);
+    //!< runs "count" children through the supervisor, returning the time taken.
+};
+
+double test_child_supervisor::time_forking(int count)
+{
+#ifndef __UNIX__
+  return 0;
+#else
+  char *args[] = { (char *)"/bin/true", NULL_POINTER };
+  time_stamp started;
+  for (int i = 0; i < count; i++) {
+    pid_t kid = fork();
+    if (!kid) {
+      execv(args[0], args);
+      _exit(127);
+    }
+    int status;
+    waitpid(kid, &status, 0);
+  }
+  return time_stamp().value() - started.value();
+#endif
+}
+
+double test_child_supervisor::time_spawning(child_supervisor &super, int count)
+{
+  FUNCDEF("time_spawning");
+  time_stamp started;
+  int failures = 0;
+  for (int i = 0; i < count; i++) {
+    un_int kid;
+    int exit_value;
+    if (super.spawn("/bin/true", "", kid)
+        || !super.await_exit(kid, EXIT_WAIT, exit_value) || exit_value)
+      failures++;
+  }
+  double duration = time_stamp().value() - started.value();
+  ASSERT_EQUAL(failures, 0, "every spawned child should exit cleanly");
+  return duration;
+}
+
+int test_child_supervisor::execute()
+{
+  FUNCDEF("execute");
+  if (!child_supervisor::supported()) {
+    LOG("pidfds are not supported here, so the supervisor can't be tested.");
+    return final_report();
+  }
+  child_supervisor super;
+  exit_recorder recorder;
+  super.add_observer(&recorder);
+
+  // the exit values should come back the way the shell would report them.
+  un_int kid;
+  int exit_value = -1;
+  ASSERT_EQUAL(int(super.spawn("/bin/true", "", kid)), 0, "true should start");
+  ASSERT_TRUE(super.await_exit(kid, EXIT_WAIT, exit_value), "true should exit");
+  ASSERT_EQUAL(exit_value, 0, "true should exit with zero");
+  ASSERT_TRUE(recorder.saw(kid), "the observer should hear about true");
+  ASSERT_FALSE(super.await_exit(kid, 0, exit_value),
+      "an exit should only be collected once");
+  ASSERT_EQUAL(int(super.spawn("/bin/false", "", kid)), 0, "false should start");
+  ASSERT_TRUE(super.await_exit(kid, EXIT_WAIT, exit_value), "false should exit");
+  ASSERT_EQUAL(exit_value, 1, "false should exit with one");
+  ASSERT_FALSE(int(super.spawn("/zz/no/such/program", "", kid)) == 0,
+      "a missing program should not start");
+
+  // a child that runs for a while is supervised until it's killed.
+  ASSERT_EQUAL(int(super.spawn("/bin/sleep", "5", kid)), 0, "sleep should start");
+  ASSERT_FALSE(super.await_exit(kid, 50, exit_value), "sleep should still run");
+  ASSERT_TRUE(super.supervising(kid), "sleep should be supervised");
+  ASSERT_TRUE(child_supervisor::alive(kid), "sleep should be alive");
+  int_set waiting_on;
+  waiting_on.add(kid);
+  ASSERT_FALSE(child_supervisor::await_any_exit(waiting_on, 50),
+      "nothing should exit while sleep runs");
+#ifdef __UNIX__
+  kill(kid, SIGKILL);
+#endif
+  ASSERT_TRUE(child_supervisor::await_any_exit(waiting_on, EXIT_WAIT),
+      "the killed sleep should be noticed");
+  ASSERT_TRUE(super.await_exit(kid, EXIT_WAIT, exit_value), "sleep should be gone");
+  ASSERT_EQUAL(exit_value, 128 + SIGKILL, "the kill signal should be reported");
+  ASSERT_FALSE(child_supervisor::alive(kid), "sleep should not be alive");
+  ASSERT_FALSE(super.supervising(kid), "sleep should not be supervised");
+
+  // the supervisor thread reaps children that nobody waits for.
+  ASSERT_EQUAL(int(super.spawn("/bin/true", "", kid)), 0, "true should restart");
+  time_stamp give_up(EXIT_WAIT);
+  while (!recorder.saw(kid) && (time_stamp() < give_up))
+    time_control::sleep_ms(1);
+  ASSERT_TRUE(recorder.saw(kid), "the thread should reap the unwatched child");
+  ASSERT_FALSE(child_supervisor::alive(kid), "the reaped child should be gone");
+  ASSERT_EQUAL(super.children(), 0, "no children should be left running");
+
+  // launch_process goes through the program's supervisor now.
+  ASSERT_EQUAL(int(launch_process::run("/bin/true", "",
+      launch_process::RETURN_IMMEDIATELY, kid)), 0, "launching should work");
+  ASSERT_TRUE(child_supervisor::program_wide().await_exit(kid, EXIT_WAIT,
+      exit_value), "the launched child should be reaped");
+
+  // compare starting children by forking with spawning them, with a small
+  // heap and then with a large one that fork has to duplicate the mappings for.
+  double fork_time = time_forking(BENCHMARK_CHILDREN);
+  double spawn_time = time_spawning(super, BENCHMARK_CHILDREN);
+  byte_array big_heap(BIG_HEAP_SIZE);
+  for (int i = 0; i < big_heap.length(); i += 4 * KILOBYTE) big_heap[i] = 'x';
+  double big_fork_time = time_forking(BENCHMARK_CHILDREN);
+  double big_spawn_time = time_spawning(super, BENCHMARK_CHILDREN);
+  log(a_sprintf("%d children launched and reaped: fork+exec+waitpid took "
+      "%.0f ms and the supervisor took %.0f ms; with a %d MB heap, fork took "
+      "%.0f ms and the supervisor took %.0f ms.", BENCHMARK_CHILDREN,
+      fork_time, spawn_time, BIG_HEAP_SIZE / MEGABYTE, big_fork_time,
+      big_spawn_time));
+  ASSERT_TRUE(big_spawn_time < big_fork_time,
+      "spawning should beat forking from a large process");
+
+  super.remove_observer(&recorder);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_child_supervisor, )
+
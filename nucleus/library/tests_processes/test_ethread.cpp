@@ -0,0 +1,185 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_ethread                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/ethread.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int STOPPED_THREADS = 40;
+  // how many sleeping threads are stopped at once for timing.
+
+const int LONG_INTERVAL = 10 * SECOND_ms;
+  // a period that no test should ever have to wait out.
+
+const int TIGHT_PERIOD = 20;
+  // the interval for the thread that's checked for drift.
+
+const int TIGHT_WORK = 5;
+  // how long the tight thread's activity takes each time.
+
+const int TIGHT_RUN = 2 * SECOND_ms;
+  // how long the tight thread is left running.
+
+const int QUICK_ENOUGH = 250;
+  // a wakeup that takes longer than this was not immediate.
+
+//////////////
+
+// counts its activations, optionally taking some time for each one.
+
+class counting_thread : public ethread
+{
+public:
+  counting_thread(int interval, timed_thread_types how, int work = 0)
+  : ethread(interval, how), _count(0), _work(work) {}
+
+  DEFINE_CLASS_NAME("counting_thread");
+
+  virtual void perform_activity(void *formal(data)) {
+    if (_work) time_control::sleep_ms(_work);
+    _count++;
+  }
+
+  int count() const { return _count; }
+
+private:
+  volatile int _count;
+  int _work;
+};
+
+// a single-shot thread that naps between bouts of doing nothing.
+
+class snoozing_thread : public ethread
+{
+public:
+  snoozing_thread() : ethread(), _naps(0) {}
+
+  DEFINE_CLASS_NAME("snoozing_thread");
+
+  virtual void perform_activity(void *formal(data)) {
+    while (snooze(LONG_INTERVAL)) _naps++;
+  }
+
+  int naps() const { return _naps; }
+
+private:
+  volatile int _naps;
+};
+
+//////////////
+
+class test_ethread : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_ethread() : application_shell() {}
+  DEFINE_CLASS_NAME("test_ethread");
+  virtual int execute();
+
+private:
+  static bool wait_for(const counting_thread &thread, int count);
+    //!< waits until "thread" reaches "count" activations, or gives up.
+};
+
+bool test_ethread::wait_for(const counting_thread &thread, int count)
+{
+  time_stamp give_up(LONG_INTERVAL);
+  while ( (thread.count() < count) && (time_stamp() < give_up) )
+    time_control::sleep_ms(1);
+  return thread.count() >= count;
+}
+
+int test_ethread::execute()
+{
+  FUNCDEF("execute");
+
+  // stopping a sleeping periodic thread shouldn't wait on its interval.
+  counting_thread *sleepers[STOPPED_THREADS];
+  for (int i = 0; i < STOPPED_THREADS; i++) {
+    sleepers[i] = new counting_thread(LONG_INTERVAL, ethread::SLACK_INTERVAL);
+    sleepers[i]->start(NULL_POINTER);
+  }
+  for (int i = 0; i < STOPPED_THREADS; i++)
+    ASSERT_TRUE(wait_for(*sleepers[i], 1), "the sleepers should activate once");
+  time_stamp started;
+  for (int i = 0; i < STOPPED_THREADS; i++) sleepers[i]->stop();
+  double stop_time = time_stamp().value() - started.value();
+  for (int i = 0; i < STOPPED_THREADS; i++) {
+    ASSERT_TRUE(sleepers[i]->thread_finished(), "the sleeper should be stopped");
+    ASSERT_EQUAL(sleepers[i]->count(), 1, "the sleeper should not reactivate");
+    WHACK(sleepers[i]);
+  }
+  ASSERT_TRUE(stop_time < QUICK_ENOUGH, "stopping should not wait for the interval");
+
+  // waking a periodic thread makes it activate right away.
+  counting_thread waker(LONG_INTERVAL, ethread::SLACK_INTERVAL);
+  waker.start(NULL_POINTER);
+  ASSERT_TRUE(wait_for(waker, 1), "the waker should activate once");
+  started.reset();
+  waker.wake_now();
+  ASSERT_TRUE(wait_for(waker, 2), "the waker should activate when woken");
+  double wake_time = time_stamp().value() - started.value();
+  ASSERT_TRUE(wake_time < QUICK_ENOUGH, "waking should be immediate");
+  waker.reschedule(0);
+  ASSERT_TRUE(wait_for(waker, 3), "the waker should activate when rescheduled");
+  waker.stop();
+
+  // a snoozing single-shot thread is woken and stopped just as quickly.
+  snoozing_thread napper;
+  napper.start(NULL_POINTER);
+  time_control::sleep_ms(20);
+  napper.wake_now();
+  time_stamp give_up(LONG_INTERVAL);
+  while (!napper.naps() && (time_stamp() < give_up)) time_control::sleep_ms(1);
+  ASSERT_EQUAL(napper.naps(), 1, "the napper should be woken");
+  started.reset();
+  napper.stop();
+  double nap_stop_time = time_stamp().value() - started.value();
+  ASSERT_TRUE(nap_stop_time < QUICK_ENOUGH, "the napper should stop right away");
+
+  // a tight interval thread keeps to its schedule, even with work to do.
+  counting_thread tight(TIGHT_PERIOD, ethread::TIGHT_INTERVAL, TIGHT_WORK);
+  started.reset();
+  tight.start(NULL_POINTER);
+  time_control::sleep_ms(TIGHT_RUN);
+  int activations = tight.count();
+  tight.stop();
+  int expected = TIGHT_RUN / TIGHT_PERIOD;
+  log(a_sprintf("stopping %d sleeping threads took %.1f ms; waking took %.1f ms; "
+      "the tight thread activated %d times where %d were expected.",
+      STOPPED_THREADS, stop_time, wake_time, activations, expected));
+  ASSERT_TRUE(absolute_value(activations - expected) <= 3,
+      "the tight interval should not drift");
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_ethread, )
+
@@ -0,0 +1,159 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_process_control                                              *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <configuration/application_configuration.h>
+#include <filesystem/filename.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/proc_scanner.h>
+#include <processes/process_control.h>
+#include <processes/process_entry.h>
+#include <structures/set.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+#ifdef __UNIX__
+  #include <unistd.h>
+#endif
+
+using namespace application;
+using namespace basis;
+using namespace configuration;
+using namespace filesystem;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int PS_SWEEPS = 20;
+  // how many times the process list is gathered with ps for timing.
+
+const int PROC_SWEEPS = 200;
+  // how many times each of the /proc scans is run for timing.
+
+class test_process_control : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_process_control() : application_shell() {}
+  DEFINE_CLASS_NAME("test_process_control");
+  virtual int execute();
+
+private:
+  int find_entry(const process_entry_array &list, un_int pid);
+    //!< returns the index of the process "pid" in the "list", or negative.
+};
+
+int test_process_control::find_entry(const process_entry_array &list, un_int pid)
+{
+  for (int i = 0; i < list.length(); i++)
+    if (list[i]._process_id == pid) return i;
+  return common::NOT_FOUND;
+}
+
+int test_process_control::execute()
+{
+  FUNCDEF("execute");
+  process_control control;
+  ASSERT_TRUE(control.healthy(), "process control should be usable");
+  un_int our_pid = application_configuration::process_id();
+  astring our_name = filename(_global_argv[0]).basename().raw();
+
+  // the ps listing is the old standard that the others should agree with.
+  process_entry_array from_ps;
+  ASSERT_TRUE(control.get_processes_with_ps(from_ps), "ps should list processes");
+  int ps_indy = find_entry(from_ps, our_pid);
+  ASSERT_FALSE(negative(ps_indy), "ps should list this process");
+
+  process_entry_array current;
+  ASSERT_TRUE(control.query_processes(current), "processes should be listed");
+  int our_indy = find_entry(current, our_pid);
+  ASSERT_FALSE(negative(our_indy), "this process should be listed");
+  if (!negative(our_indy) && !negative(ps_indy)) {
+    ASSERT_EQUAL(filename(current[our_indy].path()).basename().raw(),
+        filename(from_ps[ps_indy].path()).basename().raw(),
+        "our program should be named the same way as by ps");
+  }
+  int_set pids;
+  ASSERT_TRUE(control.find_process(our_name, pids), "this program should be found");
+  ASSERT_TRUE(pids.member(our_pid), "our own process should be in the found set");
+  int_set listed_pids;
+  process_control::find_process_in_list(current, our_name, listed_pids);
+  bool agreed = (pids.elements() == listed_pids.elements());
+  for (int i = 0; i < pids.elements(); i++)
+    if (!listed_pids.member(pids[i])) agreed = false;
+  ASSERT_TRUE(agreed, "finding should agree with searching the list");
+  ASSERT_FALSE(control.find_process("zz_no_such_program_zz", pids),
+      "made up program should not be found");
+  ASSERT_EQUAL(int(control.query_process(our_pid)._process_id), int(our_pid),
+      "this process should be found by id");
+
+  if (!proc_scanner::supported()) {
+    LOG("no /proc here, so only the ps listing was tested.");
+    return final_report();
+  }
+
+  // the scanner knows more about each process than ps told us.
+  proc_scanner scanner;
+  process_entry ours;
+  ASSERT_TRUE(scanner.query(our_pid, ours), "our process should be queried");
+#ifdef __UNIX__
+  ASSERT_EQUAL(int(ours._parent_process_id), int(getppid()),
+      "the parent should be known");
+#endif
+  ASSERT_TRUE(ours._threads >= 1, "there should be a thread");
+
+  // only the new processes have their command lines read after the first.
+  ASSERT_TRUE(scanner.snapshot(current), "the first snapshot should work");
+  int first_reads = scanner.paths_read();
+  ASSERT_EQUAL(first_reads, current.length(), "everything is new the first time");
+  ASSERT_TRUE(scanner.snapshot(current), "the second snapshot should work");
+  ASSERT_TRUE(scanner.paths_read() < first_reads / 2,
+      "few processes should be new the second time");
+  ASSERT_FALSE(negative(find_entry(current, our_pid)),
+      "this process should still be listed");
+
+  // see how long each way of looking at the processes takes.
+  time_stamp started;
+  for (int i = 0; i < PS_SWEEPS; i++) control.get_processes_with_ps(from_ps);
+  double ps_time = (time_stamp().value() - started.value()) / PS_SWEEPS;
+  started.reset();
+  for (int i = 0; i < PROC_SWEEPS; i++) {
+    // a new scanner every time has to read every command line.
+    proc_scanner full;
+    full.snapshot(current);
+  }
+  double full_time = (time_stamp().value() - started.value()) / PROC_SWEEPS;
+  started.reset();
+  for (int i = 0; i < PROC_SWEEPS; i++) scanner.snapshot(current);
+  double incremental_time = (time_stamp().value() - started.value()) / PROC_SWEEPS;
+  started.reset();
+  for (int i = 0; i < PROC_SWEEPS; i++) scanner.find_process_by_name(our_name, pids);
+  double find_time = (time_stamp().value() - started.value()) / PROC_SWEEPS;
+  log(a_sprintf("sweep of %d processes: ps took %.3f ms, /proc took %.3f ms, "
+      "incremental /proc took %.3f ms, and finding by name took %.3f ms.",
+      current.length(), ps_time, full_time, incremental_time, find_time));
+  ASSERT_TRUE(incremental_time < ps_time, "/proc should beat running ps");
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_process_control, )
+
@@ -0,0 +1,222 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_safe_roller                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <basis/mutex.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/ethread.h>
+#include <processes/safe_roller.h>
+#include <structures/roller.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int BENCHMARK_IDS = 4000000;
+  // how many ids are issued for each timing, split up among the threads.
+
+const int MOST_THREADS = 64;
+  // the timings double the number of threads up to this many.
+
+//////////////
+
+// the way that the safe_roller used to work, which is kept for comparison.
+
+class locked_roller
+{
+public:
+  locked_roller(int start, int end) : _rolling(start, end) {}
+
+  int next_id() {
+    auto_synchronizer l(_lock);
+    return _rolling.next_id();
+  }
+
+private:
+  int_roller _rolling;
+  mutex _lock;
+};
+
+//////////////
+
+enum roller_kinds { LOCKED, ATOMIC, BLOCKED };
+
+// a thread that issues a bunch of ids from one of the rollers.
+
+class id_grabber : public ethread
+{
+public:
+  id_grabber(roller_kinds kind, int count, locked_roller &locked,
+      safe_roller &atomic, block_roller &blocked)
+  : ethread(), _kind(kind), _count(count), _ids(new int[count]),
+    _locked(locked), _atomic(atomic), _blocked(blocked) {}
+
+  virtual ~id_grabber() { delete [] _ids; }
+
+  virtual void perform_activity(void *formal(data)) {
+    for (int i = 0; i < _count; i++) {
+      switch (_kind) {
+        case LOCKED: _ids[i] = _locked.next_id(); break;
+        case ATOMIC: _ids[i] = _atomic.next_id(); break;
+        case BLOCKED: _ids[i] = _blocked.next_id(); break;
+      }
+    }
+  }
+
+  roller_kinds _kind;
+  int _count;  // how many ids to issue.
+  int *_ids;  // the ids that this thread got.
+
+private:
+  locked_roller &_locked;
+  safe_roller &_atomic;
+  block_roller &_blocked;
+};
+
+//////////////
+
+class test_safe_roller : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_safe_roller() : application_shell() {}
+  DEFINE_CLASS_NAME("test_safe_roller");
+  virtual int execute();
+
+private:
+  void test_ranges();
+    //!< makes sure the rollers wrap around their ranges properly.
+
+  void test_crowding();
+    //!< uses more block_rollers at once than a thread can hold blocks for.
+
+  double time_ids(roller_kinds kind, int threads);
+    //!< returns how many ids per second "threads" can get from the "kind".
+};
+
+void test_safe_roller::test_ranges()
+{
+  FUNCDEF("test_ranges");
+  safe_roller rolling(5, 8);
+  ASSERT_EQUAL(rolling.current(), 5, "the roller should start at the start");
+  ASSERT_EQUAL(rolling.next_id(), 5, "the first id should be the start");
+  ASSERT_EQUAL(rolling.next_id(), 6, "the ids should go up");
+  ASSERT_EQUAL(rolling.current(), 7, "the current id should be the next one");
+  ASSERT_EQUAL(rolling.next_id(), 7, "the last id should be before the end");
+  ASSERT_EQUAL(rolling.next_id(), 5, "the ids should wrap around");
+  rolling.set_current(7);
+  ASSERT_EQUAL(rolling.next_id(), 7, "the current id should be settable");
+  ASSERT_EQUAL(rolling.next_id(), 5, "the set id should still wrap around");
+  rolling.set_current(8);
+  ASSERT_EQUAL(rolling.current(), 5, "the end of the range should wrap around");
+
+  block_roller blocking(5, 8, 2);
+  ASSERT_EQUAL(blocking.block_size(), 2, "the block size should be kept");
+  ASSERT_EQUAL(blocking.next_id(), 5, "the first block should start the range");
+  ASSERT_EQUAL(blocking.next_id(), 6, "the first block should be used up");
+  ASSERT_EQUAL(blocking.next_id(), 7, "the next block should follow it");
+  ASSERT_EQUAL(blocking.next_id(), 5, "the blocks should wrap around");
+  // another roller keeps its own block on this thread, and taking ids from
+  // it doesn't disturb the first roller's block.
+  block_roller others(100, 200, 10);
+  for (int i = 0; i < 20; i++)
+    ASSERT_EQUAL(others.next_id(), 100 + i, "the other roller should be separate");
+  ASSERT_EQUAL(blocking.next_id(), 6, "the first roller should continue");
+}
+
+void test_safe_roller::test_crowding()
+{
+  FUNCDEF("test_crowding");
+  const int ROLLERS = 20;
+  const int ROUNDS = 200;
+  block_roller *rollers[ROLLERS];
+  for (int i = 0; i < ROLLERS; i++) rollers[i] = new block_roller(0, 1000, 8);
+  // each roller only has one thread using it, so no matter whether it got a
+  // block or had to go without, its ids must come out with no gaps.
+  int out_of_order = 0;
+  for (int round = 0; round < ROUNDS; round++) {
+    for (int i = 0; i < ROLLERS; i++) {
+      if (rollers[i]->next_id() != round) out_of_order++;
+    }
+  }
+  ASSERT_EQUAL(out_of_order, 0, "crowded rollers should not skip any ids");
+  for (int i = 0; i < ROLLERS; i++) WHACK(rollers[i]);
+}
+
+double test_safe_roller::time_ids(roller_kinds kind, int threads)
+{
+  FUNCDEF("time_ids");
+  int per_thread = BENCHMARK_IDS / threads;
+  locked_roller locked(1, MAXINT32);
+  safe_roller atomic(1, MAXINT32);
+  block_roller blocked(1, MAXINT32);
+  id_grabber *grabbers[MOST_THREADS];
+  for (int i = 0; i < threads; i++)
+    grabbers[i] = new id_grabber(kind, per_thread, locked, atomic, blocked);
+
+  time_stamp started;
+  for (int i = 0; i < threads; i++) grabbers[i]->start(NULL_POINTER);
+  for (int i = 0; i < threads; i++) grabbers[i]->stop();
+  double duration = time_stamp().value() - started.value();
+
+  // every id must have been handed out only once.  the blocks that were
+  // partly used can leave gaps, so there's a bit of extra room.
+  int room = threads * (per_thread + block_roller::DEFAULT_BLOCK_SIZE) + 1;
+  bool *seen = new bool[room];
+  for (int i = 0; i < room; i++) seen[i] = false;
+  int repeats = 0;
+  for (int i = 0; i < threads; i++) {
+    for (int j = 0; j < per_thread; j++) {
+      int id = grabbers[i]->_ids[j];
+      if ( (id < 1) || (id >= room) || seen[id] ) repeats++;
+      else seen[id] = true;
+    }
+    WHACK(grabbers[i]);
+  }
+  delete [] seen;
+  ASSERT_EQUAL(repeats, 0, "no id should be issued twice");
+  return double(per_thread) * threads / maximum(duration, 1.0) * SECOND_ms;
+}
+
+int test_safe_roller::execute()
+{
+  FUNCDEF("execute");
+  test_ranges();
+  test_crowding();
+
+  for (int threads = 1; threads <= MOST_THREADS; threads *= 2) {
+    double locked = time_ids(LOCKED, threads);
+    double atomic = time_ids(ATOMIC, threads);
+    double blocked = time_ids(BLOCKED, threads);
+    log(a_sprintf("%d threads: %.0f ids per second with a lock, %.0f with an "
+        "atomic counter, %.0f with reserved blocks.", threads, locked, atomic,
+        blocked));
+  }
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_safe_roller, )
+
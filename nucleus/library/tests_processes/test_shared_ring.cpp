@@ -0,0 +1,359 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_shared_ring                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <application/shared_memory.h>
+#include <application/shared_ring.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/rendezvous.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+#include <string.h>
+#ifdef __UNIX__
+  #include <sched.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int MESSAGE_SIZE = 64;
+  // the size of the messages passed between the processes.
+
+const int RING_SLOTS = 256;
+  // how many messages fit in the rings being timed.
+
+const int RING_MESSAGES = 1000000;
+  // how many messages go through the ring for timing.
+
+const int RENDEZVOUS_MESSAGES = 50000;
+  // how many messages go through the rendezvous mailbox for timing.
+
+const int RING_ROUND_TRIPS = 100000;
+  // how many times a message is bounced back and forth through the rings.
+
+const int RENDEZVOUS_ROUND_TRIPS = 20000;
+  // how many times a message bounces through the rendezvous mailboxes.
+
+const int LOCK_PAIRS = 500000;
+  // how many times each lock is grabbed and released for timing.
+
+//////////////
+
+// a message slot in shared memory that's guarded by a rendezvous, which is
+// how cooperating processes had to trade messages before the shared_ring.
+
+class rendezvous_mailbox
+{
+public:
+  rendezvous_mailbox(shared_memory &memory, int offset, const astring &name)
+  : _slot(memory.memory() + offset), _lock(name) {}
+
+  bool try_send(const byte_array &message) {
+    auto_synchronizer l(_lock);
+    if (_slot[0]) return false;
+    memcpy(_slot + 1, message.observe(), message.length());
+    _slot[0] = 1;
+    return true;
+  }
+
+  bool try_receive(byte_array &message) {
+    auto_synchronizer l(_lock);
+    if (!_slot[0]) return false;
+    memcpy(message.access(), _slot + 1, message.length());
+    _slot[0] = 0;
+    return true;
+  }
+
+  void send(const byte_array &message) { while (!try_send(message)) yield(); }
+  void receive(byte_array &message) { while (!try_receive(message)) yield(); }
+
+  static void yield() {
+#ifdef __UNIX__
+    sched_yield();
+#endif
+  }
+
+private:
+  abyte *_slot;
+  rendezvous _lock;
+};
+
+//////////////
+
+class test_shared_ring : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_shared_ring() : application_shell() {}
+  DEFINE_CLASS_NAME("test_shared_ring");
+  virtual int execute();
+
+private:
+  double time_ring_stream(shared_ring::ring_modes mode, int sequencer);
+    //!< returns the time taken for a child process to stream messages to us.
+
+  double time_ring_bounces();
+    //!< returns the time for messages to make round trips through two rings.
+
+  double time_rendezvous_stream();
+    //!< streams messages from a child through a rendezvous mailbox.
+
+  double time_rendezvous_bounces();
+    //!< bounces messages back and forth through two rendezvous mailboxes.
+
+  void test_recovery();
+    //!< makes sure a lock held by a process that died can still be taken.
+
+  static void await_child(int kid);
+    //!< waits for the child process "kid" to finish.
+};
+
+#ifdef __UNIX__
+void test_shared_ring::await_child(int kid)
+{
+  int status;
+  waitpid(kid, &status, 0);
+}
+#else
+void test_shared_ring::await_child(int formal(kid)) {}
+#endif
+
+void test_shared_ring::test_recovery()
+{
+  FUNCDEF("test_recovery");
+#ifdef __UNIX__
+  shared_memory memory(128, shared_memory::unique_shared_mem_identifier(1).s());
+  ASSERT_TRUE(memory.valid(), "the memory should be created");
+  int kid = fork();
+  if (!kid) {
+    // the child grabs the lock and dies without ever letting it go.
+    abyte *contents = memory.lock();
+    contents[0] = 'x';
+    _exit(0);
+  }
+  await_child(kid);
+  abyte *contents = memory.lock();
+  ASSERT_TRUE(contents, "the lock should be taken from the dead child");
+  ASSERT_TRUE(memory.recovered(), "the lock should be known as recovered");
+  ASSERT_EQUAL(int(contents[0]), int('x'), "the child's change should be seen");
+  memory.unlock(contents);
+  ASSERT_FALSE(contents, "the pointer should be reset by the unlock");
+  contents = memory.lock();
+  ASSERT_FALSE(memory.recovered(), "a normal lock should not be recovered");
+  memory.unlock(contents);
+#endif
+}
+
+double test_shared_ring::time_ring_stream(shared_ring::ring_modes mode,
+    int sequencer)
+{
+  FUNCDEF("time_ring_stream");
+  shared_ring ring(shared_memory::unique_shared_mem_identifier(sequencer),
+      RING_SLOTS, MESSAGE_SIZE, mode);
+  ASSERT_TRUE(ring.valid(), "the streaming ring should be created");
+  time_stamp started;
+#ifdef __UNIX__
+  int kid = fork();
+  if (!kid) {
+    byte_array message(MESSAGE_SIZE);
+    for (int i = 0; i < RING_MESSAGES; i++) {
+      *(int *)message.access() = i;
+      ring.send(message, -1);
+    }
+    _exit(0);
+  }
+  byte_array message;
+  int out_of_order = 0;
+  for (int i = 0; i < RING_MESSAGES; i++) {
+    if (!ring.receive(message, -1) || (*(int *)message.observe() != i))
+      out_of_order++;
+  }
+  await_child(kid);
+  ASSERT_EQUAL(out_of_order, 0, "the messages should all arrive in order");
+#endif
+  return time_stamp().value() - started.value();
+}
+
+double test_shared_ring::time_ring_bounces()
+{
+  FUNCDEF("time_ring_bounces");
+  shared_ring there(shared_memory::unique_shared_mem_identifier(4),
+      RING_SLOTS, MESSAGE_SIZE, shared_ring::SINGLE_SENDER_RECEIVER);
+  shared_ring back(shared_memory::unique_shared_mem_identifier(5),
+      RING_SLOTS, MESSAGE_SIZE, shared_ring::SINGLE_SENDER_RECEIVER);
+  ASSERT_TRUE(there.valid() && back.valid(), "the bouncing rings should be created");
+  byte_array message(MESSAGE_SIZE);
+  time_stamp started;
+#ifdef __UNIX__
+  int kid = fork();
+  if (!kid) {
+    for (int i = 0; i < RING_ROUND_TRIPS; i++) {
+      there.receive(message, -1);
+      back.send(message, -1);
+    }
+    _exit(0);
+  }
+  for (int i = 0; i < RING_ROUND_TRIPS; i++) {
+    there.send(message, -1);
+    back.receive(message, -1);
+  }
+  await_child(kid);
+#endif
+  return time_stamp().value() - started.value();
+}
+
+double test_shared_ring::time_rendezvous_stream()
+{
+  shared_memory memory(MESSAGE_SIZE + 1,
+      shared_memory::unique_shared_mem_identifier(6).s());
+  astring lock_name = shared_memory::unique_shared_mem_identifier(7);
+  byte_array message(MESSAGE_SIZE);
+  time_stamp started;
+#ifdef __UNIX__
+  int kid = fork();
+  if (!kid) {
+    rendezvous_mailbox box(memory, 0, lock_name);
+    for (int i = 0; i < RENDEZVOUS_MESSAGES; i++) box.send(message);
+    _exit(0);
+  }
+  rendezvous_mailbox box(memory, 0, lock_name);
+  for (int i = 0; i < RENDEZVOUS_MESSAGES; i++) box.receive(message);
+  await_child(kid);
+#endif
+  return time_stamp().value() - started.value();
+}
+
+double test_shared_ring::time_rendezvous_bounces()
+{
+  shared_memory memory(2 * (MESSAGE_SIZE + 1),
+      shared_memory::unique_shared_mem_identifier(8).s());
+  astring there_name = shared_memory::unique_shared_mem_identifier(9);
+  astring back_name = shared_memory::unique_shared_mem_identifier(10);
+  byte_array message(MESSAGE_SIZE);
+  time_stamp started;
+#ifdef __UNIX__
+  int kid = fork();
+  if (!kid) {
+    rendezvous_mailbox there(memory, 0, there_name);
+    rendezvous_mailbox back(memory, MESSAGE_SIZE + 1, back_name);
+    for (int i = 0; i < RENDEZVOUS_ROUND_TRIPS; i++) {
+      there.receive(message);
+      back.send(message);
+    }
+    _exit(0);
+  }
+  rendezvous_mailbox there(memory, 0, there_name);
+  rendezvous_mailbox back(memory, MESSAGE_SIZE + 1, back_name);
+  for (int i = 0; i < RENDEZVOUS_ROUND_TRIPS; i++) {
+    there.send(message);
+    back.receive(message);
+  }
+  await_child(kid);
+#endif
+  return time_stamp().value() - started.value();
+}
+
+int test_shared_ring::execute()
+{
+  FUNCDEF("execute");
+
+  // the basics of sending and receiving within one process.
+  shared_ring ring(shared_memory::unique_shared_mem_identifier(0), 3, 16);
+  ASSERT_TRUE(ring.valid(), "the ring should be created");
+  ASSERT_EQUAL(ring.slots(), 4, "the slots should be a power of two");
+  byte_array message;
+  ASSERT_FALSE(ring.receive(message), "nothing should be in a new ring");
+  ASSERT_FALSE(ring.receive(message, 20), "nothing should arrive while waiting");
+  for (int i = 0; i < ring.slots(); i++) {
+    astring text(astring::SPRINTF, "msg %d", i);
+    ASSERT_TRUE(ring.send((abyte *)text.s(), text.length() + 1),
+        "the ring should take messages until it's full");
+  }
+  ASSERT_FALSE(ring.send((abyte *)"full", 5, 20), "a full ring should refuse");
+  ASSERT_FALSE(ring.send(byte_array(17)), "a large message should be refused");
+  shared_ring other(shared_memory::unique_shared_mem_identifier(0), 4, 16);
+  ASSERT_TRUE(other.valid(), "the same ring should be opened again");
+  shared_ring mismatch(shared_memory::unique_shared_mem_identifier(0), 8, 16);
+  ASSERT_FALSE(mismatch.valid(), "a differently sized ring should not open");
+  for (int i = 0; i < ring.slots(); i++) {
+    ASSERT_TRUE(other.receive(message), "the messages should be received");
+    ASSERT_EQUAL(astring((char *)message.observe()),
+        astring(astring::SPRINTF, "msg %d", i), "the messages should be in order");
+  }
+  ASSERT_FALSE(ring.receive(message), "the ring should be empty again");
+
+  test_recovery();
+
+  // compare the lock costs of the rendezvous and the shared memory's mutex.
+  shared_memory memory(64, shared_memory::unique_shared_mem_identifier(11).s());
+  rendezvous file_lock(shared_memory::unique_shared_mem_identifier(12));
+  time_stamp started;
+  for (int i = 0; i < LOCK_PAIRS; i++) {
+    file_lock.lock();
+    file_lock.unlock();
+  }
+  double rendezvous_lock_time = time_stamp().value() - started.value();
+  started.reset();
+  for (int i = 0; i < LOCK_PAIRS; i++) {
+    abyte *contents = memory.lock();
+    memory.unlock(contents);
+  }
+  double mutex_lock_time = time_stamp().value() - started.value();
+
+  // now pass messages between processes each way.
+  double spsc_time = time_ring_stream(shared_ring::SINGLE_SENDER_RECEIVER, 2);
+  double mpmc_time = time_ring_stream(shared_ring::MULTIPLE_SENDERS_RECEIVERS, 3);
+  double ring_bounce_time = time_ring_bounces();
+  double rendezvous_stream_time = time_rendezvous_stream();
+  double rendezvous_bounce_time = time_rendezvous_bounces();
+
+  // avoids dividing by zero when something finishes within the timer's tick.
+  #define RATE(count, time) (double(count) / maximum(time, 1.0) * SECOND_ms)
+  log(a_sprintf("lock and unlock pairs per second: rendezvous %.0f, "
+      "shared memory mutex %.0f.", RATE(LOCK_PAIRS, rendezvous_lock_time),
+      RATE(LOCK_PAIRS, mutex_lock_time)));
+  log(a_sprintf("%d byte messages per second between processes: "
+      "single ring %.0f, multiple ring %.0f, rendezvous mailbox %.0f.",
+      MESSAGE_SIZE, RATE(RING_MESSAGES, spsc_time),
+      RATE(RING_MESSAGES, mpmc_time),
+      RATE(RENDEZVOUS_MESSAGES, rendezvous_stream_time)));
+  log(a_sprintf("one way latency: ring %.2f us, rendezvous mailbox %.2f us.",
+      ring_bounce_time * 1000.0 / (2 * RING_ROUND_TRIPS),
+      rendezvous_bounce_time * 1000.0 / (2 * RENDEZVOUS_ROUND_TRIPS)));
+  #undef RATE
+  ASSERT_TRUE(mutex_lock_time < rendezvous_lock_time,
+      "the shared mutex should beat the rendezvous");
+  ASSERT_TRUE(spsc_time / RING_MESSAGES
+      < rendezvous_stream_time / RENDEZVOUS_MESSAGES,
+      "the ring should beat the rendezvous mailbox");
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_shared_ring, )
+
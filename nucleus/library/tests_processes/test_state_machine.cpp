@@ -0,0 +1,215 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_state_machine                                                *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2000-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/state_machine.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int BENCHMARK_STATES = 64;
+  // how many states are in the maps that are timed.
+
+const int RANGES_PER_STATE = 8;
+  // how many range transitions leave each of those states.
+
+const int TRIGGERS_PER_RANGE = 4;
+  // how many triggers each of the ranges covers.
+
+const int BENCHMARK_MACHINES = 100;
+  // how many machines are pulsed through the maps.
+
+const int BENCHMARK_PULSES = 1000000;
+  // how many pulses are timed for each map.
+
+const int SPARSE_SPACING = 100000;
+  // spreads the state ids and triggers out too far for dense tables.
+
+//////////////
+
+// a state machine that counts how many times it's changed state.
+
+class counting_machine : public state_machine
+{
+public:
+  counting_machine() : _updates(0), _bounce(0) {}
+
+  virtual int update() {
+    _updates++;
+    // bounce off of a state by pulsing again once, if asked to.
+    int to_return = _bounce;
+    _bounce = 0;
+    return to_return;
+  }
+
+  int _updates;  // the number of times update() was called.
+  int _bounce;  // a trigger to return from the next update.
+};
+
+//////////////
+
+class test_state_machine : public virtual unit_base, virtual public application_shell
+{
+public:
+  test_state_machine() : application_shell() {}
+  DEFINE_CLASS_NAME("test_state_machine");
+  virtual int execute();
+
+private:
+  void test_basics();
+    //!< checks the transitions on a small map.
+
+  bool build_benchmark_map(transition_map &map, int spacing);
+    //!< sets up the "map" for timing, with states and triggers "spacing" apart.
+
+  double time_pulses(transition_map &map, int spacing);
+    //!< returns how many pulses per second the "map" handled.
+};
+
+void test_state_machine::test_basics()
+{
+  FUNCDEF("test_basics");
+  transition_map map;
+  int examine;
+  ASSERT_TRUE(map.add_state(1) && map.add_state(2) && map.add_state(3),
+      "states should be added");
+  ASSERT_FALSE(map.add_state(2), "a state should only be added once");
+  ASSERT_TRUE(map.set_start(1), "the start should be set");
+  ASSERT_TRUE(map.add_range_transition(1, 2, 10, 19), "range should be added");
+  ASSERT_TRUE(map.add_range_transition(1, 3, 20, 29), "range should be added");
+  ASSERT_TRUE(map.add_range_transition(2, 1, 5, 5), "range should be added");
+  ASSERT_TRUE(map.add_timed_transition(2, 3, 20), "timed should be added");
+  ASSERT_TRUE(map.add_simple_transition(3, 1), "simple should be added");
+  ASSERT_EQUAL(map.validate(examine).value(), int(common::OKAY), "the map should validate");
+  ASSERT_FALSE(map.add_state(4), "a valid map should not be changed");
+
+  counting_machine m;
+  ASSERT_TRUE(map.reset(m), "the machine should be reset");
+  ASSERT_EQUAL(m.current(), 1, "the machine should start at the start");
+  ASSERT_FALSE(map.pulse(m, 9), "a trigger below the ranges should not move");
+  ASSERT_FALSE(map.pulse(m, 30), "a trigger above the ranges should not move");
+  ASSERT_TRUE(map.pulse(m, 15), "a trigger in a range should move");
+  ASSERT_EQUAL(m.current(), 2, "the machine should be in the ranged state");
+  ASSERT_TRUE(m.ranged(), "the transition should be ranged");
+  ASSERT_EQUAL(m.trigger(), 15, "the trigger should be remembered");
+  ASSERT_FALSE(map.time_slice(m), "the timed transition should not be due yet");
+  time_control::sleep_ms(40);
+  ASSERT_TRUE(map.time_slice(m), "the timed transition should fire");
+  ASSERT_EQUAL(m.current(), 3, "the machine should be in the timed state");
+  ASSERT_TRUE(m.timed(), "the transition should be timed");
+  ASSERT_FALSE(map.make_transition(m, 2), "there is no transition from 3 to 2");
+  ASSERT_TRUE(map.make_transition(m, 1), "the simple transition should work");
+  ASSERT_EQUAL(m.current(), 1, "the machine should be back at the start");
+
+  // an override stretches the timed transition out.
+  m.override_timing(2, 3, 10 * SECOND_ms);
+  ASSERT_EQUAL(m.duration_override(2, 3), 10 * SECOND_ms, "override should be set");
+  ASSERT_TRUE(map.pulse(m, 10), "the low end of a range should move");
+  time_control::sleep_ms(40);
+  ASSERT_FALSE(map.time_slice(m), "the override should hold off the timeout");
+  // the update's trigger is applied as another pulse.
+  m._bounce = 20;
+  ASSERT_TRUE(map.pulse(m, 5), "the range back to the start should work");
+  ASSERT_EQUAL(m.current(), 3, "the bounced trigger should be applied");
+  ASSERT_EQUAL(m._updates, 6, "every transition should be updated");
+
+  // the map can be changed again after reconfiguring it.
+  map.reconfigure();
+  ASSERT_TRUE(map.add_state(40), "a state should be added after reconfiguring");
+  ASSERT_EQUAL(map.validate(examine).value(), int(transition_map::UNREACHABLE),
+      "the new state should be unreachable");
+  ASSERT_EQUAL(examine, 40, "the unreachable state should be reported");
+  ASSERT_TRUE(map.add_range_transition(3, 40, 25, 35), "range should be added");
+  ASSERT_TRUE(map.add_range_transition(3, 1, 30, 40), "range should be added");
+  ASSERT_EQUAL(map.validate(examine).value(),
+      int(transition_map::OVERLAPPING_RANGES),
+      "the overlapping ranges should be caught");
+}
+
+bool test_state_machine::build_benchmark_map(transition_map &map, int spacing)
+{
+  // each state's ranges lead to the next several states around the ring.
+  for (int i = 1; i <= BENCHMARK_STATES; i++)
+    if (!map.add_state(i * spacing)) return false;
+  map.set_start(spacing);
+  for (int i = 1; i <= BENCHMARK_STATES; i++) {
+    for (int r = 0; r < RANGES_PER_STATE; r++) {
+      int next = (i + r) % BENCHMARK_STATES + 1;
+      int low = r * TRIGGERS_PER_RANGE * spacing;
+      map.add_range_transition(i * spacing, next * spacing, low,
+          low + TRIGGERS_PER_RANGE - 1);
+    }
+    map.add_timed_transition(i * spacing, (i % BENCHMARK_STATES + 1) * spacing,
+        10 * SECOND_ms);
+  }
+  int examine;
+  return map.validate(examine) == common::OKAY;
+}
+
+double test_state_machine::time_pulses(transition_map &map, int spacing)
+{
+  FUNCDEF("time_pulses");
+  counting_machine machines[BENCHMARK_MACHINES];
+  for (int i = 0; i < BENCHMARK_MACHINES; i++) map.reset(machines[i]);
+  int misses = 0;
+  time_stamp started;
+  for (int i = 0; i < BENCHMARK_PULSES; i++) {
+    counting_machine &m = machines[i % BENCHMARK_MACHINES];
+    int range = (i / BENCHMARK_MACHINES) % RANGES_PER_STATE;
+    int trigger = range * TRIGGERS_PER_RANGE * spacing + i % TRIGGERS_PER_RANGE;
+    if (!map.pulse(m, trigger)) misses++;
+    // the timed transitions are checked too, as a driver of them would.
+    map.time_slice(m);
+  }
+  double duration = time_stamp().value() - started.value();
+  ASSERT_EQUAL(misses, 0, "every pulse should find its range");
+  return double(BENCHMARK_PULSES) / maximum(duration, 1.0) * SECOND_ms;
+}
+
+int test_state_machine::execute()
+{
+  FUNCDEF("execute");
+  test_basics();
+
+  transition_map dense;
+  ASSERT_TRUE(build_benchmark_map(dense, 1), "the dense map should validate");
+  double dense_rate = time_pulses(dense, 1);
+  transition_map sparse;
+  ASSERT_TRUE(build_benchmark_map(sparse, SPARSE_SPACING),
+      "the sparse map should validate");
+  double sparse_rate = time_pulses(sparse, SPARSE_SPACING);
+  log(a_sprintf("%d states with %d ranges each: %.0f pulses per second with "
+      "dense ids and triggers, %.0f pulses per second with sparse ones.",
+      BENCHMARK_STATES, RANGES_PER_STATE, dense_rate, sparse_rate));
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_state_machine, )
+
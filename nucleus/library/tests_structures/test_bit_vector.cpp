@@ -12,6 +12,7 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include <application/command_line.h>
 #include <application/hoople_main.h>
 #include <basis/array.h>
 #include <basis/astring.h>
@@ -22,6 +23,7 @@
 #include <mathematics/chaos.h>
 #include <structures/bit_vector.h>
 #include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
 #include <unit_test/unit_base.h>
 
 #include <memory.h>
@@ -42,6 +44,14 @@ using namespace unit_test;
 #define MAX_TEST 100
 #define FOOP_MAX 213
 
+const int WORD_TEST_BITS = 1000;
+  // size of the vectors checked against a simple reference version.
+
+const int SMALL_BENCHMARK_BITS = 1000000;
+const int LARGE_BENCHMARK_BITS = 100000000;
+  // the sizes of vector that we time the bulk operations on.  the large one
+  // is only run when the test is passed the "--large" flag.
+
 //////////////
 
 class test_bit_vector : virtual public unit_base, virtual public application_shell
@@ -50,6 +60,8 @@ public:
   test_bit_vector() : unit_base() {}
   DEFINE_CLASS_NAME("test_bit_vector");
   virtual int execute();
+  void test_word_operations(chaos &randomizer);
+  void run_benchmark(int bits);
 };
 
 HOOPLE_MAIN(test_bit_vector, );
@@ -158,6 +170,121 @@ int test_bit_vector::execute()
     foop.reset(FOOP_MAX);  // to clear before next loop.
   }
 
+  test_word_operations(randomizer);
+  run_benchmark(SMALL_BENCHMARK_BITS);
+  command_line cmds(_global_argc, _global_argv);
+  int indy = 0;
+  if (cmds.find("large", indy))
+    run_benchmark(LARGE_BENCHMARK_BITS);
+
   return final_report();
 }
 
+// checks the word based operations against a plain array of flags.
+void test_bit_vector::test_word_operations(chaos &randomizer)
+{
+  FUNCDEF("test_word_operations");
+  bit_vector vec(WORD_TEST_BITS);
+  byte_array ref(WORD_TEST_BITS);
+  memset(ref.access(), 0, ref.length());
+
+  for (int round = 0; round < MAX_TEST; round++) {
+    // light or clear a random range.
+    int start = randomizer.inclusive(0, WORD_TEST_BITS - 1);
+    int end = randomizer.inclusive(start, minimum(WORD_TEST_BITS - 1, start + 200));
+    bool value = randomizer.inclusive(0, 1);
+    vec.set_range(start, end, value);
+    for (int i = start; i <= end; i++) ref[i] = value;
+
+    int expected_count = 0;
+    for (int i = 0; i < WORD_TEST_BITS; i++) expected_count += ref[i];
+    ASSERT_EQUAL(vec.count(), expected_count, "count should match the reference");
+
+    // walk from a random spot to find the next of each value.
+    int from = randomizer.inclusive(0, WORD_TEST_BITS - 1);
+    for (int look = 0; look <= 1; look++) {
+      int expected = common::NOT_FOUND;
+      for (int i = from; i < WORD_TEST_BITS; i++)
+        if (bool(ref[i]) == bool(look)) { expected = i; break; }
+      ASSERT_EQUAL(vec.find_next(look, from), expected,
+          "find_next should match the reference");
+    }
+
+    // pieces moved around should survive the trip.
+    int piece_start = randomizer.inclusive(0, WORD_TEST_BITS - 150);
+    bit_vector piece = vec.subvector(piece_start, piece_start + 140);
+    ASSERT_EQUAL(piece.bits(), 141, "subvector should have the right size");
+    for (int i = 0; i < piece.bits(); i++)
+      ASSERT_EQUAL(int(piece.on(i)), int(ref[piece_start + i]),
+          "subvector should copy the right bits");
+    bit_vector copy(WORD_TEST_BITS);
+    copy.overwrite(piece_start, piece);
+    ASSERT_TRUE(copy.compare(vec, piece_start, piece_start + 140),
+        "overwritten range should match");
+  }
+
+  // logical operations on two vectors with an uneven size.
+  const int ODD_SIZE = 131;
+  bit_vector a(ODD_SIZE), b(ODD_SIZE);
+  for (int i = 0; i < ODD_SIZE; i++) {
+    if (i % 3 == 0) a.light(i);
+    if (i % 5 == 0) b.light(i);
+  }
+  bit_vector anded = a & b, ored = a | b, xored = a ^ b, inverted = ~a;
+  for (int i = 0; i < ODD_SIZE; i++) {
+    ASSERT_EQUAL(int(anded.on(i)), int(i % 15 == 0), "and should work");
+    ASSERT_EQUAL(int(ored.on(i)), int((i % 3 == 0) || (i % 5 == 0)), "or should work");
+    ASSERT_EQUAL(int(xored.on(i)), int((i % 3 == 0) != (i % 5 == 0)), "xor should work");
+    ASSERT_EQUAL(int(inverted.on(i)), int(i % 3 != 0), "not should work");
+  }
+  ASSERT_EQUAL(inverted.count(), ODD_SIZE - a.count(),
+      "inverting must not light bits past the end");
+  inverted.invert();
+  ASSERT_EQUAL(inverted, a, "inverting twice should restore the vector");
+}
+
+void test_bit_vector::run_benchmark(int bits)
+{
+  FUNCDEF("run_benchmark");
+  bit_vector vec(bits);
+  time_stamp start;
+
+  // mark everything received except for a small hole every so often.
+  vec.light(0, bits - 1);
+  const int HOLE_SPACING = 1000;
+  for (int i = HOLE_SPACING / 2; i < bits; i += HOLE_SPACING)
+    vec.clear(i, i + 2);
+  double fill_time = time_stamp().value() - start.value();
+
+  // walk all of the runs of missing bits.
+  start.reset();
+  int runs = 0;
+  int posn = vec.find_next(false, 0);
+  while (!negative(posn)) {
+    runs++;
+    int end = vec.find_next(true, posn);
+    if (negative(end)) break;
+    posn = vec.find_next(false, end);
+  }
+  double walk_time = time_stamp().value() - start.value();
+  ASSERT_EQUAL(runs, (bits + HOLE_SPACING / 2) / HOLE_SPACING,
+      "should find every hole");
+
+  start.reset();
+  int lit = vec.count();
+  double count_time = time_stamp().value() - start.value();
+  ASSERT_EQUAL(lit, bits - 3 * runs, "count should see all lit bits");
+
+  start.reset();
+  bit_vector other(bits);
+  other.light(0, bits / 2);
+  other ^= vec;
+  other.invert();
+  other &= vec;
+  double logic_time = time_stamp().value() - start.value();
+
+  log(a_sprintf("%d bits: range fill %.0f ms, walked %d runs in %.0f ms, "
+      "count %.0f ms, logic ops %.0f ms.", bits, fill_time, runs, walk_time,
+      count_time, logic_time));
+}
+
@@ -0,0 +1,97 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_checksums                                                    *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/checksums.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+typedef checksums::wide_hash wide_hash;
+
+const int SPEED_TEST_SIZE = 64 * MEGABYTE;
+  // the amount of data hashed when measuring throughput.
+
+//////////////
+
+class test_checksums : public virtual unit_base, public virtual application_shell
+{
+public:
+  test_checksums() {}
+  DEFINE_CLASS_NAME("test_checksums");
+  int execute();
+
+  bool same(wide_hash a, wide_hash b) { return a == b; }
+};
+
+HOOPLE_MAIN(test_checksums, );
+
+//////////////
+
+int test_checksums::execute()
+{
+  FUNCDEF("execute");
+  // known answers for xxHash64.
+  ASSERT_TRUE(same(checksums::wide_hash_bytes((const abyte *)"", 0),
+      0xEF46DB3751D8E999ULL), "empty input should match reference");
+  ASSERT_TRUE(same(checksums::wide_hash_bytes((const abyte *)"abc", 3),
+      0x44BC2CF5AD770999ULL), "short input should match reference");
+  const char *sentence = "Nobody inspects the spammish repetition";
+  ASSERT_TRUE(same(checksums::wide_hash_bytes((const abyte *)sentence,
+      int(strlen(sentence))), 0xFBCEA83C8A378BF1ULL),
+      "striped input should match reference");
+  abyte counting[100];
+  for (int i = 0; i < 100; i++) counting[i] = abyte(i);
+  ASSERT_TRUE(same(checksums::wide_hash_bytes(counting, 100, 7),
+      0x80653E7E9B887CDDULL), "seeded input should match reference");
+
+  // every single bit flip should change the hash.
+  wide_hash original = checksums::wide_hash_bytes(counting, 100);
+  int unchanged = 0;
+  for (int i = 0; i < 100 * 8; i++) {
+    counting[i / 8] ^= abyte(1 << (i % 8));
+    if (checksums::wide_hash_bytes(counting, 100) == original) unchanged++;
+    counting[i / 8] ^= abyte(1 << (i % 8));
+  }
+  ASSERT_EQUAL(unchanged, 0, "bit flips should always change the hash");
+
+  // compare the throughput against the fletcher checksum.
+  byte_array big(SPEED_TEST_SIZE);
+  for (int i = 0; i < big.length(); i++) big[i] = abyte(i * 7 + (i >> 9));
+  time_stamp started;
+  wide_hash wide = checksums::wide_hash_bytes(big.observe(), big.length());
+  double wide_time = time_stamp().value() - started.value();
+  started.reset();
+  un_short fletch = checksums::fletcher_checksum(big.observe(), big.length());
+  double fletcher_time = time_stamp().value() - started.value();
+  log(a_sprintf("hashing %d MB: wide hash took %.0f ms (%.0f MB/s), fletcher "
+      "took %.0f ms.", SPEED_TEST_SIZE / MEGABYTE, wide_time,
+      double(SPEED_TEST_SIZE / MEGABYTE) / maximum(wide_time, 1.0) * 1000.0,
+      fletcher_time));
+  ASSERT_TRUE(wide || fletch, "the sums should be used");
+
+  return final_report();
+}
+
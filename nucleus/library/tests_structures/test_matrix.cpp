@@ -141,7 +141,7 @@ void test_matrix::print_matrix(const my_int_matrix &to_print)
 
 void test_matrix::test_out_submatrix(const my_int_matrix &source)
 {
-  FUNCDEF("test_out_submatrix")
+  FUNCDEF("test_out_submatrix");
   my_int_matrix test2(source);
 
   for (int s = 0; s < DIM_ROWS; s++)
@@ -166,7 +166,7 @@ void test_matrix::test_out_submatrix(const my_int_matrix &source)
 
 void test_matrix::test_out_redimension()
 {
-  FUNCDEF("test_out_redimension")
+  FUNCDEF("test_out_redimension");
   my_int_matrix computed(7, 14);
   for (int x1 = 0; x1 < 7; x1++) {
     for (int y1 = 0; y1 < 14; y1++) {
@@ -203,7 +203,7 @@ void test_matrix::test_out_redimension()
 
 void test_matrix::test_out_resizing_virtual_objects()
 {
-  FUNCDEF("test_out_resizing_virtual_objects")
+  FUNCDEF("test_out_resizing_virtual_objects");
   // this test block ensures that the matrix doesn't blow up from certain
   // resizing operations performed on a templated type that has a virtual
   // destructor.
@@ -217,7 +217,7 @@ void test_matrix::test_out_resizing_virtual_objects()
 
 void test_matrix::test_out_zapping(const my_int_matrix &test_pure)
 {
-  FUNCDEF("test_out_zapping")
+  FUNCDEF("test_out_zapping");
   // this block tests the zapping ops.
   my_int_matrix test_zap;
   STUFF_MATRIX(test_zap, DIM_ROWS, DIM_COLS);
@@ -275,7 +275,7 @@ void test_matrix::test_out_zapping(const my_int_matrix &test_pure)
 
 void test_matrix::test_out_inserting(const my_int_matrix &test_pure)
 {
-  FUNCDEF("test_out_inserting")
+  FUNCDEF("test_out_inserting");
   // this block tests the inserting ops.
   my_int_matrix test_insert;
   STUFF_MATRIX(test_insert, 4, 4);
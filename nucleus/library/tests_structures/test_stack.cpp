@@ -256,7 +256,7 @@ both types of stack exercises were successful.\n\
 
 void test_stack::test_stack_with_pointers()
 {
-  FUNCDEF("test_stack_with_pointers")
+  FUNCDEF("test_stack_with_pointers");
   for (int qq = 0; qq < test_iterations; qq++) {
 #ifdef DEBUG_STACK
     LOG(astring(astring::SPRINTF, "index %d", qq));
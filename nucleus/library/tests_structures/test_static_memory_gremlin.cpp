@@ -0,0 +1,176 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_static_memory_gremlin                                        *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int BENCHMARK_OBJECTS = 5000;
+  // how many objects are registered with a gremlin for the timing.
+
+const int BENCHMARK_ACCESSES = 10000000;
+  // how many times a safe static is fetched for the timing.
+
+//////////////
+
+// an object that counts how many of its kind are alive.
+
+class counted_object : public virtual nameable
+{
+public:
+  counted_object(int value = 0) : _value(value) { _alive++; }
+  virtual ~counted_object() { _alive--; }
+  DEFINE_CLASS_NAME("counted_object");
+
+  int _value;
+  static int _alive;
+};
+
+int counted_object::_alive = 0;
+
+SAFE_STATIC(counted_object, first_static, (23))
+SAFE_STATIC(counted_object, second_static, (42))
+
+//////////////
+
+class test_static_memory_gremlin : public virtual unit_base,
+    virtual public application_shell
+{
+public:
+  test_static_memory_gremlin() : application_shell() {}
+  DEFINE_CLASS_NAME("test_static_memory_gremlin");
+  virtual int execute();
+
+private:
+  void test_safe_statics();
+    //!< makes sure the safe statics are created once and then kept.
+
+  void test_records();
+    //!< checks the object records in a private gremlin.
+
+  double time_registration();
+    //!< returns how many objects per second can be registered.
+
+  double time_accesses();
+    //!< returns the nanoseconds taken by each access of a safe static.
+};
+
+void test_static_memory_gremlin::test_safe_statics()
+{
+  FUNCDEF("test_safe_statics");
+  int alive = counted_object::_alive;
+  counted_object &first = first_static();
+  ASSERT_EQUAL(counted_object::_alive, alive + 1, "the static should be created");
+  ASSERT_EQUAL(first._value, 23, "the static should get its parameters");
+  ASSERT_EQUAL(&first_static(), &first, "the same object should come back");
+  ASSERT_EQUAL(counted_object::_alive, alive + 1, "no other object should be made");
+  ASSERT_EQUAL(second_static()._value, 42, "the other static should be separate");
+  ASSERT_FALSE(static_memory_gremlin::__program_is_dying(),
+      "the program should not be dying yet");
+
+  // the program-wide gremlin knows the statics by their names.
+  static_memory_gremlin &globals = static_memory_gremlin::__hoople_globals();
+  const char *name = globals.find(&first);
+  ASSERT_TRUE(name, "the static should be listed in the gremlin");
+  if (name)
+    ASSERT_EQUAL(globals.get(name), (root_object *)&first,
+        "the static should be found under its name");
+}
+
+void test_static_memory_gremlin::test_records()
+{
+  FUNCDEF("test_records");
+  int alive = counted_object::_alive;
+  {
+    static_memory_gremlin gremlin;
+    counted_object *a = new counted_object(1);
+    counted_object *b = new counted_object(2);
+    ASSERT_TRUE(gremlin.put("a", a), "the first object should be put");
+    gremlin.enroll("b", b);
+    ASSERT_EQUAL(gremlin.get("a"), (root_object *)a, "the first should be found");
+    ASSERT_EQUAL(gremlin.get("b"), (root_object *)b, "the second should be found");
+    ASSERT_FALSE(gremlin.get("c"), "a missing name should not be found");
+    ASSERT_EQUAL(astring(gremlin.find(b)), astring("b"), "the name should be found");
+    ASSERT_FALSE(gremlin.find(this), "an unlisted object should not be found");
+
+    // putting a name again replaces the object that it had.
+    counted_object *c = new counted_object(3);
+    ASSERT_TRUE(gremlin.put("a", c), "the object should be replaced");
+    ASSERT_EQUAL(gremlin.get("a"), (root_object *)c, "the new object should be found");
+    ASSERT_EQUAL(counted_object::_alive, alive + 2, "the old object should be gone");
+  }
+  ASSERT_EQUAL(counted_object::_alive, alive, "the gremlin should destroy its objects");
+}
+
+double test_static_memory_gremlin::time_registration()
+{
+  FUNCDEF("time_registration");
+  astring *names = new astring[BENCHMARK_OBJECTS];
+  for (int i = 0; i < BENCHMARK_OBJECTS; i++)
+    names[i] = a_sprintf("file:bogus.cpp:line:%d", i);
+  double duration;
+  {
+    static_memory_gremlin gremlin;
+    time_stamp started;
+    for (int i = 0; i < BENCHMARK_OBJECTS; i++)
+      gremlin.enroll(names[i].s(), new counted_object(i));
+    duration = time_stamp().value() - started.value();
+    ASSERT_TRUE(gremlin.get(names[0].s()), "the first object should be listed");
+  }
+  delete [] names;
+  return double(BENCHMARK_OBJECTS) / maximum(duration, 1.0) * SECOND_ms;
+}
+
+double test_static_memory_gremlin::time_accesses()
+{
+  FUNCDEF("time_accesses");
+  int total = 0;
+  time_stamp started;
+  for (int i = 0; i < BENCHMARK_ACCESSES; i++)
+    total += first_static()._value;
+  double duration = time_stamp().value() - started.value();
+  ASSERT_EQUAL(total, 23 * BENCHMARK_ACCESSES, "every access should see the static");
+  return duration * 1000000.0 / BENCHMARK_ACCESSES;
+}
+
+int test_static_memory_gremlin::execute()
+{
+  FUNCDEF("execute");
+  test_safe_statics();
+  test_records();
+
+  double registered = time_registration();
+  double access_ns = time_accesses();
+  log(a_sprintf("%d objects registered at %.0f per second; each safe static "
+      "access took %.1f ns.", BENCHMARK_OBJECTS, registered, access_ns));
+
+  return final_report();
+}
+
+HOOPLE_MAIN(test_static_memory_gremlin, )
+
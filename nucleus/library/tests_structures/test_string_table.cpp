@@ -85,7 +85,7 @@ public:
 
 void test_string_table::ADD(string_table &syms, const astring &name, const astring &to_add)
 {
-  FUNCDEF("ADD")
+  FUNCDEF("ADD");
 //LOG(astring("add of ") + name + " => " + to_add);
   time_stamp start;
   outcome added = syms.add(name, to_add);
@@ -97,7 +97,7 @@ void test_string_table::ADD(string_table &syms, const astring &name, const astri
 
 void test_string_table::FIND(const string_table &syms, const astring &name, const astring &to_find)
 {
-  FUNCDEF("FIND")
+  FUNCDEF("FIND");
   for (int i = 0; i < FIND_ITERATIONS; i++) {
     time_stamp start;
     astring *found = syms.find(name);
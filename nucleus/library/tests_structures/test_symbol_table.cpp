@@ -198,7 +198,7 @@ public:
 
 void test_symbol_table::ADD(my_table_def &syms, const astring &name, const astring &to_add)
 {
-  FUNCDEF("ADD")
+  FUNCDEF("ADD");
   byte_array to_stuff(to_add.length() + 1, (abyte *)to_add.s());
   time_stamp start;
   outcome added = syms.add(name, to_stuff);
@@ -223,7 +223,7 @@ void test_symbol_table::ADD(my_table_def &syms, const astring &name, const astri
 
 void test_symbol_table::FIND(const my_table_def &syms, const astring &name, const astring &to_add)
 {
-  FUNCDEF("FIND")
+  FUNCDEF("FIND");
   byte_array to_stuff(to_add.length() + 1, (abyte *)to_add.s());
   for (int i = 0; i < FIND_ITERATIONS; i++) {
     time_stamp start;
@@ -324,7 +324,7 @@ my_table_def creatapose()
 
 void test_symbol_table::test_byte_table()
 {
-  FUNCDEF("test_byte_table")
+  FUNCDEF("test_byte_table");
   my_table_def syms;
   my_table_def new_syms;
   my_table_def newer_syms;
@@ -438,7 +438,7 @@ void test_symbol_table::test_byte_table()
 void test_symbol_table::ADD2(second_table_def &syms, const astring &name,
     const test_content &to_add)
 { 
-  FUNCDEF("ADD2")
+  FUNCDEF("ADD2");
   time_stamp start;
   outcome added = syms.add(name, to_add);
   ASSERT_EQUAL(added.value(), common::IS_NEW, "new item should not already be in table");
@@ -476,7 +476,7 @@ void test_symbol_table::ADD2(second_table_def &syms, const astring &name,
 
 void test_symbol_table::test_tc_table()
 {
-  FUNCDEF("test_tc_table")
+  FUNCDEF("test_tc_table");
   second_table_def syms;
   second_table_def new_syms;
   second_table_def newer_syms;
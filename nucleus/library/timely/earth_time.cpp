@@ -43,6 +43,9 @@ namespace timely {
   #define LOG(tpr) 
 #endif
 
+#undef static_class_name
+#define static_class_name() "earth_time"
+
 //////////////
 
 const time_number days_in_month[12]
@@ -351,7 +354,7 @@ time_locus convert(time_number seconds, time_number useconds,
 
 time_locus now()
 {
-  FUNCDEF("now")
+  FUNCDEF("now");
   timeval currtime;
   int okay = gettimeofday(&currtime, NULL_POINTER);
   if (okay != 0) {
@@ -368,7 +371,7 @@ time_locus now()
 
 time_locus greenwich_now()
 {
-  FUNCDEF("greenwich_now")
+  FUNCDEF("greenwich_now");
   timeval currtime;
   int okay = gettimeofday(&currtime, NULL_POINTER);
   if (okay != 0) {
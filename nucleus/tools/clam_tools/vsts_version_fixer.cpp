@@ -343,12 +343,17 @@ LOG(astring("chose source dir as ") + repo_source);
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
+  #include <filesystem/file_time.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <loggers/combo_logger.cpp>
   #include <loggers/console_logger.cpp>
   #include <loggers/critical_events.cpp>
   #include <loggers/file_logger.cpp>
   #include <loggers/program_wide_logger.cpp>
+  #include <processes/ethread.cpp>
+  #include <processes/child_supervisor.cpp>
   #include <processes/launch_process.cpp>
   #include <structures/bit_vector.cpp>
   #include <structures/checksums.cpp>
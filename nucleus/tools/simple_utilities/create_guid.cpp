@@ -122,7 +122,10 @@ HOOPLE_MAIN(create_guid, )
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
+  #include <filesystem/file_time.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <loggers/combo_logger.cpp>
   #include <loggers/console_logger.cpp>
   #include <loggers/critical_events.cpp>
@@ -100,7 +100,10 @@ The first parameter must be a user name that will be given the\n\
   #include <application/command_line.cpp>
   #include <opsystem/critical_events.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
+  #include <filesystem/file_time.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <configuration/ini_configurator.cpp>
   #include <opsystem/ini_parser.cpp>
   #include <configuration/application_configuration.cpp>
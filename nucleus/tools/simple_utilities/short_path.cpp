@@ -65,7 +65,10 @@ int main(int argc, char *argv[])
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
+  #include <filesystem/file_time.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <loggers/console_logger.cpp>
   #include <loggers/program_wide_logger.cpp>
   #include <structures/checksums.cpp>
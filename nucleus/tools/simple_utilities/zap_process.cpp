@@ -101,7 +101,10 @@ int main(int argc, char *argv[])
   #include <configuration/variable_tokenizer.cpp>
   #include <filesystem/byte_filer.cpp>
   #include <filesystem/directory.cpp>
+  #include <filesystem/file_info.cpp>
+  #include <filesystem/file_time.cpp>
   #include <filesystem/filename.cpp>
+  #include <filesystem/huge_file.cpp>
   #include <loggers/combo_logger.cpp>
   #include <loggers/console_logger.cpp>
   #include <loggers/critical_events.cpp>
@@ -109,6 +112,7 @@ int main(int argc, char *argv[])
   #include <loggers/program_wide_logger.cpp>
   #include <processes/process_control.cpp>
   #include <processes/process_entry.cpp>
+  #include <processes/proc_scanner.cpp>
   #include <structures/bit_vector.cpp>
   #include <structures/checksums.cpp>
   #include <structures/object_packers.cpp>
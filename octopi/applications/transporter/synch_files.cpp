@@ -12,6 +12,7 @@
 * Please send any updates to: fred@gruntose.com
 */
 
+#include <application/command_line.h>
 #include <application/hoople_main.h>
 #include <basis/functions.h>
 #include <loggers/console_logger.h>
@@ -47,36 +48,53 @@ int synch_files_tentacle::execute()
 {
   FUNCDEF("execute");
 
-  if (_global_argc < 3) {
+  command_line cmds(_global_argc, _global_argv);  // parse the command line up.
+
+  // the flags pick the optional ways of transferring.
+  int transfer_mode = file_transfer_tentacle::COMPARE_SIZE_AND_TIME;
+  int indy = 0;
+  if (cmds.find("delta", indy))
+    transfer_mode |= file_transfer_tentacle::DELTA_TRANSFER;
+  indy = 0;
+  if (cmds.find("pipeline", indy))
+    transfer_mode |= file_transfer_tentacle::PIPELINED_TRANSFER;
+
+  // everything else is positional.
+  string_array parms;
+  for (int i = 0; i < cmds.entries(); i++) {
+    const command_parameter &curr = cmds.get(i);
+    if (curr.type() == command_parameter::VALUE) parms += curr.text();
+  }
+
+  if (parms.length() < 2) {
     log(astring("\
 This program needs two parameters:\n\
 a directory for the source root and one for the target root.\n\
 Optionally, a third parameter may specify a starting point within the\n\
 source root.\n\
 Further, if fourth or more parameters are found, they are taken to be\n\
-files to include; only they will be transferred.\n"), ALWAYS_PRINT);
+files to include; only they will be transferred.\n\
+The flag --delta sends changed files as deltas against the target's copies,\n\
+and --pipeline keeps several chunks in flight at once.\n"), ALWAYS_PRINT);
     return 23;
   }
 
-  astring source_dir = _global_argv[1];
-  astring target_dir = _global_argv[2];
+  astring source_dir = parms[0];
+  astring target_dir = parms[1];
 
   astring source_start = "";
-  if (_global_argc >= 4) {
-    source_start = _global_argv[3];
+  if (parms.length() >= 3) {
+    source_start = parms[2];
   }
 
   string_array includes;
-  if (_global_argc >= 5) {
-    for (int i = 4; i < _global_argc; i++) {
-      includes += _global_argv[i];
-    }
+  for (int i = 3; i < parms.length(); i++) {
+    includes += parms[i];
   }
 
 //hmmm: make comparing the file chunks an option too!
-  outcome returned = recursive_file_copy::copy_hierarchy
-      (file_transfer_tentacle::COMPARE_SIZE_AND_TIME, source_dir,
-      target_dir, includes, source_start);
+  outcome returned = recursive_file_copy::copy_hierarchy(transfer_mode,
+      source_dir, target_dir, includes, source_start);
 
   if (returned != common::OKAY) {
     critical_events::alert_message(astring("copy failure with outcome=")
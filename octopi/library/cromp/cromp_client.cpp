@@ -38,6 +38,7 @@
 #include <tentacles/entity_registry.h>
 #include <tentacles/key_repository.h>
 #include <tentacles/login_tentacle.h>
+#include <tentacles/rsa_key_pool.h>
 #include <tentacles/security_infoton.h>
 #include <timely/time_control.h>
 #include <timely/time_stamp.h>
@@ -194,8 +195,11 @@ void cromp_client::enable_encryption()
 //      using the slightly less secure local key.  could be ameliorated by
 //      zapping the encryption tentacle for a reset and readding it if it
 //      existed?
-  } else
-    _encrypt_arm = new encryption_tentacle(encryption_infoton::RSA_KEY_SIZE);
+  } else {
+    // draw a pre-generated key from the pool rather than making one now.
+    _encrypt_arm = new encryption_tentacle
+        (rsa_key_pool::global_pool().acquire_for(other_side().text_form()));
+  }
   add_tentacle(_encrypt_arm, true);
   add_tentacle(new unwrapping_tentacle, false);
 }
@@ -22,6 +22,7 @@
 
 #include <basis/astring.h>
 #include <basis/mutex.h>
+#include <basis/rw_mutex.h>
 #include <configuration/application_configuration.h>
 #include <loggers/critical_events.h>
 #include <loggers/program_wide_logger.h>
@@ -46,9 +47,20 @@ namespace octopi {
 //#define DEBUG_OCTOPUS_FILTERS
   // uncomment for noisy filter processing.
 
-#undef GRAB_LOCK
-#define GRAB_LOCK \
-  auto_synchronizer l(*_molock)
+// the tentacle list is only changed while holding the write lock.  the
+// requests that just use the list share the read lock instead.
+#undef WRITE_LOCK
+#define WRITE_LOCK \
+  auto_writer l(*_molock)
+#undef READ_LOCK
+#define READ_LOCK \
+  auto_reader l(*_molock)
+
+// these adjust the removal blocker.  readers can do this simultaneously.
+#define BLOCK_REMOVALS \
+  __atomic_add_fetch(&_disallow_removals, 1, __ATOMIC_RELAXED)
+#define ALLOW_REMOVALS \
+  __atomic_sub_fetch(&_disallow_removals, 1, __ATOMIC_RELAXED)
 
 // this macro returns a result and deletes the request due to a failure.  it
 // stores a response for the request, in case they were expecting one, since
@@ -142,13 +154,13 @@ public:
 octopus::octopus(const astring &name, int max_per_ent)
 : _name(new astring(name)),
   _tentacles(new modula_oblongata),
-  _molock(new mutex),
+  _molock(new rw_mutex),
   _responses(new entity_data_bin(max_per_ent)),
   _disallow_removals(0),
   _next_cleaning(new time_stamp(OCTOPUS_CHECKING_INTERVAL)),
   _clean_lock(new mutex),
   _filters(new filter_list),
-  _sequencer(new safe_roller(1, MAXINT32 / 2)),
+  _sequencer(new block_roller(1, MAXINT32 / 2)),
   _rando(new chaos)
 {
   add_tentacle(new identity_tentacle(*this), true);
@@ -171,9 +183,9 @@ octopus::~octopus()
   WHACK(_sequencer);
 }
 
-void octopus::lock_tentacles() { _molock->lock(); }
+void octopus::lock_tentacles() { _molock->lock_read(); }
 
-void octopus::unlock_tentacles() { _molock->unlock(); }
+void octopus::unlock_tentacles() { _molock->unlock_read(); }
 
 entity_data_bin &octopus::responses() { return *_responses; }
 
@@ -194,7 +206,7 @@ infoton *octopus::acquire_result(const octopus_entity &requester,
 void octopus::unlock_tentacle(tentacle *to_unlock)
 {
   to_unlock = NULL_POINTER;
-  _molock->unlock();
+  _molock->unlock_read();
 }
 
 void octopus::expunge(const octopus_entity &to_remove)
@@ -202,8 +214,8 @@ void octopus::expunge(const octopus_entity &to_remove)
   FUNCDEF("expunge");
   {
     // temporary lock so we can keep tentacles from evaporating.
-    GRAB_LOCK;
-    _disallow_removals++;
+    READ_LOCK;
+    BLOCK_REMOVALS;
   }
 
   // we've now ensured that no tentacles will be removed, so at most the
@@ -221,8 +233,8 @@ void octopus::expunge(const octopus_entity &to_remove)
 
   {
     // re-enable tentacle removals.
-    GRAB_LOCK;
-    _disallow_removals--;
+    READ_LOCK;
+    ALLOW_REMOVALS;
   }
 
   // throw out any data that was waiting for that guy.
@@ -261,7 +273,7 @@ outcome octopus::add_tentacle(tentacle *to_add, bool filter)
     LOG(astring("removed existing tentacle: ") + to_add->group().text_form());
 //#endif
   }
-  GRAB_LOCK;
+  WRITE_LOCK;
   tentacle *found = _tentacles->find(to_add->group());
   // if found is non-null, then that would be a serious logic error since
   // we just zapped it above.
@@ -285,7 +297,7 @@ outcome octopus::remove_tentacle(const string_array &group_name,
   while (true) {
     // repeatedly grab the lock and make sure we're allowed to remove.  if
     // we're told we can't remove yet, then we drop the lock again and pause.
-    _molock->lock();
+    _molock->lock_write();
     if (!_disallow_removals) {
       // we ARE allowed to remove it right now.  we leave the loop in
       // possession of the lock.
@@ -295,13 +307,13 @@ outcome octopus::remove_tentacle(const string_array &group_name,
       continuable_error(class_name(), func, "logic error in removal "
           "reference counter.");
     }
-    _molock->unlock();
+    _molock->unlock_write();
     time_control::sleep_ms(0);  // yield thread's execution to another thread.
   }
   int indy = _tentacles->find_index(group_name);
   if (negative(indy)) {
     // nope, no match.
-    _molock->unlock();
+    _molock->unlock_write();
     return tentacle::NOT_FOUND;
   }
   // found the match.
@@ -309,7 +321,7 @@ outcome octopus::remove_tentacle(const string_array &group_name,
   _tentacles->zap(indy, indy);
   free_me = freeing->_limb;
   _filters->remove(free_me);
-  _molock->unlock();
+  _molock->unlock_write();
   freeing->_limb = NULL_POINTER;
   WHACK(freeing);
   return tentacle::OKAY;
@@ -329,8 +341,8 @@ outcome octopus::restore(const string_array &classifier,
   if (!classifier.length()) return tentacle::BAD_INPUT;
   {
     // keep anyone from being removed until we're done.
-    GRAB_LOCK;
-    _disallow_removals++;
+    READ_LOCK;
+    BLOCK_REMOVALS;
   }
   tentacle *found = _tentacles->find(classifier);
   outcome to_return;
@@ -343,8 +355,8 @@ outcome octopus::restore(const string_array &classifier,
     to_return = found->reconstitute(classifier, packed_form, reformed);
   }
   // re-enable tentacle removals.
-  GRAB_LOCK;
-  _disallow_removals--;
+  READ_LOCK;
+  ALLOW_REMOVALS;
   return to_return;
 }
 
@@ -362,10 +374,10 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
     WHACK_RETURN(tentacle::BAD_INPUT, request);
   }
 
-  _molock->lock();
+  _molock->lock_read();
 
   // block tentacle removals while we're working.
-  _disallow_removals++;
+  BLOCK_REMOVALS;
 
   // ensure that we pass this infoton through all the filters for vetting.
   for (int i = 0; i < _filters->length(); i++) {
@@ -385,7 +397,7 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
 #endif
 
     // this infoton is _for_ this filter.
-    _molock->unlock();
+    _molock->unlock_read();
       // unlock octopus to allow others to operate.
 
     byte_array transformed;
@@ -402,8 +414,8 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
           + tentacle::outcome_name(to_return));
 #endif
       WHACK(request);
-      GRAB_LOCK;  // short re-establishment of the lock.
-      _disallow_removals--;
+      READ_LOCK;  // short re-establishment of the lock.
+      ALLOW_REMOVALS;
       return to_return;
     } else {
       // the infoton was vetted by the filter.  make sure it was liked.
@@ -437,7 +449,7 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
           }
         }
 
-        _molock->lock();  // get the lock again.
+        _molock->lock_read();  // get the lock again.
         continue;
       } else {
         // this is a failure to process that object.
@@ -446,8 +458,8 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
             "infoton from " + id.text_form());
 #endif
         {
-          GRAB_LOCK;  // short re-establishment of the lock.
-          _disallow_removals--;
+          READ_LOCK;  // short re-establishment of the lock.
+          ALLOW_REMOVALS;
         }
         WHACK_RETURN(to_return, request);
       }
@@ -463,7 +475,7 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
   // locate the appropriate tentacle for this request.
   tentacle *found = _tentacles->find(request->classifier());
 
-  _molock->unlock();
+  _molock->unlock_read();
     // from here in, the octopus itself is not locked up.  but we have sent
     // the signal that no one must remove any tentacles for now.
 
@@ -472,8 +484,8 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
     LOG(astring("tentacle not found for: ")
         + request->classifier().text_form());
 #endif
-    GRAB_LOCK;  // short re-establishment of the lock.
-    _disallow_removals--;
+    READ_LOCK;  // short re-establishment of the lock.
+    ALLOW_REMOVALS;
     WHACK_RETURN(tentacle::NOT_FOUND, request);
   }
   // make sure they want background execution and that the tentacle can
@@ -481,16 +493,16 @@ outcome octopus::evaluate(infoton *request, const octopus_request_id &id,
   if (!now && found->backgrounding()) {
     // pass responsibility over to the tentacle.
     outcome to_return = found->enqueue(request, id);
-    GRAB_LOCK;  // short re-establishment of the lock.
-    _disallow_removals--;
+    READ_LOCK;  // short re-establishment of the lock.
+    ALLOW_REMOVALS;
     return to_return;
   } else {
     // call the tentacle directly.
     byte_array ignored;
     outcome to_return = found->consume(*request, id, ignored);
     WHACK(request);
-    GRAB_LOCK;  // short re-establishment of the lock.
-    _disallow_removals--;
+    READ_LOCK;  // short re-establishment of the lock.
+    ALLOW_REMOVALS;
     return to_return;
   }
 }
@@ -515,10 +527,10 @@ void octopus::periodic_cleaning()
 tentacle *octopus::lock_tentacle(const string_array &tentacle_name)
 {
   if (!tentacle_name.length()) return NULL_POINTER;
-  _molock->lock();
+  _molock->lock_read();
   tentacle *found = _tentacles->find(tentacle_name);
   if (!found) {
-    _molock->unlock();
+    _molock->unlock_read();
     return NULL_POINTER;
   }
   return found;
@@ -16,6 +16,8 @@
 \*****************************************************************************/
 
 #include <basis/contracts.h>
+#include <basis/mutex.h>
+#include <basis/rw_mutex.h>
 #include <mathematics/chaos.h>
 #include <processes/safe_roller.h>
 #include <structures/set.h>
@@ -176,16 +178,19 @@ public:
 private:
   basis::astring *_name;  //!< our name as passed to the constructor.
   modula_oblongata *_tentacles;  //!< the list of tentacles.  
-  basis::mutex *_molock;  //!< the synchronizer for our tentacle list.
+  basis::rw_mutex *_molock;  //!< the synchronizer for our tentacle list.
+    /*!< requests only read the list, so they share this lock; only adding
+    and removing tentacles takes it exclusively. */
   entity_data_bin *_responses;  //!< data awaiting pickup by requester.
   int _disallow_removals;
     //!< simplifies locking behavior for immediate requests.
     /*!< we set this flag and don't need to lock the whole octopus.  if it's
-    non-zero, then no tentacles can be removed yet. */
+    non-zero, then no tentacles can be removed yet.  since the readers share
+    the lock, they change this atomically. */
   timely::time_stamp *_next_cleaning;  //!< when we'll next flush old items.
   basis::mutex *_clean_lock;  //!< used only to protect the time stamp above.
   filter_list *_filters;  //!< the filters that must vet infotons.
-  processes::safe_roller *_sequencer;  //!< identity issue; this is the next entity id.
+  processes::block_roller *_sequencer;  //!< identity issue; this is the next entity id.
   mathematics::chaos *_rando;  //!< randomizer for providing extra uniquification.
 
   // not accessible.
@@ -159,6 +159,21 @@ byte_array machine_uid::native() const
 
 //////////////
 
+hashing_algorithm *machine_uid_hasher::clone() const
+{ return new machine_uid_hasher; }
+
+un_int machine_uid_hasher::hash(const void *key_data,
+    int formal(key_length)) const
+{
+  if (!key_data) return 0;  // error.
+  const byte_array &raw = ((const machine_uid *)key_data)->raw();
+  // addresses on the same network differ only in their last few bytes, so
+  // we use FNV-1a to make sure that every byte stirs up the whole value.
+  return checksums::fnv_hash(raw.observe(), raw.length());
+}
+
+//////////////
+
 class internal_machine_uid_array : public array<machine_uid> {};
 
 machine_uid_array::machine_uid_array()
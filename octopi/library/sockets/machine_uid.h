@@ -33,6 +33,7 @@
 #include <basis/astring.h>
 #include <basis/byte_array.h>
 #include <basis/contracts.h>
+#include <structures/hash_table.h>
 
 namespace sockets {
 
@@ -117,6 +118,20 @@ public:
 
 //////////////
 
+//! Hashes a machine_uid so that it can be used as a hash_table key.
+
+class machine_uid_hasher : public virtual structures::hashing_algorithm
+{
+public:
+  virtual basis::un_int hash(const void *key_data, int key_length) const;
+    //!< expects "key_data" to be a machine_uid pointer.
+
+  virtual structures::hashing_algorithm *clone() const;
+    //!< implements cloning of the algorithm object.
+};
+
+//////////////
+
 // this object contains a list of unique machine identifiers.  this is
 // intentionally just an array (and not a set) because some usages of the
 // list of machine_uids need a notion of ordering (such as for a list of
@@ -20,8 +20,8 @@
 
 #include <basis/mutex.h>
 #include <loggers/program_wide_logger.h>
-#include <structures/amorph.h>
-#include <structures/int_hash.h>
+#include <structures/bit_vector.h>
+#include <structures/hash_table.h>
 #include <textual/parser_bits.h>
 #include <timely/time_stamp.h>
 
@@ -33,18 +33,22 @@ using namespace timely;
 
 namespace sockets {
 
-const int MAX_BITS_FOR_SEQ_HASH = 10;
-  // the number of bits in the hash table of sequences, allowing 2^max buckets.
+const int WINDOW_SIZE = 4096;
+  // how many sequence numbers past the fully received point we track for
+  // each host.  a sequence that lands beyond the window pushes it forward,
+  // which treats the oldest missing sequences as received.  this plays the
+  // role of the old limit on held items, but costs only a bit per sequence.
+  // this must be a power of two.
+
+const int INITIAL_ARRIVALS = 32;
+  // the starting size of each host's list of out of order arrivals.
 
 const int CLEANING_SPAN = 20000;
   // if the sequence number is this far off from the one received, we will
-  // clean up the span list.
+  // start the host over at that sequence.
 
-const int MAX_ITEMS = 200;
-  // maximum number of items in tracker.  this is quite low since we don't
-  // want to be lugging around thousands of indices.  for connection oriented,
-  // it will never be much of an issue, although for a broadcast style bus it
-  // could be kind of an issue if we do retransmissions with a lot of lag.
+const int INITIAL_HOSTS = 64;
+  // the number of hosts we expect at first.  the table grows as needed.
 
 #undef LOG
 #define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
@@ -59,17 +63,12 @@ const int MAX_ITEMS = 200;
 //      probably we will see a sequence that's really old seeming; should that
 //      be enough to trigger flushing the whole host?
 
-class sequence_record
+// records when a sequence arrived ahead of the fully received point.
+
+struct sequence_arrival
 {
-public:
   int _sequence;  // the sequence number in question.
-  time_stamp _when;  // when we received this sequence.
-
-  sequence_record(int seq = 0) : _sequence(seq) {}
-
-  astring text_form() const {
-    return a_sprintf("seq=%d, time=", _sequence) + _when.text_form();
-  }
+  double _when;  // when we received this sequence.
 };
 
 //////////////
@@ -79,174 +78,242 @@ class host_record
 public:
   int _received_to;  // highest sequence we've got full reception prior to.
   machine_uid _host;  // the host we're concerned with.
-  int_hash<sequence_record> _sequences;  // record of active sequences.
   time_stamp _last_active;  // the last time we heard from this host.
-    // we could piece this together from the sequences but we prefer not to.
+  int _index;  // where this host lives in the host list.
 
   host_record(const machine_uid &host)
-  : _received_to(0), _host(host), _sequences(MAX_BITS_FOR_SEQ_HASH),
-    _last_active()
+  : _received_to(0), _host(host), _last_active(), _index(-1),
+    _window(WINDOW_SIZE), _held(0),
+    _arrivals(INITIAL_ARRIVALS, NULL_POINTER,
+        array<sequence_arrival>::SIMPLE_COPY),
+    _first(0), _count(0)
   {}
 
-  void clean_up(int coalesce_time) {
-    // check sequences for being right next to the highest received sequence.
-    // if they're one up, they can be collapsed without waiting for the aging
-    // process.
-    int_set ids;
-    _sequences.ids(ids);
-
-    // we restrict the size of the array with this block.
-    if (ids.elements() > MAX_ITEMS) {
-      int zap_point = ids.elements() - MAX_ITEMS;
-        // we want to remove anything before this index.
-      for (int s0 = 0; s0 < zap_point; s0++) {
-        int seq = ids[s0];
-        _sequences.zap(seq);
-        // set our received_to value from the current element.
-        if (_received_to < seq)
-          _received_to = seq;
-      }
-      // now clean the list of our ids since they're gone.
-      ids.zap(0, zap_point - 1);
-    }
+  bool seen(int sequence) const {
+    if (sequence <= _received_to) return true;
+    if (sequence - _received_to > WINDOW_SIZE) return false;
+    return _window.on(slot(sequence));
+  }
 
-    for (int s1 = 0; s1 < ids.elements(); s1++) {
-      sequence_record *seq;
-      int id = ids[s1];
-      if (!_sequences.find(id, seq)) continue;  // bad mistake going on.
-      if (_received_to + 1 == seq->_sequence) {
-        // we've hit one that can be collapsed.
-        _received_to++;
-        _sequences.zap(id);
-        ids.zap(s1, s1);
-        s1--;  // skip back before deleted item.
+  void add(int sequence, double now) {
+    if (sequence <= _received_to) return;  // already counted.
+    if (sequence == _received_to + 1) {
+      // this is just one up from our last received guy, so optimize it out.
+      _received_to = sequence;
+      collapse();
+      return;
+    }
+    if (sequence - _received_to > CLEANING_SPAN) {
+      // if the number is wildly different, assume we haven't dealt with this
+      // host for too long.
+#ifdef DEBUG_SEQUENCE_TRACKER
+      LOG("sequence is wildly different, starting host over.");
+#endif
+      restart(sequence);
+      return;
+    }
+    if (sequence - _received_to > WINDOW_SIZE) {
+      // make room in the window by giving up on the oldest sequences.
+      advance_to(sequence - WINDOW_SIZE);
+    }
+    int indy = slot(sequence);
+    if (_window.on(indy)) return;  // a duplicate.
+    _window.light(indy);
+    _held++;
+    if (_count == _arrivals.length()) {
+      if (_count < WINDOW_SIZE) grow_arrivals();
+      else {
+        // no more room to remember arrival times; coalesce the oldest.
+        int oldest = _arrivals[_first]._sequence;
+        pop_arrival();
+        advance_to(oldest);
       }
     }
+    sequence_arrival &fresh = _arrivals[(_first + _count++)
+        % _arrivals.length()];
+    fresh._sequence = sequence;
+    fresh._when = now;
+  }
 
-    // check sequence ages.  coalesce any older ones.
-    for (int s2 = 0; s2 < ids.elements(); s2++) {
-      sequence_record *seq;
-      int id = ids[s2];
-      if (!_sequences.find(id, seq)) continue;  // bad mistake going on.
-      if (seq->_when < time_stamp(-coalesce_time)) {
-        // this sequence number has floated too long; crush it now.
-        if (_received_to < seq->_sequence)
-          _received_to = seq->_sequence;  // update highest received seq.
-        _sequences.zap(id);
-      }
+  void clean_up(int coalesce_time) {
+    if (!_held) {
+      // nothing is out of order, so the arrivals are all stale.
+      _first = _count = 0;
+      return;
+    }
+    // arrivals are in time order, so only the front of the list can be old.
+    double cutoff = time_stamp(-coalesce_time).value();
+    while (_count && (_arrivals[_first]._when < cutoff)) {
+      // this sequence number has floated too long; crush it now.
+      int seq = _arrivals[_first]._sequence;
+      pop_arrival();
+      advance_to(seq);
     }
   }
 
-  astring text_form(bool verbose) {
+  int held() const { return _held; }
+
+  astring text_form(bool verbose) const {
     astring to_return;
     to_return += astring("host=") + _host.text_form()
         + a_sprintf(", rec_to=%d", _received_to)
         + ", active=" + _last_active.text_form();
     if (verbose) {
-      int_set ids;
-      _sequences.ids(ids);
-      for (int i = 0; i < ids.elements(); i++) {
-        sequence_record *found;
-        if (!_sequences.find(ids[i], found))
-          continue;  // that's a bad thing.
+      double now = time_stamp().value();
+      for (int i = 0; i < _count; i++) {
+        const sequence_arrival &curr = _arrivals[(_first + i)
+            % _arrivals.length()];
+        if (curr._sequence <= _received_to) continue;  // already coalesced.
         to_return += astring(parser_bits::platform_eol_to_chars()) + "\t"
-            + found->text_form();
+            + a_sprintf("seq=%d, age=%.0f ms", curr._sequence,
+                now - curr._when);
       }
     } else {
-      to_return += a_sprintf(", sequences held=%d", _sequences.elements());
+      to_return += a_sprintf(", sequences held=%d", _held);
     }
     return to_return;
   }
 
+private:
+  bit_vector _window;
+    // sequences received past _received_to.  a sequence's bit is at its
+    // value modulo the window size, so the window can slide without copying.
+  int _held;  // how many bits are lit in the window.
+  array<sequence_arrival> _arrivals;
+    // a ring of the sequences in the window, in the order they arrived.
+    // some of these may have been coalesced already; they're just skipped.
+  int _first;  // the ring index of the oldest arrival.
+  int _count;  // how many arrivals the ring holds.
+
+  static int slot(int sequence) { return sequence & (WINDOW_SIZE - 1); }
+
+  void collapse() {
+    // any sequences that now follow the received point can be absorbed.
+    while (_held && _window.on(slot(_received_to + 1))) {
+      _window.clear(slot(++_received_to));
+      _held--;
+    }
+  }
+
+  void advance_to(int new_received) {
+    if (new_received <= _received_to) return;
+    if (new_received - _received_to >= WINDOW_SIZE) {
+      _window.reset(WINDOW_SIZE);
+      _held = 0;
+    } else {
+      for (int seq = _received_to + 1; _held && (seq <= new_received); seq++) {
+        int indy = slot(seq);
+        if (_window.on(indy)) {
+          _window.clear(indy);
+          _held--;
+        }
+      }
+    }
+    _received_to = new_received;
+    collapse();
+  }
+
+  void restart(int sequence) {
+    _received_to = sequence;
+    _window.reset(WINDOW_SIZE);
+    _held = 0;
+    _first = _count = 0;
+  }
+
+  void pop_arrival() {
+    _first = (_first + 1) % _arrivals.length();
+    _count--;
+  }
+
+  void grow_arrivals() {
+    // unroll the ring into a larger array.
+    array<sequence_arrival> bigger(minimum(2 * _arrivals.length(), WINDOW_SIZE),
+        NULL_POINTER, array<sequence_arrival>::SIMPLE_COPY);
+    for (int i = 0; i < _count; i++)
+      bigger[i] = _arrivals[(_first + i) % _arrivals.length()];
+    _arrivals = bigger;
+    _first = 0;
+  }
 };
 
 //////////////
 
-//hmmm: should this be a hash table?
+// the hosts are found through a hash of their ids, and they are also kept
+// in a list so that cleaning can visit each of them.
 
-class host_history : public amorph<host_record>
+class host_history
 {
 public:
-  virtual ~host_history() {}
+  host_history()
+  : _table(machine_uid_hasher(), INITIAL_HOSTS),
+    _hosts(0, NULL_POINTER, array<host_record *>::SIMPLE_COPY
+        | array<host_record *>::EXPONE) {}
 
   DEFINE_CLASS_NAME("host_history");
 
-  int find_host(const machine_uid &to_find) {
-    for (int i = 0; i < elements(); i++) {
-      if (borrow(i)->_host == to_find) return i;
-    }
-    return common::NOT_FOUND;
+  int elements() const { return _hosts.length(); }
+
+  host_record *find_host(const machine_uid &to_find) const
+  { return _table.find(to_find); }
+
+  host_record *add_host(const machine_uid &to_add) {
+    host_record *rec = new host_record(to_add);
+    _table.add(to_add, rec);
+    _hosts.concatenate(rec);
+    rec->_index = _hosts.length() - 1;
+    // grow the table when it gets crowded so the buckets stay short.
+    if (_hosts.length() > 2 * _table.estimated_elements())
+      _table.rehash(2 * _hosts.length());
+    return rec;
   }
 
-  bool whack_host(const machine_uid &to_find) {
-    int indy = find_host(to_find);
-    if (negative(indy)) return false;
-    zap(indy, indy);
-    return true;
+  void whack_host(host_record *to_whack) {
+    // move the last host into the vacated spot.
+    int indy = to_whack->_index;
+    int last = _hosts.length() - 1;
+    if (indy != last) {
+      _hosts[indy] = _hosts[last];
+      _hosts[indy]->_index = indy;
+    }
+    _hosts.zap(last, last);
+    _table.zap(to_whack->_host);  // destroys the record.
   }
 
   void clean_up(int silence_time, int coalesce_time) {
-    for (int h = 0; h < elements(); h++) {
-      host_record &rec = *borrow(h);
+    time_stamp stale_point(-silence_time);
+    for (int h = 0; h < _hosts.length(); h++) {
+      host_record *rec = _hosts[h];
       // check host liveliness.
-      if (rec._last_active < time_stamp(-silence_time)) {
+      if (rec->_last_active < stale_point) {
         // this host got too stale; whack it now.
-        zap(h, h);
-        h--;  // skip back to prior element.
+        whack_host(rec);
+        h--;  // revisit the host that was moved into this spot.
         continue;
       }
-      rec.clean_up(coalesce_time);
+      rec->clean_up(coalesce_time);
     }
   }
 
-  bool add_sequence(const machine_uid &to_find, int sequence,
-      int silence_time, int coalesce_time) {
-    FUNCDEF("add_sequence");
-    int indy = find_host(to_find);
-    if (negative(indy)) {
-      host_record *rec = new host_record(to_find);
-      append(rec);
-      indy = find_host(to_find);
-      if (negative(indy)) {
-        LOG(astring("*** failure to add a host to the tracker: ")
-            + to_find.text_form());
-        return false;  // serious error.
-      }
-    }
-    host_record &rec = *borrow(indy);
-    if (borrow(indy)->_received_to + 1 == sequence) {
-      // this is just one up from our last received guy, so optimize it out.
-      rec._received_to = sequence;
-    } else if (sequence - borrow(indy)->_received_to > CLEANING_SPAN) {
-      // if the number is wildly different, assume we haven't dealt with this
-      // for too long.
-      rec._received_to = sequence;
-#ifdef DEBUG_SEQUENCE_TRACKER
-      LOG("sequence is wildly different, cleaning.");
-#endif
-      clean_up(silence_time, coalesce_time);
-    } else {
-      // standard treatment, add it to the list.
-      rec._sequences.add(sequence, new sequence_record(sequence));
-      if (rec._sequences.elements() > MAX_ITEMS) {
-        // too many sequences floating around now.  clean them up.
-        clean_up(silence_time, coalesce_time);
-      }
-    }
-    rec._last_active = time_stamp();
-    return true;
+  void add_sequence(const machine_uid &to_find, int sequence) {
+    host_record *rec = find_host(to_find);
+    if (!rec) rec = add_host(to_find);
+    rec->_last_active = time_stamp();
+    rec->add(sequence, rec->_last_active.value());
   }
 
-  astring text_form(bool verbose) {
+  astring text_form(bool verbose) const {
     astring to_return;
-    for (int i = 0; i < elements(); i++) {
-      to_return += borrow(i)->text_form(verbose);
-      if (i < elements() - 1)
+    for (int i = 0; i < _hosts.length(); i++) {
+      to_return += _hosts[i]->text_form(verbose);
+      if (i < _hosts.length() - 1)
         to_return += parser_bits::platform_eol_to_chars();
     }
     return to_return;
   }
 
+private:
+  hash_table<machine_uid, host_record> _table;  // owns the host records.
+  array<host_record *> _hosts;  // the same records, for iteration.
 };
 
 //////////////
@@ -274,21 +341,15 @@ astring sequence_tracker::text_form(bool verbose) const
 void sequence_tracker::add_pair(const machine_uid &host, int sequence)
 {
   auto_synchronizer l(*_lock);
-  if (!_hosts->add_sequence(host, sequence, _silence_time, _coalesce_time)) {
-//complain? 
-    return;
-  }
+  _hosts->add_sequence(host, sequence);
 }
 
 bool sequence_tracker::have_seen(const machine_uid &host, int sequence)
 {
   auto_synchronizer l(*_lock);
-  int indy = _hosts->find_host(host);
-  if (negative(indy)) return false;
-  host_record &rec = *_hosts->borrow(indy);
-  if (sequence <= rec._received_to) return true;
-  sequence_record *found;
-  return !!rec._sequences.find(sequence, found);
+  host_record *rec = _hosts->find_host(host);
+  if (!rec) return false;
+  return rec->seen(sequence);
 }
 
 void sequence_tracker::clean_up()
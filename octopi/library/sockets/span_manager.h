@@ -84,6 +84,9 @@ private:
 
   basis::astring funky_print(const basis::int_array &to_spew, int rec_seq) const;
     //!< prints the span holder to a string and returns it.
+
+  void make_list(basis::int_array &spans, bool received, int max_spans) const;
+    //!< creates the list of "received" spans if true, or missing ones if not.
 };
 
 } //namespace.
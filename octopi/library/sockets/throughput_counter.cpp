@@ -27,10 +27,7 @@ namespace sockets {
 throughput_counter::throughput_counter()
 : _running(false),
   _start(new time_stamp),
-  _end(new time_stamp),
-  _time_overall(0),
-  _byte_count(0),
-  _send_count(0)
+  _end(new time_stamp)
 {}
 
 throughput_counter::throughput_counter(const throughput_counter &to_copy)
@@ -54,18 +51,19 @@ throughput_counter &throughput_counter::operator =
   _running = to_copy._running;
   *_start = *to_copy._start;
   *_end = *to_copy._end;
-  _time_overall = to_copy._time_overall;
-  _byte_count = to_copy._byte_count;
-  _send_count = to_copy._send_count;
+  _totals.write(to_copy._totals.read());
   return *this;
 }
 
 void throughput_counter::combine(const throughput_counter &to_blend)
 {
   if (this == &to_blend) return;  // no, we don't like that.
-  _time_overall += to_blend._time_overall;
-  _byte_count += to_blend._byte_count;
-  _send_count += to_blend._send_count;
+  totals blending = to_blend._totals.read();
+  totals &changing = _totals.begin_write();
+  changing._time_overall += blending._time_overall;
+  changing._byte_count += blending._byte_count;
+  changing._send_count += blending._send_count;
+  _totals.end_write();
 }
 
 void throughput_counter::start()
@@ -80,7 +78,8 @@ void throughput_counter::stop()
 {
   if (!running()) return;  // better have been started before stopping.
   *_end = time_stamp();
-  _time_overall += _end->value() - _start->value();
+  _totals.begin_write()._time_overall += _end->value() - _start->value();
+  _totals.end_write();
   _running = false;
 }
 
@@ -89,40 +88,45 @@ void throughput_counter::reset()
   _running = false;
   _start->reset();
   _end->reset();
-  _time_overall = 0;
-  _byte_count = 0;
-  _send_count = 0;
+  totals cleared = { 0, 0, 0 };
+  _totals.write(cleared);
 }
 
 void throughput_counter::send(double size_of_send)
 {
   if (!running()) return;  // can't add if we're not in a run.
-  _send_count++;
-  _byte_count += size_of_send;
+  totals &changing = _totals.begin_write();
+  changing._send_count++;
+  changing._byte_count += size_of_send;
+  _totals.end_write();
 }
 
 void throughput_counter::add_run(double size_of_send, double time_of_send,
     double number_of_runs)
 {
-  _send_count += number_of_runs;
-  _byte_count += size_of_send;
-  _time_overall += time_of_send;
+  totals &changing = _totals.begin_write();
+  changing._send_count += number_of_runs;
+  changing._byte_count += size_of_send;
+  changing._time_overall += time_of_send;
+  _totals.end_write();
 }
 
 time_stamp throughput_counter::start_time() const { return *_start; }
 
 time_stamp throughput_counter::stop_time() const { return *_end; }
 
+double throughput_counter::current_run_time() const
+{ return running()? time_stamp().value() - _start->value() : 0; }
+
 double throughput_counter::total_time() const
-{
-  double extra_time = running()? time_stamp().value() - _start->value() : 0;
-  return _time_overall + extra_time;
-}
+{ return _totals.read()._time_overall + current_run_time(); }
 
 double throughput_counter::bytes_per_second() const
 {
-  double total = total_time() / SECOND_ms;
-  return double(bytes_sent()) / total;
+  // the bytes and time come from the same snapshot, so they agree.
+  totals snapshot = _totals.read();
+  double total = (snapshot._time_overall + current_run_time()) / SECOND_ms;
+  return snapshot._byte_count / total;
 }
 
 double throughput_counter::kilobytes_per_second() const
@@ -15,6 +15,7 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include <basis/seqlock.h>
 #include <timely/time_stamp.h>
 
 namespace sockets {
@@ -22,7 +23,9 @@ namespace sockets {
 //! Reports on average bandwidth of the transfers being measured.
 /*!
   Tracks the amount of data sent over a period of time and provides
-  statistics about the transfer rate.
+  statistics about the transfer rate.  The totals are kept under a seqlock,
+  so other threads can check on the statistics without any locking while
+  the sends are being recorded.
 */
 
 class throughput_counter
@@ -79,12 +82,12 @@ public:
   timely::time_stamp stop_time() const;
     //!< reports the time when this run was stopped.
 
-  double bytes_sent() const { return _byte_count; }
+  double bytes_sent() const { return _totals.read()._byte_count; }
     //!< returns the number of bytes sent so far.
     /*!< bytes_sent() and number_of_sends() work at any point during a test
     run to provide an interim measurement.  however after a test run, they
     report the statistics for the entire history of testing. */
-  double number_of_sends() const { return _send_count; }
+  double number_of_sends() const { return _totals.read()._send_count; }
     //!< returns the number of sends that have occurred.
 
   double bytes_per_second() const;
@@ -99,12 +102,20 @@ public:
     /*!< this also counts the time in the current run, if one is occurring. */
 
 private:
+  //! the accumulated statistics, which are always read as a set.
+  struct totals {
+    double _time_overall;  //!< how much time has been accumulated.
+    double _byte_count;  //!< the amount of data sent so far.
+    double _send_count;  //!< the number of times data has been sent.
+  };
+
   bool _running;  //!< true if we're currently testing.
   timely::time_stamp *_start;  //!< when the current run was started.
   timely::time_stamp *_end;  //!< when the run was stopped.
-  double _time_overall;  //!< how much time has been accumulated.
-  double _byte_count;  //!< the amount of data sent so far.
-  double _send_count;  //!< the number of times data has been sent.
+  basis::seqlock<totals> _totals;  //!< the statistics so far.
+
+  double current_run_time() const;
+    //!< the time spent in the current run, if one is occurring.
 };
 
 } //namespace.
@@ -14,11 +14,16 @@
 
 #include "bundle_list.h"
 #include "list_manager.h"
+#include "replication.h"
 
+#include <basis/array.h>
 #include <basis/astring.h>
 #include <basis/functions.h>
 #include <basis/mutex.h>
+#include <structures/hash_table.h>
 #include <structures/string_array.h>
+#include <structures/string_hasher.h>
+#include <structures/symbol_table.h>
 
 using namespace basis;
 using namespace octopi;
@@ -38,15 +43,168 @@ namespace synchronic {
 #define LOG(to_print) \
   CLASS_EMERGENCY_LOG(program_wide_logger::get(), to_print)
 
+const int INITIAL_TABLE_SIZE = 256;
+  // the number of entries we expect at first.  the table grows as needed.
+
+const int MAXIMUM_TOMBSTONES = 4096;
+  // the most deletions we remember for peers that haven't acknowledged them.
+  // if a slow peer misses a deletion that was dropped, its copy of the
+  // object will just expire there instead.
+
+//////////////
+
+// tracks one object in the list along with its position in the expiry heap.
+
+class list_entry
+{
+public:
+  synchronizable *_object;  // the real object, which we own.
+  int _heap_index;  // where this entry lives in the expiry heap.
+  int _created;  // the list version when the object was added.
+  astring _origin;  // the peer that made the last change, if not local.
+  int _origin_version;  // that peer's version stamp for the change.
+
+  list_entry(synchronizable *object)
+  : _object(object), _heap_index(-1), _created(object->_version), _origin(),
+    _origin_version(0) {}
+  ~list_entry() { WHACK(_object); }
+
+  double updated() const { return _object->_updated.value(); }
+};
+
+//////////////
+
+class classifier_table : public hash_table<string_array, list_entry>
+{
+public:
+  classifier_table()
+  : hash_table<string_array, list_entry>(string_array_hasher(),
+        INITIAL_TABLE_SIZE) {}
+};
+
+//////////////
+
+// the replication state for one peer that we send changes to.
+
+class peer_record
+{
+public:
+  int _acknowledged;  // the peer has applied all of our versions up to this.
+  bool _resync;  // true if the peer needs a full copy of the list.
+
+  peer_record() : _acknowledged(0), _resync(true) {}
+};
+
+class peer_table : public symbol_table<peer_record> {};
+
+// records the newest version from each peer that we have applied.
+
+class source_table : public symbol_table<int> {};
+
+// deletions in the order they happened, kept as ready-made records.
+
+class tombstone_list : public array<replication_record> {};
+
+//////////////
+
+// a binary min-heap of entries keyed on their last update time.  each entry
+// knows its own index in the heap, so it can be moved or removed without
+// searching for it.
+
+class expiry_heap
+{
+public:
+  expiry_heap() : _heap(0, NULL_POINTER, array<list_entry *>::SIMPLE_COPY
+      | array<list_entry *>::EXPONE) {}
+
+  int elements() const { return _heap.length(); }
+
+  list_entry *get(int index) const { return _heap[index]; }
+
+  list_entry *oldest() const
+  { return _heap.length()? _heap[0] : NULL_POINTER; }
+
+  void reset() { _heap.reset(); }
+
+  void add(list_entry *to_add) {
+    _heap.concatenate(to_add);
+    to_add->_heap_index = _heap.length() - 1;
+    sift_up(to_add->_heap_index);
+  }
+
+  void remove(list_entry *to_remove) {
+    int indy = to_remove->_heap_index;
+    int last = _heap.length() - 1;
+    if (indy != last) swap_entries(indy, last);
+    _heap.zap(last, last);
+    to_remove->_heap_index = -1;
+    if (indy < _heap.length()) adjust(_heap[indy]);
+  }
+
+  void adjust(list_entry *to_fix) {
+    // only one of these will actually move the entry.
+    sift_up(to_fix->_heap_index);
+    sift_down(to_fix->_heap_index);
+  }
+
+private:
+  array<list_entry *> _heap;
+
+  void swap_entries(int a, int b) {
+    list_entry *temp = _heap[a];
+    _heap[a] = _heap[b];
+    _heap[b] = temp;
+    _heap[a]->_heap_index = a;
+    _heap[b]->_heap_index = b;
+  }
+
+  void sift_up(int indy) {
+    while (indy > 0) {
+      int parent = (indy - 1) / 2;
+      if (_heap[parent]->updated() <= _heap[indy]->updated()) break;
+      swap_entries(parent, indy);
+      indy = parent;
+    }
+  }
+
+  void sift_down(int indy) {
+    while (true) {
+      int smallest = indy;
+      int left = 2 * indy + 1;
+      int right = left + 1;
+      if ( (left < _heap.length())
+          && (_heap[left]->updated() < _heap[smallest]->updated()) )
+        smallest = left;
+      if ( (right < _heap.length())
+          && (_heap[right]->updated() < _heap[smallest]->updated()) )
+        smallest = right;
+      if (smallest == indy) break;
+      swap_entries(smallest, indy);
+      indy = smallest;
+    }
+  }
+};
+
+//////////////
+
 list_manager::list_manager(const string_array &list_name, bool backgrounded)
 : tentacle(list_name, backgrounded),
-  _entries(new bundle_list),
-  _locking(new mutex)
+  _entries(new classifier_table),
+  _expiry(new expiry_heap),
+  _locking(new mutex),
+  _version(0),
+  _peers(new peer_table),
+  _sources(new source_table),
+  _tombstones(new tombstone_list)
 {
 }
 
 list_manager::~list_manager()
 {
+  WHACK(_tombstones);
+  WHACK(_sources);
+  WHACK(_peers);
+  WHACK(_expiry);
   WHACK(_entries);
   WHACK(_locking);
 }
@@ -56,90 +214,120 @@ const string_array &list_manager::list_name() const { return group(); }
 int list_manager::entries() const
 {
   GRAB_LOCK;
-  return _entries->elements();
+  return _expiry->elements();
+}
+
+int list_manager::version() const
+{
+  GRAB_LOCK;
+  return _version;
 }
 
 void list_manager::reset()
 {
   GRAB_LOCK;
-  _entries->zap(0, _entries->elements() - 1);
+  _expiry->reset();
+  _entries->reset();
+  // what the peers sent us is gone, so the next batch from each of them will
+  // look like it has a gap, and they'll be asked for full copies.
+  _sources->reset();
+  // every peer gets a full copy of what we have now, along with the deletions
+  // we remember.  the version keeps counting up rather than starting over,
+  // since the peers compare our versions with the ones they've already seen.
+  for (int i = 0; i < _peers->symbols(); i++) {
+    (*_peers)[i]._resync = true;
+    (*_peers)[i]._acknowledged = 0;
+  }
 }
 
 bool list_manager::is_listed(const string_array &classifier)
 {
   GRAB_LOCK;
-  int indy = locked_find(classifier);
-  return !negative(indy);
+  return !!locked_find(classifier);
 }
 
 bool list_manager::update(const string_array &classifier, int offset)
 {
   GRAB_LOCK;
-  int indy = locked_find(classifier);
-  if (negative(indy)) return false;  // not found.
-  _entries->borrow(indy)->_updated = time_stamp(offset);
+  list_entry *found = locked_find(classifier);
+  if (!found) return false;  // not found.
+  locked_touch(found, time_stamp(offset));
   return true;
 }
 
 void list_manager::clean(int older_than)
 {
   GRAB_LOCK;
-  for (int i = 0; i < _entries->elements(); i++) {
-    synchronizable *curr = _entries->borrow(i);
-    if (curr->_updated < time_stamp(-older_than)) {
-      // this one is too old to keep around.
-      _entries->zap(i, i);
-      i--;  // skip back before deleted item.
-    }
+  double cutoff = time_stamp(-older_than).value();
+  // the oldest items are at the top of the heap, so we can stop as soon as
+  // we see one that's still recent enough.
+  list_entry *curr;
+  while ( (curr = _expiry->oldest()) && (curr->updated() < cutoff) ) {
+    // this one is too old to keep around.
+    locked_zap(curr);
   }
 }
 
 bool list_manager::zap(const string_array &classifier)
 {
   GRAB_LOCK;
-  int indy = locked_find(classifier);
-  if (negative(indy)) return false;  // not found.
-  _entries->zap(indy, indy);
+  list_entry *found = locked_find(classifier);
+  if (!found) return false;  // not found.
+  locked_zap(found);
   return true;  // did find and whack it.
 }
 
-int list_manager::locked_find(const string_array &classifier)
-{
-  for (int i = 0; i < _entries->elements(); i++) {
-    // check that the classifier lengths are equal; otherwise no match.
-    if (_entries->get(i)->classifier().length() != classifier.length())
-      continue;
-    // starting from the end of most significance, we compare the strings.
-    // we don't want to bother comparing the end that's most likely to be
-    // the same for items in the list (the front, that is).
-    bool problems = false;
-    for (int j = classifier.length() - 1; j >= 0; j--) {
-      if (_entries->get(i)->classifier()[j] != classifier[j]) {
-        problems = true;
-        break;  // get out now since we're hosed.
-      }
-    }
-    if (problems) continue;  // nope, there was a mismatch.
-    // success; this guy matches.
-    return i;
-  }
-  return common::NOT_FOUND;  // not found.
+list_entry *list_manager::locked_find(const string_array &classifier)
+{ return _entries->find(classifier); }
+
+list_entry *list_manager::locked_add(synchronizable *to_add)
+{
+  list_entry *entry = new list_entry(to_add);
+  _entries->add(to_add->classifier(), entry);
+  _expiry->add(entry);
+  // grow the table when it gets crowded so the buckets stay short.
+  if (_expiry->elements() > 2 * _entries->estimated_elements())
+    _entries->rehash(2 * _expiry->elements());
+  return entry;
+}
+
+void list_manager::locked_zap(list_entry *to_whack)
+{
+  _expiry->remove(to_whack);
+  _entries->zap(to_whack->_object->classifier());
+    // destroys the entry and the object it holds.
+}
+
+void list_manager::locked_bury(list_entry *to_whack)
+{
+  const string_array &name = to_whack->_object->classifier();
+  *_tombstones += replication_record(name.subarray(list_name().length(),
+      name.length() - 1), ++_version, replication_record::REMOVED);
+  if (_tombstones->length() > MAXIMUM_TOMBSTONES)
+    _tombstones->zap(0, _tombstones->length() - MAXIMUM_TOMBSTONES - 1);
+  locked_zap(to_whack);
+}
+
+void list_manager::locked_touch(list_entry *to_touch, const time_stamp &when)
+{
+  to_touch->_object->_updated = when;
+  _expiry->adjust(to_touch);
 }
 
 synchronizable *list_manager::clone_object(const string_array &classifier)
 {
   GRAB_LOCK;
-  int indy = locked_find(classifier);
-  if (negative(indy)) return NULL_POINTER;
-  return dynamic_cast<synchronizable *>(_entries->get(indy)->clone());
+  list_entry *found = locked_find(classifier);
+  if (!found) return NULL_POINTER;
+  return dynamic_cast<synchronizable *>(found->_object->clone());
 }
 
 void list_manager::retrieve(bundle_list &to_fill) const
 {
   to_fill.reset();
   GRAB_LOCK;
-  for (int i = 0; i < _entries->elements(); i++)
-    to_fill += dynamic_cast<synchronizable *>(_entries->get(i)->clone());
+  for (int i = 0; i < _expiry->elements(); i++)
+    to_fill += dynamic_cast<synchronizable *>(_expiry->get(i)->_object->clone());
 }
 
 outcome list_manager::consume(infoton &to_chow,
@@ -159,30 +347,36 @@ outcome list_manager::consume(infoton &to_chow,
     case synchronizable::ADDED:
     case synchronizable::CHANGED: {
       // see if the item already exists; if it does, overwrite it.
-      int indy = locked_find(bun->classifier());
-      if (negative(indy)) {
+      list_entry *found = locked_find(bun->classifier());
+      if (!found) {
         // the item is new, so just drop it in the list.
-        *_entries += dynamic_cast<synchronizable *>(bun->clone());
+        synchronizable *fresh = dynamic_cast<synchronizable *>(bun->clone());
+        fresh->_version = ++_version;
+        locked_add(fresh);
       } else {
         // not a new item, so merge with the existing contents.
-        _entries->borrow(indy)->merge(*bun);
-        _entries->borrow(indy)->_updated = time_stamp();
+        found->_object->_version = ++_version;
+        found->_object->merge(*bun);
+        found->_origin.reset();
+        locked_touch(found, time_stamp());
       }
       return OKAY;
     }
     case synchronizable::DELETED: {
-      int indy = locked_find(bun->classifier());
-      if (non_negative(indy)) {
+      list_entry *found = locked_find(bun->classifier());
+      if (found) {
         // found it, so whack the entry as needed by calling merge.
-        outcome ret = _entries->borrow(indy)->merge(*bun);
-        _entries->borrow(indy)->_updated = time_stamp();
+        found->_object->_version = ++_version;
+        outcome ret = found->_object->merge(*bun);
+        found->_origin.reset();
+        locked_touch(found, time_stamp());
         if (ret == synchronizable::EMPTY) {
           // they have told us that this must go now.
 #ifdef DEBUG_LIST_MANAGER
           LOG(astring("removing entry now due to merge outcome: ")
-              + _entries->borrow(indy)->text_form());
+              + found->_object->text_form());
 #endif
-          _entries->zap(indy, indy);
+          locked_bury(found);
         }
         return OKAY;
       } else {
@@ -199,6 +393,195 @@ outcome list_manager::consume(infoton &to_chow,
   return OKAY;
 }
 
+int list_manager::replicate(const astring &source, const astring &peer,
+    replication_batch &to_fill)
+{
+  GRAB_LOCK;
+  peer_record *rec = _peers->find(peer);
+  if (!rec) {
+    // a new peer always starts out with a full copy.
+    _peers->add(peer, peer_record());
+    rec = _peers->find(peer);
+  }
+  to_fill._list_name = list_name();
+  to_fill._source = source;
+  to_fill._full = rec->_resync;
+  to_fill._from_version = rec->_resync? 0 : rec->_acknowledged;
+  to_fill._to_version = _version;
+  to_fill._records.reset();
+  int since = to_fill._from_version;
+  int prefix = list_name().length();
+
+  for (int i = 0; i < _expiry->elements(); i++) {
+    list_entry *curr = _expiry->get(i);
+    if (curr->_object->_version <= since) continue;  // they have this already.
+    // don't echo a peer's own changes back to it.
+    if (curr->_origin == peer) continue;
+    const string_array &name = curr->_object->classifier();
+    replication_record change(name.subarray(prefix, name.length() - 1),
+        curr->_object->_version, replication_record::FULL_STATE);
+    // a delta is only useful if the peer could have the object already.
+    if (!to_fill._full && (curr->_created <= since)
+        && curr->_object->pack_delta(change._payload, since)) {
+      change._kind = replication_record::DELTA;
+    } else {
+      change._payload.reset();
+      curr->_object->pack(change._payload);
+    }
+    to_fill._records += change;
+  }
+
+  // deletions are listed in version order, so only the tail is new.  a full
+  // copy starts from zero and so carries every deletion we still remember,
+  // since a peer that needs resynchronizing may have missed any of them.
+  int start = _tombstones->length();
+  while ( (start > 0) && ((*_tombstones)[start - 1]._version > since) )
+    start--;
+  for (int i = start; i < _tombstones->length(); i++) {
+    const replication_record &gone = (*_tombstones)[i];
+    if (to_fill._full) {
+      // an object that has come back since then is already in the copy.
+      string_array name = list_name();
+      name += gone._name;
+      if (locked_find(name)) continue;
+    }
+    to_fill._records += gone;
+  }
+
+  // the full copy will bring them up to date, assuming it gets there.  if it
+  // doesn't, the next batch will have a gap and they'll ask again.
+  rec->_resync = false;
+  return to_fill._records.length();
+}
+
+outcome list_manager::apply_batch(replication_batch &batch,
+    replication_ack &ack)
+{
+#ifdef DEBUG_LIST_MANAGER
+  FUNCDEF("apply_batch");
+#endif
+  ack._list_name = list_name();
+  ack._resync = false;
+  GRAB_LOCK;
+  int *applied = _sources->find(batch._source);
+  int seen = applied? *applied : 0;
+  if (!batch._full && (batch._from_version > seen)) {
+    // we never saw some of the changes that this batch builds on.
+#ifdef DEBUG_LIST_MANAGER
+    LOG(a_sprintf("gap in changes from ") + batch._source
+        + a_sprintf(": have %d, batch starts after %d.", seen,
+        batch._from_version));
+#endif
+    ack._acknowledged = seen;
+    ack._resync = true;
+    return PARTIAL;
+  }
+
+  bool missed = false;  // true if any record could not be applied.
+  for (int i = 0; i < batch._records.length(); i++) {
+    replication_record &rec = batch._records[i];
+    string_array name = list_name();
+    name += rec._name;
+    list_entry *found = locked_find(name);
+    if (found && (found->_origin == batch._source)
+        && (found->_origin_version >= rec._version))
+      continue;  // we have already applied this one.
+
+    switch (rec._kind) {
+      case replication_record::REMOVED: {
+        if (found) locked_bury(found);
+        continue;
+      }
+      case replication_record::DELTA: {
+        if (!found) {
+          // a delta is useless without the object it applies to.
+          missed = true;
+          continue;
+        }
+        found->_object->_version = ++_version;
+        if (!found->_object->merge_delta(rec._payload)) {
+          missed = true;
+          continue;
+        }
+        break;
+      }
+      case replication_record::FULL_STATE: {
+        infoton *reformed = NULL_POINTER;
+        if (reconstitute(name, rec._payload, reformed) != OKAY) {
+          missed = true;
+          continue;
+        }
+        synchronizable *bun = dynamic_cast<synchronizable *>(reformed);
+        if (!bun) {
+          WHACK(reformed);
+          missed = true;
+          continue;
+        }
+        bun->_version = ++_version;
+        if (!found) {
+          found = locked_add(bun);
+        } else {
+          found->_object->_version = bun->_version;
+          outcome ret = found->_object->merge(*bun);
+          WHACK(bun);
+          if (ret == synchronizable::EMPTY) {
+            locked_bury(found);
+            continue;
+          }
+        }
+        break;
+      }
+      default: {
+        missed = true;
+        continue;
+      }
+    }
+    found->_origin = batch._source;
+    found->_origin_version = rec._version;
+    locked_touch(found, time_stamp());
+  }
+
+  if (missed) {
+    // some objects are out of step with the sender; start over with them.
+    ack._acknowledged = seen;
+    ack._resync = true;
+    return PARTIAL;
+  }
+  if (batch._full || (batch._to_version > seen)) seen = batch._to_version;
+  if (applied) *applied = seen;
+  else _sources->add(batch._source, seen);
+  ack._acknowledged = seen;
+  return OKAY;
+}
+
+void list_manager::acknowledge(const replication_ack &ack)
+{
+  GRAB_LOCK;
+  peer_record *rec = _peers->find(ack._peer);
+  if (!rec) return;  // we never sent them anything.
+  if (ack._resync) {
+    rec->_resync = true;
+    return;
+  }
+  if (ack._acknowledged > rec->_acknowledged)
+    rec->_acknowledged = ack._acknowledged;
+  locked_trim_tombstones();
+}
+
+void list_manager::locked_trim_tombstones()
+{
+  if (!_tombstones->length() || !_peers->symbols()) return;
+  int oldest = (*_peers)[0]._acknowledged;
+  for (int i = 1; i < _peers->symbols(); i++)
+    oldest = minimum(oldest, (*_peers)[i]._acknowledged);
+  // everyone has seen the deletions up to the "oldest" acknowledgement.
+  int keep = 0;
+  while ( (keep < _tombstones->length())
+      && ((*_tombstones)[keep]._version <= oldest) )
+    keep++;
+  if (keep) _tombstones->zap(0, keep - 1);
+}
+
 void list_manager::expunge(const octopus_entity &formal(to_remove))
 {
   FUNCDEF("expunge");
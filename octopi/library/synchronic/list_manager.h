@@ -16,19 +16,40 @@
 \*****************************************************************************/
 
 #include <octopus/tentacle.h>
+#include <timely/time_stamp.h>
 
 namespace synchronic {
 
 // forward.
 class synchronizable;
 class bundle_list;
+class classifier_table;
+class expiry_heap;
+class list_entry;
+class peer_table;
+class replication_ack;
+class replication_batch;
+class source_table;
+class tombstone_list;
 
 //! Supports distributed management of a list of object states.
 /*!
   An object may have a collection of attributes which are important to keep
   up to date.  The list_manager provides a means to keep that information
   relevant given periodic updates to the state information by the entity in
-  charge of the actual object.                                          
+  charge of the actual object.
+
+  Entries are indexed by a hash of their classifiers, so finding an object
+  costs the same no matter how many are listed.  They are also kept in a heap
+  ordered by their last update time, which allows clean() to visit only the
+  entries that have actually expired.
+
+  Every change made through consume() bumps the list's version counter and
+  stamps the changed object with it.  Replication to peers uses those stamps:
+  replicate() gathers everything a peer has not acknowledged yet into a
+  single batch, using the objects' deltas where they support them, and
+  apply_batch() merges such a batch on the receiving side.  Objects removed
+  by clean() or zap() are not replicated; each side expires its own entries.
 */
 
 class list_manager : public octopi::tentacle
@@ -59,7 +80,7 @@ public:
 
   void clean(int older_than);
     // flushes out any items that haven't been updated in "older_than"
-    // microseconds.
+    // milliseconds.
 
   synchronizable *clone_object(const structures::string_array &classifier);
     // returns a clone of the object listed for "classifier" or NULL_POINTER if there
@@ -73,7 +94,34 @@ public:
     // loads "to_fill" with a copy of the current set of attribute bundles.
 
   void reset();
-    // wipes out all objects that used to be listed.
+    // wipes out all objects that used to be listed.  the replication starts
+    // over too: each peer is sent a full copy next, and each peer is asked
+    // for a full copy when its next batch shows up.
+
+  int version() const;
+    // returns the list's change counter.  this increases with every change
+    // made through consume() or applied from a replication batch.
+
+  // replication support.  both sides of a replication are named, normally
+  // by the name of the octopus that holds the list.
+
+  int replicate(const basis::astring &source, const basis::astring &peer,
+          replication_batch &to_fill);
+    // fills "to_fill" with every change that the "peer" has not acknowledged
+    // yet.  our own side is called "source".  objects that support deltas
+    // only send the attributes that changed, while new objects and peers that
+    // need resynchronizing get full copies.  a full copy also lists the
+    // remembered deletions of objects that we no longer hold, so that a peer
+    // that missed them can drop its copies.  returns the number of records.
+
+  basis::outcome apply_batch(replication_batch &batch, replication_ack &ack);
+    // merges the changes in a "batch" from a peer and fills in the "ack"
+    // (apart from the ack's peer name).  the records in the "batch" are
+    // consumed.  PARTIAL is returned if the batch relies on changes that we
+    // never received; the "ack" will ask the sender for a full resync then.
+
+  void acknowledge(const replication_ack &ack);
+    // records how far the peer named in the "ack" has gotten with our changes.
 
   virtual basis::outcome consume(octopi::infoton &to_chow,
           const octopi::octopus_request_id &item_id,
@@ -90,12 +138,33 @@ public:
     // cleans out any items held for the entity "to_remove".
 
 private:
-  bundle_list *_entries;  // the set of elements that make up our list.
+  classifier_table *_entries;  // the elements of our list by classifier.
+  expiry_heap *_expiry;  // the same elements, oldest update first.
   basis::mutex *_locking;  // protects our contents.
+  int _version;  // the list-wide change counter.
+  peer_table *_peers;  // what each peer has acknowledged from us.
+  source_table *_sources;  // how far we've applied each peer's changes.
+  tombstone_list *_tombstones;  // deletions that peers might not have seen.
 
-  int locked_find(const structures::string_array &classifier);
+  list_entry *locked_find(const structures::string_array &classifier);
     // locates the item with the "classifier" in this list.  if it's present,
-    // a non-negative index number is returned.
+    // the entry is returned; otherwise NULL_POINTER is returned.
+
+  list_entry *locked_add(synchronizable *to_add);
+    // stores the new object "to_add", which we now own.
+
+  void locked_bury(list_entry *to_whack);
+    // removes "to_whack" like locked_zap(), but remembers the deletion so
+    // that it can be replicated.
+
+  void locked_trim_tombstones();
+    // drops deletions that every peer has acknowledged.
+
+  void locked_zap(list_entry *to_whack);
+    // removes the entry "to_whack" from the list and destroys it.
+
+  void locked_touch(list_entry *to_touch, const timely::time_stamp &when);
+    // sets the update time of "to_touch" to "when" and fixes the heap.
 };
 
 } //namespace.
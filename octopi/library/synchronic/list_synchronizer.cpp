@@ -14,11 +14,14 @@
 
 #include "list_manager.h"
 #include "list_synchronizer.h"
+#include "replication.h"
 
+#include <octopus/tentacle_helper.h>
 #include <structures/string_array.h>
 #include <textual/string_manipulation.h>
 
 using namespace basis;
+using namespace octopi;
 using namespace structures;
 using namespace textual;
 
@@ -27,9 +30,56 @@ namespace synchronic {
 const int MAX_PER_ENT = 10 * MEGABYTE;
   // our arbitrary limit for how much we allow the entity data bin to store.
 
+//////////////
+
+// handles the replication infotons on behalf of the synchronizer.
+
+class replication_tentacle : public tentacle
+{
+public:
+  replication_tentacle(list_synchronizer &parent)
+  : tentacle(replication_ack::replication_group(), false), _parent(parent) {}
+
+  DEFINE_CLASS_NAME("replication_tentacle");
+
+  virtual outcome reconstitute(const string_array &classifier,
+      byte_array &packed_form, infoton * &reformed) {
+    if (classifier == replication_batch::replication_batch_classifier())
+      return reconstituter(classifier, packed_form, reformed,
+          (replication_batch *)NULL_POINTER);
+    if (classifier == replication_ack::replication_ack_classifier())
+      return reconstituter(classifier, packed_form, reformed,
+          (replication_ack *)NULL_POINTER);
+    return NO_HANDLER;
+  }
+
+  virtual outcome consume(infoton &to_chow, const octopus_request_id &item_id,
+      byte_array &transformed) {
+    transformed.reset();
+    replication_batch *batch = dynamic_cast<replication_batch *>(&to_chow);
+    if (batch) {
+      replication_ack *ack = new replication_ack;
+      outcome to_return = _parent.apply_batch(*batch, *ack);
+      store_product(ack, item_id);
+      return to_return;
+    }
+    replication_ack *ack = dynamic_cast<replication_ack *>(&to_chow);
+    if (ack) return _parent.acknowledge(*ack);
+    return NO_HANDLER;
+  }
+
+  virtual void expunge(const octopus_entity &formal(to_remove)) {}
+
+private:
+  list_synchronizer &_parent;
+};
+
+//////////////
+
 list_synchronizer::list_synchronizer()
 : octopus(string_manipulation::make_random_name(), MAX_PER_ENT)
 {
+  add_tentacle(new replication_tentacle(*this));
 }
 
 list_synchronizer::~list_synchronizer()
@@ -59,6 +109,51 @@ bool list_synchronizer::update(const string_array &object_id)
   return to_return;
 }
 
+outcome list_synchronizer::replicate(const string_array &list_name,
+    const astring &peer, replication_batch &to_fill)
+{
+  tentacle *found = lock_tentacle(list_name);
+  list_manager *t = dynamic_cast<list_manager *>(found);
+  if (!t) {
+    if (found) unlock_tentacle(found);
+    return common::NOT_FOUND;
+  }
+  t->replicate(name(), peer, to_fill);
+  unlock_tentacle(t);
+  return common::OKAY;
+}
+
+outcome list_synchronizer::apply_batch(replication_batch &batch,
+    replication_ack &ack)
+{
+  ack._peer = name();
+  tentacle *found = lock_tentacle(batch._list_name);
+  list_manager *t = dynamic_cast<list_manager *>(found);
+  if (!t) {
+    if (found) unlock_tentacle(found);
+    ack._list_name = batch._list_name;
+    ack._acknowledged = 0;
+    ack._resync = false;
+    return common::NOT_FOUND;
+  }
+  outcome to_return = t->apply_batch(batch, ack);
+  unlock_tentacle(t);
+  return to_return;
+}
+
+outcome list_synchronizer::acknowledge(const replication_ack &ack)
+{
+  tentacle *found = lock_tentacle(ack._list_name);
+  list_manager *t = dynamic_cast<list_manager *>(found);
+  if (!t) {
+    if (found) unlock_tentacle(found);
+    return common::NOT_FOUND;
+  }
+  t->acknowledge(ack);
+  unlock_tentacle(t);
+  return common::OKAY;
+}
+
 void list_synchronizer::clean(int older_than)
 {
   lock_tentacles();
@@ -25,6 +25,17 @@ namespace synchronic {
 
 // forward.
 class list_manager;
+class replication_ack;
+class replication_batch;
+
+//! Holds a set of list_managers and keeps them in step with other copies.
+/*!
+  Lists can be replicated to peer synchronizers in batches.  Each side is
+  known by its octopus name().  Batches and acknowledgements can either be
+  passed along directly with the methods below or fed to evaluate() as
+  infotons, in which case the acknowledgement for a batch is stored as the
+  response to that request.
+*/
 
 class list_synchronizer : public octopi::octopus
 {
@@ -45,6 +56,19 @@ public:
 
   bool update(const structures::string_array &object_id);
     // marks the item specified by the "object_id" as updated.
+
+  basis::outcome replicate(const structures::string_array &list_name,
+          const basis::astring &peer, replication_batch &to_fill);
+    // fills "to_fill" with the changes to the list called "list_name" that
+    // the synchronizer named "peer" has not acknowledged yet.  NOT_FOUND is
+    // returned if there is no such list.
+
+  basis::outcome apply_batch(replication_batch &batch, replication_ack &ack);
+    // merges a "batch" from another synchronizer into our copy of its list
+    // and fills in the "ack" that should be sent back to the sender.
+
+  basis::outcome acknowledge(const replication_ack &ack);
+    // records that a peer has applied the changes described by the "ack".
 };
 
 }
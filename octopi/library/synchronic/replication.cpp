@@ -0,0 +1,214 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : replication_batch, replication_ack                                *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "replication.h"
+
+#include <basis/mutex.h>
+#include <structures/object_packers.h>
+#include <structures/static_memory_gremlin.h>
+
+using namespace basis;
+using namespace octopi;
+using namespace structures;
+
+namespace synchronic {
+
+replication_record::replication_record()
+: _name(), _version(0), _kind(FULL_STATE), _payload()
+{}
+
+replication_record::replication_record(const string_array &name, int version,
+    kinds kind)
+: _name(name), _version(version), _kind(abyte(kind)), _payload()
+{}
+
+int replication_record::packed_size() const
+{
+  return _name.packed_size() + sizeof(int) + sizeof(abyte)
+      + structures::packed_size(_payload);
+}
+
+void replication_record::pack(byte_array &packed_form) const
+{
+  _name.pack(packed_form);
+  attach(packed_form, _version);
+  attach(packed_form, _kind);
+  attach(packed_form, _payload);
+}
+
+bool replication_record::unpack(byte_array &packed_form)
+{
+  if (!_name.unpack(packed_form)) return false;
+  if (!detach(packed_form, _version)) return false;
+  if (!detach(packed_form, _kind)) return false;
+  if (!detach(packed_form, _payload)) return false;
+  return true;
+}
+
+//////////////
+
+const char *replication_group_strings[] = { "#synchronic" };
+const char *replication_batch_strings[] = { "#synchronic", "batch" };
+const char *replication_ack_strings[] = { "#synchronic", "ack" };
+
+SAFE_STATIC_CONST(string_array, replication_ack::replication_group,
+    (1, replication_group_strings))
+SAFE_STATIC_CONST(string_array, replication_batch::replication_batch_classifier,
+    (2, replication_batch_strings))
+SAFE_STATIC_CONST(string_array, replication_ack::replication_ack_classifier,
+    (2, replication_ack_strings))
+
+//////////////
+
+replication_batch::replication_batch()
+: infoton(replication_batch_classifier()),
+  _list_name(),
+  _source(),
+  _from_version(0),
+  _to_version(0),
+  _full(false),
+  _records()
+{}
+
+replication_batch::replication_batch(const replication_batch &to_copy)
+: root_object(),
+  infoton(to_copy),
+  _list_name(to_copy._list_name),
+  _source(to_copy._source),
+  _from_version(to_copy._from_version),
+  _to_version(to_copy._to_version),
+  _full(to_copy._full),
+  _records(to_copy._records)
+{}
+
+replication_batch::~replication_batch() {}
+
+replication_batch &replication_batch::operator =
+    (const replication_batch &to_copy)
+{
+  if (this == &to_copy) return *this;
+  set_classifier(to_copy.classifier());
+  _list_name = to_copy._list_name;
+  _source = to_copy._source;
+  _from_version = to_copy._from_version;
+  _to_version = to_copy._to_version;
+  _full = to_copy._full;
+  _records = to_copy._records;
+  return *this;
+}
+
+clonable *replication_batch::clone() const
+{ return cloner<replication_batch>(*this); }
+
+void replication_batch::text_form(base_string &fill) const
+{
+  fill.assign(a_sprintf("list=%s source=%s versions=%d-%d%s records=%d",
+      _list_name.text_form().s(), _source.s(), _from_version, _to_version,
+      _full? " (full)" : "", _records.length()));
+}
+
+int replication_batch::packed_size() const
+{
+  return _list_name.packed_size() + _source.packed_size() + 2 * sizeof(int)
+      + sizeof(abyte) + packed_size_array(_records);
+}
+
+void replication_batch::pack(byte_array &packed_form) const
+{
+  _list_name.pack(packed_form);
+  _source.pack(packed_form);
+  attach(packed_form, _from_version);
+  attach(packed_form, _to_version);
+  attach(packed_form, _full);
+  pack_array(packed_form, _records);
+}
+
+bool replication_batch::unpack(byte_array &packed_form)
+{
+  if (!_list_name.unpack(packed_form)) return false;
+  if (!_source.unpack(packed_form)) return false;
+  if (!detach(packed_form, _from_version)) return false;
+  if (!detach(packed_form, _to_version)) return false;
+  if (!detach(packed_form, _full)) return false;
+  if (!unpack_array(packed_form, _records)) return false;
+  return true;
+}
+
+//////////////
+
+replication_ack::replication_ack()
+: infoton(replication_ack_classifier()),
+  _list_name(),
+  _peer(),
+  _acknowledged(0),
+  _resync(false)
+{}
+
+replication_ack::replication_ack(const replication_ack &to_copy)
+: root_object(),
+  infoton(to_copy),
+  _list_name(to_copy._list_name),
+  _peer(to_copy._peer),
+  _acknowledged(to_copy._acknowledged),
+  _resync(to_copy._resync)
+{}
+
+replication_ack::~replication_ack() {}
+
+replication_ack &replication_ack::operator =(const replication_ack &to_copy)
+{
+  if (this == &to_copy) return *this;
+  set_classifier(to_copy.classifier());
+  _list_name = to_copy._list_name;
+  _peer = to_copy._peer;
+  _acknowledged = to_copy._acknowledged;
+  _resync = to_copy._resync;
+  return *this;
+}
+
+clonable *replication_ack::clone() const
+{ return cloner<replication_ack>(*this); }
+
+void replication_ack::text_form(base_string &fill) const
+{
+  fill.assign(a_sprintf("list=%s peer=%s acknowledged=%d%s",
+      _list_name.text_form().s(), _peer.s(), _acknowledged,
+      _resync? " (needs resync)" : ""));
+}
+
+int replication_ack::packed_size() const
+{
+  return _list_name.packed_size() + _peer.packed_size() + sizeof(int)
+      + sizeof(abyte);
+}
+
+void replication_ack::pack(byte_array &packed_form) const
+{
+  _list_name.pack(packed_form);
+  _peer.pack(packed_form);
+  attach(packed_form, _acknowledged);
+  attach(packed_form, _resync);
+}
+
+bool replication_ack::unpack(byte_array &packed_form)
+{
+  if (!_list_name.unpack(packed_form)) return false;
+  if (!_peer.unpack(packed_form)) return false;
+  if (!detach(packed_form, _acknowledged)) return false;
+  if (!detach(packed_form, _resync)) return false;
+  return true;
+}
+
+} //namespace.
+
@@ -0,0 +1,134 @@
+#ifndef REPLICATION_CLASSES
+#define REPLICATION_CLASSES
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : replication_batch, replication_ack                                *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/array.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <octopus/infoton.h>
+#include <structures/string_array.h>
+
+namespace synchronic {
+
+//! One object's change as carried inside a replication_batch.
+/*!
+  The classifier is stored without the list name prefix, since the batch
+  already records which list it belongs to.
+*/
+
+class replication_record : public virtual basis::packable
+{
+public:
+  enum kinds {
+    FULL_STATE,  //!< the payload is the object's complete packed form.
+    DELTA,  //!< the payload came from the object's pack_delta().
+    REMOVED  //!< the object was deleted; there is no payload.
+  };
+
+  structures::string_array _name;  //!< the classifier minus the list name.
+  int _version;  //!< the sender's version stamp for the object.
+  basis::abyte _kind;  //!< one of the kinds above.
+  basis::byte_array _payload;  //!< the object state or delta.
+
+  replication_record();
+  replication_record(const structures::string_array &name, int version,
+          kinds kind);
+
+  DEFINE_CLASS_NAME("replication_record");
+
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+//////////////
+
+//! Carries all of the changes to a list since a peer's last acknowledgement.
+/*!
+  A batch covers the sender's versions after "_from_version" up to and
+  including "_to_version".  If "_full" is set, then the batch holds the full
+  state of every object in the list, plus a removal for each deletion that
+  the sender still remembers, and it can be applied no matter what the
+  receiver has seen before.  Otherwise the receiver must already have applied
+  everything up to "_from_version" from this source, or the batch is refused
+  and a full resync is requested in the acknowledgement.
+*/
+
+class replication_batch : public octopi::infoton
+{
+public:
+  structures::string_array _list_name;  //!< the list the changes are for.
+  basis::astring _source;  //!< the name of the sending synchronizer.
+  int _from_version;  //!< the receiver must have applied this version.
+  int _to_version;  //!< the newest version held in this batch.
+  bool _full;  //!< true if this is a complete copy of the list.
+  basis::array<replication_record> _records;  //!< the changed objects.
+
+  replication_batch();
+  replication_batch(const replication_batch &to_copy);
+  virtual ~replication_batch();
+
+  DEFINE_CLASS_NAME("replication_batch");
+
+  replication_batch &operator =(const replication_batch &to_copy);
+
+  static const structures::string_array &replication_batch_classifier();
+    //!< returns the classifier for this type of infoton.
+
+  virtual void text_form(basis::base_string &fill) const;
+  virtual basis::clonable *clone() const;
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+//////////////
+
+//! The receiver's answer to a replication_batch.
+
+class replication_ack : public octopi::infoton
+{
+public:
+  structures::string_array _list_name;  //!< the list that was updated.
+  basis::astring _peer;  //!< the name of the receiving synchronizer.
+  int _acknowledged;  //!< all sender versions up to this have been applied.
+  bool _resync;  //!< true if the receiver needs a full copy of the list.
+
+  replication_ack();
+  replication_ack(const replication_ack &to_copy);
+  virtual ~replication_ack();
+
+  DEFINE_CLASS_NAME("replication_ack");
+
+  replication_ack &operator =(const replication_ack &to_copy);
+
+  static const structures::string_array &replication_ack_classifier();
+    //!< returns the classifier for this type of infoton.
+
+  static const structures::string_array &replication_group();
+    //!< the group shared by the batch and ack classifiers.
+
+  virtual void text_form(basis::base_string &fill) const;
+  virtual basis::clonable *clone() const;
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+} //namespace.
+
+#endif
+
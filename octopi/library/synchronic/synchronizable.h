@@ -48,7 +48,15 @@ public:
     // when this information was last updated.  this should not be packed,
     // since it is only locally relevant.
 
-  synchronizable(const structures::string_array &object_id) : infoton(object_id) {}
+  int _version;
+    // the list's change counter as of the last modification to this object.
+    // the list_manager stamps this just before it calls merge() or
+    // merge_delta(), so a derived object can record which version each of
+    // its attributes changed in.  this is not packed either; replication
+    // batches carry it alongside the object.
+
+  synchronizable(const structures::string_array &object_id)
+  : infoton(object_id), _version(0) {}
     // constructs the base portion of an attribute bundle for an object with
     // the "object_id".  the "object_id" must follow the rules for infoton
     // classifiers.  the last string in the object id is the list-unique
@@ -73,6 +81,18 @@ public:
   virtual basis::astring text_form() const = 0;
     // provides a visual form of the data held in this bundle.
 
+  virtual bool pack_delta(basis::byte_array &formal(packed_form),
+          int formal(since_version)) const { return false; }
+    // optionally stores only the attributes that changed after the version
+    // "since_version" into "packed_form".  replication uses this to avoid
+    // shipping the whole object to peers that already have most of it.  the
+    // default returns false, which means the full object is always sent.
+
+  virtual bool merge_delta(basis::byte_array &formal(packed_form))
+          { return false; }
+    // applies a delta that was created by pack_delta() on a peer.  this
+    // must be provided if pack_delta() is; false means the delta was garbage.
+
   // promote requirements of the infoton to derived objects.
   virtual void pack(basis::byte_array &packed_form) const = 0;
   virtual bool unpack(basis::byte_array &packed_form) = 0;
@@ -84,10 +104,10 @@ public:
 
 // implementations.
 
-void synchronizable::pack_mod(basis::byte_array &packed_form) const
+inline void synchronizable::pack_mod(basis::byte_array &packed_form) const
 { structures::attach(packed_form, int(_mod)); }
 
-bool synchronizable::unpack_mod(basis::byte_array &packed_form)
+inline bool synchronizable::unpack_mod(basis::byte_array &packed_form)
 {
   int temp;
   if (!structures::detach(packed_form, temp)) return false;
@@ -0,0 +1,94 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : chunk_compressor                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "chunk_compressor.h"
+
+#include <basis/functions.h>
+
+#include <zlib.h>
+
+using namespace basis;
+
+namespace octopi {
+
+// the zlib level used for each of our codecs.
+static int zlib_level(int codec)
+{
+  switch (codec) {
+    case chunk_compressor::ZLIB_FAST: return Z_BEST_SPEED;
+    case chunk_compressor::ZLIB_BEST: return Z_DEFAULT_COMPRESSION;
+    default: return Z_NO_COMPRESSION;
+  }
+}
+
+bool chunk_compressor::valid_codec(int codec)
+{ return (codec >= RAW) && (codec <= LAST_CODEC); }
+
+const char *chunk_compressor::codec_name(int codec)
+{
+  switch (codec) {
+    case RAW: return "raw";
+    case ZLIB_FAST: return "zlib-fast";
+    case ZLIB_BEST: return "zlib-best";
+    default: return "unknown";
+  }
+}
+
+bool chunk_compressor::worth_compressing(const byte_array &data)
+{
+  if (data.length() < MINIMUM_SIZE) return false;
+  int sample = minimum(int(SAMPLE_SIZE), data.length());
+  int start = (data.length() - sample) / 2;
+  uLongf packed_length = compressBound(sample);
+  byte_array packed((int)packed_length);
+  if (compress2((Bytef *)packed.access(), &packed_length,
+      (const Bytef *)data.observe() + start, sample, Z_BEST_SPEED) != Z_OK)
+    return false;
+  return int(packed_length) * 100 <= sample * WORTHWHILE_PERCENT;
+}
+
+int chunk_compressor::compress(int codec, byte_array &data)
+{
+  if ( (codec == RAW) || !valid_codec(codec) || !worth_compressing(data) )
+    return RAW;
+  uLongf packed_length = compressBound(data.length());
+  byte_array packed((int)packed_length);
+  if (compress2((Bytef *)packed.access(), &packed_length,
+      (const Bytef *)data.observe(), data.length(), zlib_level(codec)) != Z_OK)
+    return RAW;
+  // the sample can be misleading, so make sure we really saved something.
+  if (int(packed_length) >= data.length()) return RAW;
+  packed.zap(int(packed_length), packed.length() - 1);
+  data = packed;
+  return codec;
+}
+
+bool chunk_compressor::decompress(int codec, int original_size, byte_array &data)
+{
+  if (codec == RAW) return true;
+  if (!valid_codec(codec) || negative(original_size)
+      || (original_size > MAXIMUM_ORIGINAL) )
+    return false;
+  byte_array expanded(original_size);
+  uLongf expanded_length = original_size;
+  if (uncompress((Bytef *)expanded.access(), &expanded_length,
+      (const Bytef *)data.observe(), data.length()) != Z_OK)
+    return false;
+  if (int(expanded_length) != original_size) return false;
+  data = expanded;
+  return true;
+}
+
+} //namespace.
+
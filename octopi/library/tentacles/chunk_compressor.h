@@ -0,0 +1,81 @@
+#ifndef CHUNK_COMPRESSOR_CLASS
+#define CHUNK_COMPRESSOR_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : chunk_compressor                                                  *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/byte_array.h>
+#include <basis/contracts.h>
+#include <basis/definitions.h>
+
+namespace octopi {
+
+//! Compresses the chunks of a pipelined file transfer.
+/*!
+  The destination names the codec it would like in each file_chunk_ticket,
+  and the source answers with the codec that it actually used.  A source
+  that doesn't know the codec asked for, or that finds the chunk doesn't
+  shrink enough to be worth it, just sends the chunk raw.  The codec numbers
+  are part of the protocol; new ones must be added at the end.
+*/
+
+class chunk_compressor : public virtual basis::root_object
+{
+public:
+  enum codecs {
+    RAW = 0,  //!< the chunk is sent as it is.
+    ZLIB_FAST = 1,  //!< zlib at its fastest level, for quick links.
+    ZLIB_BEST = 2,  //!< zlib at its default level, for slow links.
+    LAST_CODEC = ZLIB_BEST  //!< the highest codec known here.
+  };
+
+  enum compressor_limits {
+    SAMPLE_SIZE = 4 * basis::KILOBYTE,
+      //!< how much of a chunk is tried before compressing all of it.
+    MINIMUM_SIZE = 512,  //!< smaller chunks are never compressed.
+    WORTHWHILE_PERCENT = 90,
+      //!< the sample must shrink to this percentage of its size, or less.
+    MAXIMUM_ORIGINAL = 256 * basis::MEGABYTE
+      //!< the largest chunk that will be expanded, to catch bad input.
+  };
+
+  DEFINE_CLASS_NAME("chunk_compressor");
+
+  static bool valid_codec(int codec);
+    //!< true if the "codec" is one that this side can handle.
+
+  static const char *codec_name(int codec);
+    //!< returns a printable name for the "codec".
+
+  static bool worth_compressing(const basis::byte_array &data);
+    //!< quickly checks whether compressing "data" is likely to pay off.
+    /*!< only a sample from the middle of the "data" is compressed, so data
+    that's already compressed or random is spotted without reading it all. */
+
+  static int compress(int codec, basis::byte_array &data);
+    //!< compresses the "data" in place using the "codec" requested.
+    /*!< the codec actually used is returned; if that's RAW, then the "data"
+    has been left alone. */
+
+  static bool decompress(int codec, int original_size, basis::byte_array &data);
+    //!< expands the "data" in place, which was compressed with the "codec".
+    /*!< the "original_size" is the length that "data" had before it was
+    compressed.  false is returned if the "data" does not expand to exactly
+    that size.  RAW data is left as it is. */
+};
+
+} //namespace.
+
+#endif
+
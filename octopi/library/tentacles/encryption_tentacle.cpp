@@ -65,6 +65,15 @@ encryption_tentacle::encryption_tentacle(int key_size)
 {
 }
 
+encryption_tentacle::encryption_tentacle(rsa_crypto *private_key)
+: tentacle_helper<encryption_infoton>
+    (encryption_infoton::encryption_classifier(), false),
+  _server_side(false),
+  _keys(new key_repository),
+  _rsa_private(private_key)
+{
+}
+
 encryption_tentacle::~encryption_tentacle()
 {
   WHACK(_rsa_private);
@@ -56,6 +56,12 @@ public:
     //!< automatically creates a private key of the "key_size".
     /*!< this is for use by the client side's encryption needs. */
 
+  encryption_tentacle(crypto::rsa_crypto *private_key);
+    //!< a client side tentacle that takes over the existing "private_key".
+    /*!< this allows a key from the rsa_key_pool to be used without paying
+    for key generation at connection time.  the tentacle will destroy the
+    "private_key" when it is destroyed. */
+
   virtual ~encryption_tentacle();
 
   DEFINE_CLASS_NAME("encryption_tentacle");
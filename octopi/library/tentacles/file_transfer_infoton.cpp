@@ -15,6 +15,10 @@
 #include "file_transfer_infoton.h"
 
 #include <basis/mutex.h>
+#include <filesystem/file_delta.h>
+#include <filesystem/filename.h>
+#include <filesystem/filename_list.h>
+#include <structures/object_packers.h>
 #include <structures/string_array.h>
 #include <structures/static_memory_gremlin.h>
 
@@ -79,6 +83,61 @@ void file_transfer_infoton::package_tree_info(const directory_tree &tree,
   includes.pack(_packed_data);
 }
 
+int file_transfer_infoton::package_signatures(const filename_list &diffs)
+{
+  _packed_data.reset();
+  signature_list signatures;
+  for (int i = 0; i < diffs.elements(); i++) {
+    const file_info *curr = diffs.get(i);
+    // the destination's name for the file is held in the secondary name.
+    astring full_file = _dest_root + filename::default_separator()
+        + curr->secondary();
+    filename target(full_file);
+    if (!target.exists() || target.is_directory() || !target.is_normal())
+      continue;
+    file_signature *sig = new file_signature;
+    if (!sig->compute(full_file, curr->raw())
+        || (sig->_file_size < MINIMUM_DELTA_FILE)) {
+      WHACK(sig);
+      continue;
+    }
+    signatures.append(sig);
+  }
+  signatures.pack(_packed_data);
+  return signatures.elements();
+}
+
+int file_chunk_ticket::packed_size() const
+{
+  return 4 * sizeof(int) + 2 * sizeof(abyte)
+      + 2 * sizeof(int) + _received.length() * sizeof(int);
+}
+
+void file_chunk_ticket::pack(byte_array &packed_form) const
+{
+  attach(packed_form, _sequence);
+  attach(packed_form, _chunk_size);
+  attach(packed_form, _window);
+  attach(packed_form, abyte(_finished));
+  attach(packed_form, _codec);
+  attach(packed_form, _original_size);
+  pack_simple(packed_form, _received);
+}
+
+bool file_chunk_ticket::unpack(byte_array &packed_form)
+{
+  abyte finished;
+  if (!detach(packed_form, _sequence) || !detach(packed_form, _chunk_size)
+      || !detach(packed_form, _window) || !detach(packed_form, finished)
+      || !detach(packed_form, _codec) || !detach(packed_form, _original_size)
+      || !unpack_simple(packed_form, _received))
+    return false;
+  _finished = !!finished;
+  return true;
+}
+
+//////////////
+
 void file_transfer_infoton::pack(byte_array &packed_form) const
 {
   attach(packed_form, _success.value());
@@ -21,6 +21,38 @@
 
 namespace octopi {
 
+//! Identifies a chunk within a pipelined transfer (see PIPELINED_CHUNKS).
+
+class file_chunk_ticket : public basis::packable
+{
+public:
+  int _sequence;  //!< which chunk of the transfer this is, starting at zero.
+  int _chunk_size;  //!< the most bytes the destination wants in the chunk.
+  int _window;  //!< how many chunks the destination keeps outstanding.
+  bool _finished;  //!< set in a response when nothing was left to send.
+    /*!< in a request, it says the destination has stored the whole transfer,
+    so the source can drop the chunks it was keeping for it. */
+  basis::abyte _codec;
+    //!< the chunk_compressor codec wanted in a request, or used in a response.
+  int _original_size;  //!< a response's chunk size before it was compressed.
+  basis::int_array _received;
+    //!< the spans of chunks that the destination has already stored.
+    /*!< this is in the form made by sockets::span_manager, and it lets the
+    source forget those chunks. */
+
+  file_chunk_ticket(int sequence = 0, int chunk_size = 0, int window = 0)
+  : _sequence(sequence), _chunk_size(chunk_size), _window(window),
+    _finished(false), _codec(0), _original_size(0) {}
+
+  DEFINE_CLASS_NAME("file_chunk_ticket");
+
+  virtual int packed_size() const;
+  virtual void pack(basis::byte_array &packed_form) const;
+  virtual bool unpack(basis::byte_array &packed_form);
+};
+
+//////////////
+
 //! Base objects used by the file transfer tentacle to schedule transfers.
 /*!
   Note: this is a fairly heavy-weight header.
@@ -47,15 +79,40 @@ public:
       /*!< this is based on the source's memory of where the transfer is at.
       this will only perform properly when the file transfer was requested to
       be started by the client using a TREE_COMPARISON request.  the request
-      has an empty data chunk, but the response consists of an arbitrary
-      number of pairs of @code
+      usually has an empty data chunk, but the response consists of an
+      arbitrary number of pairs of @code
       [ file_transfer_header + file chunk described in header ]
-      @endcode */
+      @endcode
+      if some deltas could not be applied at the destination, the request
+      holds a packed string_array of those files, and the source will send
+      them again whole. */
     CONCLUDE_TRANSFER_MARKER = 3,
       //!< this infoton marks the end of the transfer process.
       /*!< we've added this type of transfer infoton to handle the finish
       of the transfer.  previously this was marked by a null data packet,
       which turns out to be a really bad idea. */
+    FILE_SIGNATURES = 5,
+      //!< the destination offers block signatures for files it already has.
+      /*!< this optional step comes after the TREE_COMPARISON.  the request
+      holds a packed filesystem::signature_list for the differing files that
+      exist on the destination.  the response holds a packed string_array of
+      the files that the source agreed to send as deltas; the chunks for
+      those files are delta pieces rather than plain file contents. */
+    PIPELINED_CHUNKS = 6
+      //!< like PLACE_FILE_CHUNKS, but many of these may be outstanding.
+      /*!< the packed data of both the request and the response starts with a
+      file_chunk_ticket saying which chunk of the transfer it is.  the rest of
+      the response is laid out as for PLACE_FILE_CHUNKS.  the source reads
+      ahead of the requests, and the destination can store the chunks in
+      whatever order they show up.  if the ticket in the response names a
+      chunk_compressor codec, then the rest of the response is compressed.
+      a source that doesn't know this command rejects it, and the destination
+      can go back to PLACE_FILE_CHUNKS. */
+  };
+
+  enum signature_limits {
+    MINIMUM_DELTA_FILE = 64 * basis::KILOBYTE
+      //!< smaller files are always sent whole; their deltas don't pay off.
   };
 
   basis::outcome _success;  //!< reports what kind of result occurred.
@@ -80,6 +137,12 @@ public:
           const structures::string_array &includes);
     //!< prepares the packed data from the "tree" and "includes" list.
 
+  int package_signatures(const filesystem::filename_list &diffs);
+    //!< signs the destination's copies of the "diffs" into the packed data.
+    /*!< only files that already exist under the "_dest_root" and are at
+    least MINIMUM_DELTA_FILE in size are signed.  the number of signatures
+    packed is returned. */
+
   virtual basis::clonable *clone() const { return cloner<file_transfer_infoton>(*this); }
 
   virtual void text_form(basis::base_string &fill) const;
@@ -12,18 +12,25 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include "chunk_compressor.h"
 #include "file_transfer_tentacle.h"
+#include "transfer_window.h"
 
 #include <basis/mutex.h>
 #include <filesystem/directory_tree.h>
+#include <filesystem/directory_watcher.h>
+#include <filesystem/file_delta.h>
 #include <filesystem/filename.h>
 #include <filesystem/filename_list.h>
+#include <filesystem/hash_cache.h>
 #include <filesystem/heavy_file_ops.h>
+#include <filesystem/huge_file.h>
 #include <loggers/program_wide_logger.h>
 #include <octopus/entity_defs.h>
 #include <octopus/entity_data_bin.h>
 #include <octopus/unhandled_request.h>
 #include <processes/ethread.h>
+#include <processes/file_hasher.h>
 #include <textual/parser_bits.h>
 
 using namespace basis;
@@ -38,8 +45,11 @@ using namespace timely;
 namespace octopi {
 
 #undef AUTO_LOCK
-#define AUTO_LOCK auto_synchronizer loc(*_lock);
+#define AUTO_LOCK auto_writer loc(*_lock);
   // protects our lists.
+#undef READ_LOCK
+#define READ_LOCK auto_reader loc(*_lock);
+  // allows looking at our lists alongside other readers.
 
 const int FTT_CLEANING_INTERVAL = 30 * SECOND_ms;
   // this is how frequently we clean up the list to remove outdated transfers.
@@ -55,6 +65,170 @@ const int TRANSFER_TIMEOUT = 10 * MINUTE_ms;
 
 //////////////
 
+// a chunk of a pipelined transfer that has been read from the files.
+
+class ready_chunk
+{
+public:
+  int _sequence;  // the chunk's place in the transfer.
+  byte_array _data;  // the headers and file pieces for the chunk.
+  bool _finished;  // true if nothing was left to send.
+  bool _fetched;  // true once it has been handed to the requester.
+  int _codec;  // how the data was compressed.
+  int _original_size;  // the length of the data before compression.
+
+  ready_chunk(int sequence)
+  : _sequence(sequence), _finished(false), _fetched(false),
+    _codec(chunk_compressor::RAW), _original_size(0) {}
+};
+
+// reads the chunks of a pipelined transfer ahead of the requests for them,
+// so the disk is kept busy while the earlier chunks are crossing the network.
+// any compression is done here too, rather than holding up the tentacle.
+// the chunks are kept until the requester acknowledges them, in case any of
+// them need to be sent again.
+
+class chunk_reader : public ethread
+{
+public:
+  chunk_reader(const astring &source_root, const filename_list &diffs,
+      delta_source *deltas)
+  : ethread(READ_AHEAD_INTERVAL, SLACK_INTERVAL),
+    _source_root(source_root), _diffs(diffs), _deltas(deltas),
+    _cursor(file_time()), _reported(file_time()), _chunk_size(0), _window(1),
+    _codec(chunk_compressor::RAW), _next_sequence(0),
+    _done(false), _list_lock(new mutex), _produce_lock(new mutex),
+    _chunks(new amorph<ready_chunk>) {}
+
+  virtual ~chunk_reader() {
+    stop();
+    WHACK(_chunks);
+    WHACK(_produce_lock);
+    WHACK(_list_lock);
+  }
+
+  DEFINE_CLASS_NAME("chunk_reader");
+
+  // sets the size of the chunks made from now on, how far to read ahead, and
+  // how to compress them.
+  void configure(int chunk_size, int window, int codec) {
+    auto_synchronizer l(*_list_lock);
+    _chunk_size = chunk_size;
+    _window = maximum(1, window);
+    _codec = chunk_compressor::valid_codec(codec)? codec : chunk_compressor::RAW;
+  }
+
+  // forgets the chunks that the requester has reported in the "spans".
+  void acknowledge(const int_array &spans) {
+    auto_synchronizer l(*_list_lock);
+    for (int i = _chunks->elements() - 1; i >= 0; i--) {
+      int sequence = _chunks->get(i)->_sequence;
+      for (int j = 0; j + 1 < spans.length(); j += 2) {
+        if ( (sequence >= spans[j]) && (sequence <= spans[j + 1]) ) {
+          _chunks->zap(i, i);
+          break;
+        }
+      }
+    }
+  }
+
+  // provides the chunk numbered in the "ticket", reading it now if needed.
+  // the ticket is filled in to describe the chunk, and the "cursor" is set
+  // to the last piece read so far.
+  outcome fetch(file_chunk_ticket &ticket, byte_array &data,
+      file_transfer_header &cursor) {
+    if (find(ticket, data, cursor)) return common::OKAY;
+    auto_synchronizer p(*_produce_lock);
+    if (find(ticket, data, cursor)) return common::OKAY;
+    // if it was read before, then they already told us they had it.
+    if (ticket._sequence < _next_sequence) return common::NOT_FOUND;
+    while (_next_sequence <= ticket._sequence) produce();
+    find(ticket, data, cursor);
+    return common::OKAY;
+  }
+
+  virtual void perform_activity(void *formal(ptr)) {
+    while (!should_stop()) {
+      {
+        // only read ahead as far as the window allows.
+        auto_synchronizer l(*_list_lock);
+        int unfetched = 0;
+        for (int i = 0; i < _chunks->elements(); i++)
+          if (!_chunks->get(i)->_fetched) unfetched++;
+        if (unfetched >= _window) return;
+      }
+      auto_synchronizer p(*_produce_lock);
+      if (_done) return;
+      produce();
+    }
+  }
+
+private:
+  astring _source_root;  // where the files are found.
+  const filename_list &_diffs;  // the files being transferred.
+  delta_source *_deltas;  // the files being sent as deltas, if any.
+  file_transfer_header _cursor;  // the last piece that was read.
+  file_transfer_header _reported;  // a copy of the cursor for the requests.
+  int _chunk_size;  // the largest chunk to make.
+  int _window;  // the number of unfetched chunks to keep ready.
+  int _codec;  // the compression to use on new chunks.
+  int _next_sequence;  // the number of the next chunk to read.
+  bool _done;  // true once the final chunk has been made.
+  mutex *_list_lock;  // protects the list of chunks and our settings.
+  mutex *_produce_lock;  // only one chunk is read at a time.
+  amorph<ready_chunk> *_chunks;  // the chunks that are ready.
+
+  static const int READ_AHEAD_INTERVAL = 10;
+    // how often the reader checks if the requests have caught up, in ms.
+
+  // looks for the chunk in the "ticket" in our list and hands it over.
+  bool find(file_chunk_ticket &ticket, byte_array &data,
+      file_transfer_header &cursor) {
+    auto_synchronizer l(*_list_lock);
+    cursor = _reported;
+    for (int i = 0; i < _chunks->elements(); i++) {
+      ready_chunk *curr = _chunks->borrow(i);
+      if (curr->_sequence != ticket._sequence) continue;
+      data = curr->_data;
+      ticket._finished = curr->_finished;
+      ticket._codec = abyte(curr->_codec);
+      ticket._original_size = curr->_original_size;
+      curr->_fetched = true;
+      return true;
+    }
+    return false;
+  }
+
+  // reads the next chunk.  the produce lock must be held.
+  void produce() {
+    FUNCDEF("produce");
+    int chunk_size, codec;
+    {
+      auto_synchronizer l(*_list_lock);
+      chunk_size = _chunk_size;
+      codec = _codec;
+    }
+    ready_chunk *next = new ready_chunk(_next_sequence++);
+    if (!_done) {
+      outcome ret = heavy_file_operations::buffer_files(_source_root, _diffs,
+          _cursor, next->_data, chunk_size, _deltas);
+      if ( (ret == heavy_file_operations::FINISHED) && !next->_data.length() )
+        _done = true;
+      else if ( (ret != heavy_file_operations::OKAY)
+          && (ret != heavy_file_operations::FINISHED) )
+        LOG(astring("buffer files returned an error for ") + _source_root);
+    }
+    next->_finished = _done;
+    next->_original_size = next->_data.length();
+    next->_codec = chunk_compressor::compress(codec, next->_data);
+    auto_synchronizer l(*_list_lock);
+    _chunks->append(next);
+    _reported = _cursor;
+  }
+};
+
+//////////////
+
 class file_transfer_record 
 {
 public:
@@ -69,21 +243,51 @@ public:
   file_transfer_header _last_sent;  // the last chunk that was sent.
   bool _done;  // true if the transfer is finished.
   string_array _includes;  // the set to include.
+  delta_source *_deltas;  // the source's signatures for sending deltas.
+  string_array _delta_files;  // the destination's files coming as deltas.
+  string_array _failed_deltas;  // deltas that the destination couldn't use.
+  string_array _resends;  // files the source must send again whole.
+  filename_list *_redo;  // the files being sent again, once diffs are done.
+  chunk_reader *_reader;  // reads ahead for pipelined transfers.
+  amorph<byte_array> _parked;  // pipelined chunks waiting for earlier ones.
+  int_array _parked_order;  // the sequence number of each parked chunk.
+  int _next_chunk;  // the pipelined chunk that's expected next.
 
   // valid for correspondence records only.
   directory_tree *_local_dir;  // our local information about the transfer.
+  directory_watcher *_watcher;  // non-null if changes are being watched.
   astring _source_mapping;  // valid for a correspondence record.
   int _refresh_interval;  // the rate of refreshing the source tree.
 
   file_transfer_record() : _diffs(NULL_POINTER), _last_sent(file_time()),
-      _done(false), _local_dir(NULL_POINTER)
+      _done(false), _deltas(NULL_POINTER), _redo(NULL_POINTER),
+      _reader(NULL_POINTER), _next_chunk(0), _local_dir(NULL_POINTER),
+      _watcher(NULL_POINTER)
   {}
 
   ~file_transfer_record() {
+    discard_partials();
+    WHACK(_reader);  // the reader uses our diffs and deltas.
+    WHACK(_deltas);
+    WHACK(_redo);
+    WHACK(_watcher);
     WHACK(_local_dir);
     WHACK(_diffs);
   }
 
+  // removes any partly built copies left by deltas that never finished.
+  // finished deltas have already replaced their files, so this only finds
+  // something when a transfer is dropped early.
+  void discard_partials() {
+    if (!_diffs) return;
+    for (int i = 0; i < _delta_files.length(); i++) {
+      const file_info *info = _diffs->find(_delta_files[i]);
+      if (!info) continue;
+      filename(_dest_root + filename::default_separator() + info->secondary()
+          + delta_target::partial_suffix()).unlink();
+    }
+  }
+
   astring text_form() const {
     astring to_return;
     to_return += astring("src=") + _src_root + astring(" last act=")
@@ -223,10 +427,12 @@ file_transfer_tentacle::file_transfer_tentacle(int maximum_transfer,
   _maximum_transfer(maximum_transfer),
   _transfers(new file_transfer_status),
   _correspondences(new file_transfer_status),
-  _lock(new mutex),
+  _lock(new rw_mutex),
   _cleaner(new file_transfer_cleaner(*this)),
-  _mode(mode_of_transfer)
+  _mode(mode_of_transfer),
+  _hasher(NULL_POINTER)
 {
+  if (_mode & COMPARE_FULL_CONTENT) _hasher = new file_hasher;
   _cleaner->start(NULL_POINTER);
 }
 
@@ -236,12 +442,21 @@ file_transfer_tentacle::~file_transfer_tentacle()
   WHACK(_transfers);
   WHACK(_correspondences);
   WHACK(_cleaner);
+  WHACK(_hasher);
   WHACK(_lock);
 }
 
-astring file_transfer_tentacle::text_form() const
+void file_transfer_tentacle::hash_cache_file(const astring &sidecar)
 {
   AUTO_LOCK;
+  if (!(_mode & COMPARE_FULL_CONTENT)) return;
+  WHACK(_hasher);
+  _hasher = new file_hasher(file_hasher::DEFAULT_THREADS, sidecar);
+}
+
+astring file_transfer_tentacle::text_form() const
+{
+  READ_LOCK;
   return _transfers->text_form();
 }
 
@@ -253,18 +468,29 @@ void file_transfer_tentacle::expunge(const octopus_entity &to_remove)
 
 outcome file_transfer_tentacle::add_correspondence
     (const astring &source_mapping, const astring &source_root,
-     int refresh_interval)
+     int refresh_interval, bool watch_changes)
 {
   FUNCDEF("add_correspondence");
   AUTO_LOCK;
 
-  remove_correspondence(source_mapping);  // clean the old one out first.
+  _correspondences->whack_mapping(source_mapping);
+    // clean the old one out first.  this can't call remove_correspondence(),
+    // since our lock isn't recursive.
 
   // create new file transfer record to hold this correspondence.
   file_transfer_record *new_record = new file_transfer_record;
   new_record->_source_mapping = source_mapping;
   new_record->_src_root = source_root;
   new_record->_refresh_interval = refresh_interval;
+  if (watch_changes) {
+    // the watches go in before the scan, so no changes can slip past us.
+    new_record->_watcher = new directory_watcher;
+    if (!new_record->_watcher->watch_tree(source_root)) {
+      LOG(astring("could not watch for changes; will rescan instead for ")
+          + source_root);
+      WHACK(new_record->_watcher);
+    }
+  }
   new_record->_local_dir = new directory_tree(source_root);
 //hmmm: doesn't say anything about a pattern.  do we need to worry about that?
 
@@ -279,6 +505,7 @@ outcome file_transfer_tentacle::add_correspondence
 #endif
   // calculate size and checksum info for the directory.
   new_record->_local_dir->calculate( !(_mode & COMPARE_CONTENT_SAMPLE) );
+  hash_tree(*new_record);
 
 #ifdef DEBUG_FILE_TRANSFER_TENTACLE
   LOG(astring("done adding tree for: ent=") + new_record->_ent.text_form()
@@ -304,7 +531,7 @@ bool file_transfer_tentacle::get_differences(const octopus_entity &ent,
 {
   FUNCDEF("get_differences");
   diffs.reset();
-  AUTO_LOCK;
+  READ_LOCK;
   file_transfer_record *the_rec = _transfers->find(ent, src, dest);
   if (!the_rec) return false;
   if (!the_rec->_diffs) return false;  // no diffs listed.
@@ -312,6 +539,19 @@ bool file_transfer_tentacle::get_differences(const octopus_entity &ent,
   return true;
 }
 
+bool file_transfer_tentacle::failed_deltas(const octopus_entity &ent,
+    const astring &src, const astring &dest, string_array &to_fill)
+{
+  FUNCDEF("failed_deltas");
+  to_fill.reset();
+  AUTO_LOCK;
+  file_transfer_record *the_rec = _transfers->find(ent, src, dest);
+  if (!the_rec) return false;
+  to_fill = the_rec->_failed_deltas;
+  the_rec->_failed_deltas.reset();
+  return true;
+}
+
 bool file_transfer_tentacle::status(const octopus_entity &ent,
     const astring &src, const astring &dest, double &total_size,
     int &total_files, double &current_size, int &current_files, bool &done,
@@ -322,7 +562,7 @@ bool file_transfer_tentacle::status(const octopus_entity &ent,
   total_files = 0;
   current_files = 0;
   current_size = 0;
-  AUTO_LOCK;
+  READ_LOCK;
   file_transfer_record *the_rec = _transfers->find(ent, src, dest);
   if (!the_rec) return false;
   done = the_rec->_done;
@@ -372,10 +612,23 @@ outcome file_transfer_tentacle::cancel_file_transfer(const octopus_entity &ent,
 
 directory_tree *file_transfer_tentacle::lock_directory(const astring &key)
 {
-  _lock->lock();
+  _lock->lock_read();
   file_transfer_record *the_rec = _correspondences->find_mapping(key);
+  if (the_rec && the_rec->_watcher) {
+    // a watched tree soaks up its changes first, which needs the write lock.
+    _lock->unlock_read();
+    {
+      AUTO_LOCK;
+      the_rec = _correspondences->find_mapping(key);
+      if (the_rec && the_rec->_watcher) refresh_tree(*the_rec);
+    }
+    // the record is looked up again, since it could have been removed while
+    // we were between the locks.
+    _lock->lock_read();
+    the_rec = _correspondences->find_mapping(key);
+  }
   if (!the_rec || !the_rec->_local_dir) {
-    _lock->unlock();
+    _lock->unlock_read();
     return NULL_POINTER;  // unknown transfer.
   }
   return the_rec->_local_dir;
@@ -383,7 +636,7 @@ directory_tree *file_transfer_tentacle::lock_directory(const astring &key)
 
 void file_transfer_tentacle::unlock_directory()
 {
-  _lock->unlock();
+  _lock->unlock_read();
 }
 
 bool file_transfer_tentacle::add_path(const astring &key,
@@ -425,26 +678,57 @@ void file_transfer_tentacle::periodic_actions()
     }
   }
 
-  // then we'll rescan any trees that are ready for it.
+  // then we'll rescan any trees that are ready for it.  watched trees just
+  // soak up their changes each time, so the event queue can't back up.
   for (int i = 0; i < _correspondences->elements(); i++) {
     file_transfer_record *curr = _correspondences->borrow(i);
-    if (curr->_last_active < time_stamp(-curr->_refresh_interval)) {
-      if (curr->_local_dir) {
+    if (curr->_watcher
+        || (curr->_last_active < time_stamp(-curr->_refresh_interval)) ) {
+      refresh_tree(*curr);
+      curr->_last_active.reset();  // reset our action time.
+    }
+  }
+}
+
+void file_transfer_tentacle::refresh_tree(file_transfer_record &mapping)
+{
+  FUNCDEF("refresh_tree");
+  if (!mapping._local_dir) return;
+  bool just_size = !(_mode & COMPARE_CONTENT_SAMPLE);
+  if (mapping._watcher) {
+    // only the paths that changed since last time are visited.
+    bool rescanned;
+    mapping._watcher->update(*mapping._local_dir, just_size, rescanned);
+    hash_tree(mapping);
+    return;
+  }
 #ifdef DEBUG_FILE_TRANSFER_TENTACLE
-        LOG(astring("refreshing tree for: ent=") + curr->_ent.text_form()
-            + " src=" + curr->_src_root + " dest=" + curr->_dest_root);
+  LOG(astring("refreshing tree for: ent=") + mapping._ent.text_form()
+      + " src=" + mapping._src_root + " dest=" + mapping._dest_root);
 #endif
-        WHACK(curr->_local_dir);
-        curr->_local_dir = new directory_tree(curr->_src_root);
-        curr->_local_dir->calculate( !(_mode & COMPARE_CONTENT_SAMPLE) );
+  WHACK(mapping._local_dir);
+  mapping._local_dir = new directory_tree(mapping._src_root);
+  mapping._local_dir->calculate(just_size);
+  hash_tree(mapping);
 #ifdef DEBUG_FILE_TRANSFER_TENTACLE
-        LOG(astring("done refreshing tree for: ent=") + curr->_ent.text_form()
-            + " src=" + curr->_src_root + " dest=" + curr->_dest_root);
+  LOG(astring("done refreshing tree for: ent=") + mapping._ent.text_form()
+      + " src=" + mapping._src_root + " dest=" + mapping._dest_root);
+#endif
+}
+
+void file_transfer_tentacle::hash_tree(file_transfer_record &mapping)
+{
+  FUNCDEF("hash_tree");
+  if (!_hasher || !mapping._local_dir) return;
+  // files whose hash is already known are skipped, and unchanged files come
+  // out of the cache, so this only reads what's new.
+  if (!_hasher->hash_tree(*mapping._local_dir))
+    LOG(astring("some files could not be hashed in ") + mapping._src_root);
+  if (_hasher->files_hashed() && _hasher->cache().sidecar().t())
+    _hasher->save_cache();
+#ifdef DEBUG_FILE_TRANSFER_TENTACLE
+  LOG(_hasher->text_form());
 #endif
-      }
-      curr->_last_active.reset();  // reset our action time.
-    }
-  }
 }
 
 outcome file_transfer_tentacle::reconstitute(const string_array &classifier,
@@ -619,6 +903,11 @@ outcome file_transfer_tentacle::handle_tree_compare_request
     how_comp |= file_info::EQUAL_FILESIZE | file_info::EQUAL_TIMESTAMP;
   if (_mode & COMPARE_CONTENT_SAMPLE)
     how_comp |= file_info::EQUAL_CHECKSUM;
+  if (_mode & COMPARE_FULL_CONTENT)
+    how_comp |= file_info::EQUAL_CONTENT;
+
+  // catch up on any changes before comparing, if we're watching for them.
+  if (mapping_record->_watcher) refresh_tree(*mapping_record);
 
   // compare the two trees of files.
   directory_tree::compare_trees(*mapping_record->_local_dir,
@@ -708,13 +997,48 @@ outcome file_transfer_tentacle::handle_storage_request
 
   the_rec->_last_active.reset();  // mark it as still active.
 
-  file_transfer_infoton *resp = dynamic_cast<file_transfer_infoton *>(req.clone());
-
   if (!the_rec->_diffs) return BAD_INPUT;  // wrong type of object.
 
-  outcome bufret = heavy_file_operations::buffer_files
-      (_correspondences->translate(the_rec->_src_root), *the_rec->_diffs,
-      the_rec->_last_sent, resp->_packed_data, _maximum_transfer);
+  if (req._packed_data.length()) {
+    // the destination couldn't use these deltas, so they're sent again whole.
+    string_array failed;
+    if (!failed.unpack(req._packed_data)) return GARBAGE;
+    WHACK(the_rec->_reader);  // it can't be reading ahead with old deltas.
+    for (int i = 0; i < failed.length(); i++) {
+      if (the_rec->_deltas) the_rec->_deltas->forget(failed[i]);
+      if (failed[i] == the_rec->_last_sent._filename) {
+        // the file in progress just starts over.
+        the_rec->_last_sent._byte_start = 0;
+        the_rec->_last_sent._length = 0;
+      } else if (the_rec->_resends.find(failed[i]) < 0) {
+        the_rec->_resends += failed[i];
+      }
+    }
+  }
+
+  req._packed_data.reset();  // clear out existing stuff before cloning.
+  file_transfer_infoton *resp = dynamic_cast<file_transfer_infoton *>(req.clone());
+
+  astring source_root = _correspondences->translate(the_rec->_src_root);
+  outcome bufret = heavy_file_operations::buffer_files(source_root,
+      the_rec->_redo? *the_rec->_redo : *the_rec->_diffs,
+      the_rec->_last_sent, resp->_packed_data, _maximum_transfer,
+      the_rec->_deltas);
+  if ( (bufret == heavy_file_operations::FINISHED)
+      && !resp->_packed_data.length() && the_rec->_resends.length() ) {
+    // everything else is done, so now the failed deltas get their turn.
+    WHACK(the_rec->_redo);
+    the_rec->_redo = new filename_list;
+    for (int i = 0; i < the_rec->_resends.length(); i++) {
+      const file_info *info = the_rec->_diffs->find(the_rec->_resends[i]);
+      if (info) the_rec->_redo->append(new file_info(*info));
+    }
+    the_rec->_resends.reset();
+    the_rec->_last_sent = file_transfer_header(file_time());
+    bufret = heavy_file_operations::buffer_files(source_root, *the_rec->_redo,
+        the_rec->_last_sent, resp->_packed_data, _maximum_transfer,
+        the_rec->_deltas);
+  }
   if (bufret == heavy_file_operations::FINISHED) {
     bufret = OKAY;  // in either case, we don't emit a finished outcome; handled elsewhere.
     if (!resp->_packed_data.length()) {
@@ -763,6 +1087,145 @@ outcome file_transfer_tentacle::handle_storage_response
     the_rec->_done = true;
   }
 
+  outcome ret = store_chunks(*the_rec, resp, item_id, false);
+  if (ret != OKAY) return ret;
+
+  // there is no response product to store.
+  return OKAY;
+}
+
+outcome file_transfer_tentacle::handle_pipelined_request
+    (file_transfer_infoton &req, const octopus_request_id &item_id)
+{
+  FUNCDEF("handle_pipelined_request");
+  if (_mode & ONLY_REPORT_DIFFS) {
+    // store an unhandled infoton.
+    unhandled_request *deny = new unhandled_request(item_id, req.classifier(), NO_HANDLER);
+    store_product(deny, item_id);
+    return NO_HANDLER;
+  }
+
+  // look up the transfer record.
+  file_transfer_record *the_rec = _transfers->find(item_id._entity,
+      req._src_root, req._dest_root);
+  if (!the_rec) {
+    LOG(astring("could not find the record for this transfer: item=")
+        + item_id.text_form() + " src=" + req._src_root + " dest="
+        + req._dest_root);
+    return NOT_FOUND;  // not registered, so reject it.
+  }
+  if (!the_rec->_diffs) return BAD_INPUT;  // wrong type of object.
+
+  the_rec->_last_active.reset();  // mark it as still active.
+
+  file_chunk_ticket ticket;
+  if (!ticket.unpack(req._packed_data)) return GARBAGE;
+
+  byte_array chunk;
+  outcome ret = OKAY;
+  if (ticket._finished || (the_rec->_done && !the_rec->_reader)) {
+    // the destination has stored the whole transfer, so the chunks that were
+    // kept in case they had to be sent again can all be dropped now.
+    WHACK(the_rec->_reader);
+    the_rec->_done = true;
+    ticket._finished = true;
+    ticket._codec = chunk_compressor::RAW;
+    ticket._original_size = 0;
+  } else {
+    if (!the_rec->_reader) {
+      // the first pipelined request starts the reading ahead.
+      the_rec->_reader = new chunk_reader
+          (_correspondences->translate(the_rec->_src_root), *the_rec->_diffs,
+          the_rec->_deltas);
+      the_rec->_reader->start(NULL_POINTER);
+    }
+    int chunk_size = _maximum_transfer;
+    if (ticket._chunk_size > 0)
+      chunk_size = minimum(_maximum_transfer, maximum(int(transfer_window::MINIMUM_CHUNK),
+          ticket._chunk_size));
+    // we can only compress the chunks in ways that we know about.
+    the_rec->_reader->configure(chunk_size, ticket._window, ticket._codec);
+    the_rec->_reader->acknowledge(ticket._received);
+
+    ticket._finished = false;
+    ticket._codec = chunk_compressor::RAW;
+    ticket._original_size = 0;
+    ret = the_rec->_reader->fetch(ticket, chunk, the_rec->_last_sent);
+  }
+
+  req._packed_data.reset();  // clear out existing stuff before cloning.
+  file_transfer_infoton *resp = dynamic_cast<file_transfer_infoton *>(req.clone());
+  if (ret != OKAY) {
+    LOG(a_sprintf("chunk %d was requested after it was acknowledged on item=",
+        ticket._sequence) + item_id.text_form());
+    resp->_success = ret;
+  }
+  if (ticket._finished) the_rec->_done = true;
+  ticket._received.reset();
+  ticket.pack(resp->_packed_data);
+  resp->_packed_data += chunk;
+  resp->_request = false;  // it's a response now.
+  store_product(resp, item_id);
+  return OKAY;
+}
+
+outcome file_transfer_tentacle::handle_pipelined_response
+    (file_transfer_infoton &resp, const octopus_request_id &item_id)
+{
+  FUNCDEF("handle_pipelined_response");
+  if (_mode & ONLY_REPORT_DIFFS) {
+    // not spoken here.
+    return NO_HANDLER;
+  }
+
+  file_transfer_record *the_rec = _transfers->find(item_id._entity,
+      resp._src_root, resp._dest_root);
+  if (!the_rec) return NOT_FOUND;  // not registered, so reject it.
+
+  the_rec->_last_active.reset();  // mark it as still active.
+
+  file_chunk_ticket ticket;
+  if (!ticket.unpack(resp._packed_data)) return GARBAGE;
+  if (resp._success != OKAY) return resp._success;
+  if (!chunk_compressor::decompress(ticket._codec, ticket._original_size,
+      resp._packed_data)) {
+    LOG(astring("failed to expand ") + chunk_compressor::codec_name(ticket._codec)
+        + " chunk on item=" + item_id.text_form());
+    return GARBAGE;
+  }
+
+  // plain file pieces can be written wherever they go, but a delta has to be
+  // applied in order.  chunks that arrive early are kept until their turn.
+  if (the_rec->_delta_files.length() && (ticket._sequence != the_rec->_next_chunk)) {
+    the_rec->_parked.append(new byte_array(resp._packed_data));
+    the_rec->_parked_order.concatenate(ticket._sequence);
+    return OKAY;
+  }
+
+  outcome ret = store_chunks(*the_rec, resp, item_id, true);
+  if (ticket._sequence >= the_rec->_next_chunk)
+    the_rec->_next_chunk = ticket._sequence + 1;
+  if (ticket._finished) the_rec->_done = true;
+
+  // see if the chunks after this one were already waiting.
+  for (int i = 0; i < the_rec->_parked_order.length(); i++) {
+    if (the_rec->_parked_order[i] != the_rec->_next_chunk) continue;
+    resp._packed_data = *the_rec->_parked.borrow(i);
+    the_rec->_parked.zap(i, i);
+    the_rec->_parked_order.zap(i, i);
+    outcome parked_ret = store_chunks(*the_rec, resp, item_id, true);
+    if (parked_ret != OKAY) ret = parked_ret;
+    the_rec->_next_chunk++;
+    i = -1;  // start looking again for the next one.
+  }
+  return ret;
+}
+
+outcome file_transfer_tentacle::store_chunks(file_transfer_record &the_rec,
+    file_transfer_infoton &resp, const octopus_request_id &item_id,
+    bool pipelined)
+{
+  FUNCDEF("store_chunks");
   // chew on all the things they sent us.
   while (resp._packed_data.length()) {
     file_time empty;
@@ -773,7 +1236,7 @@ outcome file_transfer_tentacle::handle_storage_response
           + " src=" + resp._src_root + " dest=" + resp._dest_root);
       return GARBAGE;
     }
-    the_rec->_last_sent = found;
+    the_rec._last_sent = found;
 
     if (found._length > resp._packed_data.length()) {
       // another case for leaving--not enough data left in the buffer.
@@ -784,9 +1247,9 @@ outcome file_transfer_tentacle::handle_storage_response
     byte_array to_write = resp._packed_data.subarray(0, found._length - 1);
     resp._packed_data.zap(0, found._length - 1);
 
-    if (!the_rec->_diffs) return BAD_INPUT;
+    if (!the_rec._diffs) return BAD_INPUT;
 
-    const file_info *recorded_info = the_rec->_diffs->find(found._filename);
+    const file_info *recorded_info = the_rec._diffs->find(found._filename);
     if (!recorded_info) {
       LOG(astring("unrequested file seen: ") + found._filename);
       continue;  // maybe there are others that aren't confused.
@@ -796,8 +1259,42 @@ outcome file_transfer_tentacle::handle_storage_response
         + recorded_info->secondary();
 //     LOG(astring("telling it to write to fullfile: ") + full_file);
 
+    if (the_rec._failed_deltas.find(found._filename) >= 0) {
+      // the rest of a broken delta is useless; the whole file is coming.
+      continue;
+    }
+
+    int delta_index = the_rec._delta_files.find(found._filename);
+    if (delta_index >= 0) {
+      // this piece describes changes to our existing copy of the file.
+      bool finished;
+      outcome ret = delta_target::apply_piece(full_file, found._byte_start,
+          to_write, finished);
+      if (ret == common::INCOMPLETE) {
+        // the source gave up on the delta and is sending the file whole.
+        the_rec._delta_files.zap(delta_index, delta_index);
+      } else if (ret != OKAY) {
+        LOG(astring("failed to apply delta; asking for whole file: error=")
+            + heavy_file_operations::outcome_name(ret) + " file=" + full_file);
+        the_rec._delta_files.zap(delta_index, delta_index);
+        the_rec._failed_deltas += found._filename;
+      }
+      if (finished) found._time.set_time(full_file);
+      continue;
+    }
+
+    // pipelined chunks can show up in any order, so later parts of the file
+    // might already be in place.  the file is only cut down to its expected
+    // size when its first piece is written.
     outcome ret = heavy_file_operations::write_file_chunk(full_file,
-        found._byte_start, to_write);
+        found._byte_start, to_write, !pipelined);
+    if (pipelined && !found._byte_start && (ret == OKAY)) {
+      huge_file target(full_file, "r+b");
+      if (target.good() && (target.length() > recorded_info->_file_size)) {
+        target.seek(recorded_info->_file_size, byte_filer::FROM_START);
+        target.truncate();
+      }
+    }
     if (ret != OKAY) {
       LOG(astring("failed to write file chunk: error=")
           + heavy_file_operations::outcome_name(ret) + " file=" + full_file
@@ -806,7 +1303,70 @@ outcome file_transfer_tentacle::handle_storage_response
     found._time.set_time(full_file);
   }
 
-  // there is no response product to store.
+  return OKAY;
+}
+
+outcome file_transfer_tentacle::handle_signature_request
+    (file_transfer_infoton &req, const octopus_request_id &item_id)
+{
+  FUNCDEF("handle_signature_request");
+  // look up the transfer record.
+  file_transfer_record *the_rec = _transfers->find(item_id._entity,
+      req._src_root, req._dest_root);
+  if (!the_rec) {
+    LOG(astring("could not find the record for this transfer: item=")
+        + item_id.text_form() + " src=" + req._src_root + " dest="
+        + req._dest_root);
+    return NOT_FOUND;  // not registered, so reject it.
+  }
+  if (!the_rec->_diffs) return BAD_INPUT;  // wrong type of object.
+
+  the_rec->_last_active.reset();  // mark it as still active.
+
+  signature_list signatures;
+  if (!signatures.unpack(req._packed_data)) {
+    LOG(astring("could not unpack requester's signatures"));
+    return GARBAGE;
+  }
+
+  // we only take on the files that are part of this transfer.  if deltas
+  // are not allowed here, the empty list tells them to expect whole files.
+  string_array accepted;
+  if (_mode & DELTA_TRANSFER) {
+    while (signatures.elements()) {
+      file_signature *sig = signatures.acquire(0);
+      signatures.zap(0, 0);
+      if (!the_rec->_diffs->find(sig->_filename)) {
+        WHACK(sig);
+        continue;
+      }
+      if (!the_rec->_deltas) the_rec->_deltas = new delta_source;
+      accepted += sig->_filename;
+      the_rec->_deltas->add(sig);
+    }
+  }
+
+  req._packed_data.reset();  // clear out existing stuff before cloning.
+  file_transfer_infoton *reply = dynamic_cast<file_transfer_infoton *>(req.clone());
+  accepted.pack(reply->_packed_data);
+  reply->_request = false;  // it's a response now.
+  store_product(reply, item_id);
+  return OKAY;
+}
+
+outcome file_transfer_tentacle::handle_signature_response
+    (file_transfer_infoton &resp, const octopus_request_id &item_id)
+{
+  FUNCDEF("handle_signature_response");
+  file_transfer_record *the_rec = _transfers->find(item_id._entity,
+      resp._src_root, resp._dest_root);
+  if (!the_rec) return NOT_FOUND;  // not registered, so reject it.
+
+  the_rec->_last_active.reset();  // mark it as still active.
+
+  string_array accepted;
+  if (!accepted.unpack(resp._packed_data)) return GARBAGE;
+  the_rec->_delta_files += accepted;
   return OKAY;
 }
 
@@ -899,6 +1459,14 @@ outcome file_transfer_tentacle::consume(infoton &to_chow,
       if (inf->_request) return handle_storage_request(*inf, item_id);
       else return handle_storage_response(*inf, item_id);
     }
+    case file_transfer_infoton::FILE_SIGNATURES: {
+      if (inf->_request) return handle_signature_request(*inf, item_id);
+      else return handle_signature_response(*inf, item_id);
+    }
+    case file_transfer_infoton::PIPELINED_CHUNKS: {
+      if (inf->_request) return handle_pipelined_request(*inf, item_id);
+      else return handle_pipelined_response(*inf, item_id);
+    }
     case file_transfer_infoton::CONCLUDE_TRANSFER_MARKER: {
       if (inf->_request) return conclude_storage_request(*inf, item_id);
       else return conclude_storage_response(*inf, item_id);
@@ -915,19 +1483,7 @@ outcome file_transfer_tentacle::refresh_now(const astring &source_mapping)
     file_transfer_record *curr = _correspondences->borrow(i);
     if (!curr) continue;
     if (curr->_source_mapping != source_mapping) continue;
-    if (curr->_local_dir) {
-#ifdef DEBUG_FILE_TRANSFER_TENTACLE
-      LOG(astring("refreshing tree for: ent=") + curr->_ent.text_form()
-          + " src=" + curr->_src_root + " dest=" + curr->_dest_root);
-#endif
-      WHACK(curr->_local_dir);
-      curr->_local_dir = new directory_tree(curr->_src_root);
-      curr->_local_dir->calculate( !(_mode & COMPARE_CONTENT_SAMPLE) );
-#ifdef DEBUG_FILE_TRANSFER_TENTACLE
-      LOG(astring("done refreshing tree for: ent=") + curr->_ent.text_form()
-          + " src=" + curr->_src_root + " dest=" + curr->_dest_root);
-#endif
-    }
+    refresh_tree(*curr);
     curr->_last_active.reset();  // reset our action time.
     return OKAY;
   }
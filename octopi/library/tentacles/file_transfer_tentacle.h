@@ -17,15 +17,19 @@
 
 #include "file_transfer_infoton.h"
 
-#include <basis/mutex.h>
+#include <basis/rw_mutex.h>
 #include <filesystem/directory_tree.h>
 #include <filesystem/filename_list.h>
 #include <octopus/tentacle_helper.h>
 #include <timely/time_stamp.h>
 
+// forward.
+namespace processes { class file_hasher; }
+
 namespace octopi {
 
 class file_transfer_cleaner;
+class file_transfer_record;
 class file_transfer_status;
 
 //! Manages the transferrence of directory trees from one place to another.
@@ -44,7 +48,11 @@ public:
     ONLY_REPORT_DIFFS = 0x1,  //!< no actual file transfer, just reports.
     COMPARE_SIZE_AND_TIME = 0x2,  //!< uses size and time to see differences.
     COMPARE_CONTENT_SAMPLE = 0x4,  //!< samples parts of file for comparison.
-    COMPARE_ALL = 0x6  //!< compares all of the file size, file time, and contents.
+    COMPARE_ALL = 0x6,  //!< compares all of the file size, file time, and contents.
+    COMPARE_FULL_CONTENT = 0x8,  //!< hashes the entire file for comparison.
+    DELTA_TRANSFER = 0x10,  //!< sends changed files as deltas when possible.
+    PIPELINED_TRANSFER = 0x20,  //!< keeps many chunk requests outstanding.
+    COMPRESSED_TRANSFER = 0x40  //!< asks for pipelined chunks to be compressed.
   };
 
 
@@ -57,8 +65,19 @@ public:
     COMPARE_SIZE_AND_TIME is set, then the comparison will use the file's
     size and its access time for determining if it has changed.  if the
     COMPARE_CONTENT_SAMPLE flag is set, then the file will be sampled at some
-    key locations and that will decide differences.  the comparison modes
-    can be mixed together.  if there are no comparison modes, then the files
+    key locations and that will decide differences.  if COMPARE_FULL_CONTENT
+    is set, then a strong hash of each whole file decides (see
+    processes::file_hasher); only files that changed since they were last
+    hashed are read again.  if DELTA_TRANSFER is set, then the source will
+    accept FILE_SIGNATURES for files the destination already has, and it
+    sends just the changed parts of those files.  if PIPELINED_TRANSFER is
+    set, then the destination asks for chunks with PIPELINED_CHUNKS requests
+    and keeps a transfer_window of them outstanding; sources always answer
+    those requests and read ahead of them.  if COMPRESSED_TRANSFER is also
+    set, then the destination asks for the chunks to be compressed (see
+    chunk_compressor); sources compress the ones that will shrink while they
+    read ahead, and send the rest raw.  the comparison modes can be
+    mixed together.  if there are no comparison modes, then the files
     will always be copied. */
 
   virtual ~file_transfer_tentacle();
@@ -68,15 +87,22 @@ public:
   basis::astring text_form() const;
     //!< returns a string representing the current state of transfers.
 
+  void hash_cache_file(const basis::astring &sidecar);
+    //!< keeps the full content hashes in the "sidecar" file between runs.
+    /*!< this only matters for the COMPARE_FULL_CONTENT mode.  the cache is
+    saved whenever a tree has been hashed. */
+
   filesystem::directory_tree *lock_directory(const basis::astring &source_mapping);
     //!< provides a view of the tentacle's current state.
+    /*!< the tree is only locked for reading, so it must not be changed. */
   void unlock_directory();
     //!< unlock MUST be called when one is done looking at the tree.
 
   // these methods are for the "server" side--the side that has files to offer.
 
   basis::outcome add_correspondence(const basis::astring &source_mapping,
-          const basis::astring &source_root, int refresh_interval);
+          const basis::astring &source_root, int refresh_interval,
+          bool watch_changes = false);
     //!< adds a file transfer correspondence.
     /*!< this is a "source_mapping" which is a short string that is made
     available to the other side for transfer requests.  when they specify the
@@ -85,7 +111,13 @@ public:
     how frequently, in milliseconds, the source will be scanned to update the
     internal directory tree.  this is done the first time the "source_mapping"
     is set up also.  if a previous identical "source_mapping" existed, then it
-    is removed and replaced with the information from the new invocation. */
+    is removed and replaced with the information from the new invocation.
+    if "watch_changes" is true, then the operating system's change
+    notifications are used to keep the tree current instead of rescanning it
+    (see filesystem::directory_watcher).  the changes are applied before
+    every tree comparison and lock_directory(), so the cost follows the
+    number of changes rather than the size of the tree.  if watching isn't
+    possible, then the "refresh_interval" rescans are used after all. */
 
   basis::outcome remove_correspondence(const basis::astring &source_mapping);
     //!< takes out the "source_mapping" which was previously added.
@@ -95,7 +127,7 @@ public:
   basis::outcome refresh_now(const basis::astring &source_mapping);
     //!< refreshes the "source_mapping" right now, regardless of the interval.
     /*!< the mapping must already have been created with add_correspondence().
-    */
+    a watched mapping only applies the changes it has heard about. */
 
   bool add_path(const basis::astring &source_mapping, const basis::astring &new_path);
     //!< inserts the "new_path" into a registered correspondence.
@@ -138,6 +170,13 @@ public:
     //!< accesses the list of difference for an ongoing transfer.
     /*!< the progress is stored in "diffs". */
 
+  bool failed_deltas(const octopus_entity &ent, const basis::astring &src,
+        const basis::astring &dest, structures::string_array &to_fill);
+    //!< hands over the files whose deltas could not be applied here.
+    /*!< the destination side passes these names along with its next
+    PLACE_FILE_CHUNKS request, and the source then sends those files whole.
+    the list is emptied by this call. */
+
   // required tentacle methods...
 
   virtual basis::outcome reconstitute(const structures::string_array &classifier,
@@ -162,9 +201,19 @@ private:
   int _maximum_transfer;  //!< largest chunk to send at a time.
   file_transfer_status *_transfers;  //!< our record of ongoing transfers.
   file_transfer_status *_correspondences;  //!< the synonyms for mapping.
-  basis::mutex *_lock;  //!< protects our lists.
+  basis::rw_mutex *_lock;  //!< protects our lists.
   file_transfer_cleaner *_cleaner;  //!< cleans up dead transfers.
   int _mode;  //!< how will the comparison be done?
+  processes::file_hasher *_hasher;  //!< hashes whole files, if that's needed.
+
+  basis::outcome store_chunks(file_transfer_record &the_rec,
+          file_transfer_infoton &resp, const octopus_request_id &item_id,
+          bool pipelined);
+    //!< writes the file pieces in the "resp" for the transfer "the_rec".
+  void refresh_tree(file_transfer_record &mapping);
+    //!< brings the tree for the "mapping" record up to date.
+  void hash_tree(file_transfer_record &mapping);
+    //!< fills in any missing content hashes when comparing full contents.
 
   // these process the request and response infotons that are passed to us.
   basis::outcome handle_build_target_tree_request(file_transfer_infoton &req,
@@ -179,6 +228,14 @@ private:
           const octopus_request_id &item_id);
   basis::outcome handle_storage_response(file_transfer_infoton &resp,
           const octopus_request_id &item_id);
+  basis::outcome handle_pipelined_request(file_transfer_infoton &req,
+          const octopus_request_id &item_id);
+  basis::outcome handle_pipelined_response(file_transfer_infoton &resp,
+          const octopus_request_id &item_id);
+  basis::outcome handle_signature_request(file_transfer_infoton &req,
+          const octopus_request_id &item_id);
+  basis::outcome handle_signature_response(file_transfer_infoton &resp,
+          const octopus_request_id &item_id);
   basis::outcome conclude_storage_request(file_transfer_infoton &req,
           const octopus_request_id &item_id);
   basis::outcome conclude_storage_response(file_transfer_infoton &resp,
@@ -39,13 +39,13 @@ octenc_key_record *key_repository::lock(const octopus_entity &ent)
   LOG(astring("entity sought=") + ent.text_form());
 #endif
   octenc_key_record *to_return = NULL_POINTER;
-  _locker.lock();
+  _locker.lock_read();
   to_return = _keys.find(ent.mangled_form());
   if (!to_return) {
 #ifdef DEBUG_KEY_REPOSITORY
     LOG(astring("did not find entity=") + ent.text_form());
 #endif
-    _locker.unlock();
+    _locker.unlock_read();
   } else {
 #ifdef DEBUG_KEY_REPOSITORY
     LOG(astring("found entity=") + ent.text_form());
@@ -57,7 +57,7 @@ octenc_key_record *key_repository::lock(const octopus_entity &ent)
 void key_repository::unlock(octenc_key_record *to_unlock)
 {
   if (!to_unlock) return;  // dolts!  they cannot unlock a non-record.
-  _locker.unlock();
+  _locker.unlock_read();
 }
 
 outcome key_repository::add(const octopus_entity &ent,
@@ -67,7 +67,7 @@ outcome key_repository::add(const octopus_entity &ent,
   FUNCDEF("add");
   LOG(astring("adding key for entity=") + ent.text_form());
 #endif
-  auto_synchronizer loc(_locker);
+  auto_writer loc(_locker);
   octenc_key_record rec(ent, key);
   return _keys.add(ent.mangled_form(), rec);
 }
@@ -78,7 +78,7 @@ outcome key_repository::whack(const octopus_entity &ent)
   FUNCDEF("whack");
   LOG(astring("removing key for entity=") + ent.text_form());
 #endif
-  auto_synchronizer loc(_locker);
+  auto_writer loc(_locker);
   return _keys.whack(ent.mangled_form());
 }
 
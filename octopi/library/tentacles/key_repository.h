@@ -15,7 +15,7 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
-#include <basis/mutex.h>
+#include <basis/rw_mutex.h>
 #include <crypto/blowfish_crypto.h>
 #include <structures/symbol_table.h>
 #include <octopus/entity_defs.h>
@@ -54,10 +54,12 @@ public:
 
   octenc_key_record *lock(const octopus_entity &ent);
     //!< locates the key for "ent", if it's stored.
-    /*!< the returned object, unless it's NULL_POINTER, must be unlocked. */
+    /*!< the returned object, unless it's NULL_POINTER, must be unlocked.
+    the record is only locked for reading, since other threads can be
+    looking at it at the same time, so it must not be changed. */
 
   void unlock(octenc_key_record *to_unlock);
-    //!< drops the lock on the key record in "to_unlock".
+    //!< drops the read lock on the key record in "to_unlock".
 
   basis::outcome add(const octopus_entity &ent, const crypto::blowfish_crypto &key);
     //!< adds a "key" for the "ent".  this will fail if one is already listed.
@@ -66,7 +68,7 @@ public:
     //!< removes the key for "ent".
 
 private:
-  basis::mutex _locker;  //!< protects our list of keys.
+  basis::rw_mutex _locker;  //!< protects our list of keys.
   structures::symbol_table<octenc_key_record> _keys;  //!< the list of keys.
 };
 
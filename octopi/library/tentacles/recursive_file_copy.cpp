@@ -12,9 +12,11 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include "chunk_compressor.h"
 #include "file_transfer_infoton.h"
 #include "file_transfer_tentacle.h"
 #include "recursive_file_copy.h"
+#include "transfer_window.h"
 
 #include <application/application_shell.h>
 #include <basis/guards.h>
@@ -28,6 +30,7 @@
 #include <octopus/entity_defs.h>
 #include <octopus/entity_data_bin.h>
 #include <octopus/octopus.h>
+#include <processes/file_hasher.h>
 #include <structures/static_memory_gremlin.h>
 #include <textual/string_manipulation.h>
 #include <timely/time_control.h>
@@ -36,6 +39,7 @@ using namespace application;
 using namespace basis;
 using namespace filesystem;
 using namespace loggers;
+using namespace processes;
 using namespace structures;
 using namespace textual;
 using namespace timely;
@@ -65,8 +69,40 @@ const int EXPECTED_MAXIMUM_TRANSFER_TIME = 10 * HOUR_ms;
   // we allow it a long time, since this is a copy and not an active
   // synchronization.
 
+const int FIRST_PIPELINED_REQUEST = 1000;
+  // the request numbers for pipelined chunks start here, past the others.
+
+const int CLOSING_PIPELINED_REQUEST = FIRST_PIPELINED_REQUEST - 1;
+  // the request number that tells the source the pipelined chunks all arrived.
+
 recursive_file_copy::~recursive_file_copy() {}
 
+// lists the file pieces found in a chunk of the transfer.  false is returned
+// if the chunk is malformed.
+
+#undef static_class_name
+#define static_class_name() "recursive_file_copy"
+
+static bool show_chunks(byte_array copy)
+{
+  FUNCDEF("show_chunks");
+  while (copy.length()) {
+    file_time empty;
+    file_transfer_header head(empty);
+    if (!head.unpack(copy)) return false;
+    if (copy.length() < head._length) return false;
+    if (head._length > 0)
+      copy.zap(0, head._length - 1);
+
+//hmmm: this needs better formatting, and should not repeat the same file name even
+//      if it's in multiple chunks.
+    BASE_LOG(head.readable_text_form());
+  }
+  return true;
+}
+
+#undef static_class_name
+
 const char *recursive_file_copy::outcome_name(const outcome &to_name)
 { return common::outcome_name(to_name); }
 
@@ -144,6 +180,11 @@ LOG(ring_leader.responses().text_form());
 
 //hmmm: simple asset counting debugging in calculate would be nice too.
   target_area.calculate( !(transfer_mode & file_transfer_tentacle::COMPARE_CONTENT_SAMPLE) );
+  if (transfer_mode & file_transfer_tentacle::COMPARE_FULL_CONTENT) {
+    // the source side hashes its files too, so whole contents get compared.
+    file_hasher hasher;
+    hasher.hash_tree(target_area);
+  }
 
   comparison_req->package_tree_info(target_area, includes);
 
@@ -186,7 +227,118 @@ LOG(ring_leader.responses().text_form());
   if (junk)
     RETURN_ERROR_RFC("got a response we shouldn't have!", FAILURE);
 
+  if (transfer_mode & file_transfer_tentacle::DELTA_TRANSFER) {
+    // tell the source about the blocks we already have for changed files.
+    file_transfer_infoton *signatures = new file_transfer_infoton;
+    signatures->_request = true;
+    signatures->_command = file_transfer_infoton::FILE_SIGNATURES;
+    signatures->_src_root = source_root;
+    signatures->_dest_root = target_dir;
+#ifdef DEBUG_RECURSIVE_FILE_COPY
+    int signed_files = signatures->package_signatures(diffs);
+    LOG(a_sprintf("sending signatures for %d files in %d bytes", signed_files,
+        signatures->_packed_data.length()));
+#else
+    signatures->package_signatures(diffs);
+#endif
+
+    octopus_request_id sig_id(ent, 3);
+    outcome sig_ret = ring_leader.evaluate(signatures, sig_id);
+    if (sig_ret != tentacle::OKAY)
+      RETURN_ERROR_RFC("failed to send file signatures", FAILURE);
+    file_transfer_infoton *accepted = (file_transfer_infoton *)ring_leader
+        .acquire_specific_result(sig_id);
+    if (!accepted)
+      RETURN_ERROR_RFC("no response to file signatures", NONE_READY);
+    octopus_request_id accepted_id(ent, 4);
+    outcome acc_ret = client_spider.evaluate(accepted, accepted_id);
+    if (acc_ret != tentacle::OKAY)
+      RETURN_ERROR_RFC("failed to process the signature response!", FAILURE);
+  }
+
   astring current_file;  // what file is in progress right now?
+  string_array failed;  // files whose deltas couldn't be used here.
+
+  bool pipelined = !!(transfer_mode & file_transfer_tentacle::PIPELINED_TRANSFER);
+  int codec = (transfer_mode & file_transfer_tentacle::COMPRESSED_TRANSFER)?
+      chunk_compressor::ZLIB_FAST : chunk_compressor::RAW;
+  if (pipelined) {
+    // keep a window of chunk requests outstanding rather than waiting for
+    // each chunk before asking for the next.  every reply that's handled
+    // makes room for another request right away.
+    transfer_window window(MAX_CHUNK_RFC_COPY_HIER);
+    int_array asked;  // the outstanding sequences, oldest first.
+    while (pipelined && (!window.done() || asked.length())) {
+      while (window.can_request()) {
+        file_transfer_infoton *ask = new file_transfer_infoton;
+        ask->_request = true;
+        ask->_command = file_transfer_infoton::PIPELINED_CHUNKS;
+        ask->_src_root = source_root;
+        ask->_dest_root = target_dir;
+        file_chunk_ticket ticket = window.next_request();
+        ticket._codec = abyte(codec);
+        ticket.pack(ask->_packed_data);
+        octopus_request_id chunk_id(ent, FIRST_PIPELINED_REQUEST + ticket._sequence);
+        outcome ask_ret = ring_leader.evaluate(ask, chunk_id);
+        if ( (ask_ret != tentacle::OKAY) && !ticket._sequence) {
+          // the source doesn't do pipelining, so use the plain requests.
+          LOG("source refused pipelined chunks; falling back to single chunks.");
+          pipelined = false;
+          break;
+        } else if (ask_ret != tentacle::OKAY) {
+          RETURN_ERROR_RFC("failed to request pipelined chunk", FAILURE);
+        }
+        asked.concatenate(ticket._sequence);
+      }
+      if (!pipelined) break;
+      if (!asked.length())
+        RETURN_ERROR_RFC("pipelined transfer stalled with nothing requested", FAILURE);
+
+      int sequence = asked[0];
+      asked.zap(0, 0);
+      octopus_request_id chunk_id(ent, FIRST_PIPELINED_REQUEST + sequence);
+      file_transfer_infoton *reply = (file_transfer_infoton *)ring_leader
+          .acquire_specific_result(chunk_id);
+      if (!reply)
+        RETURN_ERROR_RFC("failed to get pipelined chunk", NONE_READY);
+      byte_array copy = reply->_packed_data;
+      file_chunk_ticket answer;
+      if (!answer.unpack(copy))
+        RETURN_ERROR_RFC("failed to unpack chunk ticket", GARBAGE);
+      if (!chunk_compressor::decompress(answer._codec, answer._original_size, copy))
+        RETURN_ERROR_RFC("failed to expand compressed chunk", GARBAGE);
+      if (!show_chunks(copy))
+        RETURN_ERROR_RFC("failed to unpack chunk headers", GARBAGE);
+      window.received(answer, copy.length());
+      octopus_request_id resp_id(ent, FIRST_PIPELINED_REQUEST + sequence);
+      outcome resp_ret = client_spider.evaluate(reply, resp_id);
+      if (resp_ret != tentacle::OKAY)
+        RETURN_ERROR_RFC("failed to process the pipelined chunk!", FAILURE);
+    }
+    if (pipelined) {
+      // let the source know that it can drop the chunks it was still keeping.
+      file_transfer_infoton *closing = new file_transfer_infoton;
+      closing->_request = true;
+      closing->_command = file_transfer_infoton::PIPELINED_CHUNKS;
+      closing->_src_root = source_root;
+      closing->_dest_root = target_dir;
+      window.closing_request().pack(closing->_packed_data);
+      octopus_request_id closing_id(ent, CLOSING_PIPELINED_REQUEST);
+      if (ring_leader.evaluate(closing, closing_id) == tentacle::OKAY) {
+        infoton *closed = ring_leader.acquire_specific_result(closing_id);
+        WHACK(closed);
+      } else {
+        LOG("source did not take the closing acknowledgement.");
+      }
+    }
+    tran2->failed_deltas(ent, source_root, target_dir, failed);
+    if (pipelined && !failed.length()) {
+      BASE_LOG(astring("finished transfer from \"") + source_dir
+          + "\" to \"" + target_dir + "\"");
+      return OKAY;
+    }
+    // any deltas that didn't work out are fetched whole with plain requests.
+  }
 
   int iter = 0;
   while (true) {
@@ -200,6 +352,12 @@ LOG(ring_leader.responses().text_form());
     ongoing->_command = file_transfer_infoton::PLACE_FILE_CHUNKS;
     ongoing->_src_root = source_root;
     ongoing->_dest_root = target_dir;
+    // the source sends any files whose deltas we couldn't use again whole.
+    string_array more_failed;
+    tran2->failed_deltas(ent, source_root, target_dir, more_failed);
+    failed += more_failed;
+    if (failed.length()) failed.pack(ongoing->_packed_data);
+    failed.reset();
 
     octopus_request_id chunk_id(ent, iter + 10);
     outcome place_ret = ring_leader.evaluate(ongoing, chunk_id);
@@ -217,23 +375,8 @@ LOG(ring_leader.responses().text_form());
       break;
     }
 
-    byte_array copy = reply->_packed_data;
-    while (copy.length()) {
-      file_time empty;
-      file_transfer_header head(empty);
-      if (!head.unpack(copy)) 
-        RETURN_ERROR_RFC("failed to unpack header", GARBAGE);
-      if (copy.length() < head._length)
-        RETURN_ERROR_RFC("not enough length in array", GARBAGE);
-      if (head._length > 0)
-        copy.zap(0, head._length - 1);
-
-//hmmm: this needs better formatting, and should not repeat the same file name even
-//      if it's in multiple chunks.
-      BASE_LOG(head.readable_text_form());
-    }
-    if (copy.length())
-      RETURN_ERROR_RFC("still had data in array", GARBAGE);
+    if (!show_chunks(reply->_packed_data))
+      RETURN_ERROR_RFC("failed to unpack chunk headers", GARBAGE);
 
     octopus_request_id resp_id(ent, iter + 11);
     outcome resp_ret = client_spider.evaluate(reply, resp_id);
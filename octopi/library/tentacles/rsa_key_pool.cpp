@@ -0,0 +1,251 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : rsa_key_pool                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "encryption_infoton.h"
+#include "rsa_key_pool.h"
+
+#include <basis/functions.h>
+#include <crypto/rsa_crypto.h>
+#include <loggers/program_wide_logger.h>
+#include <processes/ethread.h>
+#include <structures/amorph.h>
+#include <structures/static_memory_gremlin.h>
+#include <structures/symbol_table.h>
+
+#ifdef __LINUX__
+  #include <sys/resource.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+using namespace basis;
+using namespace crypto;
+using namespace loggers;
+using namespace processes;
+using namespace structures;
+
+namespace octopi {
+
+#undef LOG
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+//#define DEBUG_RSA_KEY_POOL
+  // uncomment for noisier version.
+
+const int BACKGROUND_NICENESS = 19;
+  // the scheduling priority used for the key generation thread.
+
+#undef AUTO_LOCK
+#define AUTO_LOCK auto_synchronizer l(*_lock)
+
+//////////////
+
+class rsa_key_pool_filler : public ethread
+{
+public:
+  rsa_key_pool_filler(rsa_key_pool &parent)
+  : ethread(rsa_key_pool::DEFAULT_CHECK_INTERVAL, SLACK_INTERVAL),
+    _parent(parent), _demoted(false) {}
+
+  virtual void perform_activity(void *formal(ptr)) {
+    if (!_demoted) {
+      // drop our priority so that key generation only uses idle cpu time.
+      _demoted = true;
+#ifdef __LINUX__
+      // on linux, the niceness is actually per thread.
+      setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), BACKGROUND_NICENESS);
+#endif
+    }
+    _parent.top_up();
+  }
+
+private:
+  rsa_key_pool &_parent;
+  bool _demoted;  // true once our priority has been lowered.
+};
+
+//////////////
+
+rsa_key_pool::rsa_key_pool(int key_size, int pool_size, int refill_watermark)
+: _lock(new mutex),
+  _key_size(key_size),
+  _pool_size(1),
+  _watermark(0),
+  _refilling(true),
+  _cache_servers(false),
+  _keys(new amorph<rsa_crypto>),
+  _server_keys(new symbol_table<byte_array>),
+  _handed_out(0),
+  _dry_count(0),
+  _cache_hits(0),
+  _filler(new rsa_key_pool_filler(*this))
+{
+  configure(pool_size, refill_watermark);
+  _filler->start(NULL_POINTER);
+}
+
+rsa_key_pool::~rsa_key_pool()
+{
+  _filler->stop();
+  WHACK(_filler);
+  WHACK(_keys);
+  WHACK(_server_keys);
+  WHACK(_lock);
+}
+
+SAFE_STATIC(rsa_key_pool, __global_rsa_key_pool,
+    (encryption_infoton::RSA_KEY_SIZE))
+
+rsa_key_pool &rsa_key_pool::global_pool() { return __global_rsa_key_pool(); }
+
+void rsa_key_pool::configure(int pool_size, int refill_watermark)
+{
+  bool wake_filler = false;
+  {
+    AUTO_LOCK;
+    _pool_size = maximum(1, pool_size);
+    _watermark = minimum(maximum(0, refill_watermark), _pool_size - 1);
+    if (_keys->elements() > _pool_size) {
+      // trim the extras off the end.
+      _keys->zap(_pool_size, _keys->elements() - 1);
+    } else if (!_refilling && (_keys->elements() < _pool_size)) {
+      // the pool grew, so we start filling it now rather than waiting for
+      // the keys on hand to drop to the watermark.
+      _refilling = true;
+      wake_filler = true;
+    }
+  }
+  if (wake_filler) _filler->reschedule();
+}
+
+int rsa_key_pool::pool_size() const { AUTO_LOCK; return _pool_size; }
+
+int rsa_key_pool::refill_watermark() const { AUTO_LOCK; return _watermark; }
+
+void rsa_key_pool::cache_server_keys(bool remember)
+{
+  AUTO_LOCK;
+  _cache_servers = remember;
+  if (!remember) _server_keys->reset();
+}
+
+bool rsa_key_pool::caching_server_keys() const
+{ AUTO_LOCK; return _cache_servers; }
+
+int rsa_key_pool::available() const { AUTO_LOCK; return _keys->elements(); }
+
+int rsa_key_pool::keys_handed_out() const { AUTO_LOCK; return _handed_out; }
+
+int rsa_key_pool::times_run_dry() const { AUTO_LOCK; return _dry_count; }
+
+int rsa_key_pool::cache_hits() const { AUTO_LOCK; return _cache_hits; }
+
+bool rsa_key_pool::needs_keys() const
+{ return _refilling && (_keys->elements() < _pool_size); }
+
+crypto::rsa_crypto *rsa_key_pool::acquire()
+{
+  FUNCDEF("acquire");
+  rsa_crypto *to_return = NULL_POINTER;
+  bool wake_filler = false;
+  {
+    AUTO_LOCK;
+    _handed_out++;
+    if (_keys->elements()) {
+      to_return = _keys->acquire(_keys->elements() - 1);
+      _keys->zap(_keys->elements() - 1, _keys->elements() - 1);
+    } else {
+      _dry_count++;
+#ifdef DEBUG_RSA_KEY_POOL
+      LOG(a_sprintf("pool ran dry; %d of %d requests had to wait.",
+          _dry_count, _handed_out));
+#endif
+    }
+    if (!_refilling && (_keys->elements() <= _watermark)) {
+      _refilling = true;
+      wake_filler = true;
+    }
+  }
+  if (wake_filler) _filler->reschedule();
+  // if the pool was empty, we have no choice but to generate one right now.
+  if (!to_return) to_return = new rsa_crypto(_key_size);
+  return to_return;
+}
+
+crypto::rsa_crypto *rsa_key_pool::acquire_for(const astring &server)
+{
+  {
+    AUTO_LOCK;
+    if (_cache_servers) {
+      byte_array *found = _server_keys->find(server);
+      if (found) {
+        _cache_hits++;
+        return new rsa_crypto(*found);
+      }
+    }
+  }
+  rsa_crypto *to_return = acquire();
+  AUTO_LOCK;
+  if (_cache_servers) {
+    byte_array priv;
+    to_return->private_key(priv);
+    _server_keys->add(server, priv);
+  }
+  return to_return;
+}
+
+void rsa_key_pool::forget_server(const astring &server)
+{
+  AUTO_LOCK;
+  _server_keys->whack(server);
+}
+
+void rsa_key_pool::top_up()
+{
+  FUNCDEF("top_up");
+  while (!_filler->should_stop()) {
+    {
+      AUTO_LOCK;
+      if (!needs_keys()) {
+        _refilling = false;
+        return;
+      }
+    }
+    // the key is generated without holding our lock so that the pool can
+    // still be drawn from while we work.
+    rsa_crypto *fresh = new rsa_crypto(_key_size);
+    AUTO_LOCK;
+    if (_keys->elements() >= _pool_size) {
+      // someone shrank the pool while we were generating.
+      WHACK(fresh);
+      continue;
+    }
+    _keys->append(fresh);
+#ifdef DEBUG_RSA_KEY_POOL
+    LOG(a_sprintf("generated key; pool now has %d of %d.",
+        _keys->elements(), _pool_size));
+#endif
+  }
+}
+
+astring rsa_key_pool::text_form() const
+{
+  AUTO_LOCK;
+  return a_sprintf("rsa keys: %d of %d ready (refill at %d), %d handed out, "
+      "ran dry %d times, %d server cache hits", _keys->elements(), _pool_size,
+      _watermark, _handed_out, _dry_count, _cache_hits);
+}
+
+} //namespace.
+
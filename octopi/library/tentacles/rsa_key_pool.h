@@ -0,0 +1,146 @@
+#ifndef RSA_KEY_POOL_CLASS
+#define RSA_KEY_POOL_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : rsa_key_pool                                                      *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2004-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/astring.h>
+#include <basis/contracts.h>
+#include <basis/mutex.h>
+
+// forward.
+namespace crypto { class rsa_crypto; }
+namespace structures {
+  template <class contents> class amorph;
+  template <class contents> class symbol_table;
+}
+
+namespace octopi {
+
+// forward.
+class rsa_key_pool_filler;
+
+//! Keeps a stock of pre-generated RSA private keys for encrypted channels.
+/*!
+  Generating an RSA key is very expensive, and a client that is setting up
+  an encrypted connection would otherwise need to do that synchronously
+  before any data can flow.  The pool generates keys ahead of time on a
+  low-priority background thread and hands them out instantly.  When the
+  number of stored keys falls to the refill watermark, the background thread
+  is woken up to top the pool back up to its full size.  If the pool is empty
+  when a key is requested, the key is generated on the spot and the pool's
+  "dry" counter is incremented, which can be used to tune the pool size.
+
+  The pool can optionally remember the key that was used for a particular
+  server, so that a client reconnecting to the same server will reuse its
+  existing key pair rather than drawing a new one.
+
+  This class is thread-safe.
+*/
+
+class rsa_key_pool : public virtual basis::root_object
+{
+public:
+  enum pool_defaults {
+    DEFAULT_POOL_SIZE = 8,  //!< how many keys are kept ready.
+    DEFAULT_REFILL_WATERMARK = 4,  //!< refill when we drop to this many.
+    DEFAULT_CHECK_INTERVAL = 2 * basis::SECOND_ms
+      //!< how often the background thread looks at the pool when idle.
+  };
+
+  rsa_key_pool(int key_size, int pool_size = DEFAULT_POOL_SIZE,
+          int refill_watermark = DEFAULT_REFILL_WATERMARK);
+    //!< creates a pool of keys that are "key_size" bits long.
+    /*!< the pool will try to keep "pool_size" keys available and will start
+    generating more when the available count drops to "refill_watermark".
+    the background thread starts generating immediately. */
+
+  virtual ~rsa_key_pool();
+
+  DEFINE_CLASS_NAME("rsa_key_pool");
+
+  static rsa_key_pool &global_pool();
+    //!< the program-wide pool of keys sized for encryption_infoton use.
+    /*!< programs that expect to make encrypted connections can touch this
+    early on to get the pool filling before the first connection is made. */
+
+  void configure(int pool_size, int refill_watermark);
+    //!< changes the target "pool_size" and the "refill_watermark".
+    /*!< the watermark is clamped to be less than the pool size.  if the pool
+    now holds fewer keys than the new size, the refill starts right away. */
+
+  int pool_size() const;  //!< returns the number of keys we try to keep.
+  int refill_watermark() const;  //!< returns the current refill trigger level.
+
+  void cache_server_keys(bool remember);
+    //!< if "remember" is true, keys are kept per server across reconnects.
+    /*!< see acquire_for() for how the cache is used. */
+  bool caching_server_keys() const;
+    //!< reports whether keys are being remembered per server.
+
+  crypto::rsa_crypto *acquire();
+    //!< provides a new private key that is now owned by the caller.
+    /*!< the key comes from the pool if any are available.  otherwise one is
+    generated synchronously and the pool's dry count is incremented. */
+
+  crypto::rsa_crypto *acquire_for(const basis::astring &server);
+    //!< provides a private key to be used for talking to the "server".
+    /*!< if server key caching is enabled and we have previously handed out
+    a key for the "server", then a copy of that key is returned.  otherwise
+    this behaves like acquire() and remembers the key if caching is on.
+    the returned key is owned by the caller. */
+
+  void forget_server(const basis::astring &server);
+    //!< drops any cached key for the "server".
+
+  int available() const;  //!< the number of keys ready to be handed out.
+
+  int keys_handed_out() const;  //!< total keys provided by acquire methods.
+  int times_run_dry() const;
+    //!< the number of times a key was needed but the pool was empty.
+  int cache_hits() const;  //!< how many server keys were reused.
+
+  basis::astring text_form() const;
+    //!< reports the pool's statistics, including how often it ran dry.
+
+private:
+  friend class rsa_key_pool_filler;
+  basis::mutex *_lock;  //!< protects our lists and counters.
+  int _key_size;  //!< the number of bits in the keys we generate.
+  int _pool_size;  //!< the number of keys we aim to have ready.
+  int _watermark;  //!< when we drop to this many keys, we refill.
+  bool _refilling;  //!< true while we're topping the pool back up.
+  bool _cache_servers;  //!< true if keys are remembered per server.
+  structures::amorph<crypto::rsa_crypto> *_keys;  //!< the ready keys.
+  structures::symbol_table<basis::byte_array> *_server_keys;
+    //!< private keys previously used for particular servers.
+  int _handed_out;  //!< how many keys we've given out.
+  int _dry_count;  //!< how many times the pool had nothing to give.
+  int _cache_hits;  //!< how many times a server's key was reused.
+  rsa_key_pool_filler *_filler;  //!< the thread that creates new keys.
+
+  void top_up();
+    //!< invoked by the filler thread to generate keys as needed.
+  bool needs_keys() const;
+    //!< true if the pool is below its target size.  assumes we're locked.
+
+  // forbidden.
+  rsa_key_pool(const rsa_key_pool &);
+  rsa_key_pool &operator =(const rsa_key_pool &);
+};
+
+} //namespace.
+
+#endif
+
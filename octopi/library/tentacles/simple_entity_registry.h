@@ -17,6 +17,8 @@
 
 #include "entity_registry.h"
 
+#include <basis/mutex.h>
+
 namespace octopi {
 
 // forward.
@@ -0,0 +1,96 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : transfer_window                                                   *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include "file_transfer_infoton.h"
+#include "transfer_window.h"
+
+#include <basis/functions.h>
+#include <sockets/span_manager.h>
+
+using namespace basis;
+using namespace sockets;
+using namespace timely;
+
+namespace octopi {
+
+transfer_window::transfer_window(int maximum_chunk, int window)
+: _window(maximum(1, window)),
+  _maximum_chunk(maximum(int(MINIMUM_CHUNK), maximum_chunk)),
+  _chunk_size(minimum(int(MINIMUM_CHUNK) * 4, _maximum_chunk)),
+  _next_sequence(0),
+  _final_sequence(-1),
+  _received(new span_manager(4 * _window)),
+  _pending(),
+  _sent()
+{}
+
+transfer_window::~transfer_window() { WHACK(_received); }
+
+bool transfer_window::can_request() const
+{ return negative(_final_sequence) && (_pending.length() < _window); }
+
+file_chunk_ticket transfer_window::next_request()
+{
+  file_chunk_ticket to_return(_next_sequence++, _chunk_size, _window);
+  _received->make_received_list(to_return._received);
+  _pending.concatenate(to_return._sequence);
+  _sent.concatenate(time_stamp());
+  return to_return;
+}
+
+file_chunk_ticket transfer_window::closing_request() const
+{
+  file_chunk_ticket to_return(_next_sequence, _chunk_size, _window);
+  to_return._finished = true;
+  _received->make_received_list(to_return._received);
+  return to_return;
+}
+
+bool transfer_window::received(const file_chunk_ticket &response, int bytes)
+{
+  int indy = -1;
+  for (int i = 0; i < _pending.length(); i++) {
+    if (_pending[i] == response._sequence) { indy = i; break; }
+  }
+  if (negative(indy)) return false;  // we didn't ask for that.
+  double elapsed = time_stamp().value() - _sent[indy].value();
+  _pending.zap(indy, indy);
+  _sent.zap(indy, indy);
+
+  // the span manager has to be big enough for every chunk we've asked for.
+  if (response._sequence >= _received->vector().bits())
+    _received->vector().resize(2 * _next_sequence);
+  _received->vector().light(response._sequence);
+  if (response._finished && (negative(_final_sequence)
+      || (response._sequence < _final_sequence)) )
+    _final_sequence = response._sequence;
+
+  // full chunks that came back quickly mean we can ask for more at once, but
+  // slow ones mean the link or the disk is struggling.
+  if (elapsed > TARGET_CHUNK_TIME)
+    _chunk_size = maximum(int(MINIMUM_CHUNK), _chunk_size / 2);
+  else if ( (elapsed < TARGET_CHUNK_TIME / 2) && (bytes >= _chunk_size / 2) )
+    _chunk_size = minimum(_maximum_chunk, _chunk_size * 2);
+  return true;
+}
+
+bool transfer_window::done() const
+{
+  // every chunk up to the final one must have arrived.
+  return !negative(_final_sequence)
+      && (_received->received_sequence() >= _final_sequence);
+}
+
+} //namespace.
+
@@ -0,0 +1,105 @@
+#ifndef TRANSFER_WINDOW_CLASS
+#define TRANSFER_WINDOW_CLASS
+
+/*****************************************************************************\
+*                                                                             *
+*  Name   : transfer_window                                                   *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <basis/array.h>
+#include <basis/contracts.h>
+#include <timely/time_stamp.h>
+
+// forward.
+namespace sockets { class span_manager; }
+
+namespace octopi {
+
+// forward.
+class file_chunk_ticket;
+
+//! Tracks the chunk requests of a pipelined file transfer on the destination.
+/*!
+  Rather than waiting for each chunk to arrive before asking for the next
+  one, the destination keeps up to a "window" of PIPELINED_CHUNKS requests
+  outstanding, so the link stays full even when the round trip is long.
+  The chunks that have arrived are recorded in a sockets::span_manager and
+  reported back to the source with every request.  The chunk size adapts
+  to how long each chunk takes: quick chunks make the next ones larger and
+  slow ones make them smaller, within the limits given.
+*/
+
+class transfer_window : public virtual basis::root_object
+{
+public:
+  enum window_defaults {
+    DEFAULT_WINDOW = 8,  //!< the number of requests kept outstanding.
+    MINIMUM_CHUNK = 16 * basis::KILOBYTE,  //!< the smallest chunk requested.
+    TARGET_CHUNK_TIME = 250  //!< the milliseconds a chunk should take.
+  };
+
+  transfer_window(int maximum_chunk, int window = DEFAULT_WINDOW);
+    //!< allows up to "window" requests outstanding for at most "maximum_chunk".
+    /*!< the chunk size starts out small and grows to "maximum_chunk". */
+
+  virtual ~transfer_window();
+
+  DEFINE_CLASS_NAME("transfer_window");
+
+  int window() const { return _window; }  //!< the outstanding request limit.
+  int chunk_size() const { return _chunk_size; }  //!< the size asked for next.
+  int outstanding() const { return _pending.length(); }
+    //!< the number of requests that haven't been answered yet.
+
+  bool can_request() const;
+    //!< true if there's room in the window and the end hasn't been seen.
+
+  file_chunk_ticket next_request();
+    //!< creates the ticket for the next chunk to request.
+    /*!< the ticket also reports all the chunks received so far. */
+
+  file_chunk_ticket closing_request() const;
+    //!< creates a ticket telling the source that the transfer has arrived.
+    /*!< this is only meaningful once done() is true.  the ticket is marked as
+    finished and reports every chunk, so the source can let go of the chunks
+    it was keeping in case they had to be sent again. */
+
+  bool received(const file_chunk_ticket &response, int bytes);
+    //!< records the arrival of a chunk with "bytes" of content.
+    /*!< false is returned if the chunk was never asked for or has already
+    been received. */
+
+  bool done() const;
+    //!< true once the final chunk and everything before it has arrived.
+
+  const sockets::span_manager &spans() const { return *_received; }
+    //!< the record of which chunks have arrived.
+
+private:
+  int _window;  //!< the most requests outstanding at once.
+  int _maximum_chunk;  //!< the largest chunk to ask for.
+  int _chunk_size;  //!< the current size being requested.
+  int _next_sequence;  //!< the sequence number for the next request.
+  int _final_sequence;  //!< the sequence that was finished, or negative.
+  sockets::span_manager *_received;  //!< which chunks have arrived.
+  basis::int_array _pending;  //!< sequences that are still outstanding.
+  basis::array<timely::time_stamp> _sent;  //!< when each pending one was sent.
+
+  // not appropriate.
+  transfer_window(const transfer_window &);
+  transfer_window &operator =(const transfer_window &);
+};
+
+} //namespace.
+
+#endif
+
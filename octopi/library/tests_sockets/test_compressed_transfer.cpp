@@ -0,0 +1,304 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_compressed_transfer                                          *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks that compressed file transfer chunks come back out intact, and    *
+*  reports the effective throughput of each codec over a local socket that    *
+*  is throttled down to several link speeds.                                  *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2005-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <sockets/internet_address.h>
+#include <sockets/spocket.h>
+#include <structures/static_memory_gremlin.h>
+#include <tentacles/chunk_compressor.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace octopi;
+using namespace sockets;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int CHUNK_SIZE = 64 * KILOBYTE;
+  // the size of each chunk sent, before any compression.
+
+const int LINK_SPEEDS[] = { 1, 10, 100, 1000 };
+  // the throttled link speeds tried, in megabits per second.
+
+const int MAXIMUM_DATA = 8 * MEGABYTE;
+  // the most data sent at any one speed.
+
+const int MINIMUM_DATA = 256 * KILOBYTE;
+  // the least data sent at any one speed.
+
+const int BENCHMARK_PORT = 12391;
+  // where the local socket pair meets.
+
+const int TRANSFER_TIMEOUT = 2 * MINUTE_ms;
+  // the longest any single run may take.
+
+class test_compressed_transfer
+: public virtual unit_base, virtual public application_shell
+{
+public:
+  test_compressed_transfer() : application_shell(), _seed(4321) {}
+  DEFINE_CLASS_NAME("test_compressed_transfer");
+  virtual int execute();
+
+private:
+  un_int _seed;  // the state of our random generator.
+
+  un_int next_random();
+  void make_text(byte_array &data, int size);
+  void make_noise(byte_array &data, int size);
+  bool run(spocket &sender, spocket &receiver, const byte_array &data,
+          int codec, int megabits, double &elapsed, double &wire_bytes);
+};
+
+un_int test_compressed_transfer::next_random()
+{
+  _seed = _seed * 1103515245 + 12345;
+  return _seed >> 16;
+}
+
+// fills "data" with something like the source code and logs that make up
+// most transfers.
+
+void test_compressed_transfer::make_text(byte_array &data, int size)
+{
+  const char *words[] = { "outcome", "return", "the", "byte_array", "if",
+      "const", "int", "log", "transfer", "chunk", "=", "{", "}", "file",
+      "astring", "while", "for", "(i", "0;", "basis::", "failed", "to" };
+  const int word_count = sizeof(words) / sizeof(char *);
+  astring text;
+  while (text.length() < size) {
+    int words_in_line = 4 + next_random() % 8;
+    text += astring(' ', 2 * (next_random() % 4));
+    for (int i = 0; i < words_in_line; i++) {
+      text += words[next_random() % word_count];
+      text += (i + 1 < words_in_line)? " " : a_sprintf(" %d;\n",
+          int(next_random() % 1000));
+    }
+  }
+  data = byte_array(size, (const abyte *)text.s());
+}
+
+// fills "data" with bytes that can't be compressed, like an archive would.
+
+void test_compressed_transfer::make_noise(byte_array &data, int size)
+{
+  data.reset(size);
+  for (int i = 0; i < size; i++) data[i] = abyte(next_random());
+}
+
+// sends all of the "data" from the "sender" to the "receiver", compressing
+// it with the "codec", but never faster than "megabits" per second allows.
+// the receiver expands each chunk and checks it against the original.
+
+bool test_compressed_transfer::run(spocket &sender, spocket &receiver,
+    const byte_array &data, int codec, int megabits, double &elapsed,
+    double &wire_bytes)
+{
+  FUNCDEF("run");
+  const double bytes_per_ms = double(megabits) * 1000.0 / 8.0;
+  const int frame_header = sizeof(abyte) + 2 * sizeof(int);
+  byte_array outgoing;  // framed chunks waiting for the link.
+  byte_array incoming;  // bytes received but not yet made into chunks.
+  int next_chunk = 0;  // where the next chunk starts in the data.
+  int checked = 0;  // how much of the data has arrived intact.
+  wire_bytes = 0;
+  time_stamp started;
+  time_stamp when_to_leave(TRANSFER_TIMEOUT);
+
+  while (checked < data.length()) {
+    if (time_stamp() > when_to_leave) {
+      LOG(a_sprintf("timed out after %d bytes.", checked));
+      return false;
+    }
+    bool busy = false;
+
+    if (!outgoing.length() && (next_chunk < data.length())) {
+      // the compression is counted in the elapsed time, as it would be.
+      byte_array piece = data.subarray(next_chunk,
+          minimum(next_chunk + CHUNK_SIZE, data.length()) - 1);
+      int original = piece.length();
+      int used = chunk_compressor::compress(codec, piece);
+      attach(outgoing, abyte(used));
+      attach(outgoing, original);
+      attach(outgoing, piece.length());
+      outgoing += piece;
+      next_chunk += original;
+    }
+
+    // the throttle only lets out what the link could have carried by now.
+    double allowed = bytes_per_ms * (time_stamp().value() - started.value())
+        - wire_bytes;
+    if (outgoing.length() && (allowed >= 1.0)) {
+      int len_sent = 0;
+      outcome ret = sender.send(outgoing.observe(),
+          int(minimum(allowed, double(outgoing.length()))), len_sent);
+      if ( (ret == spocket::OKAY) || (ret == spocket::PARTIAL) ) {
+        if (len_sent > 0) outgoing.zap(0, len_sent - 1);
+        wire_bytes += len_sent;
+        busy = true;
+      } else if (ret != spocket::NONE_READY) {
+        LOG(astring("failed to send: ") + spocket::outcome_name(ret));
+        return false;
+      }
+    }
+
+    byte_array got;
+    int len = CHUNK_SIZE;
+    outcome ret = receiver.receive(got, len);
+    if (ret == spocket::OKAY) {
+      incoming += got;
+      busy = true;
+    } else if (ret != spocket::NONE_READY) {
+      LOG(astring("failed to receive: ") + spocket::outcome_name(ret));
+      return false;
+    }
+
+    // unpack every complete chunk that has arrived.
+    while (incoming.length() >= frame_header) {
+      byte_array head = incoming.subarray(0, frame_header - 1);
+      abyte used;
+      int original, length;
+      detach(head, used);
+      detach(head, original);
+      detach(head, length);
+      if (incoming.length() < frame_header + length) break;
+      byte_array piece = incoming.subarray(frame_header,
+          frame_header + length - 1);
+      incoming.zap(0, frame_header + length - 1);
+      byte_array expected = data.subarray(checked, checked + original - 1);
+      if (!chunk_compressor::decompress(used, original, piece)
+          || (piece != expected) ) {
+        LOG(a_sprintf("chunk at %d did not survive the trip.", checked));
+        return false;
+      }
+      checked += original;
+    }
+
+    if (!busy) time_control::sleep_ms(1);
+  }
+  elapsed = time_stamp().value() - started.value();
+  return true;
+}
+
+int test_compressed_transfer::execute()
+{
+  FUNCDEF("execute");
+
+  // the codecs must give back exactly what they were given.
+  {
+    byte_array text;
+    make_text(text, 300 * KILOBYTE + 13);
+    for (int codec = chunk_compressor::ZLIB_FAST;
+        codec <= chunk_compressor::LAST_CODEC; codec++) {
+      byte_array copy = text;
+      int used = chunk_compressor::compress(codec, copy);
+      ASSERT_EQUAL(used, codec, "text should be compressed");
+      ASSERT_TRUE(copy.length() < text.length() / 3, "text should shrink a lot");
+      ASSERT_TRUE(chunk_compressor::decompress(used, text.length(), copy),
+          "compressed text should expand");
+      ASSERT_TRUE(copy == text, "expanded text should match");
+    }
+
+    byte_array noise;
+    make_noise(noise, 300 * KILOBYTE);
+    ASSERT_FALSE(chunk_compressor::worth_compressing(noise),
+        "noise should be spotted from the sample");
+    byte_array copy = noise;
+    ASSERT_EQUAL(chunk_compressor::compress(chunk_compressor::ZLIB_BEST, copy),
+        int(chunk_compressor::RAW), "noise should be sent raw");
+    ASSERT_TRUE(copy == noise, "raw noise should be left alone");
+
+    byte_array tiny(10, (const abyte *)"abcabcabca");
+    ASSERT_EQUAL(chunk_compressor::compress(chunk_compressor::ZLIB_FAST, tiny),
+        int(chunk_compressor::RAW), "tiny chunks should be sent raw");
+    ASSERT_EQUAL(chunk_compressor::compress(chunk_compressor::LAST_CODEC + 1, text),
+        int(chunk_compressor::RAW), "unknown codecs should be sent raw");
+
+    copy = text;
+    chunk_compressor::compress(chunk_compressor::ZLIB_FAST, copy);
+    ASSERT_FALSE(chunk_compressor::decompress(chunk_compressor::ZLIB_FAST,
+        text.length() - 1, copy), "the wrong size should be caught");
+    copy.zap(copy.length() / 2, copy.length() - 1);
+    ASSERT_FALSE(chunk_compressor::decompress(chunk_compressor::ZLIB_FAST,
+        text.length(), copy), "truncated chunks should be caught");
+  }
+
+  // hook up a pair of local sockets for the benchmark.
+  abyte localhost[] = { 127, 0, 0, 1 };
+  internet_address where(byte_array(4, localhost), "", BENCHMARK_PORT);
+  spocket root(where);
+  spocket *receiver = NULL_POINTER;
+  root.accept(receiver, false);  // starts listening.
+  spocket sender(where);
+  ASSERT_EQUAL(sender.connect().value(), int(spocket::OKAY), "local connect should work");
+  time_stamp when_to_leave(10 * SECOND_ms);
+  while (!receiver && (time_stamp() < when_to_leave)) {
+    if (root.accept(receiver, false) != spocket::OKAY) time_control::sleep_ms(10);
+  }
+  ASSERT_NON_NULL(receiver, "local accept should work");
+
+  byte_array text, noise;
+  make_text(text, MAXIMUM_DATA);
+  make_noise(noise, MAXIMUM_DATA);
+
+  const int codecs[] = { chunk_compressor::RAW, chunk_compressor::ZLIB_FAST,
+      chunk_compressor::ZLIB_BEST };
+  for (int s = 0; s < int(sizeof(LINK_SPEEDS) / sizeof(int)); s++) {
+    // send about a second's worth of data at the full link speed.
+    int megabits = LINK_SPEEDS[s];
+    int size = minimum(MAXIMUM_DATA, maximum(MINIMUM_DATA,
+        megabits * 1000 * 1000 / 8));
+    for (int kind = 0; kind < 2; kind++) {
+      byte_array data = (kind? noise : text).subarray(0, size - 1);
+      for (int c = 0; c < int(sizeof(codecs) / sizeof(int)); c++) {
+        // the noise only needs to show it isn't slowed down.
+        if (kind && (codecs[c] == chunk_compressor::ZLIB_BEST)) continue;
+        double elapsed = 0, wire_bytes = 0;
+        bool worked = run(sender, *receiver, data, codecs[c], megabits,
+            elapsed, wire_bytes);
+        ASSERT_TRUE(worked, "chunks should all arrive intact");
+        if (!worked) break;
+        double effective = double(size) * 8.0 / 1000.0 / maximum(1.0, elapsed);
+        log(a_sprintf("%4d Mbit/s link, %s %s: %.1f KB became %.1f KB on the "
+            "wire in %.0f ms, effectively %.1f Mbit/s", megabits,
+            kind? "noise" : "text ", chunk_compressor::codec_name(codecs[c]),
+            double(size) / KILOBYTE, wire_bytes / KILOBYTE, elapsed, effective));
+      }
+    }
+  }
+
+  WHACK(receiver);
+  return final_report();
+}
+
+HOOPLE_MAIN(test_compressed_transfer, )
+
@@ -0,0 +1,184 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_rsa_key_pool                                                 *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks that the pool of pre-generated RSA keys hands out keys, refills   *
+*  itself at the watermark and when it is enlarged, and gives back the same   *
+*  key for a server when server keys are being cached.                        *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/byte_array.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <crypto/rsa_crypto.h>
+#include <loggers/program_wide_logger.h>
+#include <structures/static_memory_gremlin.h>
+#include <tentacles/rsa_key_pool.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace crypto;
+using namespace loggers;
+using namespace octopi;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int KEY_SIZE = 1024;
+  // small keys keep the background generation quick.
+
+const int FILL_TIMEOUT = 2 * MINUTE_ms;
+  // the longest we'll wait for the pool to reach a particular size.
+
+//////////////
+
+class test_rsa_key_pool : public virtual unit_base, public virtual application_shell
+{
+public:
+  test_rsa_key_pool() : application_shell() {}
+  DEFINE_CLASS_NAME("test_rsa_key_pool");
+  virtual int execute();
+
+private:
+  bool wait_for_keys(const rsa_key_pool &pool, int wanted);
+    //!< waits until the "pool" has "wanted" keys ready, or gives up.
+
+  static byte_array key_of(const rsa_crypto &key);
+    //!< returns the private key data in "key" for comparisons.
+
+  void test_refilling();
+  void test_enlarging();
+  void test_server_cache();
+};
+
+bool test_rsa_key_pool::wait_for_keys(const rsa_key_pool &pool, int wanted)
+{
+  time_stamp when_to_leave(FILL_TIMEOUT);
+  while (pool.available() < wanted) {
+    if (time_stamp() > when_to_leave) return false;
+    time_control::sleep_ms(10);
+  }
+  return true;
+}
+
+byte_array test_rsa_key_pool::key_of(const rsa_crypto &key)
+{
+  byte_array to_return;
+  key.private_key(to_return);
+  return to_return;
+}
+
+void test_rsa_key_pool::test_refilling()
+{
+  FUNCDEF("test_refilling");
+  rsa_key_pool pool(KEY_SIZE, 4, 2);
+  ASSERT_EQUAL(pool.pool_size(), 4, "pool size should be as constructed");
+  ASSERT_EQUAL(pool.refill_watermark(), 2, "watermark should be as constructed");
+  ASSERT_TRUE(wait_for_keys(pool, 4), "pool should fill up in the background");
+
+  // drawing one key leaves us above the watermark, so no refill happens.
+  rsa_crypto *first = pool.acquire();
+  ASSERT_TRUE(first, "a key should be handed out");
+  ASSERT_EQUAL(pool.available(), 3, "one key should have been taken");
+  ASSERT_EQUAL(pool.times_run_dry(), 0, "a full pool should not run dry");
+  time_control::sleep_ms(2 * rsa_key_pool::DEFAULT_CHECK_INTERVAL);
+  ASSERT_EQUAL(pool.available(), 3, "no refill should start above the watermark");
+
+  // dropping to the watermark wakes the filler up.
+  rsa_crypto *second = pool.acquire();
+  ASSERT_TRUE(second, "another key should be handed out");
+  ASSERT_TRUE(wait_for_keys(pool, 4), "pool should refill from the watermark");
+  ASSERT_EQUAL(pool.keys_handed_out(), 2, "two keys should be counted");
+  ASSERT_FALSE(key_of(*first) == key_of(*second),
+      "separate acquisitions should get separate keys");
+  WHACK(first);
+  WHACK(second);
+
+  // shrinking the pool trims the extras right away.
+  pool.configure(2, 9);
+  ASSERT_EQUAL(pool.available(), 2, "shrinking should trim the ready keys");
+  ASSERT_EQUAL(pool.refill_watermark(), 1, "watermark should stay below the size");
+}
+
+void test_rsa_key_pool::test_enlarging()
+{
+  FUNCDEF("test_enlarging");
+  rsa_key_pool pool(KEY_SIZE, 2, 0);
+  ASSERT_TRUE(wait_for_keys(pool, 2), "pool should fill up in the background");
+  // the keys on hand are far above the new watermark, but they're short of
+  // the new size, so the filler should get going anyway.
+  pool.configure(5, 1);
+  ASSERT_TRUE(wait_for_keys(pool, 5), "enlarging should start a refill");
+  ASSERT_EQUAL(pool.times_run_dry(), 0, "the pool should not have run dry");
+}
+
+void test_rsa_key_pool::test_server_cache()
+{
+  FUNCDEF("test_server_cache");
+  rsa_key_pool pool(KEY_SIZE, 3, 1);
+  ASSERT_TRUE(wait_for_keys(pool, 3), "pool should fill up in the background");
+
+  // without caching, each connection gets a fresh key.
+  rsa_crypto *uncached1 = pool.acquire_for("hostA");
+  rsa_crypto *uncached2 = pool.acquire_for("hostA");
+  ASSERT_FALSE(key_of(*uncached1) == key_of(*uncached2),
+      "keys should not be reused when caching is off");
+  ASSERT_EQUAL(pool.cache_hits(), 0, "there should be no cache hits yet");
+  WHACK(uncached1);
+  WHACK(uncached2);
+
+  pool.cache_server_keys(true);
+  ASSERT_TRUE(pool.caching_server_keys(), "caching should now be on");
+  rsa_crypto *a1 = pool.acquire_for("hostA");
+  rsa_crypto *b1 = pool.acquire_for("hostB");
+  rsa_crypto *a2 = pool.acquire_for("hostA");
+  ASSERT_TRUE(key_of(*a1) == key_of(*a2), "reconnecting should reuse the key");
+  ASSERT_FALSE(key_of(*a1) == key_of(*b1), "other servers get their own keys");
+  ASSERT_EQUAL(pool.cache_hits(), 1, "the reuse should count as a cache hit");
+
+  // once forgotten, the server gets a new key.
+  pool.forget_server("hostA");
+  rsa_crypto *a3 = pool.acquire_for("hostA");
+  ASSERT_FALSE(key_of(*a1) == key_of(*a3), "a forgotten server gets a new key");
+  rsa_crypto *b2 = pool.acquire_for("hostB");
+  ASSERT_TRUE(key_of(*b1) == key_of(*b2), "other cached servers are untouched");
+  ASSERT_EQUAL(pool.cache_hits(), 2, "both reuses should be counted");
+
+  // turning caching off drops everything that was remembered.
+  pool.cache_server_keys(false);
+  pool.cache_server_keys(true);
+  rsa_crypto *b3 = pool.acquire_for("hostB");
+  ASSERT_FALSE(key_of(*b1) == key_of(*b3), "the cache should have been cleared");
+  WHACK(a1); WHACK(a2); WHACK(a3);
+  WHACK(b1); WHACK(b2); WHACK(b3);
+}
+
+int test_rsa_key_pool::execute()
+{
+  FUNCDEF("execute");
+  test_refilling();
+  test_enlarging();
+  test_server_cache();
+  return final_report();
+}
+
+HOOPLE_MAIN(test_rsa_key_pool, )
+
@@ -20,6 +20,7 @@
 #include <sockets/sequence_tracker.h>
 #include <structures/set.h>
 #include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
 #include <unit_test/unit_base.h>
 
 //#include <stdio.h>
@@ -37,14 +38,94 @@ using namespace unit_test;
 
 #define LOG(to_print) EMERGENCY_LOG(program_wide_logger().get(), astring(to_print))
 
+const int BENCHMARK_HOSTS = 500;
+  // how many hosts are chattering during the throughput test.
+
+const int BENCHMARK_SEQUENCES = 2000;
+  // how many sequences each of those hosts sends.
+
 class test_sequence_tracker : public virtual unit_base, virtual public application_shell
 {
 public:
   test_sequence_tracker() {}
   DEFINE_CLASS_NAME("test_sequence_tracker");
   virtual int execute();
+  void test_windowing();
+  void test_throughput();
 };
 
+void test_sequence_tracker::test_windowing()
+{
+  FUNCDEF("test_windowing");
+  abyte addr[] = { 10, 0, 0, 7 };
+  machine_uid host(machine_uid::TCPIP_LOCATION, byte_array(4, addr));
+  sequence_tracker tracker(1 * MINUTE_ms, 10 * MINUTE_ms);
+
+  // receive some sequences out of order, leaving a hole at 3.
+  tracker.add_pair(host, 1);
+  tracker.add_pair(host, 2);
+  tracker.add_pair(host, 5);
+  tracker.add_pair(host, 4);
+  ASSERT_TRUE(tracker.have_seen(host, 2), "in order sequence should be seen");
+  ASSERT_TRUE(tracker.have_seen(host, 5), "early sequence should be seen");
+  ASSERT_FALSE(tracker.have_seen(host, 3), "the hole should not be seen");
+  ASSERT_FALSE(tracker.have_seen(host, 6), "future sequence should not be seen");
+  // filling the hole should absorb everything after it.
+  tracker.add_pair(host, 3);
+  tracker.add_pair(host, 5);  // a duplicate.
+  ASSERT_TRUE(tracker.have_seen(host, 3), "filled hole should be seen");
+  ASSERT_FALSE(tracker.have_seen(host, 6), "still no sign of the next one");
+
+  // a sequence far past the window pushes out the oldest missing ones.
+  tracker.add_pair(host, 7);
+  tracker.add_pair(host, 9000);
+  ASSERT_TRUE(tracker.have_seen(host, 6), "sequences left behind count as seen");
+  ASSERT_TRUE(tracker.have_seen(host, 9000), "the far sequence should be seen");
+  ASSERT_FALSE(tracker.have_seen(host, 8999), "recent holes should remain");
+
+  // unknown hosts have never been seen.
+  abyte other_addr[] = { 10, 0, 0, 8 };
+  machine_uid other(machine_uid::TCPIP_LOCATION, byte_array(4, other_addr));
+  ASSERT_FALSE(tracker.have_seen(other, 1), "other host should be unknown");
+  tracker.clean_up();
+  ASSERT_TRUE(tracker.have_seen(host, 9000), "cleaning keeps recent sequences");
+}
+
+void test_sequence_tracker::test_throughput()
+{
+  FUNCDEF("test_throughput");
+  sequence_tracker tracker(1 * MINUTE_ms, 10 * MINUTE_ms);
+  array<machine_uid> hosts;
+  for (int h = 0; h < BENCHMARK_HOSTS; h++) {
+    abyte addr[] = { 10, 1, abyte(h / 256), abyte(h % 256) };
+    hosts += machine_uid(machine_uid::TCPIP_LOCATION, byte_array(4, addr));
+  }
+
+  // every host sends its sequences, with each pair of them swapped to keep
+  // things out of order.  the receive loop checks before adding.
+  time_stamp start;
+  int duplicates = 0;
+  for (int seq = 1; seq <= BENCHMARK_SEQUENCES; seq += 2) {
+    for (int h = 0; h < BENCHMARK_HOSTS; h++) {
+      if (tracker.have_seen(hosts[h], seq + 1)) duplicates++;
+      tracker.add_pair(hosts[h], seq + 1);
+      if (tracker.have_seen(hosts[h], seq)) duplicates++;
+      tracker.add_pair(hosts[h], seq);
+    }
+    if (seq % 500 == 1) tracker.clean_up();
+  }
+  double duration = time_stamp().value() - start.value();
+  ASSERT_EQUAL(duplicates, 0, "no sequence should be a duplicate");
+  for (int h = 0; h < BENCHMARK_HOSTS; h += 37)
+    ASSERT_TRUE(tracker.have_seen(hosts[h], BENCHMARK_SEQUENCES),
+        "last sequence should be seen");
+
+  double pairs = double(BENCHMARK_HOSTS) * BENCHMARK_SEQUENCES;
+  log(a_sprintf("checked and added %.0f sequences from %d hosts in %.0f ms "
+      "(%.0f per second).", pairs, BENCHMARK_HOSTS, duration,
+      pairs / maximum(duration, 1.0) * SECOND_ms));
+}
+
 int test_sequence_tracker::execute()
 {
   FUNCDEF("execute");
@@ -112,6 +193,9 @@ int test_sequence_tracker::execute()
     }
   }
 
+  test_windowing();
+  test_throughput();
+
   return final_report();
 }
 
@@ -12,6 +12,7 @@
 * Please send any updates to: fred@gruntose.com                               *
 \*****************************************************************************/
 
+#include <application/command_line.h>
 #include <application/hoople_main.h>
 #include <basis/array.h>
 #include <basis/functions.h>
@@ -19,6 +20,7 @@
 #include <loggers/file_logger.h>
 #include <sockets/span_manager.h>
 #include <structures/static_memory_gremlin.h>
+#include <timely/time_stamp.h>
 #include <unit_test/unit_base.h>
 
 using namespace application;
@@ -29,7 +31,7 @@ using namespace loggers;
 using namespace sockets;
 using namespace structures;
 //using namespace textual;
-//using namespace timely;
+using namespace timely;
 using namespace unit_test;
 
 #define LOG(to_print) EMERGENCY_LOG(program_wide_logger().get(), astring(to_print))
@@ -39,6 +41,14 @@ using namespace unit_test;
 
 #define MAX_SPANS 8
 
+const int SMALL_BENCHMARK_CHUNKS = 1000000;
+const int LARGE_BENCHMARK_CHUNKS = 100000000;
+  // the number of chunks tracked when timing the span lists.  the large
+  // count is only timed when the test is passed the "--large" flag.
+
+const int HOLE_SPACING = 997;
+  // how far apart the missing chunks are in the benchmark.
+
 // INIT_STUFF gets the macros ready for use.
 #define INIT_STUFF int_array stuffer;
 
@@ -66,8 +76,39 @@ public:
   test_span_manager() {}
   DEFINE_CLASS_NAME("test_span_manager");
   virtual int execute();
+  void time_span_lists(int chunks);
 };
 
+void test_span_manager::time_span_lists(int chunks)
+{
+  FUNCDEF("time_span_lists");
+  span_manager tracker(chunks);
+  int_array spans;
+  spans.concatenate(0);
+  spans.concatenate(chunks - 1);
+  tracker.update(spans);
+  int holes = 0;
+  for (int i = HOLE_SPACING; i < chunks; i += HOLE_SPACING) {
+    tracker.vector().clear(i);
+    holes++;
+  }
+
+  time_stamp start;
+  tracker.make_missing_list(spans);
+  double missing_time = time_stamp().value() - start.value();
+  ASSERT_EQUAL(spans.length(), 2 * holes, "every hole should be listed");
+  ASSERT_EQUAL(spans[spans.length() - 1], holes * HOLE_SPACING,
+      "the last hole should be listed at its real position");
+
+  start.reset();
+  tracker.make_received_list(spans);
+  double received_time = time_stamp().value() - start.value();
+  ASSERT_EQUAL(spans.length(), 2 * (holes + 1), "every run should be listed");
+
+  log(a_sprintf("%d chunks with %d holes: missing list in %.0f ms, received "
+      "list in %.0f ms.", chunks, holes, missing_time, received_time));
+}
+
 int test_span_manager::execute()
 {
   FUNCDEF("execute");
@@ -151,6 +192,12 @@ int test_span_manager::execute()
 #endif
   ASSERT_EQUAL(fred.received_sequence(), 451, "received sequence should be filled out");
 
+  time_span_lists(SMALL_BENCHMARK_CHUNKS);
+  command_line cmds(_global_argc, _global_argv);
+  int indy = 0;
+  if (cmds.find("large", indy))
+    time_span_lists(LARGE_BENCHMARK_CHUNKS);
+
   return final_report();
 }
 
@@ -0,0 +1,169 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_transfer_window                                              *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks the bookkeeping for pipelined file transfers: the window of       *
+*  outstanding requests, replies that show up out of order, the chunk size    *
+*  adapting to the reply times, and spotting the end of the transfer.         *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2026-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <basis/functions.h>
+#include <basis/guards.h>
+#include <loggers/program_wide_logger.h>
+#include <sockets/span_manager.h>
+#include <structures/static_memory_gremlin.h>
+#include <tentacles/file_transfer_infoton.h>
+#include <tentacles/transfer_window.h>
+#include <timely/time_control.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace octopi;
+using namespace sockets;
+using namespace structures;
+using namespace timely;
+using namespace unit_test;
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+const int MIN_CHUNK = transfer_window::MINIMUM_CHUNK;
+  // shorthand for the smallest chunk the window will ask for.
+
+//////////////
+
+class test_transfer_window : public virtual unit_base, public virtual application_shell
+{
+public:
+  test_transfer_window() : application_shell() {}
+  DEFINE_CLASS_NAME("test_transfer_window");
+  virtual int execute();
+
+private:
+  static file_chunk_ticket reply(int sequence, bool finished = false);
+    //!< makes the ticket that the source would send back for "sequence".
+
+  void test_limits();
+  void test_out_of_order();
+};
+
+file_chunk_ticket test_transfer_window::reply(int sequence, bool finished)
+{
+  file_chunk_ticket to_return(sequence);
+  to_return._finished = finished;
+  return to_return;
+}
+
+void test_transfer_window::test_limits()
+{
+  FUNCDEF("test_limits");
+  transfer_window tiny(100, 0);
+  ASSERT_EQUAL(tiny.window(), 1, "the window should hold at least one request");
+  ASSERT_EQUAL(tiny.chunk_size(), MIN_CHUNK,
+      "the chunk size should not go below the minimum");
+  ASSERT_FALSE(tiny.done(), "nothing has arrived yet");
+
+  transfer_window big(64 * MIN_CHUNK);
+  ASSERT_EQUAL(big.window(), int(transfer_window::DEFAULT_WINDOW),
+      "the default window should be used");
+  ASSERT_EQUAL(big.chunk_size(), 4 * MIN_CHUNK, "the chunk size should start out small");
+}
+
+void test_transfer_window::test_out_of_order()
+{
+  FUNCDEF("test_out_of_order");
+  transfer_window window(8 * MIN_CHUNK, 3);
+
+  // fill the window up.
+  file_chunk_ticket r0 = window.next_request();
+  file_chunk_ticket r1 = window.next_request();
+  file_chunk_ticket r2 = window.next_request();
+  ASSERT_EQUAL(r0._sequence, 0, "the first request should be chunk zero");
+  ASSERT_EQUAL(r2._sequence, 2, "the requests should be numbered in order");
+  ASSERT_EQUAL(r1._chunk_size, 4 * MIN_CHUNK, "the requests should ask for the chunk size");
+  ASSERT_EQUAL(r1._window, 3, "the requests should report the window");
+  ASSERT_FALSE(r0._received.length(), "nothing should be reported as received yet");
+  ASSERT_FALSE(window.can_request(), "the window should be full");
+  ASSERT_EQUAL(window.outstanding(), 3, "three requests should be outstanding");
+
+  // a full chunk that comes back quickly grows the chunk size.
+  ASSERT_TRUE(window.received(reply(2), 4 * MIN_CHUNK), "chunk two was asked for");
+  ASSERT_EQUAL(window.chunk_size(), 8 * MIN_CHUNK, "a quick full chunk should double the size");
+  ASSERT_FALSE(window.received(reply(2), 4 * MIN_CHUNK), "a duplicate should be refused");
+  ASSERT_FALSE(window.received(reply(9), 4 * MIN_CHUNK), "an unknown chunk should be refused");
+  ASSERT_EQUAL(window.outstanding(), 2, "only the real reply should free a slot");
+  ASSERT_TRUE(window.can_request(), "a slot should have opened up");
+
+  // the next request tells the source about the chunk that skipped ahead.
+  file_chunk_ticket r3 = window.next_request();
+  ASSERT_EQUAL(r3._sequence, 3, "the numbering should carry on");
+  ASSERT_EQUAL(r3._chunk_size, 8 * MIN_CHUNK, "the larger size should be asked for");
+  ASSERT_EQUAL(r3._received.length(), 2, "one span should be reported");
+  ASSERT_TRUE( (r3._received.length() == 2) && (r3._received[0] == 2)
+      && (r3._received[1] == 2), "only chunk two should be reported");
+  ASSERT_FALSE(window.spans().received_sequence() >= 0, "chunk zero is still missing");
+
+  // the size doesn't grow past the maximum.
+  ASSERT_TRUE(window.received(reply(0), 8 * MIN_CHUNK), "chunk zero was asked for");
+  ASSERT_EQUAL(window.chunk_size(), 8 * MIN_CHUNK, "the size should stop at the maximum");
+  ASSERT_EQUAL(window.spans().received_sequence(), 0, "chunk zero should be in sequence");
+
+  // slow replies shrink the chunk size.
+  time_control::sleep_ms(transfer_window::TARGET_CHUNK_TIME + 100);
+  ASSERT_TRUE(window.received(reply(1), 8 * MIN_CHUNK), "chunk one was asked for");
+  ASSERT_EQUAL(window.chunk_size(), 4 * MIN_CHUNK, "a slow chunk should halve the size");
+  ASSERT_EQUAL(window.spans().received_sequence(), 2, "chunks zero to two should be in");
+
+  // a quick chunk that was mostly empty doesn't grow the size.
+  file_chunk_ticket r4 = window.next_request();
+  file_chunk_ticket r5 = window.next_request();
+  ASSERT_EQUAL(r4._sequence + 1, r5._sequence, "the numbering should carry on");
+  ASSERT_TRUE(window.received(reply(5, true), MIN_CHUNK), "chunk five was asked for");
+  ASSERT_EQUAL(window.chunk_size(), 4 * MIN_CHUNK, "a small chunk should not grow the size");
+
+  // the end has been seen, so no more requests go out, but we're not done
+  // until everything before the end has shown up.
+  ASSERT_FALSE(window.can_request(), "nothing past the end should be requested");
+  ASSERT_FALSE(window.done(), "chunks three and four are still missing");
+
+  // an earlier chunk also saying it's the end moves the end back.
+  ASSERT_TRUE(window.received(reply(3, true), 0), "chunk three was asked for");
+  ASSERT_TRUE(window.done(), "everything up to the earlier end has arrived");
+  ASSERT_EQUAL(window.outstanding(), 1, "chunk four should still be outstanding");
+  ASSERT_TRUE(window.received(reply(4), 0), "chunk four was still asked for");
+  ASSERT_TRUE(window.done(), "the transfer should stay done");
+  ASSERT_EQUAL(window.outstanding(), 0, "nothing should be outstanding");
+
+  // the closing ticket reports the whole transfer.
+  file_chunk_ticket closing = window.closing_request();
+  ASSERT_TRUE(closing._finished, "the closing ticket should be marked finished");
+  ASSERT_EQUAL(closing._sequence, 6, "the closing ticket should not reuse a sequence");
+  ASSERT_TRUE( (closing._received.length() == 2) && (closing._received[0] == 0)
+      && (closing._received[1] == 5), "every chunk should be reported");
+  ASSERT_EQUAL(window.outstanding(), 0, "the closing ticket is not outstanding");
+}
+
+int test_transfer_window::execute()
+{
+  FUNCDEF("execute");
+  test_limits();
+  test_out_of_order();
+  return final_report();
+}
+
+HOOPLE_MAIN(test_transfer_window, )
+
@@ -0,0 +1,566 @@
+/*****************************************************************************\
+*                                                                             *
+*  Name   : test_list_synchronizer                                            *
+*  Author : Chris Koeritz                                                     *
+*                                                                             *
+*  Purpose:                                                                   *
+*                                                                             *
+*    Checks the list_manager's bookkeeping and measures how many updates per  *
+*  second can be pushed through a list_synchronizer.  Also replicates a list  *
+*  between two synchronizers and compares the batch sizes.                    *
+*                                                                             *
+*******************************************************************************
+* Copyright (c) 2002-$now By Author.  This program is free software; you can  *
+* redistribute it and/or modify it under the terms of the GNU General Public  *
+* License as published by the Free Software Foundation; either version 2 of   *
+* the License or (at your option) any later version.  This is online at:      *
+*     http://www.fsf.org/copyleft/gpl.html                                    *
+* Please send any updates to: fred@gruntose.com                               *
+\*****************************************************************************/
+
+#include <application/hoople_main.h>
+#include <basis/astring.h>
+#include <loggers/program_wide_logger.h>
+#include <mathematics/chaos.h>
+#include <octopus/entity_defs.h>
+#include <structures/static_memory_gremlin.h>
+#include <structures/string_array.h>
+#include <synchronic/bundle_list.h>
+#include <synchronic/list_manager.h>
+#include <synchronic/list_synchronizer.h>
+#include <synchronic/replication.h>
+#include <synchronic/synchronizable.h>
+#include <timely/time_control.h>
+#include <timely/time_stamp.h>
+#include <unit_test/unit_base.h>
+
+using namespace application;
+using namespace basis;
+using namespace loggers;
+using namespace mathematics;
+using namespace octopi;
+using namespace structures;
+using namespace synchronic;
+using namespace timely;
+using namespace unit_test;
+
+const int BENCHMARK_OBJECTS = 50000;
+  // how many distinct objects are synchronized in the throughput test.
+
+const int BENCHMARK_UPDATE_ROUNDS = 3;
+  // how many times each object is changed during the throughput test.
+
+const int REPLICATED_OBJECTS = 2000;
+  // how many objects are copied between synchronizers.
+
+const int DESCRIPTION_SIZE = 200;
+  // how large the rarely changing part of the replicated objects is.
+
+//////////////
+
+// a trivial object state that just records a counter.
+
+class counter_state : public synchronizable
+{
+public:
+  int _value;
+
+  counter_state(const string_array &object_id, int value = 0)
+  : synchronizable(object_id), _value(value) { _mod = ADDED; }
+
+  DEFINE_CLASS_NAME("counter_state");
+
+  virtual outcome merge(const synchronizable &to_merge) {
+    const counter_state *cast = dynamic_cast<const counter_state *>(&to_merge);
+    if (!cast) return BAD_TYPE;
+    _value = cast->_value;
+    if (cast->_mod == DELETED) return EMPTY;
+    return OKAY;
+  }
+
+  virtual astring text_form() const
+  { return classifier().text_form() + a_sprintf("=%d", _value); }
+
+  virtual void text_form(base_string &fill) const { fill.assign(text_form()); }
+
+  virtual void pack(byte_array &packed_form) const
+  { pack_mod(packed_form); structures::attach(packed_form, _value); }
+
+  virtual bool unpack(byte_array &packed_form)
+  { return unpack_mod(packed_form) && structures::detach(packed_form, _value); }
+
+  virtual clonable *clone() const { return new counter_state(*this); }
+
+  virtual int packed_size() const { return packed_mod_size() + sizeof(int); }
+};
+
+//////////////
+
+class counter_list : public list_manager
+{
+public:
+  counter_list(const string_array &list_name) : list_manager(list_name, false) {}
+
+  DEFINE_CLASS_NAME("counter_list");
+
+  virtual outcome reconstitute(const string_array &classifier,
+      byte_array &packed_form, infoton * &reformed) {
+    counter_state *to_return = new counter_state(classifier);
+    if (!to_return->unpack(packed_form)) {
+      WHACK(to_return);
+      return GARBAGE;
+    }
+    reformed = to_return;
+    return OKAY;
+  }
+};
+
+//////////////
+
+// an object with a large description and a small reading that changes often.
+// it tracks which version each attribute was changed in so that it can
+// provide deltas.
+
+class sensor_state : public synchronizable
+{
+public:
+  int _reading;
+  astring _description;
+  int _reading_version;  // the list version where the reading changed.
+  int _description_version;  // the same for the description.
+
+  sensor_state(const string_array &object_id, int reading = 0,
+      const astring &description = astring::empty_string())
+  : synchronizable(object_id), _reading(reading), _description(description),
+    _reading_version(0), _description_version(0) { _mod = ADDED; }
+
+  DEFINE_CLASS_NAME("sensor_state");
+
+  enum delta_parts { READING = 0x1, DESCRIPTION = 0x2 };
+
+  virtual outcome merge(const synchronizable &to_merge) {
+    const sensor_state *cast = dynamic_cast<const sensor_state *>(&to_merge);
+    if (!cast) return BAD_TYPE;
+    if (cast->_reading != _reading) {
+      _reading = cast->_reading;
+      _reading_version = _version;
+    }
+    if (cast->_description != _description) {
+      _description = cast->_description;
+      _description_version = _version;
+    }
+    if (cast->_mod == DELETED) return EMPTY;
+    return OKAY;
+  }
+
+  virtual bool pack_delta(byte_array &packed_form, int since_version) const {
+    abyte parts = 0;
+    if (_reading_version > since_version) parts |= READING;
+    if (_description_version > since_version) parts |= DESCRIPTION;
+    structures::attach(packed_form, parts);
+    if (parts & READING) structures::attach(packed_form, _reading);
+    if (parts & DESCRIPTION) _description.pack(packed_form);
+    return true;
+  }
+
+  virtual bool merge_delta(byte_array &packed_form) {
+    abyte parts;
+    if (!structures::detach(packed_form, parts)) return false;
+    if (parts & READING) {
+      if (!structures::detach(packed_form, _reading)) return false;
+      _reading_version = _version;
+    }
+    if (parts & DESCRIPTION) {
+      if (!_description.unpack(packed_form)) return false;
+      _description_version = _version;
+    }
+    return true;
+  }
+
+  virtual astring text_form() const
+  { return classifier().text_form() + a_sprintf("=%d", _reading); }
+
+  virtual void text_form(base_string &fill) const { fill.assign(text_form()); }
+
+  virtual void pack(byte_array &packed_form) const {
+    pack_mod(packed_form);
+    structures::attach(packed_form, _reading);
+    _description.pack(packed_form);
+  }
+
+  virtual bool unpack(byte_array &packed_form) {
+    return unpack_mod(packed_form) && structures::detach(packed_form, _reading)
+        && _description.unpack(packed_form);
+  }
+
+  virtual clonable *clone() const { return new sensor_state(*this); }
+
+  virtual int packed_size() const
+  { return packed_mod_size() + sizeof(int) + _description.packed_size(); }
+};
+
+//////////////
+
+class sensor_list : public list_manager
+{
+public:
+  sensor_list(const string_array &list_name) : list_manager(list_name, false) {}
+
+  DEFINE_CLASS_NAME("sensor_list");
+
+  virtual outcome reconstitute(const string_array &classifier,
+      byte_array &packed_form, infoton * &reformed) {
+    sensor_state *to_return = new sensor_state(classifier);
+    if (!to_return->unpack(packed_form)) {
+      WHACK(to_return);
+      return GARBAGE;
+    }
+    reformed = to_return;
+    return OKAY;
+  }
+};
+
+//////////////
+
+class test_list_synchronizer : virtual public unit_base, virtual public application_shell
+{
+public:
+  test_list_synchronizer() : application_shell() {}
+  DEFINE_CLASS_NAME("test_list_synchronizer");
+  virtual int execute();
+
+  string_array list_name() const {
+    const char *names[] = { "counters", "test" };
+    return string_array(2, names);
+  }
+
+  string_array object_name(int which) const {
+    string_array to_return = list_name();
+    to_return += a_sprintf("item_%06d", which);
+    return to_return;
+  }
+
+  string_array sensor_list_name() const {
+    const char *names[] = { "sensors", "test" };
+    return string_array(2, names);
+  }
+
+  string_array sensor_name(int which) const {
+    string_array to_return = sensor_list_name();
+    to_return += a_sprintf("sensor_%06d", which);
+    return to_return;
+  }
+
+  int packed_batch_size(const replication_batch &batch) const {
+    byte_array packed;
+    infoton::fast_pack(packed, batch);
+    return packed.length();
+  }
+
+  int deliver(list_synchronizer &from, list_synchronizer &to,
+      octopus_request_id &id);
+    // sends a batch of changes "from" one synchronizer "to" the other by way
+    // of evaluate() and passes the acknowledgement back.  returns the size
+    // of the packed batch.
+
+  int sensor_reading(list_synchronizer &syncher, int which);
+    // returns the reading for a sensor in "syncher" or -1 if it's missing.
+
+  void test_bookkeeping();
+  void test_throughput();
+  void test_replication();
+};
+
+#define LOG(s) CLASS_EMERGENCY_LOG(program_wide_logger::get(), s)
+
+void test_list_synchronizer::test_bookkeeping()
+{
+  FUNCDEF("test_bookkeeping");
+  counter_list lister(list_name());
+
+  const int OBJECTS = 400;
+  octopus_request_id id = octopus_request_id::randomized_id();
+  byte_array transformed;
+  for (int i = 0; i < OBJECTS; i++) {
+    counter_state bun(object_name(i), i);
+    ASSERT_EQUAL(lister.consume(bun, id, transformed).value(), list_manager::OKAY,
+        "adding new object should work");
+  }
+  ASSERT_EQUAL(lister.entries(), OBJECTS, "all objects should be listed");
+  ASSERT_TRUE(lister.is_listed(object_name(OBJECTS / 2)), "object should be found");
+  ASSERT_FALSE(lister.is_listed(object_name(OBJECTS + 1)), "bogus object should be missing");
+
+  // change an object and make sure the merge took effect.
+  counter_state changer(object_name(13), 9813);
+  changer._mod = synchronizable::CHANGED;
+  lister.consume(changer, id, transformed);
+  counter_state *found = dynamic_cast<counter_state *>(lister.clone_object(object_name(13)));
+  ASSERT_TRUE(found, "cloned object should exist");
+  if (found) ASSERT_EQUAL(found->_value, 9813, "merged value should be stored");
+  WHACK(found);
+  ASSERT_EQUAL(lister.entries(), OBJECTS, "changing should not add entries");
+
+  // age half of the objects and make sure cleaning removes only those.
+  for (int i = 0; i < OBJECTS; i += 2)
+    ASSERT_TRUE(lister.update(object_name(i), -10 * MINUTE_ms), "aging should work");
+  lister.clean(MINUTE_ms);
+  ASSERT_EQUAL(lister.entries(), OBJECTS / 2, "only the aged objects should be cleaned");
+  for (int i = 0; i < OBJECTS; i++) {
+    ASSERT_EQUAL(int(lister.is_listed(object_name(i))), i % 2,
+        "cleaning should remove exactly the old entries");
+  }
+
+  // deletion through merging and explicit zapping.
+  counter_state deleter(object_name(1), 0);
+  deleter._mod = synchronizable::DELETED;
+  lister.consume(deleter, id, transformed);
+  ASSERT_FALSE(lister.is_listed(object_name(1)), "deleted object should be gone");
+  ASSERT_TRUE(lister.zap(object_name(3)), "zapping should find the object");
+  ASSERT_FALSE(lister.zap(object_name(3)), "zapping twice should fail");
+  ASSERT_EQUAL(lister.entries(), OBJECTS / 2 - 2, "removals should be counted");
+
+  bundle_list all;
+  lister.retrieve(all);
+  ASSERT_EQUAL(all.elements(), lister.entries(), "retrieve should copy every entry");
+}
+
+void test_list_synchronizer::test_throughput()
+{
+  FUNCDEF("test_throughput");
+  list_synchronizer syncher;
+  ASSERT_EQUAL(syncher.add_list(new counter_list(list_name())).value(),
+      list_manager::OKAY, "adding list should work");
+  octopus_request_id id = octopus_request_id::randomized_id();
+
+  // time the initial population of the list.
+  time_stamp start;
+  for (int i = 0; i < BENCHMARK_OBJECTS; i++) {
+    id._request_num++;
+    syncher.evaluate(new counter_state(object_name(i), i), id, true);
+  }
+  double add_time = time_stamp().value() - start.value();
+
+  // time a series of changes to every object.
+  start.reset();
+  for (int round = 0; round < BENCHMARK_UPDATE_ROUNDS; round++) {
+    for (int i = 0; i < BENCHMARK_OBJECTS; i++) {
+      counter_state *changer = new counter_state(object_name(i), i + round);
+      changer->_mod = synchronizable::CHANGED;
+      id._request_num++;
+      syncher.evaluate(changer, id, true);
+    }
+  }
+  double update_time = time_stamp().value() - start.value();
+
+  // age a tenth of the objects and time the cleaning.
+  for (int i = 0; i < BENCHMARK_OBJECTS; i += 10)
+    syncher.update(object_name(i));
+  list_manager *lister = dynamic_cast<list_manager *>
+      (syncher.lock_tentacle(list_name()));
+  ASSERT_TRUE(lister, "list should be registered");
+  if (!lister) return;
+  for (int i = 0; i < BENCHMARK_OBJECTS; i += 10)
+    lister->update(object_name(i), -10 * MINUTE_ms);
+  syncher.unlock_tentacle(lister);
+  start.reset();
+  syncher.clean(MINUTE_ms);
+  double clean_time = time_stamp().value() - start.value();
+
+  lister = dynamic_cast<list_manager *>(syncher.lock_tentacle(list_name()));
+  int remaining = lister->entries();
+  syncher.unlock_tentacle(lister);
+  ASSERT_EQUAL(remaining, BENCHMARK_OBJECTS - BENCHMARK_OBJECTS / 10,
+      "cleaning should only remove the aged objects");
+
+  double updates = double(BENCHMARK_OBJECTS) * BENCHMARK_UPDATE_ROUNDS;
+  log(a_sprintf("added %d objects in %.0f ms (%.0f adds/s).", BENCHMARK_OBJECTS,
+      add_time, BENCHMARK_OBJECTS / maximum(add_time, 1.0) * SECOND_ms));
+  log(a_sprintf("applied %.0f updates in %.0f ms (%.0f updates/s).", updates,
+      update_time, updates / maximum(update_time, 1.0) * SECOND_ms));
+  log(a_sprintf("cleaned %d expired objects in %.0f ms.", BENCHMARK_OBJECTS / 10,
+      clean_time));
+}
+
+int test_list_synchronizer::deliver(list_synchronizer &from,
+    list_synchronizer &to, octopus_request_id &id)
+{
+  FUNCDEF("deliver");
+  replication_batch *batch = new replication_batch;
+  ASSERT_EQUAL(from.replicate(sensor_list_name(), to.name(), *batch).value(),
+      common::OKAY, "replicating a known list should work");
+  int size = packed_batch_size(*batch);
+  // send the batch through its packed form, as it would be on the wire.
+  byte_array packed;
+  batch->pack(packed);
+  WHACK(batch);
+  infoton *restored = NULL_POINTER;
+  ASSERT_EQUAL(to.restore(replication_batch::replication_batch_classifier(),
+      packed, restored).value(), common::OKAY, "batch should be restored");
+  id._request_num++;
+  to.evaluate(restored, id, true);
+  replication_ack *ack = dynamic_cast<replication_ack *>
+      (to.acquire_specific_result(id));
+  ASSERT_TRUE(ack, "batch should be acknowledged");
+  if (!ack) return size;
+  ASSERT_EQUAL(from.acknowledge(*ack).value(), common::OKAY,
+      "acknowledgement should be accepted");
+  WHACK(ack);
+  return size;
+}
+
+int test_list_synchronizer::sensor_reading(list_synchronizer &syncher,
+    int which)
+{
+  list_manager *lister = dynamic_cast<list_manager *>
+      (syncher.lock_tentacle(sensor_list_name()));
+  if (!lister) return -1;
+  sensor_state *found = dynamic_cast<sensor_state *>
+      (lister->clone_object(sensor_name(which)));
+  syncher.unlock_tentacle(lister);
+  int to_return = found? found->_reading : -1;
+  WHACK(found);
+  return to_return;
+}
+
+void test_list_synchronizer::test_replication()
+{
+  FUNCDEF("test_replication");
+  list_synchronizer source;
+  list_synchronizer target;
+  sensor_list *source_list = new sensor_list(sensor_list_name());
+  source.add_list(source_list);
+  target.add_list(new sensor_list(sensor_list_name()));
+  octopus_request_id id = octopus_request_id::randomized_id();
+
+  // load up the source and see how big the individual infotons would be.
+  astring description('d', DESCRIPTION_SIZE);
+  int individual_size = 0;
+  for (int i = 0; i < REPLICATED_OBJECTS; i++) {
+    sensor_state *bun = new sensor_state(sensor_name(i), i, description);
+    byte_array packed;
+    infoton::fast_pack(packed, *bun);
+    individual_size += packed.length();
+    id._request_num++;
+    source.evaluate(bun, id, true);
+  }
+
+  // the first batch has to be a full copy.
+  int full_size = deliver(source, target, id);
+  for (int i = 0; i < REPLICATED_OBJECTS; i += 97)
+    ASSERT_EQUAL(sensor_reading(target, i), i, "full copy should arrive");
+
+  // change a tenth of the readings, which should only send those readings.
+  const int CHANGED = REPLICATED_OBJECTS / 10;
+  for (int i = 0; i < CHANGED; i++) {
+    sensor_state *changer = new sensor_state(sensor_name(i), 5000 + i,
+        description);
+    changer->_mod = synchronizable::CHANGED;
+    id._request_num++;
+    source.evaluate(changer, id, true);
+  }
+  replication_batch peek;
+  source.replicate(sensor_list_name(), target.name(), peek);
+  ASSERT_FALSE(peek._full, "a known peer should get only the changes");
+  ASSERT_EQUAL(peek._records.length(), CHANGED, "only changed objects are sent");
+  int delta_size = deliver(source, target, id);
+  for (int i = 0; i < CHANGED; i += 7)
+    ASSERT_EQUAL(sensor_reading(target, i), 5000 + i, "deltas should arrive");
+  ASSERT_EQUAL(sensor_reading(target, CHANGED + 1), CHANGED + 1,
+      "unchanged objects should be left alone");
+  ASSERT_TRUE(delta_size < individual_size / 10,
+      "the delta batch should be much smaller than sending objects");
+
+  // nothing new means an empty batch.
+  source.replicate(sensor_list_name(), target.name(), peek);
+  ASSERT_EQUAL(peek._records.length(), 0, "acknowledged changes are not resent");
+
+  // deletions are replicated too.
+  sensor_state *deleter = new sensor_state(sensor_name(3));
+  deleter->_mod = synchronizable::DELETED;
+  id._request_num++;
+  source.evaluate(deleter, id, true);
+  deliver(source, target, id);
+  ASSERT_EQUAL(sensor_reading(target, 3), -1, "deletion should be replicated");
+
+  // a receiver that lost track of the source must ask for a full copy.
+  list_synchronizer amnesiac;
+  amnesiac.add_list(new sensor_list(sensor_list_name()));
+  sensor_state *changer = new sensor_state(sensor_name(5), 77, description);
+  changer->_mod = synchronizable::CHANGED;
+  id._request_num++;
+  source.evaluate(changer, id, true);
+  replication_batch gapped;
+  source.replicate(sensor_list_name(), target.name(), gapped);
+  replication_ack ack;
+  ASSERT_EQUAL(amnesiac.apply_batch(gapped, ack).value(), common::PARTIAL,
+      "a batch with a gap should be refused");
+  ASSERT_TRUE(ack._resync, "a gap should ask for a resync");
+  ack._peer = target.name();  // pretend the target had forgotten.
+  source.acknowledge(ack);
+  source.replicate(sensor_list_name(), target.name(), peek);
+  ASSERT_TRUE(peek._full, "a resync request should produce a full copy");
+  ASSERT_EQUAL(peek._records.length(), REPLICATED_OBJECTS - 1,
+      "the full copy should hold every object");
+
+  // a peer that is resynchronized after missing a deletion must still hear
+  // about it, or it would keep its copy of that object forever.
+  list_synchronizer laggard;
+  laggard.add_list(new sensor_list(sensor_list_name()));
+  deliver(source, laggard, id);
+  const int MISSED = CHANGED + 8;  // a sensor that still has its first reading.
+  ASSERT_EQUAL(sensor_reading(laggard, MISSED), MISSED,
+      "the laggard should get a copy");
+  deleter = new sensor_state(sensor_name(MISSED));
+  deleter->_mod = synchronizable::DELETED;
+  id._request_num++;
+  source.evaluate(deleter, id, true);
+  replication_ack lost;
+  lost._list_name = sensor_list_name();
+  lost._peer = laggard.name();
+  lost._resync = true;
+  source.acknowledge(lost);
+  replication_batch resync;
+  source.replicate(sensor_list_name(), laggard.name(), resync);
+  ASSERT_TRUE(resync._full, "the laggard should get a full copy");
+  int removals = 0;
+  for (int i = 0; i < resync._records.length(); i++)
+    if (resync._records[i]._kind == replication_record::REMOVED) removals++;
+  ASSERT_EQUAL(removals, 1, "the full copy should carry the missed deletion");
+  ASSERT_EQUAL(laggard.apply_batch(resync, lost).value(), common::OKAY,
+      "the full copy should be applied");
+  ASSERT_EQUAL(sensor_reading(laggard, MISSED), -1,
+      "the missed deletion should be applied from the full copy");
+  ASSERT_EQUAL(sensor_reading(laggard, MISSED + 1), MISSED + 1,
+      "other objects should remain");
+
+  // a list that's wiped starts over with its peers rather than acting as if
+  // they were still up to date.
+  deliver(source, target, id);
+  source.replicate(sensor_list_name(), target.name(), peek);
+  ASSERT_FALSE(peek._full, "the target should be caught up before the wipe");
+  source_list->reset();
+  source.replicate(sensor_list_name(), target.name(), peek);
+  ASSERT_TRUE(peek._full, "a wiped list should send its peers full copies");
+  int objects = 0;
+  for (int i = 0; i < peek._records.length(); i++)
+    if (peek._records[i]._kind != replication_record::REMOVED) objects++;
+  ASSERT_EQUAL(objects, 0, "a wiped list has no objects to send");
+
+  log(a_sprintf("%d objects as separate infotons: %d bytes.",
+      REPLICATED_OBJECTS, individual_size));
+  log(a_sprintf("full replication batch: %d bytes.", full_size));
+  log(a_sprintf("delta batch for %d changed readings: %d bytes (%.1f bytes "
+      "per change).", CHANGED, delta_size, double(delta_size) / CHANGED));
+}
+
+int test_list_synchronizer::execute()
+{
+  FUNCDEF("execute");
+  test_bookkeeping();
+  test_throughput();
+  test_replication();
+  return final_report();
+}
+
+HOOPLE_MAIN(test_list_synchronizer, )
+